@@ -29,6 +29,6 @@ while (( "$#" )); do
 done
 
 clang++ -std=c++17 -c -g -O2 -o- -Wall -Wextra -m32 -march=i386 -ggdb -S $INPUT_FILE > $INPUT_FILE.x86.asm
-cat $INPUT_FILE.x86.asm | /home/robindegen/x86-to-6502/build/x86-to-6502 > $INPUT_FILE.6502.asm
+cat $INPUT_FILE.x86.asm | /home/robindegen/x86-to-6502/build/x86-to-6502 --65c02 > $INPUT_FILE.6502.asm
 cat $INPUT_FILE.6502.asm > $OUTPUT_FILE
 
@@ -1,12 +1,12 @@
 #pragma once
 
+#include <ca/intel_386.h>
 #include <ca/target.h>
+#include <vector>
 
 namespace ca
 {
 
-class intel_386;
-
 class cross_assembler
 {
 public:
@@ -19,8 +19,12 @@ public:
     cross_assembler(const cross_assembler &) noexcept = delete;
     auto operator=(const cross_assembler &) noexcept -> cross_assembler & = delete;
 
+    // Translates the .s file on the standard input.
     void assemble();
 
+    // Translates a program that was already read, such as the one ca::link gives for several files.
+    void assemble(std::vector<intel_386> instructions);
+
 private:
     target &target_;
 };
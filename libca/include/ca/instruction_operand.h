@@ -1,6 +1,8 @@
 #pragma once
 
 #include <ca/intel_386_register.h>
+#include <cstdint>
+#include <optional>
 #include <string>
 #include <utility>
 #include <cassert>
@@ -15,6 +17,50 @@ enum class operand_type
     reg /*ister*/
 };
 
+// A memory reference in AT&T syntax, symbol+displacement(base,index,scale), where every part is optional; the
+// address is symbol + displacement + base + index * scale.
+struct memory_operand
+{
+    std::string symbol;
+    int displacement = 0;
+    intel_386_register base = intel_386_register::unknown;
+    intel_386_register index = intel_386_register::unknown;
+    int scale = 1;
+};
+
+// Returns the AT&T syntax of the given memory reference; for example table+2(,%ecx).
+auto to_string(const memory_operand &m) -> std::string;
+
+// What a literal stands for, when that is known from the way it was written
+enum class literal_kind
+{
+    text,      // Anything else, like a label or a memory reference
+    immediate, // A number, like $5 on the x86 or #5 on the 6502
+    address,   // A numeric address, like 53280
+    symbol     // The address of a symbol as an immediate, or a byte of it; like $table+2 on the x86 or #<table
+};
+
+// The bytes of the address of a symbol that an immediate stands for
+enum class byte_selection
+{
+    all,
+    low, // #<table
+    high // #>table
+};
+
+// A literal, parsed once when the operand is created
+struct literal_value
+{
+    literal_kind kind = literal_kind::text;
+    std::int64_t number = 0; // The immediate, the address, or the offset from the symbol
+    int width = 4;           // The size of an immediate in bytes
+    std::string symbol{};
+    byte_selection selection = byte_selection::all;
+};
+
+// Memory references are literals like any other operand that isn't a register, but the ones written with a base or
+// index register also keep their parts. Immediates and addresses keep their value next to the text they are written
+// as, so that it is parsed only once.
 class instruction_operand
 {
 public:
@@ -27,12 +73,32 @@ public:
         assert(type_ == operand_type::literal);
     }
 
+    instruction_operand(literal_value v, std::string text)
+        : type_{operand_type::literal}
+        , value_{std::move(text)}
+        , literal_{std::move(v)}
+    {
+    }
+
+    explicit instruction_operand(memory_operand m)
+        : type_{operand_type::literal}
+        , value_{to_string(m)}
+        , memory_{std::move(m)}
+    {
+    }
+
     instruction_operand(const intel_386_register reg)
         : type_{operand_type::reg}
         , register_{reg}
     {
     }
 
+    // An immediate in AT&T syntax, like $-1
+    static auto immediate(const std::int64_t value, const int width = 4) -> instruction_operand
+    {
+        return {{literal_kind::immediate, value, width}, "$" + std::to_string(value)};
+    }
+
     bool operator==(const instruction_operand &other) const
     {
         return type_ == other.type_ && register_ == other.register_ && value_ == other.value_;
@@ -53,6 +119,11 @@ public:
         return type_ == operand_type::reg;
     }
 
+    auto is_memory() const noexcept
+    {
+        return memory_.has_value();
+    }
+
     auto type() const noexcept
     {
         return type_;
@@ -64,6 +135,17 @@ public:
         return register_;
     }
 
+    const auto &memory() const noexcept
+    {
+        assert(memory_);
+        return *memory_;
+    }
+
+    const auto &literal() const noexcept
+    {
+        return literal_;
+    }
+
     const auto &value() const noexcept
     {
         return value_;
@@ -72,12 +154,16 @@ public:
     void set_value(std::string value) noexcept
     {
         value_ = std::move(value);
+        memory_.reset();
+        literal_ = {};
     }
 
 private:
     operand_type type_ = operand_type::empty;
     intel_386_register register_ = intel_386_register::unknown;
     std::string value_;
+    std::optional<memory_operand> memory_;
+    literal_value literal_;
 };
 
 } // namespace ca
@@ -2,6 +2,7 @@
 
 #include "asm_line.h"
 #include "instruction_operand.h"
+#include <istream>
 #include <vector>
 
 namespace ca
@@ -20,10 +21,22 @@ enum class intel_386_opcode : int
     decl,
     incb,
     incl,
+    ja,
+    jae,
+    jb,
+    jbe,
     je,
+    jg,
+    jge,
+    jl,
+    jle,
     jmp,
     jne,
+    jno,
+    jns,
+    jo,
     js,
+    leave,
     movb,
     movl,
     movzbl,
@@ -32,6 +45,7 @@ enum class intel_386_opcode : int
     notb,
     orb,
     orl,
+    popl,
     pushl,
     rep,
     ret,
@@ -59,9 +73,21 @@ public:
     intel_386(const int line_number, std::string line_text, line_type type, std::string opcode,
               std::string operand1 = "", std::string operand2 = "");
 
+    // Reads a whole .s file from the standard input and resolves its labels.
     static auto parse() -> std::vector<intel_386>;
     static auto parse(const std::string &line, const int line_number) -> intel_386;
 
+    // Reads the lines of a .s file as they are.
+    static auto read(std::istream &input) -> std::vector<intel_386>;
+
+    // Removes the labels that nothing refers to, except for the entry points, and gives the others the names the
+    // targets write them with.
+    static void resolve_labels(std::vector<intel_386> &instructions);
+
+    // Whether the program starts at the label: main and the nmi and irq handlers, with or without the underscore
+    // that some compilers put in front of C names.
+    static auto is_entry_point(const std::string &label) -> bool;
+
     auto line_number() const noexcept
     {
         return line_number_;
@@ -87,6 +113,9 @@ public:
         return opcode_;
     }
 
+    // Replaces the opcode of this instruction, for example when an optimization pass rewrites it.
+    void set_opcode(const intel_386_opcode opcode);
+
     const auto &operand1() const noexcept
     {
         return operand1_;
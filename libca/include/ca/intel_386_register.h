@@ -1,5 +1,7 @@
 #pragma once
 
+#include <string>
+
 namespace ca
 {
 
@@ -49,4 +51,16 @@ enum class intel_386_register
     esp
 };
 
+// Returns the 32-bit register the given (sub)register is part of; for example eax for ah.
+auto get_base_register(const intel_386_register reg) -> intel_386_register;
+
+// Returns the offset in bytes of the given (sub)register within its 32-bit register; for example 1 for ah.
+auto get_register_offset(const intel_386_register reg) -> int;
+
+// Returns the size of the given register in bytes.
+auto get_register_size(const intel_386_register reg) -> int;
+
+// Returns the name of the given register in AT&T syntax; for example %eax.
+auto to_string(const intel_386_register reg) -> std::string;
+
 } // namespace ca
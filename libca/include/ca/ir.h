@@ -0,0 +1,162 @@
+#pragma once
+
+#include <ca/instruction_operand.h>
+#include <ca/intel_386.h>
+#include <ca/intel_386_register.h>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace ca
+{
+
+// A small machine independent representation of the x86 instruction stream that the optimizations shared by all
+// targets work on. Targets still select their instructions from intel_386 lines, which are rebuilt from it after
+// the passes ran.
+namespace ir
+{
+
+// Every byte of the eight 32-bit registers is a virtual register of its own, so that writes to al, ah, ax and eax
+// are told apart. A register set has one bit for each of them; bits 0 to 3 are the bytes of eax, 4 to 7 those of
+// ebx, followed by ecx, edx, esi, edi, ebp and esp.
+using register_set = std::uint32_t;
+constexpr register_set all_registers = 0xffffffff;
+
+// The bytes of the given (sub)register
+auto get_registers(intel_386_register reg) -> register_set;
+
+// The flags are explicit, so that instructions like inc that leave the carry alone don't end its use.
+using flag_set = std::uint8_t;
+constexpr flag_set carry_flag = 1;
+constexpr flag_set zero_flag = 2;
+constexpr flag_set sign_flag = 4;
+constexpr flag_set overflow_flag = 8;
+constexpr flag_set all_flags = carry_flag | zero_flag | sign_flag | overflow_flag;
+
+enum class operation
+{
+    label,
+    move,        // Also a load or a store, when one of the operands is memory
+    zero_extend, // A move into a whole 32-bit register of a byte or word
+    add,
+    subtract,
+    subtract_with_borrow,
+    bitwise_and,
+    bitwise_or,
+    bitwise_xor,
+    bitwise_not,
+    negate,
+    increment,
+    decrement,
+    shift_left,
+    shift_right,
+    shift_right_arithmetic,
+    compare,
+    test,
+    push,
+    pop,
+    leave,
+    branch,
+    jump,
+    call,
+    ret,
+    string_operation, // rep with the operation as the source and, once it's known, the byte count as destination
+    opaque            // Lines the IR can't tell anything about; they may read and write everything
+};
+
+enum class condition
+{
+    none,
+    above,
+    above_or_equal,
+    below,
+    below_or_equal,
+    equal,
+    greater,
+    greater_or_equal,
+    less,
+    less_or_equal,
+    not_equal,
+    not_overflow,
+    not_sign,
+    overflow,
+    sign
+};
+
+struct instruction
+{
+    operation op = operation::opaque;
+    condition cond = condition::none; // Of branches
+
+    // The number of bytes written, or read by compare and test. Zero extensions also have the width they read.
+    int width = 4;
+    int source_width = 4;
+
+    // Single operand instructions like inc and shifts by one only have a destination. Compare and test read it
+    // without writing it. Labels, branches, jumps and calls have their label as source.
+    instruction_operand source;
+    instruction_operand destination;
+
+    register_set reads = 0;
+    register_set writes = 0;
+    flag_set flags_read = 0;
+    flag_set flags_written = 0;
+    bool loads = false;  // Reads memory, which may be memory mapped I/O
+    bool stores = false; // Writes memory
+
+    // The index of the intel_386 line the instruction was built from
+    size_t line = 0;
+};
+
+// Works out what the instruction reads and writes from its operation and operands. Passes call this after they
+// change an instruction.
+void update_effects(instruction &i);
+
+// The x86 opcode for the operation at the given width, or unknown if there is none.
+auto select_opcode(const instruction &i) -> intel_386_opcode;
+
+// One instruction for every label and instruction line. Directives, comments and empty lines aren't part of it.
+auto build(const std::vector<intel_386> &lines) -> std::vector<instruction>;
+
+// Brings the lines the instructions were built from up to date with them. Lines whose instruction was removed are
+// left out; lines without one are kept as they are.
+void lower(const std::vector<instruction> &instructions, std::vector<intel_386> &lines);
+
+// The registers and flags that may be read before they are written again
+struct live_state
+{
+    register_set registers = 0;
+    flag_set flags = 0;
+};
+
+// The state live after each instruction. Jumps to labels that aren't in the code, returns and the end of the code
+// keep everything live, except for the flags at returns.
+auto analyze_liveness(const std::vector<instruction> &instructions) -> std::vector<live_state>;
+
+// Tracks which register bytes hold known constants or copies of other register bytes from label to label.
+// Arithmetic on known values whose flags aren't used is folded into moves, register sources of moves with a
+// known value become immediates, and register sources that copy another register read that one instead. Known
+// counts of string operations are annotated. Returns true if anything changed.
+auto propagate_copies_and_constants(std::vector<instruction> &instructions) -> bool;
+
+// Removes instructions whose registers and flags are all overwritten before they are read. Reads of memory are
+// kept. Returns true if anything was removed.
+auto eliminate_dead_code(std::vector<instruction> &instructions) -> bool;
+
+// Turns 32-bit moves and arithmetic into byte operations where only the low byte of their result is used and
+// their flags aren't. Returns true if anything changed.
+auto narrow(std::vector<instruction> &instructions) -> bool;
+
+// The names of the passes optimize can run, in the order it runs them
+auto get_pass_names() -> std::vector<std::string>;
+
+// Runs the passes on the lines until none of them changes anything.
+void optimize(std::vector<intel_386> &lines);
+
+// Runs the passes named in enabled on the lines until none of them changes anything.
+void optimize(std::vector<intel_386> &lines, const std::vector<std::string> &enabled);
+
+} // namespace ir
+
+} // namespace ca
@@ -0,0 +1,16 @@
+#pragma once
+
+#include <ca/intel_386.h>
+#include <string>
+#include <vector>
+
+namespace ca
+{
+
+// Joins the text of several .s files into one program, so that it can be translated as a whole. Labels that a unit
+// doesn't export with .globl are renamed so they can't clash with the labels of other units, and calls between the
+// units are resolved through the exported names. Functions and data that can't be reached from the entry points of
+// intel_386::is_entry_point are removed before the labels are resolved as intel_386::parse does for a single file.
+auto link(const std::vector<std::string> &units) -> std::vector<intel_386>;
+
+} // namespace ca
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <ca/intel_386.h>
+#include <vector>
+
+namespace ca
+{
+
+// A block of RAM that the translated program may use freely.
+struct memory_area
+{
+    int address;
+    int size;
+
+    // The target pulls the arguments it pushed for a call off the stack again, so the stack pointer arithmetic that
+    // pops them is kept.
+    bool pops_arguments = false;
+
+    // Arguments are passed in fixed memory that the next call overwrites, with this many bytes of each 4 byte slot on
+    // the x86 stack. Functions that make calls copy the arguments they read into their frame on entry.
+    int copied_argument_bytes = 0;
+};
+
+// Gives the locals of every function a fixed place in the given memory area, as the 6502 stack is too small and
+// can't be indexed cheaply. Frames of functions that are never active at the same time share the same bytes; a
+// function is placed after all of its callers according to the call graph, and interrupt handlers get an area of
+// their own. Local N(%esp) and N(%ebp) operands become absolute addresses, the stack pointer arithmetic and frame
+// pointer setup that maintained them are removed, and arguments are addressed as N(%esp) relative to the pushes
+// that are still left, unless they are copied into the frame. Recursive functions and functions that run both
+// inside and outside of interrupt handlers can't be placed; they are reported and left as they are.
+void allocate_static_frames(std::vector<intel_386> &instructions, const memory_area &area);
+
+} // namespace ca
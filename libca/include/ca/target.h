@@ -1,6 +1,7 @@
 #pragma once
 
 #include <ca/intel_386.h>
+#include <ca/static_frames.h>
 #include <string>
 #include <vector>
 
@@ -29,6 +30,12 @@ public:
     virtual void set_current_text(const std::string &text) = 0;
     virtual void finalize() = 0;
 
+    // The RAM that allocate_static_frames places the locals of every function in.
+    virtual auto get_frame_area() const -> memory_area = 0;
+
+    // The names of the shared passes that ir::optimize runs on the code before it is translated.
+    virtual auto get_ir_passes() const -> std::vector<std::string> = 0;
+
     // Bitwise instructions
     virtual void translate_andb(const instruction_operand &o1, const instruction_operand &o2) = 0;
     virtual void translate_andl(const instruction_operand &o1, const instruction_operand &o2) = 0;
@@ -44,6 +51,17 @@ public:
     virtual void translate_jne(const instruction_operand &o1, const instruction_operand &o2) = 0;
     virtual void translate_je(const instruction_operand &o1, const instruction_operand &o2) = 0;
     virtual void translate_js(const instruction_operand &o1, const instruction_operand &o2) = 0;
+    virtual void translate_ja(const instruction_operand &o1, const instruction_operand &o2) = 0;
+    virtual void translate_jae(const instruction_operand &o1, const instruction_operand &o2) = 0;
+    virtual void translate_jb(const instruction_operand &o1, const instruction_operand &o2) = 0;
+    virtual void translate_jbe(const instruction_operand &o1, const instruction_operand &o2) = 0;
+    virtual void translate_jg(const instruction_operand &o1, const instruction_operand &o2) = 0;
+    virtual void translate_jge(const instruction_operand &o1, const instruction_operand &o2) = 0;
+    virtual void translate_jl(const instruction_operand &o1, const instruction_operand &o2) = 0;
+    virtual void translate_jle(const instruction_operand &o1, const instruction_operand &o2) = 0;
+    virtual void translate_jno(const instruction_operand &o1, const instruction_operand &o2) = 0;
+    virtual void translate_jns(const instruction_operand &o1, const instruction_operand &o2) = 0;
+    virtual void translate_jo(const instruction_operand &o1, const instruction_operand &o2) = 0;
     virtual void translate_jmp(const instruction_operand &o1, const instruction_operand &o2) = 0;
     virtual void translate_ret(const instruction_operand &o1, const instruction_operand &o2) = 0;
     virtual void translate_retl(const instruction_operand &o1, const instruction_operand &o2) = 0;
@@ -71,6 +89,8 @@ public:
     virtual void translate_movzwl(const instruction_operand &o1, const instruction_operand &o2) = 0;
 
     // Misc instructions
+    virtual void translate_leave(const instruction_operand &o1, const instruction_operand &o2) = 0;
+    virtual void translate_popl(const instruction_operand &o1, const instruction_operand &o2) = 0;
     virtual void translate_pushl(const instruction_operand &o1, const instruction_operand &o2) = 0;
     virtual void translate_rep(const instruction_operand &o1, const instruction_operand &o2) = 0;
 
@@ -1,5 +1,7 @@
 #include <ca/cross_assembler.h>
 #include <ca/intel_386.h>
+#include <ca/ir.h>
+#include <ca/static_frames.h>
 #include "logger.h"
 #include <iostream>
 
@@ -60,7 +62,13 @@ cross_assembler::cross_assembler(target &t)
 
 void cross_assembler::assemble()
 {
-    auto instructions = intel_386::parse();
+    assemble(intel_386::parse());
+}
+
+void cross_assembler::assemble(std::vector<intel_386> instructions)
+{
+    allocate_static_frames(instructions, target_.get_frame_area());
+    ir::optimize(instructions, target_.get_ir_passes());
     internal::translate_instructions(instructions, target_);
     target_.finalize();
 }
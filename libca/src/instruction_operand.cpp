@@ -0,0 +1,33 @@
+#include <ca/instruction_operand.h>
+
+namespace ca
+{
+
+auto to_string(const memory_operand &m) -> std::string
+{
+    auto result = m.symbol;
+    if (m.displacement != 0 || result.empty())
+        result += (m.displacement > 0 && !result.empty() ? "+" : "") + std::to_string(m.displacement);
+
+    if (m.base == intel_386_register::unknown && m.index == intel_386_register::unknown)
+        return result;
+
+    // A displacement of 0 is implied by the parentheses
+    if (m.symbol.empty() && m.displacement == 0)
+        result.clear();
+
+    result += '(';
+    if (m.base != intel_386_register::unknown)
+        result += to_string(m.base);
+
+    if (m.index != intel_386_register::unknown)
+    {
+        result += ',' + to_string(m.index);
+        if (m.scale != 1)
+            result += ',' + std::to_string(m.scale);
+    }
+
+    return result + ')';
+}
+
+} // namespace ca
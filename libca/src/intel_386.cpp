@@ -5,7 +5,9 @@
 #include <iostream>
 #include <set>
 #include <map>
+#include <optional>
 #include <cctype>
+#include <algorithm>
 
 namespace ca
 {
@@ -25,10 +27,22 @@ static std::map<std::string, intel_386_opcode> opcode_string_lookup{
     {"decl",   intel_386_opcode::decl},
     {"incb",   intel_386_opcode::incb},
     {"incl",   intel_386_opcode::incl},
+    {"ja",     intel_386_opcode::ja},
+    {"jae",    intel_386_opcode::jae},
+    {"jb",     intel_386_opcode::jb},
+    {"jbe",    intel_386_opcode::jbe},
     {"je",     intel_386_opcode::je},
+    {"jg",     intel_386_opcode::jg},
+    {"jge",    intel_386_opcode::jge},
+    {"jl",     intel_386_opcode::jl},
+    {"jle",    intel_386_opcode::jle},
     {"jmp",    intel_386_opcode::jmp},
     {"jne",    intel_386_opcode::jne},
+    {"jno",    intel_386_opcode::jno},
+    {"jns",    intel_386_opcode::jns},
+    {"jo",     intel_386_opcode::jo},
     {"js",     intel_386_opcode::js},
+    {"leave",  intel_386_opcode::leave},
     {"movb",   intel_386_opcode::movb},
     {"movl",   intel_386_opcode::movl},
     {"movzbl", intel_386_opcode::movzbl},
@@ -37,6 +51,7 @@ static std::map<std::string, intel_386_opcode> opcode_string_lookup{
     {"notb",   intel_386_opcode::notb},
     {"orb",    intel_386_opcode::orb},
     {"orl",    intel_386_opcode::orl},
+    {"popl",   intel_386_opcode::popl},
     {"pushl",  intel_386_opcode::pushl},
     {"rep",    intel_386_opcode::rep},
     {"ret",    intel_386_opcode::ret},
@@ -107,19 +122,97 @@ static auto parse_opcode(asm_line::line_type t, const std::string &o) -> intel_3
     throw std::runtime_error("Unknown opcode: " + o);
 }
 
+static auto parse_register(const std::string &o) -> intel_386_register
+{
+    const auto result = register_name_lookup.find(o);
+    if (result != std::end(register_name_lookup))
+        return result->second;
+
+    throw std::runtime_error("Unknown register operand: '" + o + "'");
+}
+
+// Splits an expression like table+2, table or -4 into a symbol and a number.
+static auto parse_offset(const std::string &s, std::string &symbol) -> std::int64_t
+{
+    static const std::regex number{R"(-?\d{1,18})"};
+    static const std::regex symbol_and_number{R"((.*[^+-])([+-]\d{1,18}))"};
+
+    std::smatch match;
+    if (std::regex_match(s, number))
+    {
+        symbol.clear();
+        return std::stoll(s);
+    }
+
+    if (std::regex_match(s, match, symbol_and_number))
+    {
+        symbol = match[1];
+        return std::stoll(match[2]);
+    }
+
+    symbol = s;
+    return 0;
+}
+
+// Parses a memory reference with a base or index register, like 4(%esp), (%eax), table(,%ecx) or -2(%ebp,%esi,2).
+static auto parse_memory_operand(const std::string &o) -> std::optional<memory_operand>
+{
+    static const std::regex memory_reference{R"(([^(]*)\((%\w+)?(?:,(%\w+)(?:,(1|2|4|8))?)?\))"};
+
+    std::smatch match;
+    if (o.back() != ')' || !std::regex_match(o, match, memory_reference))
+        return {};
+
+    memory_operand m;
+    m.displacement = static_cast<int>(parse_offset(match[1], m.symbol));
+
+    if (match[2].matched)
+        m.base = parse_register(match[2]);
+
+    if (match[3].matched)
+        m.index = parse_register(match[3]);
+
+    if (match[4].matched)
+        m.scale = std::stoi(match[4]);
+
+    return m;
+}
+
+// Parses an immediate like $5 or $table+2, or a numeric address like 53280. Anything else stays text.
+static auto parse_literal(const std::string &o) -> literal_value
+{
+    const auto is_immediate = o[0] == '$';
+    if (is_immediate && o.size() == 1)
+        return {};
+
+    literal_value v;
+    v.number = parse_offset(is_immediate ? o.substr(1) : o, v.symbol);
+    if (is_immediate)
+        v.kind = v.symbol.empty() ? literal_kind::immediate : literal_kind::symbol;
+    else if (v.symbol.empty())
+        v.kind = literal_kind::address;
+    else
+        return {};
+
+    return v;
+}
+
 static auto parse_operand(std::string o) -> instruction_operand
 {
     if (o.empty())
         return {};
 
     if (o[0] != '%')
-        return {operand_type::literal, std::move(o)};
+    {
+        auto memory = parse_memory_operand(o);
+        if (memory)
+            return instruction_operand(std::move(*memory));
 
-    const auto result = register_name_lookup.find(o);
-    if (result != std::end(register_name_lookup))
-        return result->second;
+        auto literal = parse_literal(o);
+        return {std::move(literal), std::move(o)};
+    }
 
-    throw std::runtime_error("Unknown register operand: '" + o + "'");
+    return parse_register(o);
 }
 
 } // namespace internal
@@ -155,17 +248,36 @@ intel_386::intel_386(const int line_number, std::string line_text, line_type typ
 {
 }
 
-// TODO: This should be refactored into smaller methods.
+void intel_386::set_opcode(const intel_386_opcode opcode)
+{
+    const auto result =
+        std::find_if(std::begin(internal::opcode_string_lookup), std::end(internal::opcode_string_lookup),
+                     [opcode](const auto &entry) { return entry.second == opcode; });
+
+    if (result == std::end(internal::opcode_string_lookup))
+        throw std::runtime_error("Unknown opcode: " + std::to_string(static_cast<int>(opcode)));
+
+    opcode_ = opcode;
+    set_text(result->first);
+}
+
 auto intel_386::parse() -> std::vector<intel_386>
+{
+    auto instructions = read(std::cin);
+    resolve_labels(instructions);
+    return instructions;
+}
+
+auto intel_386::read(std::istream &input) -> std::vector<intel_386>
 {
     int lineno = 0;
 
     std::vector<intel_386> instructions;
 
-    while (std::cin.good())
+    while (input.good())
     {
         std::string line;
-        getline(std::cin, line);
+        getline(input, line);
 
         try
         {
@@ -182,18 +294,32 @@ auto intel_386::parse() -> std::vector<intel_386>
         ++lineno;
     }
 
+    return instructions;
+}
+
+auto intel_386::is_entry_point(const std::string &label) -> bool
+{
+    static const std::set<std::string> entry_points{"_main", "main", "_nmi", "nmi", "_irq", "irq"};
+    return entry_points.count(label) != 0;
+}
+
+// TODO: This should be refactored into smaller methods.
+void intel_386::resolve_labels(std::vector<intel_386> &instructions)
+{
     std::set<std::string> labels;
+    std::set<std::string> used_labels;
 
     for (const auto &i : instructions)
     {
         if (i.is_label())
         {
             labels.insert(i.text());
+
+            if (is_entry_point(i.text()))
+                used_labels.insert(i.text());
         }
     }
 
-    std::set<std::string> used_labels{"_main", "_nmi", "_irq"};
-
     for (const auto &i : instructions)
     {
         if (i.is_instruction())
@@ -213,7 +339,7 @@ auto intel_386::parse() -> std::vector<intel_386>
                                           {
                                               if (used_labels.count(i.text()) == 0)
                                               {
-                                                  // remove all unused labels that aren't 'main'
+                                                  // remove all unused labels that aren't entry points
                                                   return true;
                                               }
                                           }
@@ -253,8 +379,6 @@ auto intel_386::parse() -> std::vector<intel_386>
             i.operand2().set_value(itr2->second);
         }
     }
-
-    return instructions;
 }
 
 auto intel_386::parse(const std::string &line, const int line_number) -> intel_386
@@ -0,0 +1,178 @@
+#include <ca/intel_386_register.h>
+#include <stdexcept>
+#include <string>
+
+namespace ca
+{
+
+auto get_base_register(const intel_386_register reg) -> intel_386_register
+{
+    switch (reg)
+    {
+        case intel_386_register::al:
+        case intel_386_register::ah:
+        case intel_386_register::ax:
+        case intel_386_register::eax:
+            return intel_386_register::eax;
+        case intel_386_register::bl:
+        case intel_386_register::bh:
+        case intel_386_register::bx:
+        case intel_386_register::ebx:
+            return intel_386_register::ebx;
+        case intel_386_register::cl:
+        case intel_386_register::ch:
+        case intel_386_register::cx:
+        case intel_386_register::ecx:
+            return intel_386_register::ecx;
+        case intel_386_register::dl:
+        case intel_386_register::dh:
+        case intel_386_register::dx:
+        case intel_386_register::edx:
+            return intel_386_register::edx;
+        case intel_386_register::sil:
+        case intel_386_register::si:
+        case intel_386_register::esi:
+            return intel_386_register::esi;
+        case intel_386_register::dil:
+        case intel_386_register::di:
+        case intel_386_register::edi:
+            return intel_386_register::edi;
+        case intel_386_register::bpl:
+        case intel_386_register::bp:
+        case intel_386_register::ebp:
+            return intel_386_register::ebp;
+        case intel_386_register::spl:
+        case intel_386_register::sp:
+        case intel_386_register::esp:
+            return intel_386_register::esp;
+        case intel_386_register::unknown:
+            break;
+    }
+
+    throw std::runtime_error("Unhandled register: " + std::to_string(static_cast<int>(reg)));
+}
+
+auto get_register_offset(const intel_386_register reg) -> int
+{
+    switch (reg)
+    {
+        case intel_386_register::ah:
+        case intel_386_register::bh:
+        case intel_386_register::ch:
+        case intel_386_register::dh:
+            return 1;
+        default:
+            return 0;
+    }
+}
+
+auto get_register_size(const intel_386_register reg) -> int
+{
+    switch (reg)
+    {
+        case intel_386_register::al:
+        case intel_386_register::ah:
+        case intel_386_register::bl:
+        case intel_386_register::bh:
+        case intel_386_register::cl:
+        case intel_386_register::ch:
+        case intel_386_register::dl:
+        case intel_386_register::dh:
+        case intel_386_register::sil:
+        case intel_386_register::dil:
+        case intel_386_register::bpl:
+        case intel_386_register::spl:
+            return 1;
+        case intel_386_register::ax:
+        case intel_386_register::bx:
+        case intel_386_register::cx:
+        case intel_386_register::dx:
+        case intel_386_register::si:
+        case intel_386_register::di:
+        case intel_386_register::bp:
+        case intel_386_register::sp:
+            return 2;
+        case intel_386_register::eax:
+        case intel_386_register::ebx:
+        case intel_386_register::ecx:
+        case intel_386_register::edx:
+        case intel_386_register::esi:
+        case intel_386_register::edi:
+        case intel_386_register::ebp:
+        case intel_386_register::esp:
+            return 4;
+        case intel_386_register::unknown:
+            break;
+    }
+
+    throw std::runtime_error("Unhandled register: " + std::to_string(static_cast<int>(reg)));
+}
+
+auto to_string(const intel_386_register reg) -> std::string
+{
+    switch (reg)
+    {
+        case intel_386_register::al:
+            return "%al";
+        case intel_386_register::ah:
+            return "%ah";
+        case intel_386_register::ax:
+            return "%ax";
+        case intel_386_register::eax:
+            return "%eax";
+        case intel_386_register::bl:
+            return "%bl";
+        case intel_386_register::bh:
+            return "%bh";
+        case intel_386_register::bx:
+            return "%bx";
+        case intel_386_register::ebx:
+            return "%ebx";
+        case intel_386_register::cl:
+            return "%cl";
+        case intel_386_register::ch:
+            return "%ch";
+        case intel_386_register::cx:
+            return "%cx";
+        case intel_386_register::ecx:
+            return "%ecx";
+        case intel_386_register::dl:
+            return "%dl";
+        case intel_386_register::dh:
+            return "%dh";
+        case intel_386_register::dx:
+            return "%dx";
+        case intel_386_register::edx:
+            return "%edx";
+        case intel_386_register::sil:
+            return "%sil";
+        case intel_386_register::si:
+            return "%si";
+        case intel_386_register::esi:
+            return "%esi";
+        case intel_386_register::dil:
+            return "%dil";
+        case intel_386_register::di:
+            return "%di";
+        case intel_386_register::edi:
+            return "%edi";
+        case intel_386_register::bpl:
+            return "%bpl";
+        case intel_386_register::bp:
+            return "%bp";
+        case intel_386_register::ebp:
+            return "%ebp";
+        case intel_386_register::spl:
+            return "%spl";
+        case intel_386_register::sp:
+            return "%sp";
+        case intel_386_register::esp:
+            return "%esp";
+        case intel_386_register::unknown:
+            break;
+    }
+
+    throw std::runtime_error("Unhandled register: " + std::to_string(static_cast<int>(reg)));
+}
+
+} // namespace ca
@@ -0,0 +1,675 @@
+#include <ca/ir.h>
+#include <stdexcept>
+#include <string>
+
+namespace ca
+{
+
+namespace ir
+{
+
+namespace internal
+{
+
+namespace
+{
+
+auto get_register_index(const intel_386_register reg) -> int
+{
+    switch (get_base_register(reg))
+    {
+        case intel_386_register::eax:
+            return 0;
+        case intel_386_register::ebx:
+            return 1;
+        case intel_386_register::ecx:
+            return 2;
+        case intel_386_register::edx:
+            return 3;
+        case intel_386_register::esi:
+            return 4;
+        case intel_386_register::edi:
+            return 5;
+        case intel_386_register::ebp:
+            return 6;
+        case intel_386_register::esp:
+        default:
+            return 7;
+    }
+}
+
+auto is_memory(const instruction_operand &o) -> bool
+{
+    return o.is_literal() && !o.value().empty() && o.value()[0] != '$';
+}
+
+// Registers read by an operand, either directly or for addressing memory like 4(%esp).
+auto get_reads(const instruction_operand &o) -> register_set
+{
+    if (o.is_register())
+        return get_registers(o.reg());
+
+    if (o.is_memory())
+    {
+        const auto &m = o.memory();
+        register_set reads = 0;
+        for (const auto reg : {m.base, m.index})
+        {
+            if (reg != intel_386_register::unknown)
+                reads |= get_registers(get_base_register(reg));
+        }
+        return reads;
+    }
+
+    if (o.is_literal() && o.value().find('%') != std::string::npos)
+        return all_registers;
+
+    return 0;
+}
+
+// Registers read to address the operand, if it's written
+auto get_address_reads(const instruction_operand &o) -> register_set
+{
+    return o.is_register() ? 0 : get_reads(o);
+}
+
+auto get_writes(const instruction_operand &o) -> register_set
+{
+    return o.is_register() ? get_registers(o.reg()) : 0;
+}
+
+auto get_flags_read(const condition c) -> flag_set
+{
+    switch (c)
+    {
+        case condition::above:
+        case condition::below_or_equal:
+            return carry_flag | zero_flag;
+        case condition::above_or_equal:
+        case condition::below:
+            return carry_flag;
+        case condition::equal:
+        case condition::not_equal:
+            return zero_flag;
+        case condition::greater:
+        case condition::less_or_equal:
+            return zero_flag | sign_flag | overflow_flag;
+        case condition::greater_or_equal:
+        case condition::less:
+            return sign_flag | overflow_flag;
+        case condition::overflow:
+        case condition::not_overflow:
+            return overflow_flag;
+        case condition::sign:
+        case condition::not_sign:
+            return sign_flag;
+        case condition::none:
+            return all_flags;
+    }
+
+    return all_flags;
+}
+
+auto get_branch_opcode(const condition c) -> intel_386_opcode
+{
+    switch (c)
+    {
+        case condition::above:
+            return intel_386_opcode::ja;
+        case condition::above_or_equal:
+            return intel_386_opcode::jae;
+        case condition::below:
+            return intel_386_opcode::jb;
+        case condition::below_or_equal:
+            return intel_386_opcode::jbe;
+        case condition::equal:
+            return intel_386_opcode::je;
+        case condition::greater:
+            return intel_386_opcode::jg;
+        case condition::greater_or_equal:
+            return intel_386_opcode::jge;
+        case condition::less:
+            return intel_386_opcode::jl;
+        case condition::less_or_equal:
+            return intel_386_opcode::jle;
+        case condition::not_equal:
+            return intel_386_opcode::jne;
+        case condition::not_overflow:
+            return intel_386_opcode::jno;
+        case condition::not_sign:
+            return intel_386_opcode::jns;
+        case condition::overflow:
+            return intel_386_opcode::jo;
+        case condition::sign:
+            return intel_386_opcode::js;
+        case condition::none:
+            break;
+    }
+
+    return intel_386_opcode::unknown;
+}
+
+// Reads both operands and writes the destination, or the source for shifts by one that only have that.
+void set_arithmetic_effects(instruction &i)
+{
+    i.reads = get_reads(i.source) | get_reads(i.destination);
+    i.writes = get_writes(i.destination);
+    i.flags_written = all_flags;
+    i.loads = is_memory(i.source) || is_memory(i.destination);
+    i.stores = is_memory(i.destination);
+}
+
+// Sets the operation of an instruction built from a line with two operands, or one for shifts by one.
+void set_operands(instruction &i, const intel_386 &line, const operation op, const int width)
+{
+    i.op = op;
+    i.width = width;
+    i.source_width = width;
+
+    if (line.operand2().is_empty())
+    {
+        i.destination = line.operand1();
+    }
+    else
+    {
+        i.source = line.operand1();
+        i.destination = line.operand2();
+    }
+}
+
+void set_branch(instruction &i, const intel_386 &line, const condition c)
+{
+    i.op = operation::branch;
+    i.cond = c;
+    i.source = line.operand1();
+}
+
+auto build_instruction(const intel_386 &line) -> instruction
+{
+    instruction i;
+
+    switch (line.opcode())
+    {
+        case intel_386_opcode::movb:
+            set_operands(i, line, operation::move, 1);
+            break;
+        case intel_386_opcode::movl:
+            set_operands(i, line, operation::move, 4);
+            break;
+        case intel_386_opcode::movzbl:
+            set_operands(i, line, operation::zero_extend, 4);
+            i.source_width = 1;
+            break;
+        case intel_386_opcode::movzwl:
+            set_operands(i, line, operation::zero_extend, 4);
+            i.source_width = 2;
+            break;
+        case intel_386_opcode::addb:
+            set_operands(i, line, operation::add, 1);
+            break;
+        case intel_386_opcode::addl:
+            set_operands(i, line, operation::add, 4);
+            break;
+        case intel_386_opcode::subb:
+            set_operands(i, line, operation::subtract, 1);
+            break;
+        case intel_386_opcode::subl:
+            set_operands(i, line, operation::subtract, 4);
+            break;
+        case intel_386_opcode::sbbb:
+            set_operands(i, line, operation::subtract_with_borrow, 1);
+            break;
+        case intel_386_opcode::andb:
+            set_operands(i, line, operation::bitwise_and, 1);
+            break;
+        case intel_386_opcode::andl:
+            set_operands(i, line, operation::bitwise_and, 4);
+            break;
+        case intel_386_opcode::orb:
+            set_operands(i, line, operation::bitwise_or, 1);
+            break;
+        case intel_386_opcode::orl:
+            set_operands(i, line, operation::bitwise_or, 4);
+            break;
+        case intel_386_opcode::xorl:
+            set_operands(i, line, operation::bitwise_xor, 4);
+            break;
+        case intel_386_opcode::notb:
+            set_operands(i, line, operation::bitwise_not, 1);
+            break;
+        case intel_386_opcode::negb:
+            set_operands(i, line, operation::negate, 1);
+            break;
+        case intel_386_opcode::incb:
+            set_operands(i, line, operation::increment, 1);
+            break;
+        case intel_386_opcode::incl:
+            set_operands(i, line, operation::increment, 4);
+            break;
+        case intel_386_opcode::decb:
+            set_operands(i, line, operation::decrement, 1);
+            break;
+        case intel_386_opcode::decl:
+            set_operands(i, line, operation::decrement, 4);
+            break;
+        case intel_386_opcode::sall:
+            set_operands(i, line, operation::shift_left, 4);
+            break;
+        case intel_386_opcode::shrb:
+            set_operands(i, line, operation::shift_right, 1);
+            break;
+        case intel_386_opcode::shrl:
+            set_operands(i, line, operation::shift_right, 4);
+            break;
+        case intel_386_opcode::sarl:
+            set_operands(i, line, operation::shift_right_arithmetic, 4);
+            break;
+        case intel_386_opcode::cmpb:
+            set_operands(i, line, operation::compare, 1);
+            break;
+        case intel_386_opcode::testb:
+            set_operands(i, line, operation::test, 1);
+            break;
+        case intel_386_opcode::pushl:
+            i.op = operation::push;
+            i.source = line.operand1();
+            break;
+        case intel_386_opcode::popl:
+            i.op = operation::pop;
+            i.destination = line.operand1();
+            break;
+        case intel_386_opcode::leave:
+            i.op = operation::leave;
+            break;
+        case intel_386_opcode::ja:
+            set_branch(i, line, condition::above);
+            break;
+        case intel_386_opcode::jae:
+            set_branch(i, line, condition::above_or_equal);
+            break;
+        case intel_386_opcode::jb:
+            set_branch(i, line, condition::below);
+            break;
+        case intel_386_opcode::jbe:
+            set_branch(i, line, condition::below_or_equal);
+            break;
+        case intel_386_opcode::je:
+            set_branch(i, line, condition::equal);
+            break;
+        case intel_386_opcode::jg:
+            set_branch(i, line, condition::greater);
+            break;
+        case intel_386_opcode::jge:
+            set_branch(i, line, condition::greater_or_equal);
+            break;
+        case intel_386_opcode::jl:
+            set_branch(i, line, condition::less);
+            break;
+        case intel_386_opcode::jle:
+            set_branch(i, line, condition::less_or_equal);
+            break;
+        case intel_386_opcode::jne:
+            set_branch(i, line, condition::not_equal);
+            break;
+        case intel_386_opcode::jno:
+            set_branch(i, line, condition::not_overflow);
+            break;
+        case intel_386_opcode::jns:
+            set_branch(i, line, condition::not_sign);
+            break;
+        case intel_386_opcode::jo:
+            set_branch(i, line, condition::overflow);
+            break;
+        case intel_386_opcode::js:
+            set_branch(i, line, condition::sign);
+            break;
+        case intel_386_opcode::jmp:
+            i.op = operation::jump;
+            i.source = line.operand1();
+            break;
+        case intel_386_opcode::calll:
+            i.op = operation::call;
+            i.source = line.operand1();
+            break;
+        case intel_386_opcode::ret:
+        case intel_386_opcode::retl:
+            i.op = operation::ret;
+            break;
+        case intel_386_opcode::rep:
+            i.op = operation::string_operation;
+            i.source = line.operand1();
+            i.destination = line.operand2();
+            break;
+        case intel_386_opcode::unknown:
+            i.op = operation::opaque;
+            break;
+    }
+
+    return i;
+}
+
+} // namespace
+
+} // namespace internal
+
+auto get_registers(const intel_386_register reg) -> register_set
+{
+    const auto bytes = (1u << get_register_size(reg)) - 1;
+    return bytes << (internal::get_register_index(reg) * 4 + get_register_offset(reg));
+}
+
+void update_effects(instruction &i)
+{
+    i.reads = 0;
+    i.writes = 0;
+    i.flags_read = 0;
+    i.flags_written = 0;
+    i.loads = false;
+    i.stores = false;
+
+    const auto stack_pointer = get_registers(intel_386_register::esp);
+    const auto frame_pointer = get_registers(intel_386_register::ebp);
+
+    switch (i.op)
+    {
+        case operation::label:
+            break;
+        case operation::move:
+            i.reads = internal::get_reads(i.source) | internal::get_address_reads(i.destination);
+            i.writes = internal::get_writes(i.destination);
+            i.loads = internal::is_memory(i.source);
+            i.stores = internal::is_memory(i.destination);
+            break;
+        case operation::zero_extend:
+            i.reads = internal::get_reads(i.source) | internal::get_address_reads(i.destination);
+            i.writes = i.destination.is_register() ? get_registers(get_base_register(i.destination.reg())) : 0;
+            i.loads = internal::is_memory(i.source);
+            break;
+        case operation::add:
+        case operation::subtract:
+        case operation::bitwise_and:
+        case operation::bitwise_or:
+        case operation::shift_left:
+        case operation::shift_right:
+        case operation::shift_right_arithmetic:
+            internal::set_arithmetic_effects(i);
+            break;
+        case operation::bitwise_xor:
+        case operation::subtract_with_borrow:
+            internal::set_arithmetic_effects(i);
+
+            // xor and sbb of a register with itself don't depend on its value
+            if (i.source == i.destination && i.source.is_register())
+                i.reads = 0;
+            if (i.op == operation::subtract_with_borrow)
+                i.flags_read = carry_flag;
+            break;
+        case operation::negate:
+            internal::set_arithmetic_effects(i);
+            break;
+        case operation::bitwise_not:
+            internal::set_arithmetic_effects(i);
+            i.flags_written = 0;
+            break;
+        case operation::increment:
+        case operation::decrement:
+            // The carry is left alone
+            internal::set_arithmetic_effects(i);
+            i.flags_written = zero_flag | sign_flag | overflow_flag;
+            break;
+        case operation::compare:
+        case operation::test:
+            i.reads = internal::get_reads(i.source) | internal::get_reads(i.destination);
+            i.flags_written = all_flags;
+            i.loads = internal::is_memory(i.source) || internal::is_memory(i.destination);
+            break;
+        case operation::push:
+            i.reads = internal::get_reads(i.source) | stack_pointer;
+            i.writes = stack_pointer;
+            i.loads = internal::is_memory(i.source);
+            i.stores = true;
+            break;
+        case operation::pop:
+            i.reads = internal::get_address_reads(i.destination) | stack_pointer;
+            i.writes = internal::get_writes(i.destination) | stack_pointer;
+            i.loads = true;
+            i.stores = internal::is_memory(i.destination);
+            break;
+        case operation::leave:
+            i.reads = frame_pointer;
+            i.writes = frame_pointer | stack_pointer;
+            i.loads = true;
+            break;
+        case operation::branch:
+            i.reads = internal::get_reads(i.source);
+            i.flags_read = internal::get_flags_read(i.cond);
+            break;
+        case operation::jump:
+            i.reads = internal::get_reads(i.source);
+            break;
+        case operation::call:
+            // Flags are not preserved across calls
+            i.reads = all_registers;
+            i.writes = all_registers;
+            i.flags_written = all_flags;
+            i.loads = true;
+            i.stores = true;
+            break;
+        case operation::ret:
+            i.reads = all_registers;
+            i.loads = true;
+            break;
+        case operation::string_operation:
+            i.reads = all_registers;
+            i.writes = all_registers;
+            i.loads = true;
+            i.stores = true;
+            break;
+        case operation::opaque:
+            i.reads = all_registers;
+            i.writes = all_registers;
+            i.flags_read = all_flags;
+            i.flags_written = all_flags;
+            i.loads = true;
+            i.stores = true;
+            break;
+    }
+}
+
+auto select_opcode(const instruction &i) -> intel_386_opcode
+{
+    const auto byte = i.width == 1;
+    const auto dword = i.width == 4;
+    const auto select = [byte, dword](const intel_386_opcode b, const intel_386_opcode l) {
+        return byte ? b : (dword ? l : intel_386_opcode::unknown);
+    };
+
+    switch (i.op)
+    {
+        case operation::move:
+            return select(intel_386_opcode::movb, intel_386_opcode::movl);
+        case operation::zero_extend:
+            if (!dword)
+                return intel_386_opcode::unknown;
+            return i.source_width == 1 ? intel_386_opcode::movzbl
+                                       : (i.source_width == 2 ? intel_386_opcode::movzwl : intel_386_opcode::unknown);
+        case operation::add:
+            return select(intel_386_opcode::addb, intel_386_opcode::addl);
+        case operation::subtract:
+            return select(intel_386_opcode::subb, intel_386_opcode::subl);
+        case operation::subtract_with_borrow:
+            return select(intel_386_opcode::sbbb, intel_386_opcode::unknown);
+        case operation::bitwise_and:
+            return select(intel_386_opcode::andb, intel_386_opcode::andl);
+        case operation::bitwise_or:
+            return select(intel_386_opcode::orb, intel_386_opcode::orl);
+        case operation::bitwise_xor:
+            return select(intel_386_opcode::unknown, intel_386_opcode::xorl);
+        case operation::bitwise_not:
+            return select(intel_386_opcode::notb, intel_386_opcode::unknown);
+        case operation::negate:
+            return select(intel_386_opcode::negb, intel_386_opcode::unknown);
+        case operation::increment:
+            return select(intel_386_opcode::incb, intel_386_opcode::incl);
+        case operation::decrement:
+            return select(intel_386_opcode::decb, intel_386_opcode::decl);
+        case operation::shift_left:
+            return select(intel_386_opcode::unknown, intel_386_opcode::sall);
+        case operation::shift_right:
+            return select(intel_386_opcode::shrb, intel_386_opcode::shrl);
+        case operation::shift_right_arithmetic:
+            return select(intel_386_opcode::unknown, intel_386_opcode::sarl);
+        case operation::compare:
+            return select(intel_386_opcode::cmpb, intel_386_opcode::unknown);
+        case operation::test:
+            return select(intel_386_opcode::testb, intel_386_opcode::unknown);
+        case operation::push:
+            return intel_386_opcode::pushl;
+        case operation::pop:
+            return intel_386_opcode::popl;
+        case operation::leave:
+            return intel_386_opcode::leave;
+        case operation::branch:
+            return internal::get_branch_opcode(i.cond);
+        case operation::jump:
+            return intel_386_opcode::jmp;
+        case operation::call:
+            return intel_386_opcode::calll;
+        case operation::ret:
+            return intel_386_opcode::retl;
+        case operation::string_operation:
+            return intel_386_opcode::rep;
+        case operation::label:
+        case operation::opaque:
+            break;
+    }
+
+    return intel_386_opcode::unknown;
+}
+
+auto build(const std::vector<intel_386> &lines) -> std::vector<instruction>
+{
+    std::vector<instruction> instructions;
+
+    for (size_t n = 0; n < lines.size(); ++n)
+    {
+        const auto &line = lines[n];
+
+        switch (line.type())
+        {
+            case asm_line::line_type::label:
+                instructions.emplace_back();
+                instructions.back().op = operation::label;
+                instructions.back().source = {operand_type::literal, line.text()};
+                break;
+            case asm_line::line_type::instruction:
+                instructions.emplace_back(internal::build_instruction(line));
+                break;
+            case asm_line::line_type::missing_opcode:
+                instructions.emplace_back();
+                break;
+            case asm_line::line_type::empty:
+            case asm_line::line_type::comment:
+            case asm_line::line_type::directive:
+                continue;
+        }
+
+        instructions.back().line = n;
+        update_effects(instructions.back());
+    }
+
+    return instructions;
+}
+
+void lower(const std::vector<instruction> &instructions, std::vector<intel_386> &lines)
+{
+    std::vector<bool> removed(lines.size(), false);
+    auto next = std::begin(instructions);
+
+    for (size_t n = 0; n < lines.size(); ++n)
+    {
+        auto &line = lines[n];
+        if (line.is_empty() || line.is_comment() || line.is_directive())
+            continue;
+
+        if (next == std::end(instructions) || next->line != n)
+        {
+            removed[n] = true;
+            continue;
+        }
+
+        const auto &i = *next++;
+
+        switch (i.op)
+        {
+            case operation::label:
+            case operation::leave:
+            case operation::branch:
+            case operation::jump:
+            case operation::call:
+            case operation::ret:
+            case operation::opaque:
+                continue;
+            case operation::push:
+            case operation::string_operation:
+                line.operand1() = i.source;
+                line.operand2() = i.destination;
+                break;
+            case operation::pop:
+                line.operand1() = i.destination;
+                break;
+            case operation::move:
+            case operation::zero_extend:
+            case operation::add:
+            case operation::subtract:
+            case operation::subtract_with_borrow:
+            case operation::bitwise_and:
+            case operation::bitwise_or:
+            case operation::bitwise_xor:
+            case operation::bitwise_not:
+            case operation::negate:
+            case operation::increment:
+            case operation::decrement:
+            case operation::shift_left:
+            case operation::shift_right:
+            case operation::shift_right_arithmetic:
+            case operation::compare:
+            case operation::test:
+                if (i.source.is_empty())
+                {
+                    line.operand1() = i.destination;
+                    line.operand2() = {};
+                }
+                else
+                {
+                    line.operand1() = i.source;
+                    line.operand2() = i.destination;
+                }
+                break;
+        }
+
+        const auto opcode = select_opcode(i);
+        if (opcode == intel_386_opcode::unknown)
+            throw std::runtime_error("Cannot select an instruction for " + line.line_text_unindented());
+
+        if (opcode != line.opcode())
+            line.set_opcode(opcode);
+    }
+
+    size_t to = 0;
+    for (size_t from = 0; from < lines.size(); ++from)
+    {
+        if (!removed[from])
+        {
+            if (to != from)
+                lines[to] = std::move(lines[from]);
+            ++to;
+        }
+    }
+
+    lines.erase(std::next(std::begin(lines), static_cast<std::ptrdiff_t>(to)), std::end(lines));
+}
+
+} // namespace ir
+
+} // namespace ca
@@ -0,0 +1,723 @@
+#include <ca/ir.h>
+#include <algorithm>
+#include <array>
+#include <iterator>
+#include <map>
+#include <optional>
+#include <string>
+
+namespace ca
+{
+
+namespace ir
+{
+
+namespace internal
+{
+
+namespace
+{
+
+constexpr auto no_instruction = static_cast<size_t>(-1);
+
+// The bytes of ebp and esp. They address the stack, so copies from and to them aren't tracked.
+const auto frame_registers = get_registers(intel_386_register::ebp) | get_registers(intel_386_register::esp);
+
+auto get_first_byte(const intel_386_register reg) -> int
+{
+    for (auto byte = 0; byte < 32; ++byte)
+    {
+        if ((get_registers(reg) & (1u << byte)) != 0)
+            return byte;
+    }
+
+    return 0;
+}
+
+// The register with the given bytes, if there is one.
+auto find_register(const int first_byte, const int size) -> std::optional<intel_386_register>
+{
+    for (auto r = static_cast<int>(intel_386_register::al); r <= static_cast<int>(intel_386_register::esp); ++r)
+    {
+        const auto reg = static_cast<intel_386_register>(r);
+        if (get_first_byte(reg) == first_byte && get_register_size(reg) == size)
+            return reg;
+    }
+
+    return {};
+}
+
+// The low byte of a register, if it has a name of its own that isn't part of the stack addressing.
+auto get_low_byte(const intel_386_register reg) -> std::optional<intel_386_register>
+{
+    const auto low = find_register(get_first_byte(reg), 1);
+    if (!low || (get_registers(*low) & frame_registers) != 0)
+        return {};
+
+    return low;
+}
+
+auto is_immediate(const instruction_operand &o) -> bool
+{
+    return o.is_literal() && o.literal().kind == literal_kind::immediate;
+}
+
+auto create_immediate(const int width, const std::uint32_t value) -> instruction_operand
+{
+    if (width == 1)
+        return instruction_operand::immediate(value & 0xff, 1);
+
+    return instruction_operand::immediate(static_cast<std::int32_t>(value));
+}
+
+// What is known about the value of a register byte
+struct byte_value
+{
+    enum class kind
+    {
+        unknown,
+        constant,
+        copy
+    };
+
+    kind k = kind::unknown;
+    std::uint8_t constant = 0;
+    int source = 0; // The byte it's a copy of
+};
+
+// The given byte of a known value
+auto get_byte(const std::uint32_t value, const int n) -> byte_value
+{
+    return {byte_value::kind::constant, static_cast<std::uint8_t>(value >> (n * 8)), 0};
+}
+
+class register_values
+{
+public:
+    void forget_all() noexcept
+    {
+        bytes_.fill({});
+    }
+
+    // Forgets the given bytes and the copies of them that other bytes hold
+    void forget(const register_set registers) noexcept
+    {
+        for (auto &byte : bytes_)
+        {
+            if (byte.k == byte_value::kind::copy && (registers & (1u << byte.source)) != 0)
+                byte = {};
+        }
+
+        for (auto b = 0u; b < bytes_.size(); ++b)
+        {
+            if ((registers & (1u << b)) != 0)
+                bytes_[b] = {};
+        }
+    }
+
+    // The values of the bytes of the register, where a byte nothing is known about is a copy of itself
+    auto read(const intel_386_register reg) const -> std::array<byte_value, 4>
+    {
+        std::array<byte_value, 4> values{};
+        const auto first = get_first_byte(reg);
+
+        for (auto i = 0; i < get_register_size(reg); ++i)
+        {
+            const auto b = static_cast<size_t>(first + i);
+            values[static_cast<size_t>(i)] = bytes_[b];
+            if (bytes_[b].k == byte_value::kind::unknown)
+                values[static_cast<size_t>(i)] = {byte_value::kind::copy, 0, first + i};
+        }
+
+        return values;
+    }
+
+    void write(const intel_386_register reg, std::array<byte_value, 4> values)
+    {
+        const auto first = get_first_byte(reg);
+        const auto written = get_registers(reg);
+
+        for (auto i = 0; i < get_register_size(reg); ++i)
+        {
+            // A byte can't be a copy of one that is being overwritten, or of itself
+            auto &value = values[static_cast<size_t>(i)];
+            if (value.k == byte_value::kind::copy &&
+                ((written & (1u << value.source)) != 0 || ((written | (1u << value.source)) & frame_registers) != 0))
+            {
+                value = {};
+            }
+        }
+
+        forget(written);
+
+        for (auto i = 0; i < get_register_size(reg); ++i)
+            bytes_[static_cast<size_t>(first + i)] = values[static_cast<size_t>(i)];
+    }
+
+    void write(const intel_386_register reg, const std::uint32_t value)
+    {
+        std::array<byte_value, 4> values{};
+        for (auto i = 0; i < 4; ++i)
+            values[static_cast<size_t>(i)] = get_byte(value, i);
+
+        write(reg, values);
+    }
+
+    auto get_constant(const intel_386_register reg) const -> std::optional<std::uint32_t>
+    {
+        const auto values = read(reg);
+        std::uint32_t value = 0;
+
+        for (auto i = 0; i < get_register_size(reg); ++i)
+        {
+            const auto &byte = values[static_cast<size_t>(i)];
+            if (byte.k != byte_value::kind::constant)
+                return {};
+
+            value |= static_cast<std::uint32_t>(byte.constant) << (i * 8);
+        }
+
+        return value;
+    }
+
+    // The register that the given one holds a copy of, if all of its bytes are copies of one that has a name
+    auto get_copy(const intel_386_register reg) const -> std::optional<intel_386_register>
+    {
+        const auto values = read(reg);
+        const auto first = values[0].source;
+
+        for (auto i = 0; i < get_register_size(reg); ++i)
+        {
+            const auto &byte = values[static_cast<size_t>(i)];
+            if (byte.k != byte_value::kind::copy || byte.source != first + i)
+                return {};
+        }
+
+        const auto copy = find_register(first, get_register_size(reg));
+        if (!copy || (get_registers(*copy) & frame_registers) != 0)
+            return {};
+
+        return copy;
+    }
+
+private:
+    std::array<byte_value, 32> bytes_{};
+};
+
+// Computes the result of an arithmetic, logic or shift instruction. Single operand instructions like inc and neg
+// ignore the source value.
+auto evaluate(const instruction &i, const std::uint32_t src, const std::uint32_t dst) -> std::optional<std::uint32_t>
+{
+    const auto width = i.width == 1 ? 0xffu : 0xffffffffu;
+    const auto count = src & 0x1f;
+
+    switch (i.op)
+    {
+        case operation::add:
+            return (dst + src) & width;
+        case operation::subtract:
+            return (dst - src) & width;
+        case operation::bitwise_and:
+            return dst & src & width;
+        case operation::bitwise_or:
+            return (dst | src) & width;
+        case operation::bitwise_xor:
+            return (dst ^ src) & width;
+        case operation::increment:
+            return (dst + 1) & width;
+        case operation::decrement:
+            return (dst - 1) & width;
+        case operation::negate:
+            return (0u - dst) & width;
+        case operation::bitwise_not:
+            return ~dst & width;
+        case operation::shift_left:
+            return (dst << count) & width;
+        case operation::shift_right:
+            return ((dst & width) >> count) & width;
+        case operation::shift_right_arithmetic:
+            return static_cast<std::uint32_t>(static_cast<std::int32_t>(dst) >> count) & width;
+        default:
+            break;
+    }
+
+    return {};
+}
+
+auto get_value(const register_values &values, const instruction_operand &o) -> std::optional<std::uint32_t>
+{
+    if (o.is_register())
+        return values.get_constant(o.reg());
+
+    if (is_immediate(o))
+        return static_cast<std::uint32_t>(o.literal().number);
+
+    return {};
+}
+
+// Reads the register that the operand copies instead. Returns true if it did.
+auto substitute_copy(const register_values &values, instruction_operand &o) -> bool
+{
+    if (!o.is_register())
+        return false;
+
+    const auto copy = values.get_copy(o.reg());
+    if (!copy || *copy == o.reg())
+        return false;
+
+    o = *copy;
+    return true;
+}
+
+// String instructions take their count from ecx and their fill value from eax. A known count is handed to the
+// target as the destination, and dword operations are narrowed to bytes where equivalent.
+auto annotate_string_operation(instruction &i, const register_values &values) -> bool
+{
+    const auto count = values.get_constant(intel_386_register::ecx);
+    if (!count || !i.destination.is_empty())
+        return false;
+
+    auto bytes = *count;
+
+    if (i.source.value() == "movsl")
+    {
+        i.source = {operand_type::literal, "movsb"};
+        bytes *= 4;
+    }
+    else if (i.source.value() == "stosl")
+    {
+        // Only a repeated byte pattern can be stored a byte at a time
+        const auto value = values.get_constant(intel_386_register::eax);
+        if (!value || *value != (*value & 0xff) * 0x01010101u)
+            return false;
+
+        i.source = {operand_type::literal, "stosb"};
+        bytes *= 4;
+    }
+
+    i.destination = instruction_operand::immediate(bytes);
+    return true;
+}
+
+// Tracks a move or zero extension and reads a known value or a copy from where it came from. Returns true if the
+// instruction changed.
+auto propagate_move(instruction &i, register_values &values) -> bool
+{
+    auto changed = false;
+
+    if (i.source.is_register())
+    {
+        if (const auto value = values.get_constant(i.source.reg()); value)
+        {
+            i.source = create_immediate(i.width, *value);
+            changed = true;
+        }
+        else
+        {
+            changed = substitute_copy(values, i.source);
+        }
+    }
+
+    if (!i.destination.is_register())
+        return changed;
+
+    const auto dst = i.op == operation::zero_extend ? get_base_register(i.destination.reg()) : i.destination.reg();
+    std::array<byte_value, 4> known{};
+
+    if (i.source.is_register())
+    {
+        known = values.read(i.source.reg());
+    }
+    else if (const auto value = get_value(values, i.source); value)
+    {
+        for (auto n = 0; n < i.source_width; ++n)
+            known[static_cast<size_t>(n)] = get_byte(*value, n);
+    }
+
+    if (i.op == operation::zero_extend)
+    {
+        for (auto n = i.source_width; n < 4; ++n)
+            known[static_cast<size_t>(n)] = get_byte(0, 0);
+
+        // A zero extension of a known value is a move of it
+        if (is_immediate(i.source))
+        {
+            i.op = operation::move;
+            i.source_width = 4;
+            i.destination = dst;
+        }
+    }
+
+    values.write(dst, known);
+    return changed;
+}
+
+} // namespace
+
+} // namespace internal
+
+auto analyze_liveness(const std::vector<instruction> &instructions) -> std::vector<live_state>
+{
+    std::map<std::string, size_t> labels;
+    for (size_t n = 0; n < instructions.size(); ++n)
+    {
+        if (instructions[n].op == operation::label)
+            labels[instructions[n].source.value()] = n;
+    }
+
+    const auto find_target = [&labels](const instruction &i) {
+        const auto target = labels.find(i.source.value());
+        return target == std::end(labels) ? internal::no_instruction : target->second;
+    };
+
+    const live_state everything{all_registers, all_flags};
+    std::vector<live_state> live_in(instructions.size());
+    std::vector<live_state> live_out(instructions.size());
+
+    for (auto changed = true; changed;)
+    {
+        changed = false;
+
+        for (auto n = instructions.size(); n-- > 0;)
+        {
+            const auto &i = instructions[n];
+            const auto next = n + 1 < instructions.size() ? live_in[n + 1] : everything;
+            auto after = next;
+
+            switch (i.op)
+            {
+                case operation::ret:
+                    after = {};
+                    break;
+                case operation::jump:
+                case operation::branch:
+                {
+                    const auto target = find_target(i);
+                    after = target == internal::no_instruction ? everything : live_in[target];
+                    if (i.op == operation::branch)
+                    {
+                        after.registers |= next.registers;
+                        after.flags |= next.flags;
+                    }
+                    break;
+                }
+                default:
+                    break;
+            }
+
+            const live_state before{i.reads | (after.registers & ~i.writes),
+                                    static_cast<flag_set>(i.flags_read | (after.flags & ~i.flags_written))};
+
+            if (before.registers != live_in[n].registers || before.flags != live_in[n].flags)
+            {
+                live_in[n] = before;
+                changed = true;
+            }
+
+            live_out[n] = after;
+        }
+    }
+
+    return live_out;
+}
+
+auto propagate_copies_and_constants(std::vector<instruction> &instructions) -> bool
+{
+    const auto live = analyze_liveness(instructions);
+    internal::register_values values;
+    std::vector<bool> removed(instructions.size(), false);
+    auto changed = false;
+
+    for (size_t n = 0; n < instructions.size(); ++n)
+    {
+        auto &i = instructions[n];
+        auto modified = false;
+
+        switch (i.op)
+        {
+            case operation::label:
+            case operation::jump:
+            case operation::call:
+            case operation::ret:
+            case operation::opaque:
+                values.forget_all();
+                break;
+            case operation::branch:
+                break;
+            case operation::string_operation:
+                modified = internal::annotate_string_operation(i, values);
+                values.forget_all();
+                break;
+            case operation::move:
+            case operation::zero_extend:
+                modified = internal::propagate_move(i, values);
+
+                // A move of a register into itself is left over when it read a copy of itself
+                if (i.op == operation::move && i.source.is_register() && i.source == i.destination)
+                    removed[n] = true;
+                break;
+            case operation::compare:
+            case operation::test:
+                modified = internal::substitute_copy(values, i.source);
+                modified = internal::substitute_copy(values, i.destination) || modified;
+                break;
+            case operation::push:
+                modified = internal::substitute_copy(values, i.source);
+                values.forget(i.writes);
+                break;
+            case operation::add:
+            case operation::subtract:
+            case operation::bitwise_and:
+            case operation::bitwise_or:
+            case operation::bitwise_xor:
+            case operation::bitwise_not:
+            case operation::negate:
+            case operation::increment:
+            case operation::decrement:
+            case operation::shift_left:
+            case operation::shift_right:
+            case operation::shift_right_arithmetic:
+            {
+                if (!i.destination.is_register())
+                    break;
+
+                const auto dst = i.destination.reg();
+                if (i.op == operation::bitwise_xor && i.source == i.destination)
+                {
+                    values.write(dst, 0);
+                    break;
+                }
+
+                // Shift counts are always in cl
+                if (i.op != operation::shift_left && i.op != operation::shift_right &&
+                    i.op != operation::shift_right_arithmetic)
+                {
+                    modified = internal::substitute_copy(values, i.source);
+                }
+
+                // Shifts by one have a single operand
+                const auto src = i.source.is_empty() ? std::optional<std::uint32_t>{1}
+                                                     : internal::get_value(values, i.source);
+                const auto old_value = values.get_constant(dst);
+                const auto value = (src && old_value) ? internal::evaluate(i, *src, *old_value) : std::nullopt;
+
+                if (value)
+                {
+                    values.write(dst, *value);
+                }
+                else
+                {
+                    values.forget(i.writes);
+                }
+
+                if (value && (i.flags_written & live[n].flags) == 0)
+                {
+                    i.op = operation::move;
+                    i.source = internal::create_immediate(i.width, *value);
+                    modified = true;
+                }
+                break;
+            }
+            case operation::subtract_with_borrow:
+            case operation::pop:
+            case operation::leave:
+                values.forget(i.writes);
+                break;
+        }
+
+        if (modified)
+        {
+            update_effects(i);
+            changed = true;
+        }
+    }
+
+    size_t to = 0;
+    for (size_t from = 0; from < instructions.size(); ++from)
+    {
+        if (!removed[from])
+        {
+            if (to != from)
+                instructions[to] = std::move(instructions[from]);
+            ++to;
+        }
+    }
+
+    instructions.erase(std::next(std::begin(instructions), static_cast<std::ptrdiff_t>(to)), std::end(instructions));
+    return changed || to != removed.size();
+}
+
+auto eliminate_dead_code(std::vector<instruction> &instructions) -> bool
+{
+    const auto live = analyze_liveness(instructions);
+
+    size_t to = 0;
+    for (size_t from = 0; from < instructions.size(); ++from)
+    {
+        const auto &i = instructions[from];
+
+        auto removable = false;
+        switch (i.op)
+        {
+            case operation::move:
+            case operation::zero_extend:
+            case operation::add:
+            case operation::subtract:
+            case operation::subtract_with_borrow:
+            case operation::bitwise_and:
+            case operation::bitwise_or:
+            case operation::bitwise_xor:
+            case operation::bitwise_not:
+            case operation::negate:
+            case operation::increment:
+            case operation::decrement:
+            case operation::shift_left:
+            case operation::shift_right:
+            case operation::shift_right_arithmetic:
+            case operation::compare:
+            case operation::test:
+                removable = !i.loads && !i.stores;
+                break;
+            case operation::label:
+            case operation::push:
+            case operation::pop:
+            case operation::leave:
+            case operation::branch:
+            case operation::jump:
+            case operation::call:
+            case operation::ret:
+            case operation::string_operation:
+            case operation::opaque:
+                break;
+        }
+
+        if (removable && (i.writes & live[from].registers) == 0 && (i.flags_written & live[from].flags) == 0)
+            continue;
+
+        if (to != from)
+            instructions[to] = std::move(instructions[from]);
+        ++to;
+    }
+
+    const auto changed = to != instructions.size();
+    instructions.erase(std::next(std::begin(instructions), static_cast<std::ptrdiff_t>(to)), std::end(instructions));
+    return changed;
+}
+
+// Only shapes the compiler emits itself are produced; immediate sources for arithmetic, and moves of registers,
+// immediates and bytes of memory.
+auto narrow(std::vector<instruction> &instructions) -> bool
+{
+    const auto live = analyze_liveness(instructions);
+    auto changed = false;
+
+    for (size_t n = 0; n < instructions.size(); ++n)
+    {
+        auto &i = instructions[n];
+        if (i.width != 4 || !i.destination.is_register() || (i.flags_written & live[n].flags) != 0)
+            continue;
+
+        const auto low = internal::get_low_byte(i.destination.reg());
+        if (!low || (i.writes & live[n].registers & ~get_registers(*low)) != 0)
+            continue;
+
+        auto source = i.source;
+        auto op = i.op;
+
+        switch (i.op)
+        {
+            case operation::move:
+            case operation::add:
+            case operation::bitwise_and:
+            case operation::bitwise_or:
+                if (internal::is_immediate(source))
+                    source = internal::create_immediate(1, static_cast<std::uint32_t>(source.literal().number));
+                else if (i.op == operation::move && source.is_register() && internal::get_low_byte(source.reg()))
+                    source = *internal::get_low_byte(source.reg());
+                else
+                    continue;
+                break;
+            case operation::zero_extend:
+                if (source.is_register() && internal::get_low_byte(source.reg()))
+                    source = *internal::get_low_byte(source.reg());
+                else if (source.is_register() || i.source_width != 1)
+                    continue;
+                op = operation::move;
+                break;
+            case operation::bitwise_xor:
+                // Clearing a register
+                if (!(source == i.destination))
+                    continue;
+                source = internal::create_immediate(1, 0);
+                op = operation::move;
+                break;
+            case operation::increment:
+            case operation::decrement:
+                break;
+            default:
+                continue;
+        }
+
+        i.op = op;
+        i.width = 1;
+        i.source_width = 1;
+        i.source = source;
+        i.destination = *low;
+        update_effects(i);
+        changed = true;
+    }
+
+    return changed;
+}
+
+namespace
+{
+
+struct named_pass
+{
+    const char *name;
+    bool (*run)(std::vector<instruction> &);
+};
+
+const std::array<named_pass, 3> passes{{{"ir-propagate-copies-and-constants", &propagate_copies_and_constants},
+                                        {"ir-eliminate-dead-code", &eliminate_dead_code},
+                                        {"ir-narrow", &narrow}}};
+
+} // namespace
+
+auto get_pass_names() -> std::vector<std::string>
+{
+    std::vector<std::string> names;
+    for (const auto &p : passes)
+        names.emplace_back(p.name);
+    return names;
+}
+
+void optimize(std::vector<intel_386> &lines)
+{
+    optimize(lines, get_pass_names());
+}
+
+void optimize(std::vector<intel_386> &lines, const std::vector<std::string> &enabled)
+{
+    if (enabled.empty())
+        return;
+
+    auto instructions = build(lines);
+
+    for (auto changed = true; changed;)
+    {
+        changed = false;
+        for (const auto &p : passes)
+        {
+            if (std::find(std::begin(enabled), std::end(enabled), p.name) != std::end(enabled))
+                changed = p.run(instructions) || changed;
+        }
+    }
+
+    lower(instructions, lines);
+}
+
+} // namespace ir
+
+} // namespace ca
@@ -0,0 +1,208 @@
+#include <ca/linker.h>
+#include <algorithm>
+#include <map>
+#include <regex>
+#include <set>
+#include <sstream>
+#include <stdexcept>
+
+namespace ca
+{
+
+namespace internal
+{
+
+// Anything that may name a label. Quoted strings are matched as a whole so that their contents are left alone.
+static const std::regex token_regex{R"("(?:[^"\\]|\\.)*"|[A-Za-z_.][A-Za-z0-9_.$@]*)"};
+
+static const std::regex label_regex{R"(^(\S+):.*)"};
+static const std::regex global_regex{R"(^\s*\.(?:globl|global)\s+(\S+).*)"};
+
+template <typename function_t>
+static void for_each_token(const std::string &text, function_t function)
+{
+    for (auto itr = std::sregex_iterator(std::begin(text), std::end(text), token_regex);
+         itr != std::sregex_iterator(); ++itr)
+    {
+        if (itr->str().front() != '"')
+            function(*itr);
+    }
+}
+
+// Appends the number of the unit to every label that isn't exported or an entry point, so that static functions,
+// string constants and branch targets with the same name in different units stay apart.
+static auto rename_local_labels(const std::string &unit, const int number) -> std::string
+{
+    std::set<std::string> labels;
+    std::set<std::string> globals;
+
+    std::istringstream input{unit};
+    std::string line;
+    while (getline(input, line))
+    {
+        std::smatch match;
+        if (std::regex_match(line, match, label_regex))
+            labels.insert(match[1]);
+        else if (std::regex_match(line, match, global_regex))
+            globals.insert(match[1]);
+    }
+
+    std::string result;
+    auto last = std::begin(unit);
+    for_each_token(unit, [&](const std::smatch &token) {
+        if (labels.count(token.str()) != 0 && globals.count(token.str()) == 0 &&
+            !intel_386::is_entry_point(token.str()))
+        {
+            result.append(last, token[0].second);
+            result += ".unit" + std::to_string(number);
+            last = token[0].second;
+        }
+    });
+    result.append(last, std::end(unit));
+
+    if (!result.empty() && result.back() != '\n')
+        result += '\n';
+
+    return result;
+}
+
+// Branch targets and markers inside of a function, as opposed to the labels of functions and data objects
+static auto is_code_label(const std::string &label) -> bool
+{
+    static const std::regex code_label_regex{R"(^\.L([0-9]|BB|tmp|func_end).*)"};
+    return std::regex_match(label, code_label_regex);
+}
+
+// Directives that give the contents of a data object, rather than the section, alignment or visibility of the next
+static auto is_data_directive(const intel_386 &i) -> bool
+{
+    static const std::regex data_regex{R"(^\.(byte|short|value|word|hword|2byte|int|long|4byte|quad|8byte|)"
+                                       R"(zero|skip|space|fill|ascii|asciz|string)\b.*)"};
+    return i.is_directive() && std::regex_match(i.text(), data_regex);
+}
+
+static auto ends_flow(const intel_386 &i) -> bool
+{
+    switch (i.opcode())
+    {
+        case intel_386_opcode::ret:
+        case intel_386_opcode::retl:
+        case intel_386_opcode::jmp:
+            return true;
+        default:
+            return false;
+    }
+}
+
+// Splits the program into chunks that start at a function or data label, together with the directives right
+// before it, and removes the chunks that nothing reachable from an entry point refers to. The lines before the
+// first label are always kept.
+static void remove_unreachable_chunks(std::vector<intel_386> &instructions)
+{
+    std::vector<size_t> starts{0};
+
+    for (auto i = 0u; i < instructions.size(); ++i)
+    {
+        if (!instructions[i].is_label() || is_code_label(instructions[i].text()))
+            continue;
+
+        auto begin = i;
+        while (begin > starts.back() && instructions[begin - 1].is_directive() &&
+               !is_data_directive(instructions[begin - 1]))
+            --begin;
+
+        if (begin > starts.back())
+            starts.push_back(begin);
+    }
+
+    const auto chunk_count = starts.size();
+    starts.push_back(instructions.size());
+
+    std::map<std::string, size_t> chunk_of_label;
+    for (auto chunk = 0u; chunk < chunk_count; ++chunk)
+    {
+        for (auto i = starts[chunk]; i < starts[chunk + 1]; ++i)
+        {
+            if (instructions[i].is_label() && !chunk_of_label.emplace(instructions[i].text(), chunk).second)
+                throw std::runtime_error("Cannot link, " + instructions[i].text() + " is defined more than once");
+        }
+    }
+
+    std::vector<std::set<size_t>> references(chunk_count);
+    std::vector<size_t> worklist{0};
+
+    for (auto chunk = 0u; chunk < chunk_count; ++chunk)
+    {
+        const intel_386 *last = nullptr;
+
+        for (auto i = starts[chunk]; i < starts[chunk + 1]; ++i)
+        {
+            const auto &instruction = instructions[i];
+
+            if (instruction.is_label())
+            {
+                if (intel_386::is_entry_point(instruction.text()))
+                    worklist.push_back(chunk);
+                if (!is_code_label(instruction.text()))
+                    last = &instruction;
+                continue;
+            }
+
+            // Data after a label
+            if (instruction.is_instruction() || (instruction.is_directive() && last != nullptr && last->is_label()))
+                last = &instruction;
+
+            for_each_token(instruction.line_text(), [&](const std::smatch &token) {
+                const auto itr = chunk_of_label.find(token.str());
+                if (itr != std::end(chunk_of_label))
+                    references[chunk].insert(itr->second);
+            });
+        }
+
+        // A function that doesn't end in a return or jump runs on into the next chunk, and so does a label that
+        // only gives the next one another name
+        if (chunk + 1 < chunk_count && last != nullptr &&
+            (last->is_label() || (last->is_instruction() && !ends_flow(*last))))
+            references[chunk].insert(chunk + 1);
+    }
+
+    std::vector<bool> reachable(chunk_count, false);
+    while (!worklist.empty())
+    {
+        const auto chunk = worklist.back();
+        worklist.pop_back();
+
+        if (reachable[chunk])
+            continue;
+
+        reachable[chunk] = true;
+        worklist.insert(std::end(worklist), std::begin(references[chunk]), std::end(references[chunk]));
+    }
+
+    std::vector<intel_386> result;
+    for (auto chunk = 0u; chunk < chunk_count; ++chunk)
+    {
+        if (reachable[chunk])
+            std::move(std::begin(instructions) + starts[chunk], std::begin(instructions) + starts[chunk + 1],
+                      std::back_inserter(result));
+    }
+
+    instructions = std::move(result);
+}
+
+} // namespace internal
+
+auto link(const std::vector<std::string> &units) -> std::vector<intel_386>
+{
+    std::string program;
+    for (auto i = 0u; i < units.size(); ++i)
+        program += internal::rename_local_labels(units[i], static_cast<int>(i + 1));
+
+    std::istringstream input{program};
+    auto instructions = intel_386::read(input);
+    internal::remove_unreachable_chunks(instructions);
+    intel_386::resolve_labels(instructions);
+    return instructions;
+}
+
+} // namespace ca
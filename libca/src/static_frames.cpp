@@ -0,0 +1,497 @@
+#include <ca/static_frames.h>
+#include <ca/intel_386_register.h>
+#include "logger.h"
+#include <algorithm>
+#include <array>
+#include <map>
+#include <optional>
+#include <set>
+
+namespace ca
+{
+
+namespace internal
+{
+
+// The return address takes this many bytes on the x86 stack, and so does every push.
+static constexpr auto stack_slot_size = 4;
+
+// Frames of functions in different regions never overlap, as an interrupt can arrive while any function runs. An nmi
+// can even interrupt the irq handler.
+static constexpr std::array<const char *, 3> region_entry_points{"main", "irq", "nmi"};
+
+struct function
+{
+    size_t begin = 0; // The label
+    size_t end = 0;   // The label of the next function, or the end of the stream
+    std::set<size_t> callees;
+    int frame_size = 0;       // Including copied arguments
+    int copied_arguments = 0; // Bytes of incoming arguments that are copied to the end of the frame
+    int offset = -1;
+    int regions = 0; // One bit for each entry in region_entry_points that reaches this function
+    bool placeable = true;
+};
+
+// How far the stack pointer is below its value on entry to the function, which points to the return address.
+struct stack_state
+{
+    int frame = 0;     // Locals, including a saved %ebp
+    int arguments = 0; // Pushes for calls that follow
+    bool frame_pointer = false;
+};
+
+// What a function does with the stack
+struct frame_usage
+{
+    int locals = 0;
+    int arguments = 0; // Bytes of incoming arguments that are read, in whole stack slots
+    bool makes_calls = false;
+};
+
+static auto is_register(const instruction_operand &o, const intel_386_register reg) -> bool
+{
+    return o.is_register() && o.reg() == reg;
+}
+
+static auto get_immediate(const instruction_operand &o) -> std::optional<int>
+{
+    if (!o.is_literal() || o.literal().kind != literal_kind::immediate || o.literal().number < 0)
+        return {};
+
+    return static_cast<int>(o.literal().number);
+}
+
+static auto is_jump(const intel_386_opcode o) -> bool
+{
+    switch (o)
+    {
+        case intel_386_opcode::ja:
+        case intel_386_opcode::jae:
+        case intel_386_opcode::jb:
+        case intel_386_opcode::jbe:
+        case intel_386_opcode::je:
+        case intel_386_opcode::jg:
+        case intel_386_opcode::jge:
+        case intel_386_opcode::jl:
+        case intel_386_opcode::jle:
+        case intel_386_opcode::jmp:
+        case intel_386_opcode::jne:
+        case intel_386_opcode::jno:
+        case intel_386_opcode::jns:
+        case intel_386_opcode::jo:
+        case intel_386_opcode::js:
+            return true;
+        default:
+            return false;
+    }
+}
+
+// Every entry point and every function that is called directly starts a function, which runs until the next one.
+static auto find_functions(const std::vector<intel_386> &instructions) -> std::vector<function>
+{
+    std::set<std::string> names{std::begin(region_entry_points), std::end(region_entry_points)};
+    for (const auto &i : instructions)
+    {
+        if (i.is_instruction() && i.opcode() == intel_386_opcode::calll)
+            names.insert(i.operand1().value());
+    }
+
+    std::vector<function> functions;
+    for (size_t op = 0; op < instructions.size(); ++op)
+    {
+        if (!instructions[op].is_label() || names.count(instructions[op].text()) == 0)
+            continue;
+
+        if (!functions.empty())
+            functions.back().end = op;
+
+        functions.push_back({});
+        functions.back().begin = op;
+        functions.back().end = instructions.size();
+    }
+
+    std::map<std::string, size_t> indices;
+    for (size_t f = 0; f < functions.size(); ++f)
+        indices[instructions[functions[f].begin].text()] = f;
+
+    for (auto &f : functions)
+    {
+        for (auto op = f.begin; op < f.end; ++op)
+        {
+            const auto &i = instructions[op];
+            if (!i.is_instruction() || i.opcode() != intel_386_opcode::calll)
+                continue;
+
+            const auto callee = indices.find(i.operand1().value());
+            if (callee != std::end(indices))
+                f.callees.insert(callee->second);
+        }
+    }
+
+    return functions;
+}
+
+// Where an N(%esp) or N(%ebp) operand points relative to the return address of the function.
+static auto get_stack_offset(const instruction_operand &o, const stack_state &state) -> std::optional<int>
+{
+    if (!o.is_memory())
+        return {};
+
+    const auto &m = o.memory();
+    const auto is_frame_pointer = m.base == intel_386_register::ebp;
+    if (!m.symbol.empty() || m.index != intel_386_register::unknown ||
+        (m.base != intel_386_register::esp && !is_frame_pointer))
+        return {};
+
+    if (is_frame_pointer && !state.frame_pointer)
+        return {};
+
+    // %ebp points to the saved %ebp just below the return address
+    return is_frame_pointer ? m.displacement - stack_slot_size : m.displacement - state.frame - state.arguments;
+}
+
+// Rewrites an N(%esp) or N(%ebp) operand. Locals move to the static frame at the given address, and so do the
+// arguments that are copied behind them; other arguments are addressed relative to the pushes that are left once the
+// frame is gone.
+static void lower_stack_operand(instruction_operand &o, const stack_state &state, const function &f,
+                                const int address)
+{
+    const auto offset = get_stack_offset(o, state);
+    const auto locals_size = f.frame_size - f.copied_arguments;
+
+    if (!offset || *offset < -locals_size || (*offset >= 0 && *offset < stack_slot_size))
+        return;
+
+    memory_operand lowered;
+    if (*offset < 0)
+    {
+        lowered.displacement = address + locals_size + *offset;
+    }
+    else if (*offset - stack_slot_size < f.copied_arguments)
+    {
+        lowered.displacement = address + locals_size + *offset - stack_slot_size;
+    }
+    else
+    {
+        lowered.displacement = *offset + state.arguments;
+        lowered.base = intel_386_register::esp;
+    }
+
+    o = instruction_operand(std::move(lowered));
+}
+
+// Walks through a function while tracking the stack pointer and returns how it uses the stack. Given an address,
+// the frame is moved there and the instructions that maintained it are marked for removal.
+static auto lower_frame(std::vector<intel_386> &instructions, const function &f, const std::optional<int> address,
+                        const bool pops_arguments, std::vector<bool> &removed) -> frame_usage
+{
+    stack_state state;
+    std::map<std::string, stack_state> label_states;
+    frame_usage usage;
+
+    for (auto op = f.begin + 1; op < f.end; ++op)
+    {
+        auto &i = instructions[op];
+
+        // Code after a return or jump is reached through a jump with the state it had there
+        if (i.is_label())
+        {
+            const auto label_state = label_states.find(i.text());
+            if (label_state != std::end(label_states))
+                state = label_state->second;
+            continue;
+        }
+
+        if (!i.is_instruction())
+            continue;
+
+        // Operands address memory through the stack pointer as it was before the instruction
+        const auto operand_state = state;
+        auto remove = false;
+        auto skip_next = false;
+        switch (i.opcode())
+        {
+            case intel_386_opcode::pushl:
+            {
+                const auto is_prologue = op + 1 < f.end && is_register(i.operand1(), intel_386_register::ebp) &&
+                                         instructions[op + 1].opcode() == intel_386_opcode::movl &&
+                                         is_register(instructions[op + 1].operand1(), intel_386_register::esp) &&
+                                         is_register(instructions[op + 1].operand2(), intel_386_register::ebp);
+
+                if (is_prologue)
+                {
+                    state.frame += stack_slot_size;
+                    state.frame_pointer = true;
+                    remove = true;
+                    skip_next = true;
+                }
+                else
+                {
+                    state.arguments += stack_slot_size;
+                }
+                break;
+            }
+            case intel_386_opcode::popl:
+                if (state.frame_pointer && is_register(i.operand1(), intel_386_register::ebp))
+                {
+                    state.frame -= stack_slot_size;
+                    state.frame_pointer = false;
+                    remove = true;
+                }
+                else
+                {
+                    state.arguments = std::max(0, state.arguments - stack_slot_size);
+                }
+                break;
+            case intel_386_opcode::leave:
+                if (state.frame_pointer)
+                {
+                    state.frame = 0;
+                    state.frame_pointer = false;
+                    remove = true;
+                }
+                break;
+            case intel_386_opcode::movl:
+                if (state.frame_pointer && is_register(i.operand1(), intel_386_register::ebp) &&
+                    is_register(i.operand2(), intel_386_register::esp))
+                {
+                    state.frame = stack_slot_size;
+                    remove = true;
+                }
+                break;
+            case intel_386_opcode::subl:
+            {
+                const auto size = get_immediate(i.operand1());
+                if (size && is_register(i.operand2(), intel_386_register::esp))
+                {
+                    state.frame += *size;
+                    remove = true;
+                }
+                break;
+            }
+            case intel_386_opcode::addl:
+            {
+                // Pushed arguments are popped first; the rest releases locals
+                const auto size = get_immediate(i.operand1());
+                if (size && is_register(i.operand2(), intel_386_register::esp))
+                {
+                    const auto popped = std::min(*size, state.arguments);
+                    state.arguments -= popped;
+                    state.frame = std::max(0, state.frame - (*size - popped));
+                    if (address && pops_arguments && popped > 0)
+                        i.operand1() = instruction_operand::immediate(popped);
+                    else
+                        remove = true;
+                }
+                break;
+            }
+            case intel_386_opcode::calll:
+                usage.makes_calls = true;
+                break;
+            default:
+                if (is_jump(i.opcode()) && i.operand1().is_literal())
+                    label_states.emplace(i.operand1().value(), state);
+                break;
+        }
+
+        usage.locals = std::max(usage.locals, state.frame);
+
+        for (const auto *o : {&i.operand1(), &i.operand2()})
+        {
+            const auto offset = get_stack_offset(*o, operand_state);
+            if (offset && *offset >= stack_slot_size)
+                usage.arguments = std::max(usage.arguments, *offset - *offset % stack_slot_size);
+        }
+
+        if (address)
+        {
+            lower_stack_operand(i.operand1(), operand_state, f, *address);
+            lower_stack_operand(i.operand2(), operand_state, f, *address);
+            removed[op] = remove;
+            if (skip_next && op + 1 < removed.size())
+                removed[op + 1] = true;
+        }
+
+        // The movl that sets up the frame pointer goes along with its pushl
+        if (skip_next)
+            ++op;
+    }
+
+    return usage;
+}
+
+// Copies the arguments a function reads from where they were passed to the end of its frame, through %al. Nothing is
+// passed in %eax, so it is free on entry.
+static void copy_arguments(std::vector<intel_386> &instructions, const function &f, const memory_area &area)
+{
+    const auto line_number = instructions.back().line_number();
+    const auto copy = area.address + f.offset + f.frame_size - f.copied_arguments;
+
+    for (auto slot = 0; slot < f.copied_arguments; slot += stack_slot_size)
+    {
+        for (auto byte = slot; byte < slot + area.copied_argument_bytes; ++byte)
+        {
+            const auto argument = std::to_string(stack_slot_size + byte);
+            instructions.push_back(intel_386::parse("\tmovb\t" + argument + "(%esp), %al", line_number));
+            instructions.push_back(intel_386::parse("\tmovb\t%al, " + std::to_string(copy + byte), line_number));
+        }
+    }
+}
+
+static auto reaches(const std::vector<function> &functions, const size_t from, const size_t to) -> bool
+{
+    std::vector<bool> visited(functions.size(), false);
+    std::vector<size_t> pending{from};
+
+    while (!pending.empty())
+    {
+        const auto f = pending.back();
+        pending.pop_back();
+
+        for (const auto callee : functions[f].callees)
+        {
+            if (callee == to)
+                return true;
+
+            if (!visited[callee])
+            {
+                visited[callee] = true;
+                pending.push_back(callee);
+            }
+        }
+    }
+
+    return false;
+}
+
+static void mark_region(std::vector<function> &functions, const size_t f, const int region)
+{
+    if ((functions[f].regions & (1 << region)) != 0)
+        return;
+
+    functions[f].regions |= 1 << region;
+    for (const auto callee : functions[f].callees)
+        mark_region(functions, callee, region);
+}
+
+// A frame starts where the frames of all of its callers end. Calls within a cycle of recursion don't count, so this
+// always terminates.
+static auto get_offset(std::vector<function> &functions, const size_t f, const int region_start) -> int
+{
+    if (functions[f].offset >= 0)
+        return functions[f].offset;
+
+    auto offset = region_start;
+    for (size_t caller = 0; caller < functions.size(); ++caller)
+    {
+        if (functions[caller].callees.count(f) != 0 && !reaches(functions, f, caller))
+        {
+            const auto size = functions[caller].placeable ? functions[caller].frame_size : 0;
+            offset = std::max(offset, get_offset(functions, caller, region_start) + size);
+        }
+    }
+
+    functions[f].offset = offset;
+    return offset;
+}
+
+} // namespace internal
+
+void allocate_static_frames(std::vector<intel_386> &instructions, const memory_area &area)
+{
+    auto functions = internal::find_functions(instructions);
+    std::vector<bool> removed(instructions.size(), false);
+
+    for (size_t f = 0; f < functions.size(); ++f)
+    {
+        auto &function = functions[f];
+        const auto usage = internal::lower_frame(instructions, function, std::nullopt, area.pops_arguments, removed);
+
+        // Without calls the arguments stay where they are for the whole function
+        if (area.copied_argument_bytes > 0 && usage.makes_calls)
+            function.copied_arguments = usage.arguments;
+
+        function.frame_size = usage.locals + function.copied_arguments;
+
+        for (size_t region = 0; region < internal::region_entry_points.size(); ++region)
+        {
+            if (instructions[function.begin].text() == internal::region_entry_points[region])
+                internal::mark_region(functions, f, static_cast<int>(region));
+        }
+    }
+
+    // Functions without a frame have nothing to place, so they are fine either way
+    for (size_t f = 0; f < functions.size(); ++f)
+    {
+        auto &function = functions[f];
+        if (function.frame_size == 0)
+            continue;
+
+        if (internal::reaches(functions, f, f))
+        {
+            log(log_level::error, instructions[function.begin], "Recursive function needs a stack frame");
+            function.placeable = false;
+        }
+        else if ((function.regions & (function.regions - 1)) != 0)
+        {
+            log(log_level::error, instructions[function.begin],
+                "Function called from an interrupt handler and outside of it needs a stack frame");
+            function.placeable = false;
+        }
+    }
+
+    auto region_start = 0;
+    for (size_t region = 0; region < internal::region_entry_points.size(); ++region)
+    {
+        auto region_end = region_start;
+        for (size_t f = 0; f < functions.size(); ++f)
+        {
+            // Functions that can't be reached from an entry point are kept with the main program
+            const auto regions = functions[f].regions == 0 ? 1 : functions[f].regions;
+            if ((regions & (1 << region)) == 0 || !functions[f].placeable)
+                continue;
+
+            const auto end = internal::get_offset(functions, f, region_start) + functions[f].frame_size;
+            if (end > area.size)
+            {
+                log(log_level::error, instructions[functions[f].begin], "Stack frame doesn't fit in memory");
+                functions[f].placeable = false;
+                continue;
+            }
+
+            region_end = std::max(region_end, end);
+        }
+
+        region_start = region_end;
+    }
+
+    for (const auto &function : functions)
+    {
+        if (function.placeable)
+            internal::lower_frame(instructions, function, area.address + function.offset, area.pops_arguments,
+                                  removed);
+    }
+
+    std::map<size_t, const internal::function *> copying_functions;
+    for (const auto &function : functions)
+    {
+        if (function.placeable && function.copied_arguments > 0)
+            copying_functions.emplace(function.begin, &function);
+    }
+
+    std::vector<intel_386> result;
+    result.reserve(instructions.size());
+    for (size_t op = 0; op < instructions.size(); ++op)
+    {
+        if (!removed[op])
+            result.push_back(std::move(instructions[op]));
+
+        const auto copying = copying_functions.find(op);
+        if (copying != std::end(copying_functions))
+            internal::copy_arguments(result, *copying->second, area);
+    }
+
+    instructions = std::move(result);
+}
+
+} // namespace ca
@@ -25,6 +25,17 @@ static std::map<intel_386_opcode, opcode_translate_func> opcode_translation_look
     {intel_386_opcode::jmp,    &target::translate_jmp},
     {intel_386_opcode::jne,    &target::translate_jne},
     {intel_386_opcode::je,     &target::translate_je},
+    {intel_386_opcode::ja,     &target::translate_ja},
+    {intel_386_opcode::jae,    &target::translate_jae},
+    {intel_386_opcode::jb,     &target::translate_jb},
+    {intel_386_opcode::jbe,    &target::translate_jbe},
+    {intel_386_opcode::jg,     &target::translate_jg},
+    {intel_386_opcode::jge,    &target::translate_jge},
+    {intel_386_opcode::jl,     &target::translate_jl},
+    {intel_386_opcode::jle,    &target::translate_jle},
+    {intel_386_opcode::jno,    &target::translate_jno},
+    {intel_386_opcode::jns,    &target::translate_jns},
+    {intel_386_opcode::jo,     &target::translate_jo},
     {intel_386_opcode::js,     &target::translate_js},
     {intel_386_opcode::testb,  &target::translate_testb},
     {intel_386_opcode::incl,   &target::translate_incl},
@@ -40,6 +51,8 @@ static std::map<intel_386_opcode, opcode_translate_func> opcode_translation_look
     {intel_386_opcode::orb,    &target::translate_orb},
     {intel_386_opcode::rep,    &target::translate_rep},
     {intel_386_opcode::pushl,  &target::translate_pushl},
+    {intel_386_opcode::popl,   &target::translate_popl},
+    {intel_386_opcode::leave,  &target::translate_leave},
     {intel_386_opcode::sbbb,   &target::translate_sbbb},
     {intel_386_opcode::negb,   &target::translate_negb},
     {intel_386_opcode::notb,   &target::translate_notb},
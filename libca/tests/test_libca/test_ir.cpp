@@ -0,0 +1,152 @@
+#include <ca/intel_386.h>
+#include <ca/ir.h>
+#include <gtest/gtest.h>
+
+static auto parse(const std::vector<std::string> &lines) -> std::vector<ca::intel_386>
+{
+    std::vector<ca::intel_386> instructions;
+    auto line_number = 0;
+
+    for (const auto &line : lines)
+        instructions.emplace_back(ca::intel_386::parse(line, line_number++));
+
+    return instructions;
+}
+
+static auto to_string(const ca::intel_386 &i) -> std::string
+{
+    const auto to_string = [](const ca::instruction_operand &o) -> std::string {
+        return o.is_register() ? "%" + std::to_string(static_cast<int>(o.reg())) : o.value();
+    };
+
+    auto result = i.text();
+    if (!i.operand1().is_empty())
+        result += ' ' + to_string(i.operand1());
+    if (!i.operand2().is_empty())
+        result += ", " + to_string(i.operand2());
+    return result;
+}
+
+static auto optimize(const std::vector<std::string> &lines) -> std::vector<std::string>
+{
+    auto instructions = parse(lines);
+    ca::ir::optimize(instructions);
+
+    std::vector<std::string> result;
+    for (const auto &i : instructions)
+        result.emplace_back(to_string(i));
+    return result;
+}
+
+TEST(test_ir, test_fold_arithmetic_into_store)
+{
+    const auto result = optimize({"\tmovb\t$5, %al", "\taddb\t$3, %al", "\tmovb\t%al, 53280", "\tretl"});
+    const std::vector<std::string> expected{"movb $8, %1", "movb $8, 53280", "retl"};
+    EXPECT_EQ(expected, result);
+}
+
+TEST(test_ir, test_fold_logic_and_shifts)
+{
+    const auto result = optimize({"\tmovl\t$12, %ecx", "\tshrl\t$2, %ecx", "\torl\t$16, %ecx", "\tandl\t$23, %ecx",
+                                   "\tmovb\t%cl, 53280", "\tretl"});
+    const std::vector<std::string> expected{"movl $19, %12", "movb $19, 53280", "retl"};
+    EXPECT_EQ(expected, result);
+}
+
+TEST(test_ir, test_flags_used_by_branch_are_kept)
+{
+    const auto result = optimize({"\tmovb\t$1, %al", "\tdecb\t%al", "\tje\t.LBB0_1", "\tretl"});
+    const std::vector<std::string> expected{"movb $1, %1", "decb %1", "je .LBB0_1", "retl"};
+    EXPECT_EQ(expected, result);
+}
+
+TEST(test_ir, test_values_are_forgotten_at_labels)
+{
+    const auto result = optimize({"\tmovb\t$1, %al", "_loop:", "\tmovb\t%al, 53280", "\tretl"});
+    const std::vector<std::string> expected{"movb $1, %1", "_loop", "movb %1, 53280", "retl"};
+    EXPECT_EQ(expected, result);
+}
+
+TEST(test_ir, test_partial_register_writes)
+{
+    const auto result =
+        optimize({"\tmovb\t$1, %ah", "\tmovb\t$2, %al", "\tmovl\t%eax, %ecx", "\tmovb\t%ch, 53280", "\tretl"});
+    const std::vector<std::string> expected{"movb $1, %2", "movb $2, %1", "movl %4, %12", "movb $1, 53280", "retl"};
+    EXPECT_EQ(expected, result);
+}
+
+TEST(test_ir, test_memory_reads_are_kept)
+{
+    const auto result = optimize({"\tmovb\t53280, %al", "\tmovb\t$1, %al", "\tretl"});
+    const std::vector<std::string> expected{"movb 53280, %1", "movb $1, %1", "retl"};
+    EXPECT_EQ(expected, result);
+}
+
+TEST(test_ir, test_known_string_count_is_annotated)
+{
+    const auto result = optimize({"\tmovl\t$10, %ecx", "\tmovl\t$0, %eax", "\trep\tstosl", "\tretl"});
+    const std::vector<std::string> expected{"movl $10, %12", "movl $0, %4", "rep stosb, $40", "retl"};
+    EXPECT_EQ(expected, result);
+}
+
+TEST(test_ir, test_dword_fill_with_mixed_bytes_is_kept)
+{
+    const auto result = optimize({"\tmovl\t$10, %ecx", "\tmovl\t$258, %eax", "\trep\tstosl", "\tretl"});
+    const std::vector<std::string> expected{"movl $10, %12", "movl $258, %4", "rep stosl", "retl"};
+    EXPECT_EQ(expected, result);
+}
+
+TEST(test_ir, test_copies_are_read_from_their_source)
+{
+    const auto result = optimize({"\tmovl\t%eax, %ecx", "\tmovb\t%cl, 53280", "\tmovl\t$0, %ecx", "\tretl"});
+    const std::vector<std::string> expected{"movb %1, 53280", "movl $0, %12", "retl"};
+    EXPECT_EQ(expected, result);
+}
+
+TEST(test_ir, test_copies_end_when_their_source_is_written)
+{
+    const auto result =
+        optimize({"\tmovl\t%eax, %ecx", "\tmovb\t53280, %al", "\tmovb\t%cl, 53281", "\tmovl\t$0, %ecx", "\tretl"});
+    // Only the low byte of the copy is used
+    const std::vector<std::string> expected{"movb %1, %9", "movb 53280, %1", "movb %9, 53281", "movl $0, %12",
+                                            "retl"};
+    EXPECT_EQ(expected, result);
+}
+
+TEST(test_ir, test_dead_writes_are_found_across_blocks)
+{
+    // Both paths overwrite ecx before they read it
+    const auto result = optimize({"\tmovl\t$1, %ecx", "\tcmpb\t$0, %al", "\tje\t.LBB0_2", "\tmovl\t$2, %ecx",
+                                  "\tjmp\t.LBB0_3", ".LBB0_2:", "\tmovl\t$3, %ecx", ".LBB0_3:", "\tretl"});
+    const std::vector<std::string> expected{"cmpb $0, %1",  "je .LBB0_2", "movl $2, %12", "jmp .LBB0_3",
+                                            ".LBB0_2",      "movl $3, %12", ".LBB0_3",     "retl"};
+    EXPECT_EQ(expected, result);
+}
+
+TEST(test_ir, test_flags_are_tracked_one_by_one)
+{
+    // inc leaves the carry that jb reads alone, so the compare stays and the known inc is folded
+    const auto result = optimize({"\tmovb\t$1, %cl", "\tcmpb\t$5, %al", "\tincb\t%cl", "\tjb\t.LBB0_1",
+                                  "\tmovb\t%cl, 53280", ".LBB0_1:", "\tretl"});
+    const std::vector<std::string> expected{"cmpb $5, %1",    "movb $2, %9", "jb .LBB0_1",
+                                            "movb $2, 53280", ".LBB0_1",     "retl"};
+    EXPECT_EQ(expected, result);
+}
+
+TEST(test_ir, test_only_used_low_bytes_are_computed)
+{
+    const auto result = optimize({"\tmovzbl\t53280, %ecx", "\taddl\t$257, %ecx", "\tmovb\t%cl, 53281",
+                                  "\tmovl\t$0, %ecx", "\tretl"});
+    const std::vector<std::string> expected{"movb 53280, %9", "addb $1, %9", "movb %9, 53281", "movl $0, %12",
+                                            "retl"};
+    EXPECT_EQ(expected, result);
+}
+
+TEST(test_ir, test_wide_results_are_kept_where_used)
+{
+    const auto result =
+        optimize({"\tmovzbl\t53280, %ecx", "\taddl\t$257, %ecx", "\tmovl\t%ecx, 53281", "\tmovl\t$0, %ecx", "\tretl"});
+    const std::vector<std::string> expected{"movzbl 53280, %12", "addl $257, %12", "movl %12, 53281", "movl $0, %12",
+                                            "retl"};
+    EXPECT_EQ(expected, result);
+}
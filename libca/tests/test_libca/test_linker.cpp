@@ -0,0 +1,112 @@
+#include <ca/linker.h>
+#include <gtest/gtest.h>
+#include <algorithm>
+
+static auto get_labels(const std::vector<ca::intel_386> &instructions) -> std::vector<std::string>
+{
+    std::vector<std::string> result;
+    for (const auto &i : instructions)
+    {
+        if (i.is_label())
+            result.emplace_back(i.text());
+    }
+    return result;
+}
+
+TEST(test_linker, test_calls_into_other_units_are_resolved)
+{
+    const auto instructions = ca::link({"\t.globl\t_main\n"
+                                        "_main:\n"
+                                        "\tcalll\t_f\n"
+                                        "\tretl\n",
+                                        "\t.globl\t_f\n"
+                                        "_f:\n"
+                                        "\tretl\n"});
+
+    const std::vector<std::string> expected{"main", "f"};
+    EXPECT_EQ(expected, get_labels(instructions));
+
+    const auto call = std::find_if(std::begin(instructions), std::end(instructions),
+                                   [](const auto &i) { return i.opcode() == ca::intel_386_opcode::calll; });
+    ASSERT_NE(std::end(instructions), call);
+    EXPECT_EQ("f", call->operand1().value());
+}
+
+TEST(test_linker, test_local_labels_of_different_units_stay_apart)
+{
+    const auto instructions = ca::link({"\t.globl\t_main\n"
+                                        "_main:\n"
+                                        "\tcalll\t_helper\n"
+                                        "\tcalll\t_f\n"
+                                        "\tretl\n"
+                                        "_helper:\n"
+                                        "\tjmp\t.L1\n"
+                                        ".L1:\n"
+                                        "\tretl\n",
+                                        "\t.globl\t_f\n"
+                                        "_f:\n"
+                                        "\tcalll\t_helper\n"
+                                        "\tretl\n"
+                                        "_helper:\n"
+                                        "\tjmp\t.L1\n"
+                                        ".L1:\n"
+                                        "\tretl\n"});
+
+    const std::vector<std::string> expected{"main", "helperunit1", "l1unit1", "f", "helperunit2", "l1unit2"};
+    EXPECT_EQ(expected, get_labels(instructions));
+}
+
+TEST(test_linker, test_unreachable_functions_and_data_are_removed)
+{
+    const auto instructions = ca::link({"\t.globl\t_main\n"
+                                        "_main:\n"
+                                        "\tmovb\t_used+1, %al\n"
+                                        "\tretl\n"
+                                        "\t.globl\t_unused\n"
+                                        "_unused:\n"
+                                        "\tmovb\t_unused_data, %al\n"
+                                        "\tretl\n",
+                                        "\t.data\n"
+                                        "\t.globl\t_used\n"
+                                        "_used:\n"
+                                        "\t.byte\t1, 2\n"
+                                        "\t.globl\t_unused_data\n"
+                                        "_unused_data:\n"
+                                        "\t.byte\t3\n"});
+
+    // Labels that aren't the operand of an instruction as a whole are left out of the output, but their data isn't
+    const auto has_line = [&instructions](const std::string &text) {
+        return std::any_of(std::begin(instructions), std::end(instructions),
+                           [&text](const auto &i) { return i.line_text() == text; });
+    };
+    EXPECT_TRUE(has_line("\t.byte\t1, 2"));
+    EXPECT_FALSE(has_line("\t.byte\t3"));
+    EXPECT_FALSE(has_line("\tmovb\t_unused_data, %al"));
+}
+
+TEST(test_linker, test_entry_points_without_underscore_are_kept)
+{
+    const auto instructions = ca::link({"foo:\n"
+                                        "\tmovb\t$1, 53280\n"
+                                        "\tret\n"
+                                        "main:\n"
+                                        "\tmovb\t$2, 53281\n"
+                                        "\tcalll\tfoo\n"
+                                        "\tret\n",
+                                        "\t.globl\tnmi\n"
+                                        "nmi:\n"
+                                        "\tretl\n"});
+
+    const std::vector<std::string> expected{"foounit1", "main", "nmi"};
+    EXPECT_EQ(expected, get_labels(instructions));
+
+    const auto store = std::find_if(std::begin(instructions), std::end(instructions),
+                                    [](const auto &i) { return i.operand2().value() == "53281"; });
+    EXPECT_NE(std::end(instructions), store);
+}
+
+TEST(test_linker, test_function_exported_by_two_units_is_an_error)
+{
+    EXPECT_THROW(ca::link({"\t.globl\t_main\n_main:\n\tretl\n", "\t.globl\t_main\n_main:\n\tretl\n"}),
+                 std::runtime_error);
+}
@@ -54,3 +54,50 @@ TEST(test_parse_x86_asm_line, test_basic_binary_instruction_line)
     test_line("\taddl\t$8, %esp", ca::asm_line::line_type::instruction);
     test_line("\tmovb\t$-1, 24577", ca::asm_line::line_type::instruction);
 }
+
+TEST(test_parse_x86_asm_line, test_conditional_jump_line)
+{
+    EXPECT_EQ(ca::intel_386_opcode::jb, ca::intel_386::parse("\tjb\tLBB0_2", 0).opcode());
+    EXPECT_EQ(ca::intel_386_opcode::jge, ca::intel_386::parse("\tjge\tLBB0_2", 0).opcode());
+    EXPECT_EQ(ca::intel_386_opcode::jno, ca::intel_386::parse("\tjno\tLBB0_2", 0).opcode());
+}
+
+TEST(test_parse_x86_asm_line, test_memory_operand)
+{
+    const auto line = ca::intel_386::parse("\tmovb\t_table-2(%eax,%ecx,4), %dl", 0);
+    ASSERT_TRUE(line.operand1().is_memory());
+    EXPECT_TRUE(line.operand1().is_literal());
+
+    const auto &m = line.operand1().memory();
+    EXPECT_EQ("_table", m.symbol);
+    EXPECT_EQ(-2, m.displacement);
+    EXPECT_EQ(ca::intel_386_register::eax, m.base);
+    EXPECT_EQ(ca::intel_386_register::ecx, m.index);
+    EXPECT_EQ(4, m.scale);
+    EXPECT_EQ("_table-2(%eax,%ecx,4)", line.operand1().value());
+
+    const auto index = ca::intel_386::parse("\tmovb\t2040(,%ecx), %al", 0).operand1();
+    ASSERT_TRUE(index.is_memory());
+    EXPECT_EQ(2040, index.memory().displacement);
+    EXPECT_EQ(ca::intel_386_register::unknown, index.memory().base);
+    EXPECT_EQ(ca::intel_386_register::ecx, index.memory().index);
+
+    // Addresses without a register stay plain literals, just like jump targets
+    EXPECT_FALSE(ca::intel_386::parse("\tmovb\t$-1, 24577", 0).operand2().is_memory());
+}
+
+TEST(test_parse_x86_asm_line, test_literal_values)
+{
+    const auto immediate = ca::intel_386::parse("\tmovb\t$-1, 24577", 0);
+    EXPECT_EQ(ca::literal_kind::immediate, immediate.operand1().literal().kind);
+    EXPECT_EQ(-1, immediate.operand1().literal().number);
+    EXPECT_EQ(ca::literal_kind::address, immediate.operand2().literal().kind);
+    EXPECT_EQ(24577, immediate.operand2().literal().number);
+
+    const auto symbol = ca::intel_386::parse("\tpushl\t$_table+2", 0).operand1();
+    EXPECT_EQ(ca::literal_kind::symbol, symbol.literal().kind);
+    EXPECT_EQ("_table", symbol.literal().symbol);
+    EXPECT_EQ(2, symbol.literal().number);
+
+    EXPECT_EQ(ca::literal_kind::text, ca::intel_386::parse("\tjb\tLBB0_2", 0).operand1().literal().kind);
+}
@@ -0,0 +1,118 @@
+#include <ca/static_frames.h>
+#include <ca/intel_386.h>
+#include <gtest/gtest.h>
+
+static auto to_string(const ca::intel_386 &i) -> std::string
+{
+    const auto to_string = [](const ca::instruction_operand &o) -> std::string {
+        return o.is_register() ? "%" + std::to_string(static_cast<int>(o.reg())) : o.value();
+    };
+
+    auto result = i.text();
+    if (!i.operand1().is_empty())
+        result += ' ' + to_string(i.operand1());
+    if (!i.operand2().is_empty())
+        result += ", " + to_string(i.operand2());
+    return result;
+}
+
+static auto allocate(const std::vector<std::string> &lines) -> std::vector<std::string>
+{
+    std::vector<ca::intel_386> instructions;
+    auto line_number = 0;
+    for (const auto &line : lines)
+        instructions.emplace_back(ca::intel_386::parse(line, line_number++));
+
+    ca::allocate_static_frames(instructions, {1000, 64});
+
+    std::vector<std::string> result;
+    for (const auto &i : instructions)
+        result.emplace_back(to_string(i));
+    return result;
+}
+
+TEST(test_static_frames, test_frames_of_sibling_calls_overlap)
+{
+    const auto result = allocate({"main:", "\tsubl\t$4, %esp", "\tmovb\t$1, 3(%esp)", "\tcalll\tf", "\tcalll\tg",
+                                  "\taddl\t$4, %esp", "\tretl", "f:", "\tsubl\t$2, %esp", "\tmovb\t$2, (%esp)",
+                                  "\taddl\t$2, %esp", "\tretl", "g:", "\tsubl\t$8, %esp", "\tmovb\t$3, 4(%esp)",
+                                  "\taddl\t$8, %esp", "\tretl"});
+    const std::vector<std::string> expected{"main", "movb $1, 1003", "calll f", "calll g", "retl", "f",
+                                            "movb $2, 1004", "retl", "g", "movb $3, 1008", "retl"};
+    EXPECT_EQ(expected, result);
+}
+
+TEST(test_static_frames, test_frame_pointer_and_arguments)
+{
+    const auto result = allocate({"main:", "\tpushl\t$7", "\tcalll\tf", "\taddl\t$4, %esp", "\tretl", "f:",
+                                  "\tpushl\t%ebp", "\tmovl\t%esp, %ebp", "\tsubl\t$4, %esp", "\tmovb\t8(%ebp), %al",
+                                  "\tmovb\t%al, -4(%ebp)", "\tpushl\t%eax", "\tmovb\t16(%esp), %al",
+                                  "\tcalll\tputchar", "\taddl\t$4, %esp", "\tleave", "\tretl"});
+    const std::vector<std::string> expected{"main", "pushl $7", "calll f", "retl", "f", "movb 4(%esp), %1",
+                                            "movb %1, 1000", "pushl %4", "movb 8(%esp), %1", "calll putchar", "retl"};
+    EXPECT_EQ(expected, result);
+}
+
+TEST(test_static_frames, test_recursive_function_keeps_its_stack_frame)
+{
+    const auto result = allocate({"main:", "\tcalll\tf", "\tretl", "f:", "\tsubl\t$4, %esp", "\tmovb\t$1, (%esp)",
+                                  "\tcalll\tf", "\taddl\t$4, %esp", "\tretl"});
+    const std::vector<std::string> expected{"main", "calll f", "retl", "f", "subl $4, %28", "movb $1, (%esp)",
+                                            "calll f", "addl $4, %28", "retl"};
+    EXPECT_EQ(expected, result);
+}
+
+TEST(test_static_frames, test_popping_arguments_is_kept_when_asked_for)
+{
+    std::vector<ca::intel_386> instructions;
+    auto line_number = 0;
+    for (const auto *line : {"main:", "\tsubl\t$4, %esp", "\tmovb\t$1, 3(%esp)", "\tpushl\t$7", "\tcalll\tf",
+                             "\taddl\t$8, %esp", "\tretl", "f:", "\tretl"})
+        instructions.emplace_back(ca::intel_386::parse(line, line_number++));
+
+    ca::allocate_static_frames(instructions, {1000, 64, true});
+
+    std::vector<std::string> result;
+    for (const auto &i : instructions)
+        result.emplace_back(to_string(i));
+
+    const std::vector<std::string> expected{"main", "movb $1, 1003", "pushl $7", "calll f", "addl $4, %28", "retl",
+                                            "f",    "retl"};
+    EXPECT_EQ(expected, result);
+}
+
+TEST(test_static_frames, test_arguments_read_by_a_function_that_makes_calls_are_copied)
+{
+    std::vector<ca::intel_386> instructions;
+    auto line_number = 0;
+    for (const auto *line : {"main:", "\tsubl\t$4, %esp", "\tmovb\t$1, (%esp)", "\tcalll\tf", "\tmovb\t12(%esp), %al",
+                             "\taddl\t$4, %esp", "\tretl", "f:", "\tmovb\t4(%esp), %al", "\tretl"})
+        instructions.emplace_back(ca::intel_386::parse(line, line_number++));
+
+    ca::allocate_static_frames(instructions, {1000, 64, false, 2});
+
+    // The second argument of main is copied behind its locals; f makes no calls, so it reads its argument in place
+    std::vector<std::string> result;
+    for (const auto &i : instructions)
+        result.emplace_back(to_string(i));
+    const std::vector<std::string> expected{"main",         "movb 4(%esp), %1", "movb %1, 1004", "movb 5(%esp), %1",
+                                            "movb %1, 1005", "movb 8(%esp), %1", "movb %1, 1008", "movb 9(%esp), %1",
+                                            "movb %1, 1009", "movb $1, 1000",   "calll f",        "movb 1008, %1",
+                                            "retl",          "f",               "movb 4(%esp), %1", "retl"};
+    EXPECT_EQ(expected, result);
+}
+
+TEST(test_static_frames, test_function_ending_on_the_last_line)
+{
+    // 64 lines fill the removal flags up to a word boundary exactly
+    std::vector<std::string> lines{"main:", "\tsubl\t$8, %esp"};
+    for (auto i = 0; i < 60; ++i)
+        lines.emplace_back("\tmovb\t$1, 4(%esp)");
+    lines.emplace_back("\taddl\t$8, %esp");
+    lines.emplace_back("\tretl");
+
+    const auto result = allocate(lines);
+    ASSERT_EQ(62u, result.size());
+    EXPECT_EQ("movb $1, 1004", result[1]);
+    EXPECT_EQ("retl", result.back());
+}
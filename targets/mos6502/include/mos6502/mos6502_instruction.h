@@ -2,9 +2,47 @@
 
 #include <ca/asm_line.h>
 #include <ca/instruction_operand.h>
+#include <cstdint>
+#include <memory>
+#include <string>
 
 enum class mos6502_opcode : int;
 
+// Bit masks for the processor status flags an instruction reads or writes.
+namespace mos6502_flags
+{
+constexpr std::uint8_t carry = 0x01;
+constexpr std::uint8_t zero = 0x02;
+constexpr std::uint8_t overflow = 0x04;
+constexpr std::uint8_t negative = 0x08;
+constexpr std::uint8_t all = carry | zero | overflow | negative;
+} // namespace mos6502_flags
+
+// The x86 source line an instruction was generated from. All instructions of a line share its text instead of holding
+// a copy each.
+class source_line
+{
+public:
+    source_line() = default;
+
+    explicit source_line(std::string text)
+        : text_{std::make_shared<const std::string>(std::move(text))}
+    {
+    }
+
+    auto text() const noexcept -> const std::string &;
+
+    auto operator==(const source_line &other) const -> bool
+    {
+        return text_ == other.text_ || text() == other.text();
+    }
+
+private:
+    std::shared_ptr<const std::string> text_;
+};
+
+// An instruction, label or directive. The mnemonic is formatted from the opcode when the line is printed, and the
+// comment is shared with the other instructions of its x86 line, so that an instruction only holds its own operand.
 struct mos6502 : ca::asm_line
 {
     explicit mos6502(const mos6502_opcode o);
@@ -30,7 +68,7 @@ struct mos6502 : ca::asm_line
         return comment_;
     }
 
-    void set_comment(std::string comment) noexcept
+    void set_comment(source_line comment) noexcept
     {
         comment_ = std::move(comment);
     }
@@ -45,10 +83,22 @@ struct mos6502 : ca::asm_line
         return is_comparison_;
     }
 
+    auto flags_read() const noexcept
+    {
+        return flags_read_;
+    }
+
+    auto flags_written() const noexcept
+    {
+        return flags_written_;
+    }
+
 private:
     mos6502_opcode opcode_;
     ca::instruction_operand operand_;
-    std::string comment_;
+    source_line comment_;
     bool is_branch_ = false;
     bool is_comparison_ = false;
+    std::uint8_t flags_read_ = 0;
+    std::uint8_t flags_written_ = 0;
 };
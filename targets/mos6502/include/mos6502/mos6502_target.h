@@ -3,14 +3,87 @@
 #include <ca/target.h>
 #include <ca/instruction_operand.h>
 #include <mos6502/mos6502_instruction.h>
+#include <functional>
+#include <optional>
 #include <string>
 #include <vector>
 #include <stdexcept>
+#include <cctype>
+#include <algorithm>
+
+namespace internal
+{
+struct zero_page_registers;
+} // namespace internal
+
+// How arguments are passed to functions
+enum class calling_convention
+{
+    // cdecl as written by the compiler; pushl places arguments on the hardware stack
+    stack,
+
+    // Arguments go to fixed zero page slots instead, where callees read their N(%esp) operands from
+    zero_page
+};
+
+// The processor the code is generated for
+enum class instruction_set
+{
+    // The original NMOS 6502, as found in the C64
+    nmos6502,
+
+    // The same, but also using the stable undocumented opcodes lax, sax, dcp, isc, anc and alr
+    nmos6502_undocumented,
+
+    // The CMOS 65C02, which adds instructions like stz, bra, phx and trb
+    wdc65c02,
+
+    // The 65816 in native mode, which adds 16-bit operations, block moves and stack relative addressing to those of
+    // the 65C02. The code runs with 8-bit registers and switches to 16 bits where that pays off.
+    wdc65816,
+
+    // The HuC6280 of the PC Engine, which adds block transfers and stores to the video display controller to those
+    // of the 65C02. RAM is expected at $2000-$3fff and the I/O page at $0000-$1fff, as after a reset.
+    huc6280
+};
+
+// How much effort finalize spends on the generated code
+enum class optimization_level
+{
+    // -O0: only the passes the code is wrong without, for the fastest turnaround
+    none,
+
+    // -O1: also the cheap passes that only ever make the code smaller and faster
+    basic,
+
+    // -O2: everything, including the loop passes and those that trade size for speed
+    speed,
+
+    // -Os: everything except the passes that make the code larger
+    size
+};
+
+struct optimization_options
+{
+    optimization_level level = optimization_level::speed;
+
+    // Passes to run or skip regardless of the level, by the names mos6502_target::get_pass_names returns
+    std::vector<std::string> enabled_passes;
+    std::vector<std::string> disabled_passes;
+
+    // Report the number of runs, changes and time of every pass and analysis to stderr
+    bool time_passes = false;
+};
 
 class mos6502_target final : public ca::target
 {
 public:
     mos6502_target() = default;
+    // Given the address the code will be loaded at, loops and tables are kept from straddling pages.
+    // Throws if the options name a pass that doesn't exist or disable one the code is wrong without.
+    explicit mos6502_target(const calling_convention convention,
+                            const instruction_set instructions = instruction_set::nmos6502,
+                            const std::optional<int> origin = std::nullopt, optimization_options options = {});
     virtual ~mos6502_target() = default;
 
     mos6502_target(mos6502_target &&) noexcept = delete;
@@ -19,10 +92,20 @@ public:
     mos6502_target(const mos6502_target &) noexcept = delete;
     auto operator=(const mos6502_target &) noexcept -> mos6502_target & = delete;
 
+    // The names of all passes that finalize may run, in the order it runs them
+    static auto get_pass_names() -> std::vector<std::string>;
+
 private:
-    int parse_literal(const std::string &s)
+    // The value of a numeric immediate, as parsed by the front end
+    auto parse_literal(const ca::instruction_operand &o) const noexcept
+    {
+        return static_cast<int>(o.literal().number);
+    }
+
+    // Returns true for numeric immediates like $-1 or $4660, as opposed to symbols like $_table.
+    auto is_numeric_literal(const ca::instruction_operand &o) const noexcept
     {
-        return std::stoi(std::string(std::next(std::begin(s)), std::end(s)));
+        return o.is_literal() && o.literal().kind == ca::literal_kind::immediate;
     }
 
     auto is_8bit_literal(const int value) noexcept
@@ -45,19 +128,19 @@ private:
         return static_cast<std::uint8_t>(value & 0xff);
     }
 
-    std::string create_8bit_literal(const int value)
+    auto create_8bit_literal(const int value) const -> ca::instruction_operand
     {
-        return "#" + std::to_string(static_cast<uint8_t>(value));
+        const auto byte = static_cast<std::uint8_t>(value);
+        return {{ca::literal_kind::immediate, byte, 1}, "#" + std::to_string(byte)};
     }
 
-    std::string fixup_8bit_literal(const std::string &s)
+    // Truncates an immediate to its low byte; anything else, like a memory operand, is returned unchanged.
+    auto fixup_8bit_literal(const ca::instruction_operand &o) -> ca::instruction_operand
     {
-        if (s[0] == '$')
-        {
-            return "#" + std::to_string(static_cast<uint8_t>(parse_literal(s)));
-        }
+        if (is_immediate(o))
+            return get_operand_byte(o, 0);
 
-        return s;
+        return o;
     }
 
     auto get_register(const ca::intel_386_register reg, const int offset = 0) const -> ca::instruction_operand
@@ -118,6 +201,7 @@ private:
                 else
                     throw std::runtime_error("Unexpected register offset.");
             case ca::intel_386_register::si:
+            case ca::intel_386_register::esi:
                 if (offset == 0)
                     return get_register(ca::intel_386_register::sil);
                 else if (offset == 1)
@@ -125,6 +209,7 @@ private:
                 else
                     throw std::runtime_error("Unexpected register offset.");
             case ca::intel_386_register::di:
+            case ca::intel_386_register::edi:
                 if (offset == 0)
                     return get_register(ca::intel_386_register::dil);
                 else if (offset == 1)
@@ -145,10 +230,167 @@ private:
                 break;
         }
 
-        // TODO: i386_register enum to string
-        throw std::runtime_error("Unhandled register: " + std::to_string(static_cast<int>(reg)));
+        throw std::runtime_error("Unhandled register: " + ca::to_string(reg));
+    }
+
+    // Registers only hold 16 bits on this target; memory operands keep their full 32 bits.
+    auto get_operand_size(const ca::instruction_operand &o) const noexcept -> int
+    {
+        return o.is_register() ? 2 : 4;
+    }
+
+    auto is_immediate(const ca::instruction_operand &o) const noexcept -> bool
+    {
+        return o.is_literal() &&
+               (o.literal().kind == ca::literal_kind::immediate || o.literal().kind == ca::literal_kind::symbol);
+    }
+
+    // Returns the value of the byte at the given offset if it is known at compile time, or -1 otherwise.
+    auto get_known_byte(const ca::instruction_operand &o, const int offset) const noexcept -> int
+    {
+        if (o.is_register())
+            return offset < 2 ? -1 : 0;
+
+        if (is_numeric_literal(o))
+            return static_cast<int>((o.literal().number >> (8 * offset)) & 0xff);
+
+        return -1;
+    }
+
+    // Returns true if all bytes starting at the given offset are known to be zero.
+    auto are_upper_bytes_zero(const ca::instruction_operand &o, const int offset, const int size) -> bool
+    {
+        for (auto i = offset; i < size; ++i)
+        {
+            if (get_known_byte(o, i) != 0)
+                return false;
+        }
+
+        return true;
+    }
+
+    // Returns the 6502 operand that addresses a single byte of a 32-bit x86 operand.
+    auto get_operand_byte(const ca::instruction_operand &o, const int offset) -> ca::instruction_operand
+    {
+        if (o.is_register())
+        {
+            if (offset < 2)
+                return get_register(o.reg(), offset);
+
+            return create_8bit_literal(0);
+        }
+
+        if (is_numeric_literal(o))
+            return create_8bit_literal(get_known_byte(o, offset));
+
+        if (is_immediate(o))
+        {
+            if (offset > 1)
+                return create_8bit_literal(0);
+
+            auto byte = o.literal();
+            byte.width = 1;
+            byte.selection = offset == 0 ? ca::byte_selection::low : ca::byte_selection::high;
+            return {std::move(byte), (offset == 0 ? "#<" : "#>") + o.value().substr(1)};
+        }
+
+        if (offset == 0)
+            return o;
+
+        if (o.is_memory())
+        {
+            auto m = o.memory();
+            m.displacement += offset;
+            return ca::instruction_operand(std::move(m));
+        }
+
+        if (o.literal().kind == ca::literal_kind::address)
+        {
+            const auto address = o.literal().number + offset;
+            return {{ca::literal_kind::address, address}, std::to_string(address)};
+        }
+
+        return ca::instruction_operand(ca::operand_type::literal, o.value() + "+" + std::to_string(offset));
+    }
+
+    // Returns the address that a pointer immediate like $buffer or $1024 refers to, moved by the given number of bytes.
+    auto get_pointer_target(const ca::instruction_operand &o, const int offset, const std::string &index = "")
+        -> ca::instruction_operand
+    {
+        if (is_numeric_literal(o))
+        {
+            return ca::instruction_operand(ca::operand_type::literal,
+                                           std::to_string(o.literal().number + offset) + index);
+        }
+
+        const auto address = o.value().substr(1);
+
+        if (offset == 0)
+            return ca::instruction_operand(ca::operand_type::literal, address + index);
+
+        return ca::instruction_operand(ca::operand_type::literal,
+                                       address + (offset > 0 ? "+" : "") + std::to_string(offset) + index);
+    }
+
+    // Maps a stack operand like 4(%esp) to the zero page argument slot it refers to when arguments are passed in the
+    // zero page, or to a stack relative operand for the given instruction on the 65816. Returns other operands
+    // unchanged.
+    auto get_argument_slot(const mos6502_opcode opcode, const ca::instruction_operand &o) const
+        -> ca::instruction_operand;
+
+    // On the 65816 arguments on the stack are read in place. Every pushed argument takes 2 bytes with the low byte at
+    // the lower address, like the return address of jsr.
+    auto uses_stack_relative_arguments() const noexcept -> bool
+    {
+        return instruction_set_ == instruction_set::wdc65816 && calling_convention_ == calling_convention::stack;
     }
 
+    // Maps a memory operand to the cheapest addressing mode for it, and emits the load of X or Y that an indexed mode
+    // needs. Returns other operands unchanged.
+    auto lower_memory_operand(const ca::instruction_operand &o) -> ca::instruction_operand;
+
+    // Labels for control flow inside of a single lowered instruction. They contain an underscore, which never
+    // appears in labels taken from the x86 source.
+    auto create_local_label() -> std::string
+    {
+        return "local_" + std::to_string(++local_label_count_);
+    }
+
+    void emit_add(const ca::instruction_operand &source, const ca::instruction_operand &destination);
+    void emit_subtract(const ca::instruction_operand &source, const ca::instruction_operand &destination);
+    void emit_increment(const ca::instruction_operand &destination);
+    void emit_decrement(const ca::instruction_operand &destination);
+    void emit_bitwise(const mos6502_opcode o, const ca::instruction_operand &source,
+                      const ca::instruction_operand &destination);
+    void emit_zero_test(const ca::instruction_operand &destination);
+    void emit_absolute_block(const ca::instruction_operand &destination, const ca::instruction_operand &source,
+                             const int size, const bool backwards);
+    void emit_indirect_block(const bool copy, const std::optional<int> size);
+    void emit_block_transfer_stub(const bool copy, const std::optional<int> size);
+    void emit_stack_adjustment(const int bytes);
+    void emit_counted_shift(const ca::instruction_operand &count, const std::function<void()> &shift);
+    auto inline_library_call(const std::string &function) -> bool;
+
+    auto get_zero_page_registers() const -> internal::zero_page_registers;
+
+    // Which 6502 flags still match the x86 flags, based on the last instruction that set them. Conditional jumps
+    // pick their branch sequence from this, since 6502 carry is inverted after subtraction and never changes for
+    // logic operations.
+    enum class flags_source
+    {
+        comparison,    // cmp: N, Z and C (set when no borrow), but no V
+        subtraction,   // sec/sbc: N, Z, C (set when no borrow) and V
+        addition,      // clc/adc: N, Z, C and V
+        logic,         // and/ora/eor and friends: N and Z, x86 clears CF and OF
+        sign_and_zero, // N and Z of the result only
+        zero,          // Z only, as produced for multi-byte results
+        none           // nothing, like multi-byte shifts where Z only covers the last byte
+    };
+
+    void set_flags_source(const flags_source source);
+    void enable_overflow_flag();
+    void emit_signed_branch(const bool less, const ca::instruction_operand &destination);
+
     template <typename... T>
     void emit(T... t)
     {
@@ -157,6 +399,13 @@ private:
         instructions_.back().set_comment(current_text_);
     }
 
+    void emit(const mos6502_opcode o, const ca::instruction_operand &operand)
+    {
+        auto lowered = lower_memory_operand(get_argument_slot(o, operand));
+        instructions_.emplace_back(o, std::move(lowered));
+        instructions_.back().set_comment(current_text_);
+    }
+
     const auto &current_label() const noexcept
     {
         return current_label_;
@@ -164,6 +413,8 @@ private:
 
     void set_current_text(const std::string &text) override;
     void finalize() override;
+    auto get_frame_area() const -> ca::memory_area override;
+    auto get_ir_passes() const -> std::vector<std::string> override;
 
     void translate_unknown(const std::string &line) override;
     void translate_label(const std::string &line) override;
@@ -182,6 +433,17 @@ private:
     void translate_jne(const ca::instruction_operand &o1, const ca::instruction_operand &o2) override;
     void translate_je(const ca::instruction_operand &o1, const ca::instruction_operand &o2) override;
     void translate_js(const ca::instruction_operand &o1, const ca::instruction_operand &o2) override;
+    void translate_jns(const ca::instruction_operand &o1, const ca::instruction_operand &o2) override;
+    void translate_jb(const ca::instruction_operand &o1, const ca::instruction_operand &o2) override;
+    void translate_jae(const ca::instruction_operand &o1, const ca::instruction_operand &o2) override;
+    void translate_ja(const ca::instruction_operand &o1, const ca::instruction_operand &o2) override;
+    void translate_jbe(const ca::instruction_operand &o1, const ca::instruction_operand &o2) override;
+    void translate_jl(const ca::instruction_operand &o1, const ca::instruction_operand &o2) override;
+    void translate_jge(const ca::instruction_operand &o1, const ca::instruction_operand &o2) override;
+    void translate_jg(const ca::instruction_operand &o1, const ca::instruction_operand &o2) override;
+    void translate_jle(const ca::instruction_operand &o1, const ca::instruction_operand &o2) override;
+    void translate_jo(const ca::instruction_operand &o1, const ca::instruction_operand &o2) override;
+    void translate_jno(const ca::instruction_operand &o1, const ca::instruction_operand &o2) override;
     void translate_jmp(const ca::instruction_operand &o1, const ca::instruction_operand &o2) override;
     void translate_ret(const ca::instruction_operand &o1, const ca::instruction_operand &o2) override;
     void translate_retl(const ca::instruction_operand &o1, const ca::instruction_operand &o2) override;
@@ -206,10 +468,38 @@ private:
     void translate_movzbl(const ca::instruction_operand &o1, const ca::instruction_operand &o2) override;
     void translate_movzwl(const ca::instruction_operand &o1, const ca::instruction_operand &o2) override;
 
+    void translate_leave(const ca::instruction_operand &o1, const ca::instruction_operand &o2) override;
+    void translate_popl(const ca::instruction_operand &o1, const ca::instruction_operand &o2) override;
     void translate_pushl(const ca::instruction_operand &o1, const ca::instruction_operand &o2) override;
     void translate_rep(const ca::instruction_operand &o1, const ca::instruction_operand &o2) override;
 
+    // The instructions emitted for each pushl, so that calls to known library functions can take their arguments
+    // directly instead of from the stack.
+    struct pushed_argument
+    {
+        ca::instruction_operand operand;
+        size_t first_instruction;
+        size_t end_instruction;
+    };
+
+    void assign_argument_slots();
+
     std::vector<mos6502> instructions_;
-    std::string current_text_;
+    std::vector<pushed_argument> pushed_arguments_;
+
+    // The addresses and length of a HuC6280 block transfer are operands, so transfers between pointers that are only
+    // known at run time are written to this RAM together with an rts, and called there.
+    static constexpr int transfer_stub_address_ = 0x2200;
+    static constexpr int transfer_stub_size_ = 8;
+
+    int inlined_argument_bytes_ = 0; // Of library calls that were replaced; the caller still pops them
+    calling_convention calling_convention_ = calling_convention::stack;
+    instruction_set instruction_set_ = instruction_set::nmos6502;
+    std::optional<int> origin_;
+    optimization_options optimization_options_;
+    source_line current_text_;
     std::string current_label_;
+    int local_label_count_ = 0;
+    flags_source flags_source_ = flags_source::sign_and_zero;
+    size_t flags_instruction_ = 0;
 };
@@ -8,24 +8,31 @@ void mos6502_target::translate_andb(const ca::instruction_operand &o1, const ca:
     {
         const auto reg = get_register(o2.reg());
         emit(mos6502_opcode::lda, reg);
-        emit(mos6502_opcode::AND, ca::instruction_operand(ca::operand_type::literal, fixup_8bit_literal(o1.value())));
+        emit(mos6502_opcode::AND, fixup_8bit_literal(o1));
         emit(mos6502_opcode::sta, reg);
     }
     else if (o1.is_literal() && o2.is_literal())
     {
         emit(mos6502_opcode::lda, o2);
-        emit(mos6502_opcode::AND, ca::instruction_operand(ca::operand_type::literal, fixup_8bit_literal(o1.value())));
+        emit(mos6502_opcode::AND, fixup_8bit_literal(o1));
         emit(mos6502_opcode::sta, o2);
     }
     else
     {
         throw std::runtime_error("Cannot translate andb instruction");
     }
+
+    set_flags_source(flags_source::logic);
 }
 
 void mos6502_target::translate_andl(const ca::instruction_operand &o1, const ca::instruction_operand &o2)
 {
-    throw std::runtime_error("Cannot translate andl instruction");
+    if (is_immediate(o2))
+        throw std::runtime_error("Cannot translate andl instruction");
+
+    emit_bitwise(mos6502_opcode::AND, o1, o2);
+
+    set_flags_source(flags_source::zero);
 }
 
 void mos6502_target::translate_notb(const ca::instruction_operand &o1, const ca::instruction_operand &o2)
@@ -47,7 +54,7 @@ void mos6502_target::translate_orb(const ca::instruction_operand &o1, const ca::
 {
     if (o1.is_literal() && o2.is_literal())
     {
-        emit(mos6502_opcode::lda, ca::instruction_operand(ca::operand_type::literal, fixup_8bit_literal(o1.value())));
+        emit(mos6502_opcode::lda, fixup_8bit_literal(o1));
         emit(mos6502_opcode::ORA, o2);
         emit(mos6502_opcode::sta, o2);
     }
@@ -59,7 +66,7 @@ void mos6502_target::translate_orb(const ca::instruction_operand &o1, const ca::
     }
     else if (o1.is_literal() && o2.is_register())
     {
-        emit(mos6502_opcode::lda, ca::instruction_operand(ca::operand_type::literal, fixup_8bit_literal(o1.value())));
+        emit(mos6502_opcode::lda, fixup_8bit_literal(o1));
         emit(mos6502_opcode::ORA, get_register(o2.reg()));
         emit(mos6502_opcode::sta, get_register(o2.reg()));
     }
@@ -67,11 +74,18 @@ void mos6502_target::translate_orb(const ca::instruction_operand &o1, const ca::
     {
         throw std::runtime_error("Cannot translate orb instruction");
     }
+
+    set_flags_source(flags_source::logic);
 }
 
 void mos6502_target::translate_orl(const ca::instruction_operand &o1, const ca::instruction_operand &o2)
 {
-    throw std::runtime_error("Cannot translate orl instruction");
+    if (is_immediate(o2))
+        throw std::runtime_error("Cannot translate orl instruction");
+
+    emit_bitwise(mos6502_opcode::ORA, o1, o2);
+
+    set_flags_source(flags_source::zero);
 }
 
 void mos6502_target::translate_shrb(const ca::instruction_operand &o1, const ca::instruction_operand &o2)
@@ -82,12 +96,16 @@ void mos6502_target::translate_shrb(const ca::instruction_operand &o1, const ca:
 
         if (o1.is_literal())
         {
-            const auto count = parse_literal(o1.value());
+            const auto count = parse_literal(o1);
             for (int i = 0; i < count; ++i)
             {
                 do_shift(o2.reg());
             }
         }
+        else if (o2.is_register())
+        {
+            emit_counted_shift(o1, [&]() { do_shift(o2.reg()); });
+        }
         else
         {
             do_shift(o1.reg());
@@ -97,6 +115,8 @@ void mos6502_target::translate_shrb(const ca::instruction_operand &o1, const ca:
     {
         throw std::runtime_error("Cannot translate shrb instruction");
     }
+
+    set_flags_source(flags_source::sign_and_zero);
 }
 
 void mos6502_target::translate_shrl(const ca::instruction_operand &o1, const ca::instruction_operand &o2)
@@ -110,12 +130,16 @@ void mos6502_target::translate_shrl(const ca::instruction_operand &o1, const ca:
 
         if (o1.is_literal())
         {
-            const auto count = parse_literal(o1.value());
+            const auto count = parse_literal(o1);
             for (int i = 0; i < count; ++i)
             {
                 do_shift(o2.reg());
             }
         }
+        else if (o2.is_register())
+        {
+            emit_counted_shift(o1, [&]() { do_shift(o2.reg()); });
+        }
         else
         {
             do_shift(o1.reg());
@@ -125,6 +149,8 @@ void mos6502_target::translate_shrl(const ca::instruction_operand &o1, const ca:
     {
         throw std::runtime_error("Cannot translate shrl instruction");
     }
+
+    set_flags_source(flags_source::none);
 }
 
 void mos6502_target::translate_xorl(const ca::instruction_operand &o1, const ca::instruction_operand &o2)
@@ -134,9 +160,44 @@ void mos6502_target::translate_xorl(const ca::instruction_operand &o1, const ca:
         emit(mos6502_opcode::lda, ca::instruction_operand(ca::operand_type::literal, "#$00"));
         emit(mos6502_opcode::sta, get_register(o2.reg()));
         emit(mos6502_opcode::sta, get_register(o2.reg(), 1));
+        set_flags_source(flags_source::logic);
+    }
+    else if (!is_immediate(o2))
+    {
+        emit_bitwise(mos6502_opcode::eor, o1, o2);
+        set_flags_source(flags_source::zero);
     }
     else
     {
         throw std::runtime_error("Cannot translate xorl instruction");
     }
 }
+
+void mos6502_target::emit_bitwise(const mos6502_opcode o, const ca::instruction_operand &source,
+                                  const ca::instruction_operand &destination)
+{
+    const auto size = get_operand_size(destination);
+
+    for (auto offset = 0; offset < size; ++offset)
+    {
+        const auto value = get_known_byte(source, offset);
+        const auto destination_byte = get_operand_byte(destination, offset);
+
+        // Bytes that come out unchanged are skipped, bytes that come out constant are stored directly.
+        if ((o == mos6502_opcode::AND && value == 0xff) || (o != mos6502_opcode::AND && value == 0))
+            continue;
+
+        if ((o == mos6502_opcode::AND && value == 0) || (o == mos6502_opcode::ORA && value == 0xff))
+        {
+            emit(mos6502_opcode::lda, create_8bit_literal(value));
+            emit(mos6502_opcode::sta, destination_byte);
+            continue;
+        }
+
+        emit(mos6502_opcode::lda, destination_byte);
+        emit(o, get_operand_byte(source, offset));
+        emit(mos6502_opcode::sta, destination_byte);
+    }
+
+    emit_zero_test(destination);
+}
@@ -6,7 +6,17 @@ void mos6502_target::translate_calll(const ca::instruction_operand &o1, const ca
 {
     if (o1.is_literal())
     {
-        emit(mos6502_opcode::jsr, o1);
+        inlined_argument_bytes_ = 0;
+        if (!inline_library_call(o1.value()))
+        {
+            if (calling_convention_ == calling_convention::zero_page)
+                assign_argument_slots();
+
+            emit(mos6502_opcode::jsr, o1);
+        }
+
+        pushed_arguments_.clear();
+        set_flags_source(flags_source::sign_and_zero);
     }
     else
     {
@@ -14,21 +24,335 @@ void mos6502_target::translate_calll(const ca::instruction_operand &o1, const ca
     }
 }
 
+void mos6502_target::set_flags_source(const flags_source source)
+{
+    flags_source_ = source;
+    flags_instruction_ = instructions_.empty() ? 0 : instructions_.size() - 1;
+}
+
+// cmp doesn't touch the overflow flag, so signed and overflow jumps redo the comparison as a subtraction. This
+// clobbers A, but every instruction translated since loads its own operands.
+void mos6502_target::enable_overflow_flag()
+{
+    if (flags_source_ != flags_source::comparison)
+        return;
+
+    const auto comment = instructions_[flags_instruction_].comment();
+    instructions_[flags_instruction_] = mos6502(mos6502_opcode::sbc, instructions_[flags_instruction_].operand());
+    instructions_[flags_instruction_].set_comment(comment);
+    instructions_.insert(std::next(std::begin(instructions_), flags_instruction_), mos6502(mos6502_opcode::sec));
+    instructions_[flags_instruction_].set_comment(comment);
+    ++flags_instruction_;
+
+    // The subtraction is no longer a comparison, so preserve its flags up to the next branch on them here instead of
+    // in fix_overwritten_flags.
+    auto use = flags_instruction_ + 1;
+    while (use < instructions_.size() &&
+           (!instructions_[use].is_branch() || instructions_[use - 1].comment() == instructions_[use].comment()))
+    {
+        ++use;
+    }
+
+    const auto overwritten =
+        std::any_of(std::next(std::begin(instructions_), flags_instruction_ + 1),
+                    std::next(std::begin(instructions_), use), [](const auto &i) { return i.flags_written() != 0; });
+
+    if (overwritten)
+    {
+        if (use < instructions_.size())
+        {
+            instructions_.insert(std::next(std::begin(instructions_), use), mos6502(mos6502_opcode::plp));
+            instructions_[use].set_comment(instructions_[use + 1].comment());
+        }
+        else
+        {
+            emit(mos6502_opcode::plp);
+        }
+
+        const auto push = flags_instruction_ + 1;
+        instructions_.insert(std::next(std::begin(instructions_), push), mos6502(mos6502_opcode::php));
+        instructions_[push].set_comment(comment);
+    }
+
+    flags_source_ = flags_source::subtraction;
+}
+
+// Branches if N xor V is set (less) or clear (greater or equal). The usual eor #$80 trick would clobber Z, which jg
+// and jle still need, so this tests V first instead.
+void mos6502_target::emit_signed_branch(const bool less, const ca::instruction_operand &destination)
+{
+    const auto no_overflow = create_local_label();
+    const auto done = create_local_label();
+
+    emit(mos6502_opcode::bvc, ca::instruction_operand(ca::operand_type::literal, no_overflow));
+    emit(less ? mos6502_opcode::bpl : mos6502_opcode::bmi, destination);
+    emit(mos6502_opcode::bvs, ca::instruction_operand(ca::operand_type::literal, done));
+    emit(ca::asm_line::line_type::label, no_overflow);
+    emit(less ? mos6502_opcode::bmi : mos6502_opcode::bpl, destination);
+    emit(ca::asm_line::line_type::label, done);
+}
+
 void mos6502_target::translate_jne(const ca::instruction_operand &o1, const ca::instruction_operand &o2)
 {
+    if (flags_source_ == flags_source::none)
+        throw std::runtime_error("Cannot translate jne instruction");
+
     emit(mos6502_opcode::bne, o1);
 }
 
 void mos6502_target::translate_je(const ca::instruction_operand &o1, const ca::instruction_operand &o2)
 {
+    if (flags_source_ == flags_source::none)
+        throw std::runtime_error("Cannot translate je instruction");
+
     emit(mos6502_opcode::beq, o1);
 }
 
 void mos6502_target::translate_js(const ca::instruction_operand &o1, const ca::instruction_operand &o2)
 {
+    if (flags_source_ == flags_source::zero || flags_source_ == flags_source::none)
+        throw std::runtime_error("Cannot translate js instruction");
+
     emit(mos6502_opcode::bmi, o1);
 }
 
+void mos6502_target::translate_jns(const ca::instruction_operand &o1, const ca::instruction_operand &o2)
+{
+    if (flags_source_ == flags_source::zero || flags_source_ == flags_source::none)
+        throw std::runtime_error("Cannot translate jns instruction");
+
+    emit(mos6502_opcode::bpl, o1);
+}
+
+// The 6502 carry is the inverse of the x86 one after a subtraction: set means no borrow.
+void mos6502_target::translate_jb(const ca::instruction_operand &o1, const ca::instruction_operand &o2)
+{
+    switch (flags_source_)
+    {
+        case flags_source::comparison:
+        case flags_source::subtraction:
+            emit(mos6502_opcode::bcc, o1);
+            break;
+        case flags_source::addition:
+            emit(mos6502_opcode::bcs, o1);
+            break;
+        case flags_source::logic:
+            // x86 clears the carry flag, so the jump is never taken
+            break;
+        case flags_source::sign_and_zero:
+        case flags_source::zero:
+        case flags_source::none:
+            throw std::runtime_error("Cannot translate jb instruction");
+    }
+}
+
+void mos6502_target::translate_jae(const ca::instruction_operand &o1, const ca::instruction_operand &o2)
+{
+    switch (flags_source_)
+    {
+        case flags_source::comparison:
+        case flags_source::subtraction:
+            emit(mos6502_opcode::bcs, o1);
+            break;
+        case flags_source::addition:
+            emit(mos6502_opcode::bcc, o1);
+            break;
+        case flags_source::logic:
+            emit(mos6502_opcode::jmp, o1);
+            break;
+        case flags_source::sign_and_zero:
+        case flags_source::zero:
+        case flags_source::none:
+            throw std::runtime_error("Cannot translate jae instruction");
+    }
+}
+
+void mos6502_target::translate_ja(const ca::instruction_operand &o1, const ca::instruction_operand &o2)
+{
+    const auto emit_carry_and_not_zero = [this, &o1](const mos6502_opcode carry_branch) {
+        const auto skip = create_local_label();
+        emit(mos6502_opcode::beq, ca::instruction_operand(ca::operand_type::literal, skip));
+        emit(carry_branch, o1);
+        emit(ca::asm_line::line_type::label, skip);
+    };
+
+    switch (flags_source_)
+    {
+        case flags_source::comparison:
+        case flags_source::subtraction:
+            emit_carry_and_not_zero(mos6502_opcode::bcs);
+            break;
+        case flags_source::addition:
+            emit_carry_and_not_zero(mos6502_opcode::bcc);
+            break;
+        case flags_source::logic:
+            emit(mos6502_opcode::bne, o1);
+            break;
+        case flags_source::sign_and_zero:
+        case flags_source::zero:
+        case flags_source::none:
+            throw std::runtime_error("Cannot translate ja instruction");
+    }
+}
+
+void mos6502_target::translate_jbe(const ca::instruction_operand &o1, const ca::instruction_operand &o2)
+{
+    switch (flags_source_)
+    {
+        case flags_source::comparison:
+        case flags_source::subtraction:
+            emit(mos6502_opcode::bcc, o1);
+            emit(mos6502_opcode::beq, o1);
+            break;
+        case flags_source::addition:
+            emit(mos6502_opcode::bcs, o1);
+            emit(mos6502_opcode::beq, o1);
+            break;
+        case flags_source::logic:
+            emit(mos6502_opcode::beq, o1);
+            break;
+        case flags_source::sign_and_zero:
+        case flags_source::zero:
+        case flags_source::none:
+            throw std::runtime_error("Cannot translate jbe instruction");
+    }
+}
+
+void mos6502_target::translate_jl(const ca::instruction_operand &o1, const ca::instruction_operand &o2)
+{
+    enable_overflow_flag();
+
+    switch (flags_source_)
+    {
+        case flags_source::subtraction:
+        case flags_source::addition:
+            emit_signed_branch(true, o1);
+            break;
+        case flags_source::logic:
+            // x86 clears the overflow flag, so only the sign is left
+            emit(mos6502_opcode::bmi, o1);
+            break;
+        case flags_source::comparison:
+        case flags_source::sign_and_zero:
+        case flags_source::zero:
+        case flags_source::none:
+            throw std::runtime_error("Cannot translate jl instruction");
+    }
+}
+
+void mos6502_target::translate_jge(const ca::instruction_operand &o1, const ca::instruction_operand &o2)
+{
+    enable_overflow_flag();
+
+    switch (flags_source_)
+    {
+        case flags_source::subtraction:
+        case flags_source::addition:
+            emit_signed_branch(false, o1);
+            break;
+        case flags_source::logic:
+            emit(mos6502_opcode::bpl, o1);
+            break;
+        case flags_source::comparison:
+        case flags_source::sign_and_zero:
+        case flags_source::zero:
+        case flags_source::none:
+            throw std::runtime_error("Cannot translate jge instruction");
+    }
+}
+
+void mos6502_target::translate_jg(const ca::instruction_operand &o1, const ca::instruction_operand &o2)
+{
+    enable_overflow_flag();
+
+    const auto skip = create_local_label();
+
+    switch (flags_source_)
+    {
+        case flags_source::subtraction:
+        case flags_source::addition:
+            emit(mos6502_opcode::beq, ca::instruction_operand(ca::operand_type::literal, skip));
+            emit_signed_branch(false, o1);
+            break;
+        case flags_source::logic:
+            emit(mos6502_opcode::beq, ca::instruction_operand(ca::operand_type::literal, skip));
+            emit(mos6502_opcode::bpl, o1);
+            break;
+        case flags_source::comparison:
+        case flags_source::sign_and_zero:
+        case flags_source::zero:
+        case flags_source::none:
+            throw std::runtime_error("Cannot translate jg instruction");
+    }
+
+    emit(ca::asm_line::line_type::label, skip);
+}
+
+void mos6502_target::translate_jle(const ca::instruction_operand &o1, const ca::instruction_operand &o2)
+{
+    enable_overflow_flag();
+
+    switch (flags_source_)
+    {
+        case flags_source::subtraction:
+        case flags_source::addition:
+            emit(mos6502_opcode::beq, o1);
+            emit_signed_branch(true, o1);
+            break;
+        case flags_source::logic:
+            emit(mos6502_opcode::beq, o1);
+            emit(mos6502_opcode::bmi, o1);
+            break;
+        case flags_source::comparison:
+        case flags_source::sign_and_zero:
+        case flags_source::zero:
+        case flags_source::none:
+            throw std::runtime_error("Cannot translate jle instruction");
+    }
+}
+
+void mos6502_target::translate_jo(const ca::instruction_operand &o1, const ca::instruction_operand &o2)
+{
+    enable_overflow_flag();
+
+    switch (flags_source_)
+    {
+        case flags_source::subtraction:
+        case flags_source::addition:
+            emit(mos6502_opcode::bvs, o1);
+            break;
+        case flags_source::logic:
+            // x86 clears the overflow flag, so the jump is never taken
+            break;
+        case flags_source::comparison:
+        case flags_source::sign_and_zero:
+        case flags_source::zero:
+        case flags_source::none:
+            throw std::runtime_error("Cannot translate jo instruction");
+    }
+}
+
+void mos6502_target::translate_jno(const ca::instruction_operand &o1, const ca::instruction_operand &o2)
+{
+    enable_overflow_flag();
+
+    switch (flags_source_)
+    {
+        case flags_source::subtraction:
+        case flags_source::addition:
+            emit(mos6502_opcode::bvc, o1);
+            break;
+        case flags_source::logic:
+            emit(mos6502_opcode::jmp, o1);
+            break;
+        case flags_source::comparison:
+        case flags_source::sign_and_zero:
+        case flags_source::zero:
+        case flags_source::none:
+            throw std::runtime_error("Cannot translate jno instruction");
+    }
+}
+
 void mos6502_target::translate_jmp(const ca::instruction_operand &o1, const ca::instruction_operand &o2)
 {
     emit(mos6502_opcode::jmp, o1);
@@ -0,0 +1,299 @@
+#include "cfg.h"
+#include "opcodes.h"
+#include <algorithm>
+#include <utility>
+
+namespace internal
+{
+
+namespace
+{
+
+void add_edge(control_flow_graph &cfg, const size_t from, const size_t to)
+{
+    auto &successors = cfg.blocks[from].successors;
+    if (std::find(std::begin(successors), std::end(successors), to) != std::end(successors))
+        return;
+
+    successors.push_back(to);
+    cfg.blocks[to].predecessors.push_back(from);
+}
+
+auto ends_block(const mos6502 &i) -> bool
+{
+    if (!i.is_instruction())
+        return false;
+
+    return i.is_branch() || i.opcode() == mos6502_opcode::jmp || i.opcode() == mos6502_opcode::rts ||
+           i.opcode() == mos6502_opcode::rti;
+}
+
+} // namespace
+
+auto build_control_flow_graph(const std::vector<mos6502> &instructions) -> control_flow_graph
+{
+    control_flow_graph cfg;
+    cfg.block_of.resize(instructions.size(), no_block);
+
+    auto starts_block = true;
+    for (size_t op = 0; op < instructions.size(); ++op)
+    {
+        const auto &i = instructions[op];
+        if (starts_block || i.is_label())
+        {
+            cfg.blocks.emplace_back();
+            cfg.blocks.back().begin = op;
+        }
+
+        cfg.blocks.back().end = op + 1;
+        cfg.block_of[op] = cfg.blocks.size() - 1;
+
+        if (i.is_label())
+            cfg.labels[i.text()] = cfg.blocks.size() - 1;
+
+        starts_block = ends_block(i);
+    }
+
+    for (size_t b = 0; b < cfg.blocks.size(); ++b)
+    {
+        auto &block = cfg.blocks[b];
+        for (auto op = block.begin; op < block.end; ++op)
+        {
+            const auto &i = instructions[op];
+            if (!i.is_instruction() || i.opcode() != mos6502_opcode::jsr)
+                continue;
+
+            const auto callee = cfg.labels.find(i.operand().value());
+            if (callee == std::end(cfg.labels))
+                continue;
+
+            auto &callees = block.callees;
+            if (std::find(std::begin(callees), std::end(callees), callee->second) == std::end(callees))
+                callees.push_back(callee->second);
+        }
+
+        const auto &last = instructions[block.end - 1];
+        auto falls_through = true;
+        if (last.is_instruction())
+        {
+            if (last.is_branch() || last.opcode() == mos6502_opcode::jmp)
+            {
+                const auto target = cfg.labels.find(last.operand().value());
+                if (target != std::end(cfg.labels))
+                    add_edge(cfg, b, target->second);
+                else
+                    block.leaves = true;
+
+                falls_through = last.is_branch() && last.opcode() != mos6502_opcode::bra;
+            }
+            else if (last.opcode() == mos6502_opcode::rts || last.opcode() == mos6502_opcode::rti)
+            {
+                block.returns = true;
+                falls_through = false;
+            }
+        }
+
+        if (falls_through)
+        {
+            if (b + 1 < cfg.blocks.size())
+                add_edge(cfg, b, b + 1);
+            else
+                block.leaves = true;
+        }
+    }
+
+    std::vector<bool> is_entry(cfg.blocks.size(), false);
+    for (size_t b = 0; b < cfg.blocks.size(); ++b)
+    {
+        if (b == 0 || cfg.blocks[b].predecessors.empty())
+            is_entry[b] = true;
+
+        for (const auto callee : cfg.blocks[b].callees)
+            is_entry[callee] = true;
+    }
+
+    for (size_t b = 0; b < cfg.blocks.size(); ++b)
+    {
+        if (is_entry[b])
+            cfg.entries.push_back(b);
+    }
+
+    return cfg;
+}
+
+auto dominator_tree::dominates(const size_t a, size_t b) const -> bool
+{
+    if (immediate_dominators[b] == no_block)
+        return false;
+
+    while (b != a)
+    {
+        const auto next = immediate_dominators[b];
+        if (next == b)
+            return false;
+        b = next;
+    }
+
+    return true;
+}
+
+// Cooper, Harvey and Kennedy's iterative algorithm, on a virtual root in front of all entries
+auto find_dominators(const control_flow_graph &cfg) -> dominator_tree
+{
+    const auto count = cfg.blocks.size();
+    const auto root = count;
+
+    const auto successors_of = [&cfg, root](const size_t n) -> const std::vector<size_t> & {
+        return n == root ? cfg.entries : cfg.blocks[n].successors;
+    };
+
+    // Postorder numbers of everything reachable from the root
+    std::vector<size_t> postorder(count + 1, no_block);
+    std::vector<size_t> order;
+    std::vector<bool> visited(count + 1, false);
+    std::vector<std::pair<size_t, size_t>> stack{{root, 0}};
+    visited[root] = true;
+    while (!stack.empty())
+    {
+        auto &[n, next] = stack.back();
+        const auto &successors = successors_of(n);
+        if (next < successors.size())
+        {
+            const auto s = successors[next++];
+            if (!visited[s])
+            {
+                visited[s] = true;
+                stack.emplace_back(s, 0);
+            }
+            continue;
+        }
+
+        postorder[n] = order.size();
+        order.push_back(n);
+        stack.pop_back();
+    }
+
+    std::vector<bool> is_entry(count, false);
+    for (const auto e : cfg.entries)
+        is_entry[e] = true;
+
+    std::vector<size_t> idom(count + 1, no_block);
+    idom[root] = root;
+
+    const auto intersect = [&idom, &postorder](size_t a, size_t b) {
+        while (a != b)
+        {
+            while (postorder[a] < postorder[b])
+                a = idom[a];
+            while (postorder[b] < postorder[a])
+                b = idom[b];
+        }
+        return a;
+    };
+
+    for (auto changed = true; changed;)
+    {
+        changed = false;
+        for (auto n = order.rbegin(); n != order.rend(); ++n)
+        {
+            if (*n == root)
+                continue;
+
+            auto new_idom = is_entry[*n] ? root : no_block;
+            for (const auto p : cfg.blocks[*n].predecessors)
+            {
+                if (idom[p] == no_block)
+                    continue;
+                new_idom = new_idom == no_block ? p : intersect(p, new_idom);
+            }
+
+            if (idom[*n] != new_idom)
+            {
+                idom[*n] = new_idom;
+                changed = true;
+            }
+        }
+    }
+
+    dominator_tree tree;
+    tree.immediate_dominators.resize(count, no_block);
+    for (size_t b = 0; b < count; ++b)
+        tree.immediate_dominators[b] = idom[b] == root ? b : idom[b];
+
+    return tree;
+}
+
+auto find_loop_nest(const control_flow_graph &cfg, const dominator_tree &dominators) -> loop_nest
+{
+    const auto count = cfg.blocks.size();
+
+    // The body of the loop at each header; every block that reaches a back edge without going through the header
+    std::map<size_t, std::vector<bool>> bodies;
+    for (size_t from = 0; from < count; ++from)
+    {
+        for (const auto header : cfg.blocks[from].successors)
+        {
+            if (!dominators.dominates(header, from))
+                continue;
+
+            auto &body = bodies[header];
+            body.resize(count, false);
+            body[header] = true;
+
+            std::vector<size_t> work{from};
+            while (!work.empty())
+            {
+                const auto b = work.back();
+                work.pop_back();
+                if (body[b] || dominators.immediate_dominators[b] == no_block)
+                    continue;
+
+                body[b] = true;
+                work.insert(std::end(work), std::begin(cfg.blocks[b].predecessors),
+                            std::end(cfg.blocks[b].predecessors));
+            }
+        }
+    }
+
+    loop_nest nest;
+    for (const auto &[header, body] : bodies)
+    {
+        natural_loop l;
+        l.header = header;
+        for (size_t b = 0; b < count; ++b)
+        {
+            if (body[b])
+                l.blocks.push_back(b);
+        }
+        nest.loops.push_back(std::move(l));
+    }
+
+    // A loop that contains another has more blocks, so sorting by size puts the outer ones first
+    std::stable_sort(std::begin(nest.loops), std::end(nest.loops),
+                     [](const auto &a, const auto &b) { return a.blocks.size() > b.blocks.size(); });
+
+    nest.depth_of.resize(count, 0);
+    for (size_t n = 0; n < nest.loops.size(); ++n)
+    {
+        auto &l = nest.loops[n];
+
+        // The innermost loop around this one is the last one before it that contains its header
+        for (auto outer = n; outer-- > 0;)
+        {
+            const auto &blocks = nest.loops[outer].blocks;
+            if (std::binary_search(std::begin(blocks), std::end(blocks), l.header))
+            {
+                l.parent = outer;
+                l.depth = nest.loops[outer].depth + 1;
+                break;
+            }
+        }
+
+        for (const auto b : l.blocks)
+            ++nest.depth_of[b];
+    }
+
+    return nest;
+}
+
+} // namespace internal
@@ -0,0 +1,90 @@
+#pragma once
+
+#include <mos6502/mos6502_instruction.h>
+#include <cstddef>
+#include <limits>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace internal
+{
+
+constexpr auto no_block = std::numeric_limits<size_t>::max();
+
+// A run of lines that is only entered at the top and only left at the bottom. Blocks start at labels and after
+// branches, jumps and returns. A jsr doesn't end a block, as the callee comes back to the next line.
+struct basic_block
+{
+    size_t begin = 0; // The first line
+    size_t end = 0;   // One past the last line
+
+    std::vector<size_t> successors;
+    std::vector<size_t> predecessors;
+
+    // The blocks that the jsr instructions in this block call
+    std::vector<size_t> callees;
+
+    // Set if the block ends in rts or rti
+    bool returns = false;
+
+    // Set if control may continue somewhere outside the code; a branch or jump to a label that isn't in it, or
+    // falling off the end
+    bool leaves = false;
+};
+
+struct control_flow_graph
+{
+    std::vector<basic_block> blocks;
+
+    // The block each line belongs to
+    std::vector<size_t> block_of;
+
+    // The block each label starts
+    std::map<std::string, size_t> labels;
+
+    // The blocks control may enter from outside; the first one, those that jsr calls and those that nothing
+    // branches, jumps or falls through to, like main, irq and nmi
+    std::vector<size_t> entries;
+};
+
+auto build_control_flow_graph(const std::vector<mos6502> &instructions) -> control_flow_graph;
+
+// The immediate dominator of each block, the closest block that every path from an entry to it goes through.
+// Entries are their own immediate dominator and blocks that can't be reached have none (no_block).
+struct dominator_tree
+{
+    std::vector<size_t> immediate_dominators;
+
+    // Returns true if every path from an entry to b goes through a; blocks dominate themselves.
+    auto dominates(size_t a, size_t b) const -> bool;
+};
+
+auto find_dominators(const control_flow_graph &cfg) -> dominator_tree;
+
+// A loop with a single header block that dominates every block in it, found from the edges back to that header.
+struct natural_loop
+{
+    size_t header = 0;
+
+    // All blocks of the loop, in order, including those of the loops nested in it
+    std::vector<size_t> blocks;
+
+    // The innermost loop this one is nested in, as an index into the loop nest, or no_block
+    size_t parent = no_block;
+
+    int depth = 1; // 1 for loops that aren't inside any other
+};
+
+struct loop_nest
+{
+    // Outer loops come before the loops nested in them
+    std::vector<natural_loop> loops;
+
+    // The number of loops each block is in
+    std::vector<int> depth_of;
+};
+
+auto find_loop_nest(const control_flow_graph &cfg, const dominator_tree &dominators) -> loop_nest;
+
+} // namespace internal
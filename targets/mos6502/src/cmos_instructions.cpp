@@ -0,0 +1,259 @@
+#include "passes.h"
+#include "liveness.h"
+#include "opcodes.h"
+#include <map>
+
+namespace internal
+{
+
+namespace
+{
+
+// stz supports zero page and absolute addressing, optionally indexed by X.
+auto supports_store_zero(const std::string &operand) -> bool
+{
+    if (operand.empty() || operand[0] == '#' || operand[0] == '(')
+        return false;
+
+    const auto comma = operand.find(',');
+    return comma == std::string::npos || operand.substr(comma) == ",x";
+}
+
+// trb and tsb only support zero page and absolute addressing.
+auto supports_test_and_modify(const std::string &operand) -> bool
+{
+    return !operand.empty() && operand[0] != '#' && operand[0] != '(' && operand.find(',') == std::string::npos;
+}
+
+// Instructions that have a (zp) form without an index on the 65C02.
+auto supports_zero_page_indirect(const mos6502_opcode o) -> bool
+{
+    switch (o)
+    {
+        case mos6502_opcode::lda:
+        case mos6502_opcode::sta:
+        case mos6502_opcode::ORA:
+        case mos6502_opcode::AND:
+        case mos6502_opcode::eor:
+        case mos6502_opcode::adc:
+        case mos6502_opcode::sbc:
+        case mos6502_opcode::cmp:
+            return true;
+        default:
+            return false;
+    }
+}
+
+// Returns the store belonging to a load of the same register, or unknown for anything else.
+auto get_store(const mos6502_opcode load) -> mos6502_opcode
+{
+    switch (load)
+    {
+        case mos6502_opcode::lda:
+            return mos6502_opcode::sta;
+        case mos6502_opcode::ldx:
+            return mos6502_opcode::stx;
+        case mos6502_opcode::ldy:
+            return mos6502_opcode::sty;
+        default:
+            return mos6502_opcode::unknown;
+    }
+}
+
+auto get_register_mask(const mos6502_opcode load) -> live_mask
+{
+    switch (load)
+    {
+        case mos6502_opcode::ldx:
+            return register_x;
+        case mos6502_opcode::ldy:
+            return register_y;
+        default:
+            return register_a;
+    }
+}
+
+} // namespace
+
+auto use_65c02_instructions(std::vector<mos6502> &instructions, const zero_page_registers &registers) -> bool
+{
+    return use_65c02_instructions(instructions, analyze_liveness(instructions, registers));
+}
+
+auto use_65c02_instructions(std::vector<mos6502> &instructions, const liveness &info) -> bool
+{
+    std::vector<bool> removed(instructions.size(), false);
+    auto changed = false;
+
+    const auto is = [&instructions](const size_t op, const mos6502_opcode o) {
+        return op < instructions.size() && instructions[op].is_instruction() && instructions[op].opcode() == o;
+    };
+
+    const auto operand = [&instructions](const size_t op) -> const std::string & {
+        return instructions[op].operand().value();
+    };
+
+    const auto is_dead_after = [&info](const size_t op, const live_mask mask) {
+        return (info.live_out[op] & mask) == 0;
+    };
+
+    const auto replace = [&instructions, &changed](const size_t op, const mos6502_opcode o,
+                                                   const std::string &location = "") {
+        const auto comment = instructions[op].comment();
+        instructions[op] = location.empty()
+                               ? mos6502(o)
+                               : mos6502(o, ca::instruction_operand(ca::operand_type::literal, location));
+        instructions[op].set_comment(comment);
+        changed = true;
+    };
+
+    const auto sign_and_zero = get_flags_mask(mos6502_flags::negative | mos6502_flags::zero);
+    const auto carry_and_overflow = get_flags_mask(mos6502_flags::carry | mos6502_flags::overflow);
+
+    for (size_t op = 0; op < instructions.size(); ++op)
+    {
+        if (!instructions[op].is_instruction())
+            continue;
+
+        const auto opcode = instructions[op].opcode();
+
+        // lda #0; sta m; sta n -> stz m; stz n
+        // The stores leave the flags of the load alone, so those must be dead as well as the register.
+        const auto store = get_store(opcode);
+        if (store != mos6502_opcode::unknown && parse_immediate(operand(op)) == 0)
+        {
+            auto last = op;
+            while (is(last + 1, store) && supports_store_zero(operand(last + 1)))
+                ++last;
+
+            if (last != op && is_dead_after(last, get_register_mask(opcode) | sign_and_zero))
+            {
+                removed[op] = true;
+                for (auto i = op + 1; i <= last; ++i)
+                    replace(i, mos6502_opcode::stz, operand(i));
+                op = last;
+                continue;
+            }
+        }
+
+        // clc; adc #1 -> inc
+        // sec; sbc #1 -> dec
+        // N and Z are set from the result in both cases. C and V are not, so they must be dead.
+        if ((opcode == mos6502_opcode::clc && is(op + 1, mos6502_opcode::adc)) ||
+            (opcode == mos6502_opcode::sec && is(op + 1, mos6502_opcode::sbc)))
+        {
+            if (parse_immediate(operand(op + 1)) == 1 && is_dead_after(op + 1, carry_and_overflow))
+            {
+                removed[op] = true;
+                replace(op + 1, opcode == mos6502_opcode::clc ? mos6502_opcode::inc : mos6502_opcode::dec);
+                ++op;
+            }
+            continue;
+        }
+
+        // txa; pha -> phx
+        // A ends up holding the pushed value and the transfer sets N and Z, so neither may be read afterwards.
+        if ((opcode == mos6502_opcode::txa || opcode == mos6502_opcode::tya) && is(op + 1, mos6502_opcode::pha))
+        {
+            if (is_dead_after(op + 1, register_a | sign_and_zero))
+            {
+                removed[op] = true;
+                replace(op + 1, opcode == mos6502_opcode::txa ? mos6502_opcode::phx : mos6502_opcode::phy);
+                ++op;
+            }
+            continue;
+        }
+
+        // pla; tax -> plx
+        // Both set N and Z from the same value.
+        if (opcode == mos6502_opcode::pla && (is(op + 1, mos6502_opcode::tax) || is(op + 1, mos6502_opcode::tay)))
+        {
+            if (is_dead_after(op + 1, register_a))
+            {
+                removed[op] = true;
+                replace(op + 1, is(op + 1, mos6502_opcode::tax) ? mos6502_opcode::plx : mos6502_opcode::ply);
+                ++op;
+            }
+            continue;
+        }
+
+        // ldy #0; lda (p),y; sta (q),y -> lda (p); sta (q)
+        if (opcode == mos6502_opcode::ldy && parse_immediate(operand(op)) == 0)
+        {
+            auto last = op;
+            while (last + 1 < instructions.size() && instructions[last + 1].is_instruction() &&
+                   supports_zero_page_indirect(instructions[last + 1].opcode()) &&
+                   operand(last + 1).size() > 3 && operand(last + 1)[0] == '(' &&
+                   operand(last + 1).substr(operand(last + 1).size() - 3) == "),y")
+            {
+                ++last;
+            }
+
+            if (last != op && is_dead_after(last, register_y) &&
+                are_flags_dead(instructions, op, mos6502_flags::negative | mos6502_flags::zero))
+            {
+                removed[op] = true;
+                for (auto i = op + 1; i <= last; ++i)
+                {
+                    const auto &indexed = operand(i);
+                    replace(i, instructions[i].opcode(), indexed.substr(0, indexed.size() - 2));
+                }
+                op = last;
+            }
+            continue;
+        }
+
+        // lda m; ora #k; sta m -> lda #k; tsb m
+        // lda m; and #k; sta m -> lda #~k; trb m
+        // The immediate may also come first. Only Z is set, from the bits that were tested instead of the result, so
+        // N and Z must be dead.
+        if (opcode == mos6502_opcode::lda && (is(op + 1, mos6502_opcode::ORA) || is(op + 1, mos6502_opcode::AND)) &&
+            is(op + 2, mos6502_opcode::sta) && supports_test_and_modify(operand(op + 2)) &&
+            is_dead_after(op + 2, register_a | sign_and_zero))
+        {
+            const auto &location = operand(op + 2);
+            auto mask = -1;
+            if (operand(op) == location)
+                mask = parse_immediate(operand(op + 1));
+            else if (operand(op + 1) == location)
+                mask = parse_immediate(operand(op));
+
+            if (mask < 0)
+                continue;
+
+            const auto set = is(op + 1, mos6502_opcode::ORA);
+            replace(op, mos6502_opcode::lda, "#" + std::to_string(set ? mask : ~mask & 0xff));
+            replace(op + 1, set ? mos6502_opcode::tsb : mos6502_opcode::trb, location);
+            removed[op + 2] = true;
+            op += 2;
+        }
+    }
+
+    return erase_marked(instructions, removed) || changed;
+}
+
+auto use_branch_always(std::vector<mos6502> &instructions) -> bool
+{
+    std::map<std::string, size_t> labels;
+    for (size_t op = 0; op < instructions.size(); ++op)
+    {
+        if (instructions[op].is_label())
+            labels[instructions[op].text()] = op;
+    }
+
+    auto changed = false;
+    for (auto &i : instructions)
+    {
+        if (!i.is_instruction() || i.opcode() != mos6502_opcode::jmp || labels.count(i.operand().value()) == 0)
+            continue;
+
+        const auto comment = i.comment();
+        i = mos6502(mos6502_opcode::bra, i.operand());
+        i.set_comment(comment);
+        changed = true;
+    }
+
+    return changed;
+}
+
+} // namespace internal
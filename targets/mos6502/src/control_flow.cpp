@@ -0,0 +1,159 @@
+#include "passes.h"
+#include "opcodes.h"
+#include <map>
+
+namespace internal
+{
+
+namespace
+{
+
+// Jump chains longer than this are left alone; it also stops us from following jumps that loop forever.
+constexpr auto max_jump_chain = 16;
+
+auto is_return(const mos6502 &i) noexcept
+{
+    return i.opcode() == mos6502_opcode::rts || i.opcode() == mos6502_opcode::rti;
+}
+
+auto is_jump(const mos6502 &i) noexcept
+{
+    return i.opcode() == mos6502_opcode::jmp || i.opcode() == mos6502_opcode::bra;
+}
+
+class control_flow
+{
+public:
+    explicit control_flow(const std::vector<mos6502> &instructions)
+        : instructions_{instructions}
+    {
+        for (size_t op = 0; op < instructions_.size(); ++op)
+        {
+            if (instructions_[op].is_label())
+                labels_[instructions_[op].text()] = op;
+        }
+    }
+
+    // Returns the index of the first line at or after the given index that isn't a label.
+    auto skip_labels(size_t op) const -> size_t
+    {
+        while (op < instructions_.size() && instructions_[op].is_label())
+            ++op;
+
+        return op;
+    }
+
+    // Returns the index of the first instruction executed when control reaches the given index, skipping labels
+    // and following unconditional jumps. Returns the size of the stream if that can't be determined; for
+    // directives, unknown lines and loops of jumps.
+    auto resolve(size_t op) const -> size_t
+    {
+        for (auto jumps = 0; jumps < max_jump_chain; ++jumps)
+        {
+            op = skip_labels(op);
+
+            if (op >= instructions_.size() || !instructions_[op].is_instruction())
+                return instructions_.size();
+
+            if (!is_jump(instructions_[op]))
+                return op;
+
+            const auto target = labels_.find(instructions_[op].operand().value());
+            if (target == std::end(labels_))
+                return op;
+
+            op = target->second;
+        }
+
+        return instructions_.size();
+    }
+
+    // Returns the index of the label a jump or branch goes to, or the size of the stream if it leaves the stream.
+    auto get_target(const mos6502 &i) const -> size_t
+    {
+        const auto target = labels_.find(i.operand().value());
+        return target == std::end(labels_) ? instructions_.size() : target->second;
+    }
+
+private:
+    const std::vector<mos6502> &instructions_;
+    std::map<std::string, size_t> labels_;
+};
+
+void replace(std::vector<mos6502> &instructions, const size_t op, mos6502 replacement)
+{
+    replacement.set_comment(instructions[op].comment());
+    instructions[op] = std::move(replacement);
+}
+
+} // namespace
+
+auto optimize_control_flow(std::vector<mos6502> &instructions) -> bool
+{
+    const control_flow flow{instructions};
+    const auto end = instructions.size();
+    auto changed = false;
+
+    for (size_t op = 0; op < instructions.size(); ++op)
+    {
+        const auto &i = instructions[op];
+        if (!i.is_instruction())
+            continue;
+
+        if (i.opcode() == mos6502_opcode::jsr)
+        {
+            // jsr f; rts -> jmp f. The callee returns straight to our caller instead.
+            const auto next = flow.resolve(op + 1);
+            if (next != end && instructions[next].opcode() == mos6502_opcode::rts)
+            {
+                replace(instructions, op, mos6502(mos6502_opcode::jmp, i.operand()));
+                changed = true;
+            }
+        }
+        else if (is_jump(i) || i.is_branch())
+        {
+            // Jumps that end up in a loop of jumps resolve to nothing; leave them alone.
+            const auto target = flow.get_target(i);
+            if (target == end || flow.resolve(target) == end)
+                continue;
+
+            const auto &destination = instructions[flow.resolve(target)];
+            const auto &next = instructions[flow.skip_labels(target)];
+
+            if (is_jump(i) && is_return(destination))
+            {
+                // jmp to a return -> the return itself
+                replace(instructions, op, mos6502(destination.opcode()));
+                changed = true;
+            }
+            else if ((is_jump(next) || next.opcode() == i.opcode()) &&
+                     !(next.operand() == i.operand()))
+            {
+                // Branches don't change the flags, so a jump or branch to a jmp or to the same branch can go
+                // straight to where that one goes. fix_long_branches takes care of branches that end up out of range.
+                replace(instructions, op, mos6502(i.opcode(), next.operand()));
+                changed = true;
+            }
+        }
+    }
+
+    // Nothing after a jump or a return is reached until the next label.
+    std::vector<bool> unreachable(instructions.size(), false);
+    for (size_t op = 0; op < instructions.size(); ++op)
+    {
+        const auto &i = instructions[op];
+        if (!i.is_instruction() || (!is_jump(i) && !is_return(i)))
+            continue;
+
+        for (++op; op < instructions.size() && !instructions[op].is_label(); ++op)
+        {
+            if (instructions[op].is_instruction())
+                unreachable[op] = true;
+        }
+        --op;
+    }
+
+    return erase_marked(instructions, unreachable) || changed;
+}
+
+} // namespace internal
@@ -0,0 +1,244 @@
+#include "passes.h"
+#include "opcodes.h"
+
+namespace internal
+{
+
+namespace
+{
+
+enum class addressing_mode
+{
+    implied, // Including the accumulator
+    immediate,
+    zero_page,
+    zero_page_indexed,
+    absolute,
+    absolute_indexed,
+    indexed_indirect, // (zp,x)
+    indirect_indexed, // (zp),y
+    indirect,         // (zp), 65C02 only
+    long_immediate,   // 16 bits wide, 65816 only
+    stack_relative    // n,s, 65816 only
+};
+
+auto get_addressing_mode(const std::string &operand) -> addressing_mode
+{
+    if (operand.empty())
+        return addressing_mode::implied;
+
+    if (operand[0] == '#')
+        return is_16bit_immediate(operand) ? addressing_mode::long_immediate : addressing_mode::immediate;
+
+    if (operand[0] == '(')
+    {
+        if (operand.find(",x)") != std::string::npos)
+            return addressing_mode::indexed_indirect;
+
+        return operand.back() == 'y' ? addressing_mode::indirect_indexed : addressing_mode::indirect;
+    }
+
+    if (is_stack_relative(operand))
+        return addressing_mode::stack_relative;
+
+    const auto comma = operand.find(',');
+    const auto address = parse_address(operand.substr(0, comma));
+    const auto zero_page = address >= 0 && address < 256;
+
+    if (comma == std::string::npos)
+        return zero_page ? addressing_mode::zero_page : addressing_mode::absolute;
+
+    return zero_page ? addressing_mode::zero_page_indexed : addressing_mode::absolute_indexed;
+}
+
+auto get_size(const addressing_mode mode) -> int
+{
+    switch (mode)
+    {
+        case addressing_mode::implied:
+            return 1;
+        case addressing_mode::absolute:
+        case addressing_mode::absolute_indexed:
+        case addressing_mode::long_immediate:
+            return 3;
+        case addressing_mode::immediate:
+        case addressing_mode::stack_relative:
+        case addressing_mode::zero_page:
+        case addressing_mode::zero_page_indexed:
+        case addressing_mode::indexed_indirect:
+        case addressing_mode::indirect_indexed:
+        case addressing_mode::indirect:
+            return 2;
+    }
+
+    return 3;
+}
+
+// Cycles of instructions that read memory. Crossing a page boundary while indexing costs one more.
+auto get_read_cycles(const addressing_mode mode) -> int
+{
+    switch (mode)
+    {
+        case addressing_mode::implied:
+        case addressing_mode::immediate:
+            return 2;
+        case addressing_mode::zero_page:
+        case addressing_mode::long_immediate:
+            return 3;
+        case addressing_mode::zero_page_indexed:
+        case addressing_mode::stack_relative:
+        case addressing_mode::absolute:
+        case addressing_mode::absolute_indexed:
+            return 4;
+        case addressing_mode::indirect_indexed:
+        case addressing_mode::indirect:
+            return 5;
+        case addressing_mode::indexed_indirect:
+            return 6;
+    }
+
+    return 6;
+}
+
+// Cycles of instructions that only write memory.
+auto get_write_cycles(const addressing_mode mode) -> int
+{
+    switch (mode)
+    {
+        case addressing_mode::absolute_indexed:
+            return 5;
+        case addressing_mode::indirect_indexed:
+            return 6;
+        default:
+            return get_read_cycles(mode);
+    }
+}
+
+// Cycles of instructions that read, modify and write back memory. The undocumented ones also support indirect
+// addressing, which takes 8 cycles.
+auto get_read_modify_write_cycles(const addressing_mode mode) -> int
+{
+    switch (mode)
+    {
+        case addressing_mode::implied:
+            return 2;
+        case addressing_mode::zero_page:
+            return 5;
+        case addressing_mode::zero_page_indexed:
+        case addressing_mode::absolute:
+            return 6;
+        case addressing_mode::absolute_indexed:
+            return 7;
+        case addressing_mode::immediate:
+        case addressing_mode::indexed_indirect:
+        case addressing_mode::indirect_indexed:
+        case addressing_mode::indirect:
+        case addressing_mode::long_immediate:
+        case addressing_mode::stack_relative:
+            return 8;
+    }
+
+    return 8;
+}
+
+} // namespace
+
+auto estimate_cost(const mos6502 &i) -> instruction_cost
+{
+    const auto mode = get_addressing_mode(i.operand().value());
+
+    switch (i.opcode())
+    {
+        case mos6502_opcode::lda:
+        case mos6502_opcode::ldx:
+        case mos6502_opcode::ldy:
+        case mos6502_opcode::cpx:
+        case mos6502_opcode::cpy:
+        case mos6502_opcode::eor:
+        case mos6502_opcode::AND:
+        case mos6502_opcode::ORA:
+        case mos6502_opcode::cmp:
+        case mos6502_opcode::adc:
+        case mos6502_opcode::sbc:
+        case mos6502_opcode::bit:
+        case mos6502_opcode::lax:
+        case mos6502_opcode::anc:
+        case mos6502_opcode::alr:
+            return {get_size(mode), get_read_cycles(mode)};
+        case mos6502_opcode::sta:
+        case mos6502_opcode::stx:
+        case mos6502_opcode::sty:
+        case mos6502_opcode::stz:
+        case mos6502_opcode::sax:
+            return {get_size(mode), get_write_cycles(mode)};
+        case mos6502_opcode::asl:
+        case mos6502_opcode::lsr:
+        case mos6502_opcode::rol:
+        case mos6502_opcode::ror:
+        case mos6502_opcode::inc:
+        case mos6502_opcode::dec:
+        case mos6502_opcode::trb:
+        case mos6502_opcode::tsb:
+        case mos6502_opcode::dcp:
+        case mos6502_opcode::isc:
+            return {get_size(mode), get_read_modify_write_cycles(mode)};
+        case mos6502_opcode::tax:
+        case mos6502_opcode::tay:
+        case mos6502_opcode::txa:
+        case mos6502_opcode::tya:
+        case mos6502_opcode::dex:
+        case mos6502_opcode::dey:
+        case mos6502_opcode::inx:
+        case mos6502_opcode::iny:
+        case mos6502_opcode::clc:
+        case mos6502_opcode::sec:
+            return {1, 2};
+        case mos6502_opcode::pha:
+        case mos6502_opcode::php:
+        case mos6502_opcode::phx:
+        case mos6502_opcode::phy:
+            return {1, 3};
+        case mos6502_opcode::pla:
+        case mos6502_opcode::plp:
+        case mos6502_opcode::plx:
+        case mos6502_opcode::ply:
+            return {1, 4};
+        case mos6502_opcode::bne:
+        case mos6502_opcode::beq:
+        case mos6502_opcode::bmi:
+        case mos6502_opcode::bcc:
+        case mos6502_opcode::bcs:
+        case mos6502_opcode::bpl:
+        case mos6502_opcode::bvc:
+        case mos6502_opcode::bvs:
+            return {2, 2}; // Not taken
+        case mos6502_opcode::bra:
+        case mos6502_opcode::jmp:
+            return {i.opcode() == mos6502_opcode::bra ? 2 : 3, 3};
+        case mos6502_opcode::jsr:
+        case mos6502_opcode::rts:
+        case mos6502_opcode::rti:
+            return {i.opcode() == mos6502_opcode::jsr ? 3 : 1, 6};
+        case mos6502_opcode::rep:
+        case mos6502_opcode::sep:
+            return {2, 3};
+        case mos6502_opcode::mvn:
+        case mos6502_opcode::mvp:
+            return {3, 7}; // For every byte moved
+        case mos6502_opcode::pea:
+            return {3, 5};
+        case mos6502_opcode::tii:
+        case mos6502_opcode::tdd:
+            return {7, 17}; // And 6 for every byte moved
+        case mos6502_opcode::st0:
+        case mos6502_opcode::st1:
+        case mos6502_opcode::st2:
+            return {2, 4};
+        case mos6502_opcode::unknown:
+            return {0, 0};
+    }
+
+    return {0, 0};
+}
+
+} // namespace internal
@@ -0,0 +1,25 @@
+#include "passes.h"
+#include "liveness.h"
+
+namespace internal
+{
+
+auto eliminate_dead_code(std::vector<mos6502> &instructions, const zero_page_registers &registers) -> bool
+{
+    return eliminate_dead_code(instructions, analyze_liveness(instructions, registers));
+}
+
+auto eliminate_dead_code(std::vector<mos6502> &instructions, const liveness &info) -> bool
+{
+    std::vector<bool> dead(instructions.size(), false);
+    for (size_t op = 0; op < instructions.size(); ++op)
+    {
+        const auto &e = info.effects[op];
+        if (instructions[op].is_instruction() && e.removable && e.def != 0 && (e.def & info.live_out[op]) == 0)
+            dead[op] = true;
+    }
+
+    return erase_marked(instructions, dead);
+}
+
+} // namespace internal
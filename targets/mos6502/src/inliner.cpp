@@ -0,0 +1,198 @@
+#include "passes.h"
+#include "opcodes.h"
+#include <algorithm>
+#include <cctype>
+#include <map>
+#include <optional>
+
+namespace internal
+{
+
+namespace
+{
+
+// Leaf functions up to this estimated size in bytes are copied into every caller. A jsr takes 3 bytes and the
+// round trip through jsr and rts 12 cycles, so this trades a little size for speed.
+constexpr auto max_inlined_size = 12;
+
+// Returns the estimated size of an instruction in bytes, assuming numeric addresses below 256 are in the zero page.
+auto estimate_size(const mos6502 &i) -> int
+{
+    const auto &operand = i.operand().value();
+
+    if (operand.empty())
+        return 1;
+
+    if (operand[0] == '#')
+        return 2;
+
+    const auto address = parse_address(operand);
+    return (address >= 0 && address < 256) ? 2 : 3;
+}
+
+// Lines can only be moved, so duplicate instructions through their constructor.
+auto copy_instruction(const mos6502 &i) -> mos6502
+{
+    mos6502 result{i.opcode(), i.operand()};
+    result.set_comment(i.comment());
+    return result;
+}
+
+// Returns true if the operand mentions the given label, like "f", "#<f" or "f+1,x".
+auto refers_to(const std::string &operand, const std::string &label) -> bool
+{
+    for (auto pos = operand.find(label); pos != std::string::npos; pos = operand.find(label, pos + 1))
+    {
+        const auto end = pos + label.size();
+        if ((pos == 0 || !std::isalnum(operand[pos - 1])) && (end == operand.size() || !std::isalnum(operand[end])))
+            return true;
+    }
+
+    return false;
+}
+
+// Returns the index of the rts that ends the function starting at the given label, if the function is a single
+// basic block that doesn't call anything or touch the stack, which includes reading its arguments from there. Those
+// can run in place of the jsr as they are.
+auto get_leaf_function_end(const std::vector<mos6502> &instructions, const size_t label) -> std::optional<size_t>
+{
+    for (auto op = label + 1; op < instructions.size(); ++op)
+    {
+        const auto &i = instructions[op];
+        if (!i.is_instruction())
+            return std::nullopt;
+
+        switch (i.opcode())
+        {
+            case mos6502_opcode::rts:
+                return op;
+            case mos6502_opcode::pha:
+            case mos6502_opcode::pea:
+            case mos6502_opcode::pla:
+            case mos6502_opcode::phx:
+            case mos6502_opcode::phy:
+            case mos6502_opcode::plx:
+            case mos6502_opcode::ply:
+            case mos6502_opcode::php:
+            case mos6502_opcode::plp:
+            case mos6502_opcode::jmp:
+            case mos6502_opcode::jsr:
+            case mos6502_opcode::rti:
+            case mos6502_opcode::unknown:
+                return std::nullopt;
+            default:
+                if (i.is_branch() || is_stack_relative(i.operand().value()))
+                    return std::nullopt;
+                break;
+        }
+    }
+
+    return std::nullopt;
+}
+
+// Returns true if nothing but the given calls can reach the function at the given label; it isn't an entry point,
+// no code falls through into it and nothing else refers to it.
+auto is_only_called(const std::vector<mos6502> &instructions, const size_t label, const std::vector<size_t> &calls)
+    -> bool
+{
+    const auto &name = instructions[label].text();
+    if (name == "main" || name == "nmi" || name == "irq")
+        return false;
+
+    auto previous = label;
+    while (previous > 0 && instructions[previous - 1].is_directive())
+        --previous;
+
+    if (previous > 0)
+    {
+        const auto &p = instructions[previous - 1];
+        if (!p.is_instruction() || (p.opcode() != mos6502_opcode::jmp && p.opcode() != mos6502_opcode::rts &&
+                                    p.opcode() != mos6502_opcode::rti))
+        {
+            return false;
+        }
+    }
+
+    for (size_t op = 0; op < instructions.size(); ++op)
+    {
+        if (instructions[op].is_instruction() && refers_to(instructions[op].operand().value(), name) &&
+            std::find(std::begin(calls), std::end(calls), op) == std::end(calls))
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+} // namespace
+
+auto inline_leaf_functions(std::vector<mos6502> &instructions) -> bool
+{
+    std::map<std::string, size_t> labels;
+    for (size_t op = 0; op < instructions.size(); ++op)
+    {
+        if (instructions[op].is_label())
+            labels[instructions[op].text()] = op;
+    }
+
+    // Calls to each label; a jmp is a call that was turned into a tail call
+    std::map<size_t, std::vector<size_t>> calls;
+    for (size_t op = 0; op < instructions.size(); ++op)
+    {
+        const auto &i = instructions[op];
+        if (i.is_instruction() && (i.opcode() == mos6502_opcode::jsr || i.opcode() == mos6502_opcode::jmp))
+        {
+            const auto label = labels.find(i.operand().value());
+            if (label != std::end(labels))
+                calls[label->second].push_back(op);
+        }
+    }
+
+    for (const auto &[label, sites] : calls)
+    {
+        const auto end = get_leaf_function_end(instructions, label);
+        if (!end)
+            continue;
+
+        auto size = 0;
+        for (auto op = label + 1; op < *end; ++op)
+            size += estimate_size(instructions[op]);
+
+        // A function with a single caller just moves when it can be removed afterwards.
+        const auto remove = is_only_called(instructions, label, sites);
+        if (size > max_inlined_size && !(remove && sites.size() == 1))
+            continue;
+
+        std::vector<mos6502> result;
+        result.reserve(instructions.size() + sites.size() * (*end - label));
+
+        for (size_t op = 0; op < instructions.size(); ++op)
+        {
+            if (remove && op >= label && op <= *end)
+                continue;
+
+            if (std::find(std::begin(sites), std::end(sites), op) == std::end(sites))
+            {
+                // The body is still needed for the calls that come after it
+                if (op > label && op <= *end)
+                    result.push_back(copy_instruction(instructions[op]));
+                else
+                    result.push_back(std::move(instructions[op]));
+                continue;
+            }
+
+            // A tail call keeps the return; the jsr returns to the instruction after it
+            const auto last = instructions[op].opcode() == mos6502_opcode::jmp ? *end : *end - 1;
+            for (auto body = label + 1; body <= last; ++body)
+                result.push_back(copy_instruction(instructions[body]));
+        }
+
+        instructions = std::move(result);
+        return true;
+    }
+
+    return false;
+}
+
+} // namespace internal
@@ -0,0 +1,297 @@
+#include "passes.h"
+#include "opcodes.h"
+#include <algorithm>
+#include <map>
+#include <optional>
+
+namespace internal
+{
+
+namespace
+{
+
+constexpr auto page_size = 256;
+
+// How often a loop is assumed to run for each time the code around it runs, in the absence of profile data
+constexpr auto assumed_iterations = 10;
+
+// Deeper nesting than this doesn't make a loop any more important
+constexpr auto max_loop_depth = 4;
+
+const auto page_alignment = ".align " + std::to_string(page_size);
+
+auto get_directive_name(const std::string &text) -> std::string
+{
+    return text.substr(0, text.find_first_of(" \t"));
+}
+
+auto get_directive_arguments(const std::string &text) -> std::string
+{
+    const auto begin = text.find_first_not_of(" \t", get_directive_name(text).size());
+    return begin == std::string::npos ? "" : text.substr(begin);
+}
+
+auto count_values(const std::string &arguments) -> int
+{
+    return arguments.empty() ? 0 : static_cast<int>(std::count(arguments.begin(), arguments.end(), ',')) + 1;
+}
+
+auto parse_count(const std::string &arguments) -> int
+{
+    try
+    {
+        return std::stoi(arguments, nullptr, 0);
+    }
+    catch (const std::exception &)
+    {
+        return 0;
+    }
+}
+
+// The bytes taken by the characters between the quotes, counting each escape sequence as one
+auto get_string_length(const std::string &arguments) -> int
+{
+    auto length = 0;
+    for (size_t i = arguments.find('"') + 1; i < arguments.size() && arguments[i] != '"'; ++i)
+    {
+        if (arguments[i] == '\\')
+            ++i;
+        ++length;
+    }
+    return length;
+}
+
+// The bytes a data directive emits, or the alignment it asks for. Directives that emit nothing, or that aren't
+// known, take no space. Without an address, alignment takes the most padding it could need.
+auto get_directive_size(const std::string &text, const std::optional<int> address) -> int
+{
+    const auto name = get_directive_name(text);
+    const auto arguments = get_directive_arguments(text);
+
+    auto alignment = 0;
+    if (name == ".align")
+        alignment = parse_count(arguments);
+    else if (name == ".p2align")
+        alignment = 1 << parse_count(arguments);
+
+    if (alignment > 0)
+        return address ? (alignment - *address % alignment) % alignment : alignment - 1;
+
+    if (name == ".byte")
+        return count_values(arguments);
+    if (name == ".short" || name == ".word" || name == ".2byte")
+        return count_values(arguments) * 2;
+    if (name == ".long" || name == ".int" || name == ".4byte")
+        return count_values(arguments) * 4;
+    if (name == ".zero" || name == ".space" || name == ".skip")
+        return parse_count(arguments);
+    if (name == ".ascii" || name == ".asciz" || name == ".string")
+        return get_string_length(arguments) + (name == ".ascii" ? 0 : 1);
+
+    return 0;
+}
+
+auto get_page(const int address) -> int
+{
+    return address / page_size;
+}
+
+auto falls_through(const mos6502 &i) -> bool
+{
+    switch (i.opcode())
+    {
+        case mos6502_opcode::jmp:
+        case mos6502_opcode::bra:
+        case mos6502_opcode::rts:
+        case mos6502_opcode::rti:
+            return false;
+        default:
+            return true;
+    }
+}
+
+auto is_page_alignment(const mos6502 &i) -> bool
+{
+    return i.is_directive() && i.text() == page_alignment;
+}
+
+auto get_weight(const int depth) -> int
+{
+    auto weight = 1;
+    for (auto i = 0; i < std::min(depth, max_loop_depth); ++i)
+        weight *= assumed_iterations;
+    return weight;
+}
+
+auto get_depth(const std::vector<loop> &loops, const size_t op) -> int
+{
+    auto depth = 0;
+    for (const auto &l : loops)
+    {
+        if (l.head <= op && op <= l.end)
+            depth = std::max(depth, l.depth);
+    }
+    return depth;
+}
+
+auto get_labels(const std::vector<mos6502> &instructions) -> std::map<std::string, size_t>
+{
+    std::map<std::string, size_t> labels;
+    for (size_t op = 0; op < instructions.size(); ++op)
+    {
+        if (instructions[op].is_label())
+            labels[instructions[op].text()] = op;
+    }
+    return labels;
+}
+
+// Tries to keep the lines from first up to, but not including, last within a page by inserting a page alignment
+// in front of them. The padding goes after the nearest earlier instruction that doesn't fall through, as long as
+// that still leaves everything in one page; otherwise a jump over it is needed. Alignment only happens when the
+// cycles it saves are worth at least as many as the bytes it costs, counting a cycle saved each time the
+// surrounding code runs as one byte.
+auto align_range(std::vector<mos6502> &instructions, const std::vector<int> &addresses, const size_t first,
+                 const size_t last, const int saved_cycles, const int entries) -> bool
+{
+    const auto size = addresses[last] - addresses[first];
+    if (size > page_size || get_page(addresses[first]) == get_page(addresses[last] - 1))
+        return false;
+
+    for (auto op = first; op > 0 && addresses[last] - addresses[op] <= page_size; --op)
+    {
+        const auto &previous = instructions[op - 1];
+        if (is_page_alignment(previous))
+            break;
+
+        if (previous.is_instruction() && !falls_through(previous))
+        {
+            const auto padding = (page_size - addresses[op] % page_size) % page_size;
+            if (padding > saved_cycles)
+                return false;
+
+            instructions.emplace(instructions.begin() + static_cast<std::ptrdiff_t>(op),
+                                 ca::asm_line::line_type::directive, page_alignment);
+            return true;
+        }
+    }
+
+    const auto jump_size = 3;
+    const auto jump_cycles = 3;
+    const auto padding = (page_size - (addresses[first] + jump_size) % page_size) % page_size;
+    if (!instructions[first].is_label() || padding + jump_size + jump_cycles * entries > saved_cycles)
+        return false;
+
+    const auto label = instructions[first].text();
+    instructions.emplace(instructions.begin() + static_cast<std::ptrdiff_t>(first),
+                         ca::asm_line::line_type::directive, page_alignment);
+    instructions.emplace(instructions.begin() + static_cast<std::ptrdiff_t>(first), mos6502_opcode::jmp,
+                         ca::instruction_operand(ca::operand_type::literal, label));
+    return true;
+}
+
+// Returns the label that an operand like "table,x" indexes from, or an empty string.
+auto get_indexed_label(const std::string &operand) -> std::string
+{
+    const auto comma = operand.find(',');
+    if (comma == std::string::npos || operand[0] == '(' || operand[0] == '#')
+        return "";
+
+    return operand.substr(0, comma);
+}
+
+} // namespace
+
+auto get_addresses(const std::vector<mos6502> &instructions, const std::optional<int> origin) -> std::vector<int>
+{
+    std::vector<int> addresses;
+    addresses.reserve(instructions.size() + 1);
+
+    auto address = origin.value_or(0);
+    for (const auto &i : instructions)
+    {
+        addresses.push_back(address);
+        if (i.is_instruction())
+            address += estimate_cost(i).bytes;
+        else if (i.is_directive())
+            address += get_directive_size(i.text(), origin ? std::optional<int>{address} : std::nullopt);
+    }
+
+    addresses.push_back(address);
+    return addresses;
+}
+
+auto align_to_pages(std::vector<mos6502> &instructions, const int origin) -> bool
+{
+    auto changed = false;
+
+    // Innermost loops first, as they run most often. The lines move with each alignment, so everything is found
+    // again afterwards; the loops that are done no longer straddle a page.
+    for (auto depth = max_loop_depth; depth > 0; --depth)
+    {
+        for (auto aligned = true; aligned;)
+        {
+            aligned = false;
+            const auto addresses = get_addresses(instructions, origin);
+            const auto labels = get_labels(instructions);
+            const auto loops = find_loops(instructions);
+
+            for (const auto &l : loops)
+            {
+                if (std::min(l.depth, max_loop_depth) != depth)
+                    continue;
+
+                // Taken branches to a page other than that of the next instruction take a cycle more. Only the ones
+                // that stay within the loop are fixed by keeping it in one page.
+                auto crossings = 0;
+                for (auto op = l.head; op <= l.end; ++op)
+                {
+                    const auto &i = instructions[op];
+                    const auto target = labels.find(i.operand().value());
+                    if (i.is_instruction() && i.is_branch() && target != std::end(labels) &&
+                        target->second >= l.head && target->second <= l.end &&
+                        get_page(addresses[target->second]) != get_page(addresses[op + 1]))
+                    {
+                        ++crossings;
+                    }
+                }
+
+                if (crossings > 0 && align_range(instructions, addresses, l.head, l.end + 1,
+                                                 crossings * get_weight(l.depth), get_weight(l.depth - 1)))
+                {
+                    aligned = changed = true;
+                    break;
+                }
+            }
+        }
+    }
+
+    // Tables indexed by X or Y take a cycle more for every access that crosses into the next page
+    const auto labels = get_labels(instructions);
+    std::map<std::string, int> accesses;
+    const auto loops = find_loops(instructions);
+    for (size_t op = 0; op < instructions.size(); ++op)
+    {
+        const auto &i = instructions[op];
+        const auto label = i.is_instruction() ? get_indexed_label(i.operand().value()) : "";
+        if (!label.empty() && labels.count(label) != 0)
+            accesses[label] += get_weight(get_depth(loops, op));
+    }
+
+    for (const auto &[label, weight] : accesses)
+    {
+        const auto addresses = get_addresses(instructions, origin);
+        const auto first = get_labels(instructions).at(label);
+        auto last = first + 1;
+        while (last < instructions.size() && instructions[last].is_directive() &&
+               !is_page_alignment(instructions[last]))
+        {
+            ++last;
+        }
+
+        changed = align_range(instructions, addresses, first, last, weight, 0) || changed;
+    }
+
+    return changed;
+}
+
+} // namespace internal
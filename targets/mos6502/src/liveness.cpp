@@ -0,0 +1,378 @@
+#include "liveness.h"
+#include "opcodes.h"
+#include <algorithm>
+#include <cctype>
+#include <stdexcept>
+
+namespace internal
+{
+
+class liveness_model
+{
+public:
+    explicit liveness_model(const zero_page_registers &registers)
+        : locations_{registers.locations}
+    {
+        if (locations_.size() > max_zero_page_registers)
+            throw std::runtime_error("Too many zero page registers for liveness analysis");
+
+        for (const auto location : registers.live_on_return)
+            live_on_return_ |= get_location_mask(location);
+    }
+
+    auto live_on_return() const noexcept
+    {
+        return live_on_return_;
+    }
+
+    auto all_locations() const noexcept -> live_mask
+    {
+        return (1u << locations_.size()) - 1;
+    }
+
+    auto get_effects(const mos6502 &i) const -> instruction_effects
+    {
+        instruction_effects e;
+        e.use = get_flags_mask(i.flags_read());
+        e.def = get_flags_mask(i.flags_written());
+
+        const auto &operand = i.operand();
+        const auto &text = operand.value();
+        const auto immediate = !text.empty() && text[0] == '#';
+        const auto location = get_location_mask(parse_address(text));
+        // Numeric addresses may be hardware registers where a read has side effects; symbols name program data.
+        const auto symbol = !text.empty() && (std::isalpha(text[0]) || text[0] == '_') &&
+                            text.find(',') == std::string::npos;
+        const auto plain = immediate || location != 0 || symbol;
+
+        // Indexed and indirect addressing may read any zero page register, but a store only reads the registers
+        // that form its address.
+        live_mask address_use = 0;
+        if (!immediate && !text.empty() && text[0] == '(')
+        {
+            const auto pointer = parse_address(text.substr(1, text.find_first_of(",)") - 1));
+            address_use |=
+                (pointer < 0) ? all_locations() : get_location_mask(pointer) | get_location_mask(pointer + 1);
+
+            if (text.find(",x") != std::string::npos)
+                address_use |= register_x;
+            else if (text.back() == 'y')
+                address_use |= register_y;
+        }
+        else if (!immediate && text.find(',') != std::string::npos)
+        {
+            // Stack relative addressing on the 65816 doesn't use an index register
+            if (text.back() == 'x')
+                address_use |= register_x;
+            else if (text.back() == 'y')
+                address_use |= register_y;
+        }
+
+        auto operand_use = location | address_use;
+        if (address_use != 0)
+            operand_use |= all_locations();
+
+        switch (i.opcode())
+        {
+            case mos6502_opcode::lda:
+                e.use |= operand_use;
+                e.def |= register_a;
+                e.removable = plain;
+                break;
+            case mos6502_opcode::ldx:
+                e.use |= operand_use;
+                e.def |= register_x;
+                e.removable = plain;
+                break;
+            case mos6502_opcode::ldy:
+                e.use |= operand_use;
+                e.def |= register_y;
+                e.removable = plain;
+                break;
+            case mos6502_opcode::lax:
+                e.use |= operand_use;
+                e.def |= register_a | register_x;
+                e.removable = plain;
+                break;
+            case mos6502_opcode::sta:
+                e.use |= address_use | register_a;
+                e.def |= location;
+                e.removable = location != 0;
+                break;
+            case mos6502_opcode::stx:
+                e.use |= address_use | register_x;
+                e.def |= location;
+                e.removable = location != 0;
+                break;
+            case mos6502_opcode::sty:
+                e.use |= address_use | register_y;
+                e.def |= location;
+                e.removable = location != 0;
+                break;
+            case mos6502_opcode::stz:
+                e.use |= address_use;
+                e.def |= location;
+                e.removable = location != 0;
+                break;
+            case mos6502_opcode::sax:
+                e.use |= address_use | register_a | register_x;
+                e.def |= location;
+                e.removable = location != 0;
+                break;
+            case mos6502_opcode::tax:
+                e.use |= register_a;
+                e.def |= register_x;
+                e.removable = true;
+                break;
+            case mos6502_opcode::tay:
+                e.use |= register_a;
+                e.def |= register_y;
+                e.removable = true;
+                break;
+            case mos6502_opcode::txa:
+                e.use |= register_x;
+                e.def |= register_a;
+                e.removable = true;
+                break;
+            case mos6502_opcode::tya:
+                e.use |= register_y;
+                e.def |= register_a;
+                e.removable = true;
+                break;
+            case mos6502_opcode::eor:
+            case mos6502_opcode::AND:
+            case mos6502_opcode::ORA:
+            case mos6502_opcode::adc:
+            case mos6502_opcode::sbc:
+            case mos6502_opcode::anc:
+            case mos6502_opcode::alr:
+                e.use |= operand_use | register_a;
+                e.def |= register_a;
+                e.removable = plain;
+                break;
+            case mos6502_opcode::cmp:
+            case mos6502_opcode::bit:
+                e.use |= operand_use | register_a;
+                e.removable = plain;
+                break;
+            case mos6502_opcode::cpx:
+                e.use |= operand_use | register_x;
+                e.removable = plain;
+                break;
+            case mos6502_opcode::cpy:
+                e.use |= operand_use | register_y;
+                e.removable = plain;
+                break;
+            case mos6502_opcode::asl:
+            case mos6502_opcode::lsr:
+            case mos6502_opcode::rol:
+            case mos6502_opcode::ror:
+            case mos6502_opcode::inc:
+            case mos6502_opcode::dec:
+                if (operand.is_empty())
+                {
+                    e.use |= register_a;
+                    e.def |= register_a;
+                    e.removable = true;
+                }
+                else
+                {
+                    // Read-modify-write of memory; the memory location stays live.
+                    e.use |= operand_use;
+                    e.def |= location;
+                    e.removable = location != 0;
+                }
+                break;
+            case mos6502_opcode::trb:
+            case mos6502_opcode::tsb:
+                e.use |= operand_use | register_a;
+                e.def |= location;
+                e.removable = location != 0;
+                break;
+            case mos6502_opcode::dcp:
+                e.use |= operand_use | register_a;
+                e.def |= location;
+                e.removable = location != 0;
+                break;
+            case mos6502_opcode::isc:
+                e.use |= operand_use | register_a;
+                e.def |= location | register_a;
+                e.removable = location != 0;
+                break;
+            case mos6502_opcode::dex:
+            case mos6502_opcode::inx:
+                e.use |= register_x;
+                e.def |= register_x;
+                e.removable = true;
+                break;
+            case mos6502_opcode::dey:
+            case mos6502_opcode::iny:
+                e.use |= register_y;
+                e.def |= register_y;
+                e.removable = true;
+                break;
+            case mos6502_opcode::clc:
+            case mos6502_opcode::sec:
+                e.removable = true;
+                break;
+            case mos6502_opcode::pha:
+                e.use |= register_a;
+                break;
+            case mos6502_opcode::pla:
+                e.def |= register_a;
+                break;
+            case mos6502_opcode::phx:
+                e.use |= register_x;
+                break;
+            case mos6502_opcode::phy:
+                e.use |= register_y;
+                break;
+            case mos6502_opcode::plx:
+                e.def |= register_x;
+                break;
+            case mos6502_opcode::ply:
+                e.def |= register_y;
+                break;
+            case mos6502_opcode::jsr:
+                // The callee may read any register
+                e.use |= all_locations() | register_a | register_x | register_y;
+                break;
+            case mos6502_opcode::rep:
+            case mos6502_opcode::sep:
+                // Everything is read at a different width on one side than on the other
+                e.use |= all_locations() | register_a | register_x | register_y;
+                break;
+            case mos6502_opcode::mvn:
+            case mos6502_opcode::mvp:
+                // The count in A and the addresses in X and Y all end up changed
+                e.use |= register_a | register_x | register_y;
+                e.def |= register_a | register_x | register_y;
+                break;
+            case mos6502_opcode::pea:
+            case mos6502_opcode::tii:
+            case mos6502_opcode::tdd:
+            case mos6502_opcode::st0:
+            case mos6502_opcode::st1:
+            case mos6502_opcode::st2:
+            case mos6502_opcode::php:
+            case mos6502_opcode::plp:
+            case mos6502_opcode::bne:
+            case mos6502_opcode::beq:
+            case mos6502_opcode::bmi:
+            case mos6502_opcode::bcc:
+            case mos6502_opcode::bcs:
+            case mos6502_opcode::bpl:
+            case mos6502_opcode::bvc:
+            case mos6502_opcode::bvs:
+            case mos6502_opcode::bra:
+            case mos6502_opcode::jmp:
+            case mos6502_opcode::rts:
+            case mos6502_opcode::rti:
+            case mos6502_opcode::unknown:
+                break;
+        }
+
+        return e;
+    }
+
+private:
+    auto get_location_mask(const int address) const -> live_mask
+    {
+        if (address < 0)
+            return 0;
+
+        const auto result = std::find(std::begin(locations_), std::end(locations_), address);
+        if (result == std::end(locations_))
+            return 0;
+
+        return 1u << std::distance(std::begin(locations_), result);
+    }
+
+    std::vector<int> locations_;
+    live_mask live_on_return_ = 0;
+};
+
+auto analyze_liveness(const std::vector<mos6502> &instructions, const zero_page_registers &registers) -> liveness
+{
+    return analyze_liveness(instructions, build_control_flow_graph(instructions), registers);
+}
+
+auto analyze_liveness(const std::vector<mos6502> &instructions, const control_flow_graph &cfg,
+                      const zero_page_registers &registers) -> liveness
+{
+    const liveness_model model{registers};
+
+    liveness result;
+    auto &effects = result.effects;
+    effects.resize(instructions.size());
+
+    for (size_t op = 0; op < instructions.size(); ++op)
+    {
+        const auto &i = instructions[op];
+        if (i.is_instruction())
+            effects[op] = model.get_effects(i);
+        else if (i.is_missing_opcode())
+            effects[op].use = all_live;
+    }
+
+    // What each block reads before writing it and what it writes, so that the blocks can be solved as a whole.
+    // Control flow leaving to somewhere we don't know about makes everything live.
+    std::vector<live_mask> block_use(cfg.blocks.size(), 0);
+    std::vector<live_mask> block_def(cfg.blocks.size(), 0);
+    std::vector<live_mask> live_on_exit(cfg.blocks.size(), 0);
+    for (size_t b = 0; b < cfg.blocks.size(); ++b)
+    {
+        const auto &block = cfg.blocks[b];
+        for (auto op = block.end; op-- > block.begin;)
+        {
+            block_use[b] = effects[op].use | (block_use[b] & ~effects[op].def);
+            block_def[b] |= effects[op].def;
+        }
+
+        if (block.returns)
+            live_on_exit[b] |= model.live_on_return();
+        if (block.leaves)
+            live_on_exit[b] |= all_live;
+    }
+
+    std::vector<live_mask> block_in(cfg.blocks.size(), 0);
+    std::vector<live_mask> block_out(cfg.blocks.size(), 0);
+
+    auto changed = true;
+    while (changed)
+    {
+        changed = false;
+
+        for (auto b = cfg.blocks.size(); b-- > 0;)
+        {
+            auto out = live_on_exit[b];
+            for (const auto s : cfg.blocks[b].successors)
+                out |= block_in[s];
+
+            const auto in = block_use[b] | (out & ~block_def[b]);
+
+            if (in != block_in[b] || out != block_out[b])
+            {
+                block_in[b] = in;
+                block_out[b] = out;
+                changed = true;
+            }
+        }
+    }
+
+    auto &live_out = result.live_out;
+    live_out.resize(instructions.size(), 0);
+    for (size_t b = 0; b < cfg.blocks.size(); ++b)
+    {
+        auto live = block_out[b];
+        for (auto op = cfg.blocks[b].end; op-- > cfg.blocks[b].begin;)
+        {
+            live_out[op] = live;
+            live = effects[op].use | (live & ~effects[op].def);
+        }
+    }
+
+    return result;
+}
+
+} // namespace internal
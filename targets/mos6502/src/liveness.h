@@ -0,0 +1,50 @@
+#pragma once
+
+#include "cfg.h"
+#include "passes.h"
+#include <cstdint>
+#include <vector>
+
+namespace internal
+{
+
+// Liveness is tracked as a bit mask. The low bits are the zero page registers, followed by the
+// A, X and Y registers and the processor status flags.
+using live_mask = std::uint32_t;
+
+constexpr auto max_zero_page_registers = 24;
+constexpr live_mask register_a = 1u << 24;
+constexpr live_mask register_x = 1u << 25;
+constexpr live_mask register_y = 1u << 26;
+constexpr auto flags_shift = 27;
+constexpr live_mask all_live = 0xffffffff;
+
+inline auto get_flags_mask(const std::uint8_t flags) -> live_mask
+{
+    return static_cast<live_mask>(flags) << flags_shift;
+}
+
+struct instruction_effects
+{
+    live_mask use = 0;
+    live_mask def = 0;
+
+    // Set if the instruction has no effect other than writing the locations in def.
+    bool removable = false;
+};
+
+struct liveness
+{
+    std::vector<instruction_effects> effects;
+
+    // Everything that may still be read after each instruction
+    std::vector<live_mask> live_out;
+};
+
+// Computes which zero page registers, CPU registers and flags are live after every instruction. The blocks of the
+// control flow graph are solved as a whole before the liveness is spread over their lines.
+auto analyze_liveness(const std::vector<mos6502> &instructions, const zero_page_registers &registers) -> liveness;
+auto analyze_liveness(const std::vector<mos6502> &instructions, const control_flow_graph &cfg,
+                      const zero_page_registers &registers) -> liveness;
+
+} // namespace internal
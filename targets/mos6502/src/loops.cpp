@@ -0,0 +1,336 @@
+#include "passes.h"
+#include "liveness.h"
+#include "opcodes.h"
+#include <algorithm>
+#include <map>
+#include <optional>
+
+namespace internal
+{
+
+namespace
+{
+
+// The instructions that do the same with X or Y as lda, sta, inc, dec and cmp do with a counter in memory
+struct index_register
+{
+    live_mask mask;
+    mos6502_opcode load;
+    mos6502_opcode store;
+    mos6502_opcode to_a;
+    mos6502_opcode from_a;
+    mos6502_opcode increment;
+    mos6502_opcode decrement;
+    mos6502_opcode compare;
+};
+
+constexpr index_register index_x{register_x,         mos6502_opcode::ldx, mos6502_opcode::stx,
+                                 mos6502_opcode::txa, mos6502_opcode::tax, mos6502_opcode::inx,
+                                 mos6502_opcode::dex, mos6502_opcode::cpx};
+
+constexpr index_register index_y{register_y,         mos6502_opcode::ldy, mos6502_opcode::sty,
+                                 mos6502_opcode::tya, mos6502_opcode::tay, mos6502_opcode::iny,
+                                 mos6502_opcode::dey, mos6502_opcode::cpy};
+
+constexpr live_mask all_locations = (1u << max_zero_page_registers) - 1;
+
+// cpx and cpy only have immediate, zero page and absolute addressing.
+auto supports_index_compare(const std::string &operand) -> bool
+{
+    return !operand.empty() && operand[0] != '(' && operand.find(',') == std::string::npos;
+}
+
+// Everything that may be read before the instruction at the given index runs
+auto get_live_in(const liveness &info, const size_t op) -> live_mask
+{
+    return (info.live_out[op] & ~info.effects[op].def) | info.effects[op].use;
+}
+
+class counter_rewriter
+{
+public:
+    counter_rewriter(std::vector<mos6502> &instructions, const liveness &info, const loop &l)
+        : instructions_{instructions}
+        , info_{info}
+        , loop_{l}
+    {
+    }
+
+    // Moves the counter at the given location into the index register, if every access to it in the loop can be
+    // done with the index register instead.
+    auto rewrite(const std::string &counter, const live_mask counter_mask, const index_register &reg) -> bool
+    {
+        const auto sign_and_zero = get_flags_mask(mos6502_flags::negative | mos6502_flags::zero);
+
+        // The register must be free throughout the loop, and the flags the load in front of it sets must be dead
+        if ((info_.live_out[loop_.head] & (reg.mask | sign_and_zero)) != 0)
+            return false;
+
+        std::map<size_t, std::optional<mos6502>> replacements;
+        std::vector<size_t> accesses;
+        for (auto op = loop_.head + 1; op < loop_.end; ++op)
+        {
+            const auto &e = info_.effects[op];
+            if (((e.use | e.def) & reg.mask) != 0)
+                return false;
+
+            if (((e.use | e.def) & counter_mask) == 0)
+                continue;
+
+            const auto &i = instructions_[op];
+            if (i.operand().value() != counter)
+                return false;
+
+            accesses.push_back(op);
+        }
+
+        const auto initial_value = get_initial_value(counter);
+        const auto exit_live = loop_.end + 1 < instructions_.size() ? get_live_in(info_, loop_.end + 1) : 0;
+        const auto counts_down = counts_up_to_constant(accesses, counter_mask, exit_live) && initial_value >= 0;
+
+        for (const auto op : accesses)
+        {
+            const auto &i = instructions_[op];
+            switch (i.opcode())
+            {
+                case mos6502_opcode::inc:
+                    replacements[op] = counts_down ? std::nullopt : std::optional{mos6502(reg.increment)};
+                    break;
+                case mos6502_opcode::dec:
+                    replacements[op] = mos6502(reg.decrement);
+                    break;
+                case mos6502_opcode::sta:
+                    if ((info_.live_out[op] & sign_and_zero) != 0)
+                        return false;
+                    replacements[op] = mos6502(reg.from_a);
+                    break;
+                case mos6502_opcode::lda:
+                {
+                    // lda m; cmp n -> cpx n, as long as A isn't read afterwards
+                    const auto &next = instructions_[op + 1];
+                    if (counts_down)
+                    {
+                        replacements[op] = std::nullopt;
+                        replacements[op + 1] = mos6502(reg.decrement);
+                    }
+                    else if (next.is_instruction() && next.opcode() == mos6502_opcode::cmp &&
+                             supports_index_compare(next.operand().value()) &&
+                             (info_.live_out[op + 1] & register_a) == 0)
+                    {
+                        replacements[op] = std::nullopt;
+                        replacements[op + 1] = mos6502(reg.compare, next.operand());
+                    }
+                    else
+                    {
+                        replacements[op] = mos6502(reg.to_a);
+                    }
+                    break;
+                }
+                default:
+                    return false;
+            }
+        }
+
+        // Apply the changes, starting at the end so that the indices stay valid
+        if (!counts_down && (exit_live & counter_mask) != 0)
+        {
+            instructions_.emplace(instructions_.begin() + static_cast<std::ptrdiff_t>(loop_.end + 1), reg.store,
+                                  ca::instruction_operand(ca::operand_type::literal, counter));
+            instructions_[loop_.end + 1].set_comment(instructions_[loop_.end].comment());
+        }
+
+        std::vector<bool> removed(instructions_.size(), false);
+        for (auto &[op, replacement] : replacements)
+        {
+            if (replacement)
+            {
+                replacement->set_comment(instructions_[op].comment());
+                instructions_[op] = std::move(*replacement);
+            }
+            else
+            {
+                removed[op] = true;
+            }
+        }
+
+        const auto initial_count = counts_down ? (count_limit_ - initial_value) & 0xff : initial_value;
+        const auto initial_operand = initial_value >= 0 ? "#" + std::to_string(initial_count) : counter;
+        instructions_.emplace(instructions_.begin() + static_cast<std::ptrdiff_t>(loop_.head), reg.load,
+                              ca::instruction_operand(ca::operand_type::literal, initial_operand));
+        instructions_[loop_.head].set_comment(instructions_[loop_.head - 1].comment());
+        removed.insert(removed.begin() + static_cast<std::ptrdiff_t>(loop_.head), false);
+
+        erase_marked(instructions_, removed);
+        return true;
+    }
+
+private:
+    // The constant the counter is set to right in front of the loop with lda #k; sta m, or -1.
+    auto get_initial_value(const std::string &counter) const -> int
+    {
+        const auto head = loop_.head;
+        if (head < 2 || !instructions_[head - 1].is_instruction() || !instructions_[head - 2].is_instruction())
+            return -1;
+
+        const auto &store = instructions_[head - 1];
+        const auto &load = instructions_[head - 2];
+        if (store.opcode() != mos6502_opcode::sta || store.operand().value() != counter ||
+            load.opcode() != mos6502_opcode::lda)
+        {
+            return -1;
+        }
+
+        return parse_immediate(load.operand().value());
+    }
+
+    // inc m; lda m; cmp #k; bne loop, where the counter isn't otherwise read and not needed after the loop. The
+    // comparison leaves N and C behind, which the decrement that replaces it doesn't, so those must be dead too.
+    auto counts_up_to_constant(const std::vector<size_t> &accesses, const live_mask counter_mask,
+                               const live_mask exit_live) -> bool
+    {
+        if (accesses.size() != 2 || instructions_[loop_.end].opcode() != mos6502_opcode::bne ||
+            (exit_live & counter_mask) != 0)
+        {
+            return false;
+        }
+
+        const auto increment = accesses[0];
+        const auto load = accesses[1];
+        const auto negative_and_carry = get_flags_mask(mos6502_flags::negative | mos6502_flags::carry);
+        if (instructions_[increment].opcode() != mos6502_opcode::inc ||
+            instructions_[load].opcode() != mos6502_opcode::lda || load + 2 != loop_.end ||
+            instructions_[load + 1].opcode() != mos6502_opcode::cmp ||
+            (info_.live_out[load + 1] & register_a) != 0 || (info_.live_out[loop_.end] & negative_and_carry) != 0)
+        {
+            return false;
+        }
+
+        count_limit_ = parse_immediate(instructions_[load + 1].operand().value());
+        return count_limit_ >= 0;
+    }
+
+    std::vector<mos6502> &instructions_;
+    const liveness &info_;
+    const loop &loop_;
+    int count_limit_ = -1;
+};
+
+// Loops that consist of a single basic block, entered only by falling into them
+auto is_simple_loop(const std::vector<mos6502> &instructions, const loop &l) -> bool
+{
+    const auto &back_edge = instructions[l.end];
+    if (!back_edge.is_branch() || back_edge.opcode() == mos6502_opcode::bra || l.head == 0 ||
+        !instructions[l.head - 1].is_instruction())
+    {
+        return false;
+    }
+
+    switch (instructions[l.head - 1].opcode())
+    {
+        case mos6502_opcode::jmp:
+        case mos6502_opcode::bra:
+        case mos6502_opcode::rts:
+        case mos6502_opcode::rti:
+            return false;
+        default:
+            break;
+    }
+
+    for (auto op = l.head + 1; op < l.end; ++op)
+    {
+        const auto &i = instructions[op];
+        if (i.is_label() || i.is_branch() || i.opcode() == mos6502_opcode::jmp || i.opcode() == mos6502_opcode::jsr ||
+            i.opcode() == mos6502_opcode::rts || i.opcode() == mos6502_opcode::rti)
+        {
+            return false;
+        }
+    }
+
+    const auto &label = instructions[l.head].text();
+    for (size_t op = 0; op < instructions.size(); ++op)
+    {
+        if (op != l.end && instructions[op].is_instruction() && instructions[op].operand().value() == label)
+            return false;
+    }
+
+    return true;
+}
+
+} // namespace
+
+auto find_loops(const std::vector<mos6502> &instructions) -> std::vector<loop>
+{
+    std::map<std::string, size_t> labels;
+    for (size_t op = 0; op < instructions.size(); ++op)
+    {
+        if (instructions[op].is_label())
+            labels[instructions[op].text()] = op;
+    }
+
+    std::vector<loop> loops;
+    for (size_t op = 0; op < instructions.size(); ++op)
+    {
+        const auto &i = instructions[op];
+        if (!i.is_instruction() || (!i.is_branch() && i.opcode() != mos6502_opcode::jmp))
+            continue;
+
+        const auto target = labels.find(i.operand().value());
+        if (target != std::end(labels) && target->second < op)
+            loops.push_back({target->second, op});
+    }
+
+    for (auto &l : loops)
+    {
+        l.depth = static_cast<int>(std::count_if(loops.begin(), loops.end(), [&l](const loop &outer) {
+            return outer.head <= l.head && outer.end >= l.end;
+        }));
+    }
+
+    return loops;
+}
+
+auto use_index_register_counters(std::vector<mos6502> &instructions, const zero_page_registers &registers) -> bool
+{
+    const auto loops = find_loops(instructions);
+    return use_index_register_counters(instructions, analyze_liveness(instructions, registers), loops);
+}
+
+auto use_index_register_counters(std::vector<mos6502> &instructions, const liveness &info,
+                                 const std::vector<loop> &loops) -> bool
+{
+    for (const auto &l : loops)
+    {
+        if (!is_simple_loop(instructions, l))
+            continue;
+
+        // Every zero page register that is incremented, decremented, loaded or stored in the loop is a candidate
+        for (auto op = l.head + 1; op < l.end; ++op)
+        {
+            const auto &i = instructions[op];
+            const auto &e = info.effects[op];
+            const auto counter_mask = (e.use | e.def) & all_locations;
+            if (counter_mask == 0 || (counter_mask & (counter_mask - 1)) != 0 || !i.is_instruction())
+                continue;
+
+            switch (i.opcode())
+            {
+                case mos6502_opcode::inc:
+                case mos6502_opcode::dec:
+                case mos6502_opcode::lda:
+                case mos6502_opcode::sta:
+                    break;
+                default:
+                    continue;
+            }
+
+            const auto counter = i.operand().value();
+            counter_rewriter rewriter{instructions, info, l};
+            if (rewriter.rewrite(counter, counter_mask, index_x) || rewriter.rewrite(counter, counter_mask, index_y))
+                return true;
+        }
+    }
+
+    return false;
+}
+
+} // namespace internal
@@ -1,6 +1,7 @@
 #include <mos6502/mos6502_target.h>
 #include "opcodes.h"
 #include <ca/instruction_operand.h>
+#include <vector>
 
 void mos6502_target::translate_addb(const ca::instruction_operand &o1, const ca::instruction_operand &o2)
 {
@@ -8,12 +9,12 @@ void mos6502_target::translate_addb(const ca::instruction_operand &o1, const ca:
     {
         emit(mos6502_opcode::lda, get_register(o2.reg()));
         emit(mos6502_opcode::clc);
-        emit(mos6502_opcode::adc, ca::instruction_operand(ca::operand_type::literal, fixup_8bit_literal(o1.value())));
+        emit(mos6502_opcode::adc, fixup_8bit_literal(o1));
         emit(mos6502_opcode::sta, get_register(o2.reg()));
     }
     else if (o1.is_literal() && o2.is_literal())
     {
-        emit(mos6502_opcode::lda, ca::instruction_operand(ca::operand_type::literal, fixup_8bit_literal(o1.value())));
+        emit(mos6502_opcode::lda, fixup_8bit_literal(o1));
         emit(mos6502_opcode::clc);
         emit(mos6502_opcode::adc, o2);
         emit(mos6502_opcode::sta, o2);
@@ -29,43 +30,32 @@ void mos6502_target::translate_addb(const ca::instruction_operand &o1, const ca:
     {
         throw std::runtime_error("Cannot translate addb instruction");
     }
+
+    set_flags_source(flags_source::addition);
 }
 
-// TODO: Fixup 16-bit add. addl is generated when doing cdecl calling conventions to change the stack pointer.
+// Adds all bytes with a carry chain. Additions to the stack pointer pop the arguments of a call.
 void mos6502_target::translate_addl(const ca::instruction_operand &o1, const ca::instruction_operand &o2)
 {
-    if (o1.is_literal() && o2.is_register())
+    // Popping the arguments of a call. Only the 65816 pulls them off the stack again; the others leave it alone.
+    if (o2.is_register() && (o2.reg() == ca::intel_386_register::sp || o2.reg() == ca::intel_386_register::esp))
     {
-        // TODO: Is it the stack pointer (SP/ESP)? Then skip emitting this code.
-        // This should probably be an optimization step instead as it should only
-        // be skipped if it's used in context of calling a cdecl function.
-        if (o2.reg() != ca::intel_386_register::sp && o2.reg() != ca::intel_386_register::esp)
+        // The 65816 reads the arguments in place, so they have to come off again after the call. Those of library
+        // calls that were replaced by inline code were never pushed.
+        if (uses_stack_relative_arguments() && is_numeric_literal(o1))
         {
-            emit(mos6502_opcode::lda, get_register(o2.reg()));
-            emit(mos6502_opcode::clc);
-            emit(mos6502_opcode::adc,
-                 ca::instruction_operand(ca::operand_type::literal, fixup_8bit_literal(o1.value())));
-            emit(mos6502_opcode::sta, get_register(o2.reg()));
+            const auto inlined = std::min(parse_literal(o1), inlined_argument_bytes_);
+            inlined_argument_bytes_ -= inlined;
+            emit_stack_adjustment(parse_literal(o1) - inlined);
         }
+        return;
     }
-    else if (o1.is_literal() && o2.is_literal())
-    {
-        emit(mos6502_opcode::lda, ca::instruction_operand(ca::operand_type::literal, fixup_8bit_literal(o1.value())));
-        emit(mos6502_opcode::clc);
-        emit(mos6502_opcode::adc, o2);
-        emit(mos6502_opcode::sta, o2);
-    }
-    else if (o1.is_register() && o2.is_literal())
-    {
-        emit(mos6502_opcode::lda, get_register(o1.reg()));
-        emit(mos6502_opcode::clc);
-        emit(mos6502_opcode::adc, o2);
-        emit(mos6502_opcode::sta, o2);
-    }
-    else
-    {
-        throw std::runtime_error("Cannot translate addb instruction");
-    }
+
+    if (is_immediate(o2))
+        throw std::runtime_error("Cannot translate addl instruction");
+
+    emit_add(o1, o2);
+    set_flags_source(flags_source::zero);
 }
 
 void mos6502_target::translate_cmpb(const ca::instruction_operand &o1, const ca::instruction_operand &o2)
@@ -73,17 +63,29 @@ void mos6502_target::translate_cmpb(const ca::instruction_operand &o1, const ca:
     if (o1.is_literal() && o2.is_literal())
     {
         emit(mos6502_opcode::lda, o2);
-        emit(mos6502_opcode::cmp, ca::instruction_operand(ca::operand_type::literal, fixup_8bit_literal(o1.value())));
+        emit(mos6502_opcode::cmp, fixup_8bit_literal(o1));
     }
     else if (o1.is_literal() && o2.is_register())
     {
         emit(mos6502_opcode::lda, get_register(o2.reg()));
-        emit(mos6502_opcode::cmp, ca::instruction_operand(ca::operand_type::literal, fixup_8bit_literal(o1.value())));
+        emit(mos6502_opcode::cmp, fixup_8bit_literal(o1));
+    }
+    else if (o1.is_register() && o2.is_register())
+    {
+        emit(mos6502_opcode::lda, get_register(o2.reg()));
+        emit(mos6502_opcode::cmp, get_register(o1.reg()));
+    }
+    else if (o1.is_register() && o2.is_literal() && !is_immediate(o2))
+    {
+        emit(mos6502_opcode::lda, o2);
+        emit(mos6502_opcode::cmp, get_register(o1.reg()));
     }
     else
     {
         throw std::runtime_error("Cannot translate cmpb instruction");
     }
+
+    set_flags_source(flags_source::comparison);
 }
 
 void mos6502_target::translate_decb(const ca::instruction_operand &o1, const ca::instruction_operand &o2)
@@ -96,11 +98,17 @@ void mos6502_target::translate_decb(const ca::instruction_operand &o1, const ca:
     {
         emit(mos6502_opcode::dec, o1);
     }
+
+    set_flags_source(flags_source::sign_and_zero);
 }
 
 void mos6502_target::translate_decl(const ca::instruction_operand &o1, const ca::instruction_operand &o2)
 {
-    throw std::runtime_error("Cannot translate decl instruction");
+    if (is_immediate(o1))
+        throw std::runtime_error("Cannot translate decl instruction");
+
+    emit_decrement(o1);
+    set_flags_source(flags_source::zero);
 }
 
 void mos6502_target::translate_incb(const ca::instruction_operand &o1, const ca::instruction_operand &o2)
@@ -113,11 +121,17 @@ void mos6502_target::translate_incb(const ca::instruction_operand &o1, const ca:
     {
         emit(mos6502_opcode::inc, o1);
     }
+
+    set_flags_source(flags_source::sign_and_zero);
 }
 
 void mos6502_target::translate_incl(const ca::instruction_operand &o1, const ca::instruction_operand &o2)
 {
-    throw std::runtime_error("Cannot translate incl instruction");
+    if (is_immediate(o1))
+        throw std::runtime_error("Cannot translate incl instruction");
+
+    emit_increment(o1);
+    set_flags_source(flags_source::zero);
 }
 
 void mos6502_target::translate_negb(const ca::instruction_operand &o1, const ca::instruction_operand &o2)
@@ -134,16 +148,98 @@ void mos6502_target::translate_negb(const ca::instruction_operand &o1, const ca:
     {
         throw std::runtime_error("Cannot translate negb instruction");
     }
+
+    set_flags_source(flags_source::sign_and_zero);
 }
 
 void mos6502_target::translate_sall(const ca::instruction_operand &o1, const ca::instruction_operand &o2)
 {
-    throw std::runtime_error("Cannot translate sall instruction");
+    if (o1.is_register() || o2.is_register())
+    {
+        // Shift the register in place in memory; there is no need to go through A.
+        const auto do_shift = [this](const auto reg) {
+            emit(mos6502_opcode::asl, get_register(reg));
+            emit(mos6502_opcode::rol, get_register(reg, 1));
+        };
+
+        if (o1.is_literal())
+        {
+            const auto count = parse_literal(o1);
+            for (int i = 0; i < count; ++i)
+            {
+                do_shift(o2.reg());
+            }
+        }
+        else if (o2.is_register())
+        {
+            emit_counted_shift(o1, [&]() { do_shift(o2.reg()); });
+        }
+        else
+        {
+            do_shift(o1.reg());
+        }
+    }
+    else
+    {
+        throw std::runtime_error("Cannot translate sall instruction");
+    }
+
+    set_flags_source(flags_source::none);
 }
 
 void mos6502_target::translate_sarl(const ca::instruction_operand &o1, const ca::instruction_operand &o2)
 {
-    throw std::runtime_error("Cannot translate sarl instruction");
+    if (o1.is_register() || o2.is_register())
+    {
+        const auto do_shift = [this](const auto reg) {
+            // Shift the sign bit into carry, so that it is shifted back into the top bit
+            emit(mos6502_opcode::lda, get_register(reg, 1));
+            emit(mos6502_opcode::asl);
+            emit(mos6502_opcode::ror, get_register(reg, 1));
+            emit(mos6502_opcode::ror, get_register(reg));
+        };
+
+        if (o1.is_literal())
+        {
+            const auto count = parse_literal(o1);
+            for (int i = 0; i < count; ++i)
+            {
+                do_shift(o2.reg());
+            }
+        }
+        else if (o2.is_register())
+        {
+            emit_counted_shift(o1, [&]() { do_shift(o2.reg()); });
+        }
+        else
+        {
+            do_shift(o1.reg());
+        }
+    }
+    else
+    {
+        throw std::runtime_error("Cannot translate sarl instruction");
+    }
+
+    set_flags_source(flags_source::none);
+}
+
+// Repeats a shift by the count in a register, like sall %cl, %eax. As on x86 only the low 5 bits of the count are
+// used, and a count of zero leaves the value alone.
+void mos6502_target::emit_counted_shift(const ca::instruction_operand &count, const std::function<void()> &shift)
+{
+    const auto loop = create_local_label();
+    const auto done = create_local_label();
+
+    emit(mos6502_opcode::lda, get_register(count.reg()));
+    emit(mos6502_opcode::AND, create_8bit_literal(31));
+    emit(mos6502_opcode::beq, ca::instruction_operand(ca::operand_type::literal, done));
+    emit(mos6502_opcode::tax);
+    emit(ca::asm_line::line_type::label, loop);
+    shift();
+    emit(mos6502_opcode::dex);
+    emit(mos6502_opcode::bne, ca::instruction_operand(ca::operand_type::literal, loop));
+    emit(ca::asm_line::line_type::label, done);
 }
 
 void mos6502_target::translate_sbbb(const ca::instruction_operand &o1, const ca::instruction_operand &o2)
@@ -165,6 +261,8 @@ void mos6502_target::translate_sbbb(const ca::instruction_operand &o1, const ca:
     {
         throw std::runtime_error("Cannot translate sbbb instruction");
     }
+
+    set_flags_source(flags_source::sign_and_zero);
 }
 
 void mos6502_target::translate_subb(const ca::instruction_operand &o1, const ca::instruction_operand &o2)
@@ -183,11 +281,27 @@ void mos6502_target::translate_subb(const ca::instruction_operand &o1, const ca:
     {
         throw std::runtime_error("Cannot translate subb instruction");
     }
+
+    set_flags_source(flags_source::subtraction);
 }
 
 void mos6502_target::translate_subl(const ca::instruction_operand &o1, const ca::instruction_operand &o2)
 {
-    throw std::runtime_error("Cannot translate subl instruction");
+    // Stack operands are mapped to argument slots as seen on entry, so the stack pointer can't move
+    const auto moves_stack_pointer = o2.is_register() && (o2.reg() == ca::intel_386_register::sp ||
+                                                         o2.reg() == ca::intel_386_register::esp);
+
+    if (is_immediate(o2) || (moves_stack_pointer && calling_convention_ == calling_convention::zero_page))
+        throw std::runtime_error("Cannot translate subl instruction");
+
+    if (moves_stack_pointer && uses_stack_relative_arguments() && is_numeric_literal(o1))
+    {
+        emit_stack_adjustment(-parse_literal(o1));
+        return;
+    }
+
+    emit_subtract(o1, o2);
+    set_flags_source(flags_source::zero);
 }
 
 void mos6502_target::translate_testb(const ca::instruction_operand &o1, const ca::instruction_operand &o2)
@@ -197,6 +311,8 @@ void mos6502_target::translate_testb(const ca::instruction_operand &o1, const ca
         // this just tests the register for 0
         emit(mos6502_opcode::lda, get_register(o1.reg()));
         //        instructions.emplace_back(mos6502_opcode::bit, Operand(Operand::Type::literal, "#$00"));
+        set_flags_source(flags_source::logic);
+        return;
     }
     else if (o1.is_register() && o2.is_register())
     {
@@ -207,17 +323,174 @@ void mos6502_target::translate_testb(const ca::instruction_operand &o1, const ca
     else if (o1.is_literal() && o2.is_register())
     {
         // ands the values
-        emit(mos6502_opcode::lda, ca::instruction_operand(ca::operand_type::literal, fixup_8bit_literal(o1.value())));
+        emit(mos6502_opcode::lda, fixup_8bit_literal(o1));
         emit(mos6502_opcode::bit, get_register(o2.reg()));
     }
     else if (o1.is_literal() && o2.is_literal())
     {
         // ands the values
-        emit(mos6502_opcode::lda, ca::instruction_operand(ca::operand_type::literal, fixup_8bit_literal(o1.value())));
+        emit(mos6502_opcode::lda, fixup_8bit_literal(o1));
         emit(mos6502_opcode::bit, o2);
     }
     else
     {
         throw std::runtime_error("Cannot translate testb instruction");
     }
+
+    // bit takes N from the operand instead of the result
+    set_flags_source(flags_source::zero);
+}
+
+void mos6502_target::emit_add(const ca::instruction_operand &source, const ca::instruction_operand &destination)
+{
+    const auto size = get_operand_size(destination);
+
+    if (source.is_literal() && is_numeric_literal(source))
+    {
+        const auto value = std::stoll(source.value().substr(1)) & 0xffffffffll;
+
+        if (value == 1)
+        {
+            emit_increment(destination);
+            return;
+        }
+
+        if (value == 0xffffffffll)
+        {
+            emit_decrement(destination);
+            return;
+        }
+    }
+
+    // Zero bytes at the bottom of an immediate leave those bytes unchanged and can't produce a carry.
+    auto first = 0;
+    while (first < size && get_known_byte(source, first) == 0)
+        ++first;
+
+    if (first == size)
+    {
+        emit_zero_test(destination);
+        return;
+    }
+
+    emit(mos6502_opcode::clc);
+
+    for (auto offset = first; offset < size; ++offset)
+    {
+        if (offset > first && are_upper_bytes_zero(source, offset, size))
+        {
+            // Only the carry is left to add; it rarely ripples further than the next byte.
+            const auto done = create_local_label();
+            emit(mos6502_opcode::bcc, ca::instruction_operand(ca::operand_type::literal, done));
+            for (auto i = offset; i < size; ++i)
+            {
+                emit(mos6502_opcode::inc, get_operand_byte(destination, i));
+                if (i + 1 < size)
+                    emit(mos6502_opcode::bne, ca::instruction_operand(ca::operand_type::literal, done));
+            }
+            emit(ca::asm_line::line_type::label, done);
+            break;
+        }
+
+        emit(mos6502_opcode::lda, get_operand_byte(destination, offset));
+        emit(mos6502_opcode::adc, get_operand_byte(source, offset));
+        emit(mos6502_opcode::sta, get_operand_byte(destination, offset));
+    }
+
+    emit_zero_test(destination);
+}
+
+void mos6502_target::emit_subtract(const ca::instruction_operand &source, const ca::instruction_operand &destination)
+{
+    const auto size = get_operand_size(destination);
+
+    if (source.is_literal() && is_numeric_literal(source))
+    {
+        const auto value = std::stoll(source.value().substr(1)) & 0xffffffffll;
+
+        if (value == 1)
+        {
+            emit_decrement(destination);
+            return;
+        }
+
+        if (value == 0xffffffffll)
+        {
+            emit_increment(destination);
+            return;
+        }
+    }
+
+    // Zero bytes at the bottom of an immediate leave those bytes unchanged and can't produce a borrow.
+    auto first = 0;
+    while (first < size && get_known_byte(source, first) == 0)
+        ++first;
+
+    if (first == size)
+    {
+        emit_zero_test(destination);
+        return;
+    }
+
+    emit(mos6502_opcode::sec);
+
+    for (auto offset = first; offset < size; ++offset)
+    {
+        emit(mos6502_opcode::lda, get_operand_byte(destination, offset));
+        emit(mos6502_opcode::sbc, get_operand_byte(source, offset));
+        emit(mos6502_opcode::sta, get_operand_byte(destination, offset));
+    }
+
+    emit_zero_test(destination);
+}
+
+void mos6502_target::emit_increment(const ca::instruction_operand &destination)
+{
+    const auto size = get_operand_size(destination);
+    const auto done = create_local_label();
+
+    // The zero flag is correct for the whole value at the end: either a byte didn't wrap around or all of them did.
+    for (auto offset = 0; offset < size; ++offset)
+    {
+        emit(mos6502_opcode::inc, get_operand_byte(destination, offset));
+        if (offset + 1 < size)
+            emit(mos6502_opcode::bne, ca::instruction_operand(ca::operand_type::literal, done));
+    }
+
+    emit(ca::asm_line::line_type::label, done);
+}
+
+void mos6502_target::emit_decrement(const ca::instruction_operand &destination)
+{
+    const auto size = get_operand_size(destination);
+
+    // A byte only borrows from the next one when it is zero before being decremented.
+    std::vector<std::string> labels;
+    for (auto offset = 0; offset + 1 < size; ++offset)
+    {
+        labels.push_back(create_local_label());
+        emit(mos6502_opcode::lda, get_operand_byte(destination, offset));
+        emit(mos6502_opcode::bne, ca::instruction_operand(ca::operand_type::literal, labels.back()));
+    }
+
+    emit(mos6502_opcode::dec, get_operand_byte(destination, size - 1));
+
+    for (auto offset = size - 2; offset >= 0; --offset)
+    {
+        emit(ca::asm_line::line_type::label, labels[offset]);
+        emit(mos6502_opcode::dec, get_operand_byte(destination, offset));
+    }
+
+    emit_zero_test(destination);
+}
+
+// Only the zero flag reflects the whole value after multi-byte arithmetic; the dead code pass removes the test when
+// nothing reads it.
+void mos6502_target::emit_zero_test(const ca::instruction_operand &destination)
+{
+    const auto size = get_operand_size(destination);
+
+    emit(mos6502_opcode::lda, get_operand_byte(destination, 0));
+    for (auto offset = 1; offset < size; ++offset)
+        emit(mos6502_opcode::ORA, get_operand_byte(destination, offset));
 }
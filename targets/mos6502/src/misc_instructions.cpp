@@ -1,42 +1,747 @@
 #include <mos6502/mos6502_target.h>
 #include "opcodes.h"
+#include "passes.h"
 #include <ca/instruction_operand.h>
+#include <cstdlib>
+#include <iomanip>
+#include <sstream>
+
+namespace internal
+{
+
+// Blocks up to this size are copied or filled with straight-line code instead of a loop.
+static constexpr auto max_unrolled_block_size = 16;
+
+// Arguments passed in the zero page live in the BASIC floating point work area, which is free as long as no BASIC
+// code runs. Every argument takes 4 bytes, just like on the x86 stack, so that N(%esp) maps to a slot directly.
+static constexpr auto first_argument_slot = 0x57;
+static constexpr auto argument_slots_size = 16;
+static constexpr auto argument_size = 4;
+
+static auto create_zero_page_address(const int address) -> std::string
+{
+    std::ostringstream result;
+    result << '$' << std::hex << address;
+    return result.str();
+}
+
+// The 65816 only has stack relative forms of the instructions that also have (zp,x) ones.
+static auto supports_stack_relative(const mos6502_opcode o) -> bool
+{
+    switch (o)
+    {
+        case mos6502_opcode::lda:
+        case mos6502_opcode::sta:
+        case mos6502_opcode::ORA:
+        case mos6502_opcode::AND:
+        case mos6502_opcode::eor:
+        case mos6502_opcode::adc:
+        case mos6502_opcode::sbc:
+        case mos6502_opcode::cmp:
+            return true;
+        default:
+            return false;
+    }
+}
+
+// A 16-bit immediate in the form the 65816 passes recognize
+static auto create_16bit_immediate(const int value) -> ca::instruction_operand
+{
+    std::ostringstream result;
+    result << "#$" << std::hex << std::setw(4) << std::setfill('0') << (value & 0xffff);
+    return ca::instruction_operand(ca::operand_type::literal, result.str());
+}
+
+// pea takes the value it pushes written as an address
+static auto create_pushed_value(const int value) -> ca::instruction_operand
+{
+    return ca::instruction_operand(ca::operand_type::literal, create_16bit_immediate(value).value().substr(1));
+}
+
+// The bits of rep and sep that switch A, X and Y between 16 and 8 bits for the 65816 block moves
+static auto create_register_width_bits() -> ca::instruction_operand
+{
+    return ca::instruction_operand(ca::operand_type::literal, "#$30");
+}
+
+// Both banks of a block move; everything happens in bank 0
+static auto create_block_move_banks() -> ca::instruction_operand
+{
+    return ca::instruction_operand(ca::operand_type::literal, "0,0");
+}
+
+// The source, destination and length of a HuC6280 block transfer
+static auto create_block_transfer(const ca::instruction_operand &source, const ca::instruction_operand &destination,
+                                  const int size) -> ca::instruction_operand
+{
+    return ca::instruction_operand(ca::operand_type::literal,
+                                   source.value() + "," + destination.value() + "," + std::to_string(size));
+}
+
+// The opcodes that make up a block transfer stub
+static constexpr auto tii_opcode = 0x73;
+static constexpr auto rts_opcode = 0x60;
+
+} // namespace internal
+
+auto mos6502_target::get_argument_slot(const mos6502_opcode opcode, const ca::instruction_operand &o) const
+    -> ca::instruction_operand
+{
+    if ((calling_convention_ != calling_convention::zero_page && !uses_stack_relative_arguments()) || !o.is_memory())
+        return o;
+
+    const auto &m = o.memory();
+    if (m.base != ca::intel_386_register::esp || m.index != ca::intel_386_register::unknown || !m.symbol.empty())
+        return o;
+
+    if (uses_stack_relative_arguments())
+    {
+        // Every 4 bytes of the x86 stack are 2 here, and S points below the last byte pushed. Only the low half of
+        // each is there, as registers only hold 16 bits.
+        const auto offset = (m.displacement / 4) * 2 + m.displacement % 4 + 1;
+        if (m.displacement < 0 || m.displacement % 4 > 1 || offset > 0xff || !internal::supports_stack_relative(opcode))
+            throw std::runtime_error("Cannot translate stack operand " + o.value());
+
+        return ca::instruction_operand(ca::operand_type::literal, std::to_string(offset) + ",s");
+    }
+
+    // The return address sits at 0(%esp) on entry, and every argument pushed for a call that follows moves the
+    // others further up.
+    const auto depth = static_cast<int>(pushed_arguments_.size()) * internal::argument_size;
+    const auto offset = m.displacement - internal::argument_size - depth;
+
+    if (offset < 0 || offset >= internal::argument_slots_size)
+        throw std::runtime_error("Cannot translate stack operand " + o.value());
+
+    return ca::instruction_operand(ca::operand_type::literal,
+                                   internal::create_zero_page_address(internal::first_argument_slot + offset));
+}
+
+auto mos6502_target::lower_memory_operand(const ca::instruction_operand &o) -> ca::instruction_operand
+{
+    using reg = ca::intel_386_register;
+
+    if (!o.is_memory())
+        return o;
+
+    // The x86 stack has no counterpart here; what allocate_static_frames left of it is kept as it is, like the
+    // arguments of the stack calling convention.
+    const auto &m = o.memory();
+    const auto is_stack = [](const reg r) {
+        return r != reg::unknown && (ca::get_base_register(r) == reg::esp || ca::get_base_register(r) == reg::ebp);
+    };
+    if (is_stack(m.base) || is_stack(m.index))
+        return o;
+
+    const auto has_base = m.base != reg::unknown;
+    const auto has_index = m.index != reg::unknown;
+    const auto address = ca::to_string(ca::memory_operand{m.symbol, m.displacement});
+
+    // Absolute, or zero page if the address is small enough
+    if (!has_base && !has_index)
+        return ca::instruction_operand(ca::operand_type::literal, address);
+
+    // Index registers are 8 bits wide, so only the low byte of the x86 register takes part in the address
+    if (m.scale == 1 && has_base != has_index && (!has_base || !m.symbol.empty() || m.displacement > 0xff))
+    {
+        // An array element, like table(,%ecx) or table(%ecx)
+        emit(mos6502_opcode::ldx, get_register(has_base ? m.base : m.index));
+        return ca::instruction_operand(ca::operand_type::literal, address + ",x");
+    }
+
+    if (m.scale == 1 && has_base && m.symbol.empty())
+    {
+        // A pointer in a register, with a small offset like a field of a struct, or with a byte index
+        if (!has_index && m.displacement >= 0 && m.displacement <= 0xff)
+            emit(mos6502_opcode::ldy, ca::instruction_operand(ca::operand_type::literal, "#" + address));
+        else if (has_index && m.displacement == 0)
+            emit(mos6502_opcode::ldy, get_register(m.index));
+        else
+            throw std::runtime_error("Cannot translate memory operand " + o.value());
+
+        return ca::instruction_operand(ca::operand_type::literal, "(" + get_register(m.base).value() + "),y");
+    }
+
+    throw std::runtime_error("Cannot translate memory operand " + o.value());
+}
+
+// The slot of each argument is only known once the call shows how many arguments there are; the last one pushed is
+// the first argument. Until then the stores in translate_pushl have no operand.
+void mos6502_target::assign_argument_slots()
+{
+    // Drop the stores that never got a slot, so that a failed call doesn't leave them in the output
+    const auto fail = [this]() {
+        for (auto argument = std::rbegin(pushed_arguments_); argument != std::rend(pushed_arguments_); ++argument)
+        {
+            instructions_.erase(std::next(std::begin(instructions_), argument->first_instruction),
+                                std::next(std::begin(instructions_), argument->end_instruction));
+        }
+
+        pushed_arguments_.clear();
+        throw std::runtime_error("Cannot translate calll instruction");
+    };
+
+    const auto count = static_cast<int>(pushed_arguments_.size());
+    if (count * internal::argument_size > internal::argument_slots_size)
+        fail();
+
+    std::vector<int> written;
+    for (auto argument = 0; argument < count; ++argument)
+    {
+        const auto &pushed = pushed_arguments_[argument];
+        const auto slot = internal::first_argument_slot + (count - 1 - argument) * internal::argument_size;
+        auto offset = 0;
+
+        for (auto op = pushed.first_instruction; op < pushed.end_instruction; ++op)
+        {
+            auto &i = instructions_[op];
+
+            // Forwarding our own arguments in a different order would read slots that were already overwritten
+            if (std::find(std::begin(written), std::end(written), internal::parse_address(i.operand().value())) !=
+                std::end(written))
+            {
+                fail();
+            }
+
+            if (i.opcode() == mos6502_opcode::sta)
+            {
+                written.push_back(slot + offset);
+
+                const auto comment = i.comment();
+                i = mos6502(mos6502_opcode::sta,
+                            ca::instruction_operand(ca::operand_type::literal,
+                                                    internal::create_zero_page_address(slot + offset++)));
+                i.set_comment(comment);
+            }
+        }
+    }
+}
+
+void mos6502_target::translate_leave(const ca::instruction_operand &o1, const ca::instruction_operand &o2)
+{
+    // Frames set up through %ebp are placed in static memory before lowering, which removes their leave.
+    throw std::runtime_error("Cannot translate leave instruction");
+}
+
+void mos6502_target::translate_popl(const ca::instruction_operand &o1, const ca::instruction_operand &o2)
+{
+    if (calling_convention_ == calling_convention::zero_page || !o1.is_register())
+        throw std::runtime_error("Cannot translate popl instruction");
+
+    // Restores a register saved by pushl, which pushed the low byte first. It wasn't an argument after all.
+    if (!pushed_arguments_.empty())
+        pushed_arguments_.pop_back();
+
+    // The 65816 has the low byte on top instead, where it pushed it last
+    const auto first = uses_stack_relative_arguments() ? 0 : 1;
+    emit(mos6502_opcode::pla);
+    emit(mos6502_opcode::sta, get_register(o1.reg(), first));
+    emit(mos6502_opcode::pla);
+    emit(mos6502_opcode::sta, get_register(o1.reg(), 1 - first));
+}
 
 void mos6502_target::translate_pushl(const ca::instruction_operand &o1, const ca::instruction_operand &o2)
 {
-    if (o1.is_register())
+    const auto first_instruction = instructions_.size();
+
+    if (calling_convention_ == calling_convention::zero_page)
+    {
+        // Registers only hold 16 bits, so that is all an argument passes along
+        for (auto offset = 0; offset < 2; ++offset)
+        {
+            emit(mos6502_opcode::lda, get_operand_byte(o1, offset));
+            emit(mos6502_opcode::sta);
+        }
+    }
+    else if (uses_stack_relative_arguments() && o1.is_literal() && is_numeric_literal(o1))
+    {
+        // pea pushes its operand high byte first, without going through A
+        emit(mos6502_opcode::pea, internal::create_pushed_value(parse_literal(o1)));
+    }
+    else if (uses_stack_relative_arguments() && (o1.is_register() || is_immediate(o1)))
+    {
+        // Always both bytes, the high one first, so that arguments are read in place like any 16-bit value
+        emit(mos6502_opcode::lda, get_operand_byte(o1, 1));
+        emit(mos6502_opcode::pha);
+        emit(mos6502_opcode::lda, get_operand_byte(o1, 0));
+        emit(mos6502_opcode::pha);
+    }
+    else if (o1.is_register())
     {
         emit(mos6502_opcode::lda, get_register(o1.reg()));
         emit(mos6502_opcode::pha);
         emit(mos6502_opcode::lda, get_register(o1.reg(), 1));
         emit(mos6502_opcode::pha);
     }
-    else if (o1.is_literal())
+    else if (o1.is_literal() && is_numeric_literal(o1))
     {
-        const auto value = parse_literal(o1.value());
+        const auto value = parse_literal(o1);
 
         if (is_8bit_literal(value))
         {
-            emit(mos6502_opcode::lda, o1);
+            emit(mos6502_opcode::lda, fixup_8bit_literal(o1));
             emit(mos6502_opcode::pha);
         }
         else
         {
-            emit(mos6502_opcode::lda,
-                 ca::instruction_operand(ca::operand_type::literal, create_8bit_literal(get_16bit_msb(value))));
+            emit(mos6502_opcode::lda, create_8bit_literal(get_16bit_msb(value)));
             emit(mos6502_opcode::pha);
-            emit(mos6502_opcode::lda,
-                 ca::instruction_operand(ca::operand_type::literal, create_8bit_literal(get_16bit_lsb(value))));
+            emit(mos6502_opcode::lda, create_8bit_literal(get_16bit_lsb(value)));
             emit(mos6502_opcode::pha);
         }
     }
+    else if (is_immediate(o1))
+    {
+        emit(mos6502_opcode::lda, get_operand_byte(o1, 1));
+        emit(mos6502_opcode::pha);
+        emit(mos6502_opcode::lda, get_operand_byte(o1, 0));
+        emit(mos6502_opcode::pha);
+    }
     else
     {
         throw std::runtime_error("Cannot translate pushl instruction");
     }
+
+    pushed_arguments_.push_back({o1, first_instruction, instructions_.size()});
+}
+
+// Moves the stack pointer of the 65816 by the given number of bytes of the x86 stack, where they take half as many.
+// Space is made with pha, since only the position matters, and given back with pla.
+void mos6502_target::emit_stack_adjustment(const int bytes)
+{
+    if (bytes % internal::argument_size != 0)
+        throw std::runtime_error("Cannot move the stack pointer by " + std::to_string(bytes));
+
+    for (auto i = 0; i < std::abs(bytes) / 2; ++i)
+        emit(bytes > 0 ? mos6502_opcode::pla : mos6502_opcode::pha);
 }
 
 void mos6502_target::translate_rep(const ca::instruction_operand &o1, const ca::instruction_operand &o2)
 {
-    throw std::runtime_error("Cannot translate rep instruction");
+    // A count that is known at compile time is passed in the second operand.
+    std::optional<int> size;
+    if (o2.is_literal() && is_numeric_literal(o2))
+        size = parse_literal(o2);
+
+    if (size && (*size < 0 || *size > 0xffff))
+        throw std::runtime_error("Cannot translate rep instruction");
+
+    if (o1.value() == "movsb")
+    {
+        emit_indirect_block(true, size);
+    }
+    else if (o1.value() == "stosb")
+    {
+        emit(mos6502_opcode::lda, get_register(ca::intel_386_register::al));
+        emit_indirect_block(false, size);
+    }
+    else if (o1.value() == "movsl" && !size)
+    {
+        // Count bytes instead of dwords; ecx ends up as zero either way.
+        for (auto i = 0; i < 2; ++i)
+        {
+            emit(mos6502_opcode::asl, get_register(ca::intel_386_register::ecx, 0));
+            emit(mos6502_opcode::rol, get_register(ca::intel_386_register::ecx, 1));
+        }
+        emit_indirect_block(true, size);
+    }
+    else
+    {
+        throw std::runtime_error("Cannot translate rep instruction");
+    }
+}
+
+// Copies or fills a block at an address known at compile time, like a screen or sprite buffer. When filling, the
+// source operand is empty and A holds the value.
+void mos6502_target::emit_absolute_block(const ca::instruction_operand &destination,
+                                         const ca::instruction_operand &source, const int size, const bool backwards)
+{
+    if (instruction_set_ == instruction_set::wdc65816 && size > internal::max_unrolled_block_size)
+    {
+        const auto address = [this](const ca::instruction_operand &pointer, const int offset) {
+            if (is_numeric_literal(pointer))
+                return internal::create_16bit_immediate(parse_literal(pointer) + offset);
+            return ca::instruction_operand(ca::operand_type::literal,
+                                           "#" + get_pointer_target(pointer, offset).value());
+        };
+
+        // A fill stores the first byte, and then moves every byte one up
+        if (source.is_empty())
+            emit(mos6502_opcode::sta, get_pointer_target(destination, 0));
+
+        const auto first = source.is_empty() ? 1 : 0;
+        const auto last = backwards ? size - 1 : 0;
+        emit(mos6502_opcode::rep, internal::create_register_width_bits());
+        emit(mos6502_opcode::lda, internal::create_16bit_immediate(size - 1 - first));
+        emit(mos6502_opcode::ldx, source.is_empty() ? address(destination, 0) : address(source, last));
+        emit(mos6502_opcode::ldy, address(destination, first + last));
+        emit(backwards ? mos6502_opcode::mvp : mos6502_opcode::mvn, internal::create_block_move_banks());
+        emit(mos6502_opcode::sep, internal::create_register_width_bits());
+        return;
+    }
+
+    // The HuC6280 transfers a block with tii, or with tdd from the last byte down. A fill stores the first byte, and
+    // then moves every byte one up.
+    if (instruction_set_ == instruction_set::huc6280 && size > internal::max_unrolled_block_size)
+    {
+        if (source.is_empty())
+            emit(mos6502_opcode::sta, get_pointer_target(destination, 0));
+
+        const auto first = source.is_empty() ? 1 : 0;
+        const auto last = backwards ? size - 1 : 0;
+        const auto &from = source.is_empty() ? destination : source;
+        const auto to = get_pointer_target(destination, first + last);
+        emit(backwards ? mos6502_opcode::tdd : mos6502_opcode::tii,
+             internal::create_block_transfer(get_pointer_target(from, last), to, size - first));
+        return;
+    }
+
+    const auto transfer = [&](const int offset, const std::string &index) {
+        if (!source.is_empty())
+            emit(mos6502_opcode::lda, get_pointer_target(source, offset, index));
+        emit(mos6502_opcode::sta, get_pointer_target(destination, offset, index));
+    };
+
+    if (size <= internal::max_unrolled_block_size)
+    {
+        for (auto offset = 0; offset < size; ++offset)
+            transfer(offset, "");
+        return;
+    }
+
+    const auto pages = size / 256;
+    const auto rest = size % 256;
+
+    if (pages > 0)
+    {
+        // Y runs through 0, 255, ..., 1, so a single dey/bne closes the loop over all pages at once.
+        const auto loop = create_local_label();
+        emit(mos6502_opcode::ldy, ca::instruction_operand(ca::operand_type::literal, "#0"));
+        emit(ca::asm_line::line_type::label, loop);
+        for (auto page = 0; page < pages; ++page)
+            transfer(page * 256, ",y");
+        emit(mos6502_opcode::dey);
+        emit(mos6502_opcode::bne, ca::instruction_operand(ca::operand_type::literal, loop));
+    }
+
+    if (rest > 0)
+    {
+        // Y runs from the size down to 1, so the addresses are based one byte lower.
+        const auto loop = create_local_label();
+        emit(mos6502_opcode::ldy, create_8bit_literal(rest));
+        emit(ca::asm_line::line_type::label, loop);
+        transfer(pages * 256 - 1, ",y");
+        emit(mos6502_opcode::dey);
+        emit(mos6502_opcode::bne, ca::instruction_operand(ca::operand_type::literal, loop));
+    }
+}
+
+// Copies from (esi) to (edi) or fills (edi) with A, the way rep movsb and rep stosb do. Without a known size the count
+// is taken from ecx. Afterwards the pointers have moved past the block and ecx is zero, like on x86; the dead code
+// pass removes these updates when nothing reads them.
+void mos6502_target::emit_indirect_block(const bool copy, const std::optional<int> size)
+{
+    const auto destination = get_register(ca::intel_386_register::di).value();
+    const auto source = get_register(ca::intel_386_register::si).value();
+    const auto count = get_register(ca::intel_386_register::cl);
+
+    // The 65816 moves the block with mvn, which leaves X and Y past its end, just like the pointers should be. A fill
+    // stores the first byte, and then moves every byte one up. Fills of an unknown size keep the loops below.
+    if (instruction_set_ == instruction_set::wdc65816 && (!size || *size > internal::max_unrolled_block_size) &&
+        (copy || size))
+    {
+        const auto done = create_local_label();
+        if (!copy)
+            emit(mos6502_opcode::sta, ca::instruction_operand(ca::operand_type::literal, "(" + destination + ")"));
+
+        emit(mos6502_opcode::rep, internal::create_register_width_bits());
+        if (!size)
+        {
+            emit(mos6502_opcode::lda, count);
+            emit(mos6502_opcode::beq, ca::instruction_operand(ca::operand_type::literal, done));
+            emit(mos6502_opcode::dec);
+        }
+        else
+        {
+            emit(mos6502_opcode::lda, internal::create_16bit_immediate(*size - (copy ? 1 : 2)));
+        }
+
+        emit(mos6502_opcode::ldx, get_register(copy ? ca::intel_386_register::si : ca::intel_386_register::di));
+        emit(mos6502_opcode::ldy, get_register(ca::intel_386_register::di));
+        if (!copy)
+            emit(mos6502_opcode::iny);
+        emit(mos6502_opcode::mvn, internal::create_block_move_banks());
+        if (copy)
+            emit(mos6502_opcode::stx, get_register(ca::intel_386_register::si));
+        emit(mos6502_opcode::sty, get_register(ca::intel_386_register::di));
+        emit(mos6502_opcode::stz, count);
+        if (!size)
+            emit(ca::asm_line::line_type::label, done);
+        emit(mos6502_opcode::sep, internal::create_register_width_bits());
+        return;
+    }
+
+    if (instruction_set_ == instruction_set::huc6280 && (!size || *size > internal::max_unrolled_block_size) &&
+        (copy || size))
+    {
+        emit_block_transfer_stub(copy, size);
+        return;
+    }
+
+    const auto transfer = [&]() {
+        if (copy)
+            emit(mos6502_opcode::lda, ca::instruction_operand(ca::operand_type::literal, "(" + source + "),y"));
+        emit(mos6502_opcode::sta, ca::instruction_operand(ca::operand_type::literal, "(" + destination + "),y"));
+    };
+
+    // The number of bytes that have not been added to the high byte of the pointers yet.
+    auto remainder = size ? create_8bit_literal(*size) : count;
+
+    if (size && *size <= internal::max_unrolled_block_size)
+    {
+        // Y runs from the last byte down to 0
+        for (auto offset = *size - 1; offset >= 0; --offset)
+        {
+            if (offset == *size - 1)
+            {
+                emit(mos6502_opcode::ldy, create_8bit_literal(offset));
+            }
+            else
+            {
+                emit(mos6502_opcode::dey);
+            }
+            transfer();
+        }
+    }
+    else
+    {
+        const auto pages_done = create_local_label();
+
+        if (!size || *size >= 256)
+        {
+            const auto loop = create_local_label();
+
+            if (size)
+            {
+                emit(mos6502_opcode::ldx, create_8bit_literal(*size >> 8));
+            }
+            else
+            {
+                emit(mos6502_opcode::ldx, get_register(ca::intel_386_register::ecx, 1));
+                emit(mos6502_opcode::beq, ca::instruction_operand(ca::operand_type::literal, pages_done));
+            }
+
+            // Y runs through 0, 255, ..., 1 for each page
+            emit(mos6502_opcode::ldy, ca::instruction_operand(ca::operand_type::literal, "#0"));
+            emit(ca::asm_line::line_type::label, loop);
+            transfer();
+            emit(mos6502_opcode::dey);
+            emit(mos6502_opcode::bne, ca::instruction_operand(ca::operand_type::literal, loop));
+            if (copy)
+                emit(mos6502_opcode::inc, get_register(ca::intel_386_register::si, 1));
+            emit(mos6502_opcode::inc, get_register(ca::intel_386_register::di, 1));
+            emit(mos6502_opcode::dex);
+            emit(mos6502_opcode::bne, ca::instruction_operand(ca::operand_type::literal, loop));
+            if (!size)
+                emit(ca::asm_line::line_type::label, pages_done);
+
+            if (size)
+                remainder = create_8bit_literal(*size & 0xff);
+        }
+
+        if (!size || (*size & 0xff) != 0)
+        {
+            // Y runs from the remaining count down to 0
+            const auto loop = create_local_label();
+            const auto done = create_local_label();
+
+            emit(mos6502_opcode::ldy, remainder);
+            if (!size)
+                emit(mos6502_opcode::beq, ca::instruction_operand(ca::operand_type::literal, done));
+            emit(ca::asm_line::line_type::label, loop);
+            emit(mos6502_opcode::dey);
+            transfer();
+            emit(mos6502_opcode::cpy, ca::instruction_operand(ca::operand_type::literal, "#0"));
+            emit(mos6502_opcode::bne, ca::instruction_operand(ca::operand_type::literal, loop));
+            if (!size)
+                emit(ca::asm_line::line_type::label, done);
+        }
+    }
+
+    for (const auto pointer : {ca::intel_386_register::di, ca::intel_386_register::si})
+    {
+        if (pointer == ca::intel_386_register::si && !copy)
+            continue;
+
+        const auto done = create_local_label();
+        emit(mos6502_opcode::clc);
+        emit(mos6502_opcode::lda, get_register(pointer, 0));
+        emit(mos6502_opcode::adc, remainder);
+        emit(mos6502_opcode::sta, get_register(pointer, 0));
+        emit(mos6502_opcode::bcc, ca::instruction_operand(ca::operand_type::literal, done));
+        emit(mos6502_opcode::inc, get_register(pointer, 1));
+        emit(ca::asm_line::line_type::label, done);
+    }
+
+    emit(mos6502_opcode::lda, ca::instruction_operand(ca::operand_type::literal, "#0"));
+    emit(mos6502_opcode::sta, get_register(ca::intel_386_register::ecx, 0));
+    emit(mos6502_opcode::sta, get_register(ca::intel_386_register::ecx, 1));
+}
+
+// Does what emit_indirect_block does with a HuC6280 block transfer. Its addresses and length are operands, so it is
+// written to RAM together with an rts and called there. A fill stores the first byte, and then moves every byte one
+// up.
+void mos6502_target::emit_block_transfer_stub(const bool copy, const std::optional<int> size)
+{
+    using reg = ca::intel_386_register;
+
+    const auto stub = [](const int offset) {
+        return ca::instruction_operand(ca::operand_type::literal, std::to_string(transfer_stub_address_ + offset));
+    };
+    const auto store = [&](const ca::instruction_operand &value, const int offset) {
+        emit(mos6502_opcode::lda, value);
+        emit(mos6502_opcode::sta, stub(offset));
+    };
+
+    // A length of 0 would transfer 64K
+    const auto done = create_local_label();
+    if (!size)
+    {
+        emit(mos6502_opcode::lda, get_register(reg::ecx, 0));
+        emit(mos6502_opcode::ORA, get_register(reg::ecx, 1));
+        emit(mos6502_opcode::beq, ca::instruction_operand(ca::operand_type::literal, done));
+    }
+    else if (!copy)
+    {
+        emit(mos6502_opcode::sta, ca::instruction_operand(ca::operand_type::literal,
+                                                          "(" + get_register(reg::di).value() + ")"));
+    }
+
+    const auto length = [&](const int offset) {
+        return size ? create_8bit_literal(offset == 0 ? get_16bit_lsb(*size - (copy ? 0 : 1))
+                                                      : get_16bit_msb(*size - (copy ? 0 : 1)))
+                    : get_register(reg::ecx, offset);
+    };
+
+    store(create_8bit_literal(internal::tii_opcode), 0);
+    for (auto offset = 0; offset < 2; ++offset)
+    {
+        store(get_register(copy ? reg::si : reg::di, offset), 1 + offset);
+        store(length(offset), 5 + offset);
+    }
+
+    if (copy)
+    {
+        for (auto offset = 0; offset < 2; ++offset)
+            store(get_register(reg::di, offset), 3 + offset);
+    }
+    else
+    {
+        emit(mos6502_opcode::clc);
+        for (auto offset = 0; offset < 2; ++offset)
+        {
+            emit(mos6502_opcode::lda, get_register(reg::di, offset));
+            emit(mos6502_opcode::adc, create_8bit_literal(offset == 0 ? 1 : 0));
+            emit(mos6502_opcode::sta, stub(3 + offset));
+        }
+    }
+
+    store(create_8bit_literal(internal::rts_opcode), transfer_stub_size_ - 1);
+    emit(mos6502_opcode::jsr, stub(0));
+
+    // Afterwards the pointers have moved past the block and ecx is zero, like on x86
+    for (const auto pointer : {reg::di, reg::si})
+    {
+        if (pointer == reg::si && !copy)
+            continue;
+
+        emit(mos6502_opcode::clc);
+        for (auto offset = 0; offset < 2; ++offset)
+        {
+            emit(mos6502_opcode::lda, get_register(pointer, offset));
+            emit(mos6502_opcode::adc, size ? create_8bit_literal(offset == 0 ? get_16bit_lsb(*size)
+                                                                            : get_16bit_msb(*size))
+                                           : get_register(reg::ecx, offset));
+            emit(mos6502_opcode::sta, get_register(pointer, offset));
+        }
+    }
+
+    emit(mos6502_opcode::stz, get_register(reg::ecx, 0));
+    emit(mos6502_opcode::stz, get_register(reg::ecx, 1));
+    if (!size)
+        emit(ca::asm_line::line_type::label, done);
+}
+
+// Replaces calls to memcpy and memset on buffers at known addresses with inline code, and on the 65816 and HuC6280
+// also memmove.
+// Returns false if the call has to go to the library instead.
+auto mos6502_target::inline_library_call(const std::string &function) -> bool
+{
+    auto name = function.substr(0, function.find('@'));
+    if (!name.empty() && name[0] == '_')
+        name.erase(0, 1);
+
+    // Only the block moves of the 65816 and HuC6280 can copy between overlapping buffers
+    const auto move = name == "memmove" && (instruction_set_ == instruction_set::wdc65816 ||
+                                            instruction_set_ == instruction_set::huc6280);
+    if ((name != "memcpy" && name != "memset" && !move) || pushed_arguments_.size() < 3)
+        return false;
+
+    // cdecl pushes the arguments from right to left; they must be pushed right before the call.
+    const auto arguments = std::prev(std::end(pushed_arguments_), 3);
+    for (auto argument = arguments; argument != std::end(pushed_arguments_); ++argument)
+    {
+        const auto next = std::next(argument);
+        const auto end = (next == std::end(pushed_arguments_)) ? instructions_.size() : next->first_instruction;
+        if (argument->end_instruction != end)
+            return false;
+    }
+
+    const auto &size = arguments[0].operand;
+    const auto &source = arguments[1].operand;
+    const auto &destination = arguments[2].operand;
+
+    if (!is_immediate(destination) || !size.is_literal() || !is_numeric_literal(size))
+        return false;
+
+    const auto bytes = parse_literal(size);
+    if (bytes < 0 || bytes > 0xffff)
+        return false;
+
+    const auto copy = name != "memset";
+    if (copy && !is_immediate(source))
+        return false;
+
+    // Copying downwards from the last byte with mvp or tdd is safe where the destination overlaps the end of the
+    // source. Without known addresses that can't be decided.
+    if (move && (bytes <= internal::max_unrolled_block_size || !is_numeric_literal(source) ||
+                 !is_numeric_literal(destination)))
+    {
+        return false;
+    }
+    const auto backwards = move && parse_literal(destination) > parse_literal(source);
+
+    const auto fill_value = source.is_register() ? get_register(source.reg()) : get_operand_byte(source, 0);
+
+    instructions_.erase(std::next(std::begin(instructions_), static_cast<std::ptrdiff_t>(arguments->first_instruction)),
+                        std::end(instructions_));
+    inlined_argument_bytes_ += 3 * internal::argument_size;
+
+    if (copy)
+    {
+        emit_absolute_block(destination, source, bytes, backwards);
+    }
+    else
+    {
+        emit(mos6502_opcode::lda, fill_value);
+        emit_absolute_block(destination, ca::instruction_operand(), bytes, false);
+    }
+
+    // All of them return the destination
+    emit(mos6502_opcode::lda, get_operand_byte(destination, 0));
+    emit(mos6502_opcode::sta, get_register(ca::intel_386_register::eax, 0));
+    emit(mos6502_opcode::lda, get_operand_byte(destination, 1));
+    emit(mos6502_opcode::sta, get_register(ca::intel_386_register::eax, 1));
+
+    return true;
 }
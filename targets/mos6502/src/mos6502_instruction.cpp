@@ -11,27 +11,67 @@ static auto is_branch(const mos6502_opcode o) -> bool
 {
     switch (o)
     {
+        case mos6502_opcode::bra:
         case mos6502_opcode::beq:
         case mos6502_opcode::bne:
         case mos6502_opcode::bmi:
+        case mos6502_opcode::bcc:
+        case mos6502_opcode::bcs:
+        case mos6502_opcode::bpl:
+        case mos6502_opcode::bvc:
+        case mos6502_opcode::bvs:
             return true;
+        case mos6502_opcode::stz:
+        case mos6502_opcode::phx:
+        case mos6502_opcode::phy:
+        case mos6502_opcode::plx:
+        case mos6502_opcode::ply:
+        case mos6502_opcode::trb:
+        case mos6502_opcode::tsb:
+        case mos6502_opcode::rep:
+        case mos6502_opcode::sep:
+        case mos6502_opcode::mvn:
+        case mos6502_opcode::mvp:
+        case mos6502_opcode::pea:
+        case mos6502_opcode::tii:
+        case mos6502_opcode::tdd:
+        case mos6502_opcode::st0:
+        case mos6502_opcode::st1:
+        case mos6502_opcode::st2:
+        case mos6502_opcode::lax:
+        case mos6502_opcode::sax:
+        case mos6502_opcode::dcp:
+        case mos6502_opcode::isc:
+        case mos6502_opcode::anc:
+        case mos6502_opcode::alr:
         case mos6502_opcode::lda:
+        case mos6502_opcode::ldx:
         case mos6502_opcode::ldy:
+        case mos6502_opcode::tax:
         case mos6502_opcode::tay:
+        case mos6502_opcode::txa:
         case mos6502_opcode::tya:
         case mos6502_opcode::cpy:
+        case mos6502_opcode::cpx:
         case mos6502_opcode::eor:
         case mos6502_opcode::sta:
+        case mos6502_opcode::stx:
         case mos6502_opcode::sty:
         case mos6502_opcode::pha:
         case mos6502_opcode::pla:
         case mos6502_opcode::php:
         case mos6502_opcode::plp:
+        case mos6502_opcode::asl:
         case mos6502_opcode::lsr:
+        case mos6502_opcode::rol:
         case mos6502_opcode::ror:
         case mos6502_opcode::AND:
         case mos6502_opcode::inc:
         case mos6502_opcode::dec:
+        case mos6502_opcode::dex:
+        case mos6502_opcode::dey:
+        case mos6502_opcode::inx:
+        case mos6502_opcode::iny:
         case mos6502_opcode::ORA:
         case mos6502_opcode::cmp:
         case mos6502_opcode::jmp:
@@ -55,30 +95,70 @@ static auto is_comparison(const mos6502_opcode o) -> bool
 {
     switch (o)
     {
+        case mos6502_opcode::dcp:
         case mos6502_opcode::cmp:
         case mos6502_opcode::cpy:
+        case mos6502_opcode::cpx:
         case mos6502_opcode::bit:
             return true;
+        case mos6502_opcode::stz:
+        case mos6502_opcode::bra:
+        case mos6502_opcode::phx:
+        case mos6502_opcode::phy:
+        case mos6502_opcode::plx:
+        case mos6502_opcode::ply:
+        case mos6502_opcode::trb:
+        case mos6502_opcode::tsb:
+        case mos6502_opcode::rep:
+        case mos6502_opcode::sep:
+        case mos6502_opcode::mvn:
+        case mos6502_opcode::mvp:
+        case mos6502_opcode::pea:
+        case mos6502_opcode::tii:
+        case mos6502_opcode::tdd:
+        case mos6502_opcode::st0:
+        case mos6502_opcode::st1:
+        case mos6502_opcode::st2:
+        case mos6502_opcode::lax:
+        case mos6502_opcode::sax:
+        case mos6502_opcode::isc:
+        case mos6502_opcode::anc:
+        case mos6502_opcode::alr:
         case mos6502_opcode::lda:
+        case mos6502_opcode::ldx:
         case mos6502_opcode::ldy:
+        case mos6502_opcode::tax:
         case mos6502_opcode::tay:
+        case mos6502_opcode::txa:
         case mos6502_opcode::tya:
         case mos6502_opcode::eor:
         case mos6502_opcode::sta:
+        case mos6502_opcode::stx:
         case mos6502_opcode::sty:
         case mos6502_opcode::pha:
         case mos6502_opcode::pla:
         case mos6502_opcode::php:
         case mos6502_opcode::plp:
+        case mos6502_opcode::asl:
         case mos6502_opcode::lsr:
+        case mos6502_opcode::rol:
         case mos6502_opcode::ror:
         case mos6502_opcode::AND:
         case mos6502_opcode::inc:
         case mos6502_opcode::dec:
+        case mos6502_opcode::dex:
+        case mos6502_opcode::dey:
+        case mos6502_opcode::inx:
+        case mos6502_opcode::iny:
         case mos6502_opcode::ORA:
         case mos6502_opcode::jmp:
         case mos6502_opcode::bne:
         case mos6502_opcode::bmi:
+        case mos6502_opcode::bcc:
+        case mos6502_opcode::bcs:
+        case mos6502_opcode::bpl:
+        case mos6502_opcode::bvc:
+        case mos6502_opcode::bvs:
         case mos6502_opcode::beq:
         case mos6502_opcode::adc:
         case mos6502_opcode::sbc:
@@ -95,13 +175,198 @@ static auto is_comparison(const mos6502_opcode o) -> bool
     return false;
 }
 
+static auto get_flags_read(const mos6502_opcode o) -> std::uint8_t
+{
+    switch (o)
+    {
+        case mos6502_opcode::bne:
+        case mos6502_opcode::beq:
+            return mos6502_flags::zero;
+        case mos6502_opcode::bmi:
+        case mos6502_opcode::bpl:
+            return mos6502_flags::negative;
+        case mos6502_opcode::bvc:
+        case mos6502_opcode::bvs:
+            return mos6502_flags::overflow;
+        case mos6502_opcode::isc:
+        case mos6502_opcode::bcc:
+        case mos6502_opcode::bcs:
+        case mos6502_opcode::rol:
+        case mos6502_opcode::ror:
+        case mos6502_opcode::adc:
+        case mos6502_opcode::sbc:
+            return mos6502_flags::carry;
+        case mos6502_opcode::php:
+            return mos6502_flags::all;
+        case mos6502_opcode::stz:
+        case mos6502_opcode::bra:
+        case mos6502_opcode::phx:
+        case mos6502_opcode::phy:
+        case mos6502_opcode::plx:
+        case mos6502_opcode::ply:
+        case mos6502_opcode::trb:
+        case mos6502_opcode::tsb:
+        case mos6502_opcode::rep:
+        case mos6502_opcode::sep:
+        case mos6502_opcode::mvn:
+        case mos6502_opcode::mvp:
+        case mos6502_opcode::pea:
+        case mos6502_opcode::tii:
+        case mos6502_opcode::tdd:
+        case mos6502_opcode::st0:
+        case mos6502_opcode::st1:
+        case mos6502_opcode::st2:
+        case mos6502_opcode::lax:
+        case mos6502_opcode::sax:
+        case mos6502_opcode::dcp:
+        case mos6502_opcode::anc:
+        case mos6502_opcode::alr:
+        case mos6502_opcode::lda:
+        case mos6502_opcode::ldx:
+        case mos6502_opcode::ldy:
+        case mos6502_opcode::tax:
+        case mos6502_opcode::tay:
+        case mos6502_opcode::txa:
+        case mos6502_opcode::tya:
+        case mos6502_opcode::cpy:
+        case mos6502_opcode::cpx:
+        case mos6502_opcode::eor:
+        case mos6502_opcode::sta:
+        case mos6502_opcode::stx:
+        case mos6502_opcode::sty:
+        case mos6502_opcode::pha:
+        case mos6502_opcode::pla:
+        case mos6502_opcode::plp:
+        case mos6502_opcode::asl:
+        case mos6502_opcode::lsr:
+        case mos6502_opcode::AND:
+        case mos6502_opcode::inc:
+        case mos6502_opcode::dec:
+        case mos6502_opcode::dex:
+        case mos6502_opcode::dey:
+        case mos6502_opcode::inx:
+        case mos6502_opcode::iny:
+        case mos6502_opcode::ORA:
+        case mos6502_opcode::cmp:
+        case mos6502_opcode::jmp:
+        case mos6502_opcode::rts:
+        case mos6502_opcode::rti:
+        case mos6502_opcode::clc:
+        case mos6502_opcode::sec:
+        case mos6502_opcode::bit:
+        case mos6502_opcode::jsr:
+        case mos6502_opcode::unknown:
+            return 0;
+    }
+
+    assert(false && "Missing opcode in mos6502::get_flags_read");
+    return 0;
+}
+
+static auto get_flags_written(const mos6502_opcode o) -> std::uint8_t
+{
+    switch (o)
+    {
+        case mos6502_opcode::plx:
+        case mos6502_opcode::ply:
+        case mos6502_opcode::lax:
+        case mos6502_opcode::lda:
+        case mos6502_opcode::ldx:
+        case mos6502_opcode::ldy:
+        case mos6502_opcode::tax:
+        case mos6502_opcode::tay:
+        case mos6502_opcode::txa:
+        case mos6502_opcode::tya:
+        case mos6502_opcode::eor:
+        case mos6502_opcode::pla:
+        case mos6502_opcode::AND:
+        case mos6502_opcode::inc:
+        case mos6502_opcode::dec:
+        case mos6502_opcode::dex:
+        case mos6502_opcode::dey:
+        case mos6502_opcode::inx:
+        case mos6502_opcode::iny:
+        case mos6502_opcode::ORA:
+            return mos6502_flags::negative | mos6502_flags::zero;
+        case mos6502_opcode::dcp:
+        case mos6502_opcode::anc:
+        case mos6502_opcode::alr:
+        case mos6502_opcode::cpy:
+        case mos6502_opcode::cpx:
+        case mos6502_opcode::cmp:
+        case mos6502_opcode::asl:
+        case mos6502_opcode::lsr:
+        case mos6502_opcode::rol:
+        case mos6502_opcode::ror:
+            return mos6502_flags::negative | mos6502_flags::zero | mos6502_flags::carry;
+        case mos6502_opcode::bit:
+            return mos6502_flags::negative | mos6502_flags::zero | mos6502_flags::overflow;
+        case mos6502_opcode::isc:
+        case mos6502_opcode::adc:
+        case mos6502_opcode::sbc:
+        case mos6502_opcode::plp:
+        case mos6502_opcode::rti:
+            return mos6502_flags::all;
+        case mos6502_opcode::trb:
+        case mos6502_opcode::tsb:
+            return mos6502_flags::zero;
+        case mos6502_opcode::clc:
+        case mos6502_opcode::sec:
+            return mos6502_flags::carry;
+        case mos6502_opcode::stz:
+        case mos6502_opcode::bra:
+        case mos6502_opcode::phx:
+        case mos6502_opcode::phy:
+        case mos6502_opcode::rep:
+        case mos6502_opcode::sep:
+        case mos6502_opcode::mvn:
+        case mos6502_opcode::mvp:
+        case mos6502_opcode::pea:
+        case mos6502_opcode::tii:
+        case mos6502_opcode::tdd:
+        case mos6502_opcode::st0:
+        case mos6502_opcode::st1:
+        case mos6502_opcode::st2:
+        case mos6502_opcode::sax:
+        case mos6502_opcode::sta:
+        case mos6502_opcode::stx:
+        case mos6502_opcode::sty:
+        case mos6502_opcode::pha:
+        case mos6502_opcode::php:
+        case mos6502_opcode::bne:
+        case mos6502_opcode::beq:
+        case mos6502_opcode::bmi:
+        case mos6502_opcode::bcc:
+        case mos6502_opcode::bcs:
+        case mos6502_opcode::bpl:
+        case mos6502_opcode::bvc:
+        case mos6502_opcode::bvs:
+        case mos6502_opcode::jmp:
+        case mos6502_opcode::rts:
+        case mos6502_opcode::jsr:
+        case mos6502_opcode::unknown:
+            return 0;
+    }
+
+    assert(false && "Missing opcode in mos6502::get_flags_written");
+    return 0;
+}
+
 } // namespace internal
 
+auto source_line::text() const noexcept -> const std::string &
+{
+    static const std::string empty;
+    return text_ ? *text_ : empty;
+}
+
 mos6502::mos6502(const mos6502_opcode o)
-    : asm_line{line_type::instruction, to_string(o)}
+    : asm_line{line_type::instruction, {}}
     , opcode_{o}
     , is_branch_{internal::is_branch(o)}
     , is_comparison_{internal::is_comparison(o)}
+    , flags_read_{internal::get_flags_read(o)}
+    , flags_written_{internal::get_flags_written(o)}
 {
 }
 
@@ -112,11 +377,13 @@ mos6502::mos6502(const line_type t, std::string s)
 }
 
 mos6502::mos6502(const mos6502_opcode o, ca::instruction_operand t_o)
-    : asm_line{line_type::instruction, to_string(o)}
+    : asm_line{line_type::instruction, {}}
     , opcode_{o}
     , operand_{std::move(t_o)}
     , is_branch_{internal::is_branch(o)}
     , is_comparison_{internal::is_comparison(o)}
+    , flags_read_{internal::get_flags_read(o)}
+    , flags_written_{internal::get_flags_written(o)}
 {
 }
 
@@ -126,18 +393,28 @@ auto mos6502::to_string(const mos6502_opcode o) -> std::string
     {
         case mos6502_opcode::lda:
             return "lda";
+        case mos6502_opcode::ldx:
+            return "ldx";
         case mos6502_opcode::ldy:
             return "ldy";
+        case mos6502_opcode::tax:
+            return "tax";
         case mos6502_opcode::tay:
             return "tay";
+        case mos6502_opcode::txa:
+            return "txa";
         case mos6502_opcode::tya:
             return "tya";
         case mos6502_opcode::cpy:
             return "cpy";
+        case mos6502_opcode::cpx:
+            return "cpx";
         case mos6502_opcode::eor:
             return "eor";
         case mos6502_opcode::sta:
             return "sta";
+        case mos6502_opcode::stx:
+            return "stx";
         case mos6502_opcode::sty:
             return "sty";
         case mos6502_opcode::pha:
@@ -148,8 +425,12 @@ auto mos6502::to_string(const mos6502_opcode o) -> std::string
             return "php";
         case mos6502_opcode::plp:
             return "plp";
+        case mos6502_opcode::asl:
+            return "asl";
         case mos6502_opcode::lsr:
             return "lsr";
+        case mos6502_opcode::rol:
+            return "rol";
         case mos6502_opcode::ror:
             return "ror";
         case mos6502_opcode::AND:
@@ -158,6 +439,14 @@ auto mos6502::to_string(const mos6502_opcode o) -> std::string
             return "inc";
         case mos6502_opcode::dec:
             return "dec";
+        case mos6502_opcode::dex:
+            return "dex";
+        case mos6502_opcode::dey:
+            return "dey";
+        case mos6502_opcode::inx:
+            return "inx";
+        case mos6502_opcode::iny:
+            return "iny";
         case mos6502_opcode::ORA:
             return "ora";
         case mos6502_opcode::cmp:
@@ -166,6 +455,16 @@ auto mos6502::to_string(const mos6502_opcode o) -> std::string
             return "bne";
         case mos6502_opcode::bmi:
             return "bmi";
+        case mos6502_opcode::bcc:
+            return "bcc";
+        case mos6502_opcode::bcs:
+            return "bcs";
+        case mos6502_opcode::bpl:
+            return "bpl";
+        case mos6502_opcode::bvc:
+            return "bvc";
+        case mos6502_opcode::bvs:
+            return "bvs";
         case mos6502_opcode::beq:
             return "beq";
         case mos6502_opcode::jmp:
@@ -186,6 +485,54 @@ auto mos6502::to_string(const mos6502_opcode o) -> std::string
             return "bit";
         case mos6502_opcode::jsr:
             return "jsr";
+        case mos6502_opcode::stz:
+            return "stz";
+        case mos6502_opcode::bra:
+            return "bra";
+        case mos6502_opcode::phx:
+            return "phx";
+        case mos6502_opcode::phy:
+            return "phy";
+        case mos6502_opcode::plx:
+            return "plx";
+        case mos6502_opcode::ply:
+            return "ply";
+        case mos6502_opcode::trb:
+            return "trb";
+        case mos6502_opcode::tsb:
+            return "tsb";
+        case mos6502_opcode::rep:
+            return "rep";
+        case mos6502_opcode::sep:
+            return "sep";
+        case mos6502_opcode::mvn:
+            return "mvn";
+        case mos6502_opcode::mvp:
+            return "mvp";
+        case mos6502_opcode::pea:
+            return "pea";
+        case mos6502_opcode::tii:
+            return "tii";
+        case mos6502_opcode::tdd:
+            return "tdd";
+        case mos6502_opcode::st0:
+            return "st0";
+        case mos6502_opcode::st1:
+            return "st1";
+        case mos6502_opcode::st2:
+            return "st2";
+        case mos6502_opcode::lax:
+            return "lax";
+        case mos6502_opcode::sax:
+            return "sax";
+        case mos6502_opcode::dcp:
+            return "dcp";
+        case mos6502_opcode::isc:
+            return "isc";
+        case mos6502_opcode::anc:
+            return "anc";
+        case mos6502_opcode::alr:
+            return "alr";
         case mos6502_opcode::unknown:
             return "";
     }
@@ -204,9 +551,10 @@ auto mos6502::to_string() const -> std::string
         case asm_line::line_type::directive:
         case asm_line::line_type::instruction:
         {
-            const std::string line = "    " + text() + ' ' + operand_.value();
+            const auto &mnemonic = is_instruction() ? to_string(opcode_) : text();
+            const std::string line = "    " + mnemonic + ' ' + operand().value();
             return line + std::string(static_cast<size_t>(std::max(15 - static_cast<int>(line.size()), 1)), ' ') +
-                   "; " + comment_;
+                   "; " + comment_.text();
         }
         case asm_line::line_type::missing_opcode:
         {
@@ -1,6 +1,8 @@
 #include <mos6502/mos6502_target.h>
 #include "opcodes.h"
-#include <map>
+#include "pass_manager.h"
+#include "passes.h"
+#include <ca/ir.h>
 #include <iostream>
 
 namespace internal
@@ -71,34 +73,84 @@ static auto optimize(std::vector<mos6502> &instructions) -> bool
         }
     }
 
+    for (size_t op = 0; op < instructions.size() - 1; ++op)
+    {
+        // look for a branch or jump to the label that immediately follows it
+        if (instructions[op].is_branch() || instructions[op].opcode() == mos6502_opcode::jmp)
+        {
+            const auto next = next_instruction(op);
+            if (next < instructions.size() && instructions[next].is_label() &&
+                instructions[next].text() == instructions[op].operand().value())
+            {
+                instructions.erase(std::next(std::begin(instructions), op));
+                return true;
+            }
+        }
+    }
+
     return false;
 }
 
-static auto fix_long_branches(std::vector<mos6502> &instructions, int &branch_patch_count) -> bool
+// Returns the branch taken exactly when the given one is not, or unknown if there is no such instruction.
+static auto get_inverted_branch(const mos6502_opcode o) noexcept -> mos6502_opcode
 {
-    std::map<std::string, size_t> labels;
-    for (size_t op = 0; op < instructions.size(); ++op)
+    switch (o)
     {
-        if (instructions[op].is_label())
-        {
-            labels[instructions[op].text()] = op;
-        }
+        case mos6502_opcode::bne:
+            return mos6502_opcode::beq;
+        case mos6502_opcode::beq:
+            return mos6502_opcode::bne;
+        case mos6502_opcode::bcc:
+            return mos6502_opcode::bcs;
+        case mos6502_opcode::bcs:
+            return mos6502_opcode::bcc;
+        case mos6502_opcode::bmi:
+            return mos6502_opcode::bpl;
+        case mos6502_opcode::bpl:
+            return mos6502_opcode::bmi;
+        case mos6502_opcode::bvc:
+            return mos6502_opcode::bvs;
+        case mos6502_opcode::bvs:
+            return mos6502_opcode::bvc;
+        default:
+            return mos6502_opcode::unknown;
     }
+}
 
-    for (size_t op = 0; op < instructions.size(); ++op)
+static auto fix_long_branches(std::vector<mos6502> &instructions, const control_flow_graph &cfg,
+                              const std::optional<int> origin, int &branch_patch_count) -> bool
+{
+    // Branches reach from 128 bytes before to 127 bytes after the instruction that follows them. Only the last line
+    // of a block can be a branch.
+    const auto addresses = get_addresses(instructions, origin);
+    for (const auto &block : cfg.blocks)
     {
-        if (instructions[op].is_branch() &&
-            std::abs(static_cast<int>(labels[instructions[op].operand().value()]) - static_cast<int>(op)) * 3 > 255)
+        const auto op = block.end - 1;
+        if (!instructions[op].is_branch())
+            continue;
+
+        const auto target = cfg.labels.find(instructions[op].operand().value());
+        const auto distance =
+            target == std::end(cfg.labels) ? 0 : addresses[cfg.blocks[target->second].begin] - addresses[op + 1];
+        if (distance < -128 || distance > 127)
         {
             ++branch_patch_count;
             const auto going_to = instructions[op].operand().value();
             const auto new_pos = "patch_" + std::to_string(branch_patch_count);
             // uh-oh too long of a branch, have to convert this to a jump...
-            if (instructions[op].opcode() == mos6502_opcode::bne)
+            const auto inverted = get_inverted_branch(instructions[op].opcode());
+            if (instructions[op].opcode() == mos6502_opcode::bra)
+            {
+                // An unconditional branch simply becomes a jump again
+                const auto comment = instructions[op].comment();
+                instructions[op] = mos6502(mos6502_opcode::jmp, instructions[op].operand());
+                instructions[op].set_comment(comment);
+                return true;
+            }
+            else if (inverted != mos6502_opcode::unknown)
             {
                 const auto comment = instructions[op].comment();
-                instructions[op] =
-                    mos6502(mos6502_opcode::beq, ca::instruction_operand(ca::operand_type::literal, new_pos));
+                instructions[op] = mos6502(inverted, ca::instruction_operand(ca::operand_type::literal, new_pos));
                 instructions.insert(
                     std::next(std::begin(instructions), op + 1),
                     mos6502(mos6502_opcode::jmp, ca::instruction_operand(ca::operand_type::literal, going_to)));
@@ -130,8 +182,22 @@ static auto fix_overwritten_flags(std::vector<mos6502> &instructions) -> bool
     {
         if (instructions[op].is_comparison())
         {
+            // Branches emitted in the middle of a single x86 instruction (like a carry into the high byte) test
+            // the flags of that lowering, not the comparison. Control flow merges at a label, so stop there.
+            const auto is_internal_branch = [&instructions](const auto i) {
+                return instructions[i].is_branch() && instructions[i - 1].comment() == instructions[i].comment();
+            };
+
+            // An instruction that writes every flag of the comparison takes over as the source of the flags, like
+            // the subtraction that a signed jump turns a later comparison into.
+            const auto written = instructions[op].flags_written();
+            const auto replaces_flags = [&instructions, written](const auto i) {
+                return (instructions[i].flags_written() & written) == written;
+            };
+
             auto op2 = op + 1;
-            while (op2 < instructions.size() && !instructions[op2].is_comparison() && !instructions[op2].is_branch())
+            while (op2 < instructions.size() && !instructions[op2].is_comparison() && !instructions[op2].is_label() &&
+                   !replaces_flags(op2) && (!instructions[op2].is_branch() || is_internal_branch(op2)))
             {
                 ++op2;
             }
@@ -159,35 +225,209 @@ static auto fix_overwritten_flags(std::vector<mos6502> &instructions) -> bool
     return false;
 }
 
+// The passes finalize runs, in the groups it runs them in
+struct pipeline
+{
+    std::vector<pass> ir_passes;
+    pass fix_overwritten_flags;
+    std::vector<pass> optimizations;
+    pass use_branch_always;
+    pass use_16bit_accumulator;
+    pass fix_long_branches;
+    pass align_to_pages;
+
+    auto get_passes() const -> std::vector<const pass *>
+    {
+        std::vector<const pass *> passes;
+        for (const auto &p : ir_passes)
+            passes.push_back(&p);
+        passes.push_back(&fix_overwritten_flags);
+        for (const auto &p : optimizations)
+            passes.push_back(&p);
+        passes.insert(std::end(passes),
+                      {&use_branch_always, &use_16bit_accumulator, &fix_long_branches, &align_to_pages});
+        return passes;
+    }
+};
+
+static auto create_pipeline(const instruction_set instructions, const std::optional<int> origin,
+                            int &branch_patch_count) -> pipeline
+{
+    using level = optimization_level;
+
+    const auto is_65c02 = instructions == instruction_set::wdc65c02 || instructions == instruction_set::wdc65816 ||
+                          instructions == instruction_set::huc6280;
+    const auto is_65816 = instructions == instruction_set::wdc65816;
+    const auto is_undocumented = instructions == instruction_set::nmos6502_undocumented;
+    const auto uses_liveness = std::vector<analysis>{analysis::liveness};
+
+    pipeline p;
+
+    // ca::ir::optimize runs these on the x86 code before it is translated
+    for (const auto &name : ca::ir::get_pass_names())
+        p.ir_passes.push_back({name, level::basic, false, true, {}, {}});
+
+    p.fix_overwritten_flags = {"fix-overwritten-flags", level::none, false, true, {},
+                               [](auto &i, auto &) { return fix_overwritten_flags(i); }};
+
+    p.optimizations = {
+        {"optimize", level::basic, false, true, {}, [](auto &i, auto &) { return optimize(i); }},
+        {"eliminate-redundant-loads", level::basic, false, true, {},
+         [](auto &i, auto &) { return eliminate_redundant_loads(i); }},
+        {"eliminate-dead-code", level::basic, false, true, uses_liveness,
+         [](auto &i, auto &a) { return eliminate_dead_code(i, a.get_liveness()); }},
+        {"use-read-modify-write", level::basic, false, true, uses_liveness,
+         [](auto &i, auto &a) { return use_read_modify_write(i, a.get_liveness()); }},
+        {"optimize-control-flow", level::basic, false, true, {},
+         [](auto &i, auto &) { return optimize_control_flow(i); }},
+        {"inline-leaf-functions", level::speed, true, true, {},
+         [](auto &i, auto &) { return inline_leaf_functions(i); }},
+        {"use-index-register-counters", level::speed, false, true, {analysis::liveness, analysis::loops},
+         [](auto &i, auto &a) { return use_index_register_counters(i, a.get_liveness(), a.get_loops()); }},
+        {"apply-peephole-rules", level::basic, false, true, uses_liveness,
+         [](auto &i, auto &a) { return apply_peephole_rules(i, a.get_liveness()); }},
+        {"use-65c02-instructions", level::basic, false, is_65c02, uses_liveness,
+         [](auto &i, auto &a) { return use_65c02_instructions(i, a.get_liveness()); }},
+        {"use-undocumented-opcodes", level::basic, false, is_undocumented, uses_liveness,
+         [](auto &i, auto &a) { return use_undocumented_opcodes(i, a.get_liveness()); }},
+    };
+
+    p.use_branch_always = {"use-branch-always", level::basic, false, is_65c02, {},
+                           [](auto &i, auto &) { return internal::use_branch_always(i); }};
+
+    // Once nothing else changes, so that the other passes don't have to tell 8-bit and 16-bit code apart
+    p.use_16bit_accumulator = {"use-16-bit-accumulator", level::basic, false, is_65816, uses_liveness,
+                               [](auto &i, auto &a) { return use_16bit_accumulator(i, a.get_liveness()); }};
+    p.fix_long_branches = {"fix-long-branches", level::none, false, true, {analysis::control_flow},
+                           [origin, &branch_patch_count](auto &i, auto &a) {
+                               return fix_long_branches(i, a.get_control_flow_graph(), origin, branch_patch_count);
+                           }};
+
+    // Padding moves branches further from their targets
+    p.align_to_pages = {"align-to-pages", level::speed, true, origin.has_value(), {}, [origin](auto &i, auto &) {
+                            return internal::align_to_pages(i, origin.value_or(0));
+                        }};
+
+    return p;
+}
+
 } // namespace internal
 
+mos6502_target::mos6502_target(const calling_convention convention, const instruction_set instructions,
+                               const std::optional<int> origin, optimization_options options)
+    : calling_convention_{convention}
+    , instruction_set_{instructions}
+    , origin_{origin}
+    , optimization_options_{std::move(options)}
+{
+    int branch_patch_count = 0;
+    const auto pipeline = internal::create_pipeline(instruction_set_, origin_, branch_patch_count);
+    internal::validate_options(optimization_options_, pipeline.get_passes());
+}
+
+auto mos6502_target::get_pass_names() -> std::vector<std::string>
+{
+    int branch_patch_count = 0;
+    const auto pipeline = internal::create_pipeline(instruction_set::nmos6502, std::nullopt, branch_patch_count);
+
+    std::vector<std::string> names;
+    for (const auto *p : pipeline.get_passes())
+        names.push_back(p->name);
+    return names;
+}
+
 void mos6502_target::set_current_text(const std::string &text)
 {
-    current_text_ = text;
+    current_text_ = source_line(text);
 }
 
-void mos6502_target::finalize()
+auto mos6502_target::get_zero_page_registers() const -> internal::zero_page_registers
 {
-    while (internal::fix_overwritten_flags(instructions_))
+    using reg = ca::intel_386_register;
+
+    internal::zero_page_registers registers;
+
+    for (const auto r : {reg::eax, reg::ebx, reg::ecx, reg::edx, reg::si, reg::di, reg::esp})
     {
-        // do it however many times it takes
+        for (auto offset = 0; offset < 2; ++offset)
+        {
+            const auto address = internal::parse_address(get_register(r, offset).value());
+            registers.locations.push_back(address);
+
+            // ecx and edx are scratch registers in the cdecl calling convention
+            if (r != reg::ecx && r != reg::edx)
+                registers.live_on_return.push_back(address);
+        }
     }
 
-    while (internal::optimize(instructions_))
+    return registers;
+}
+
+void mos6502_target::finalize()
+{
+    const auto registers = get_zero_page_registers();
+    int branch_patch_count = 0;
+    const auto pipeline = internal::create_pipeline(instruction_set_, origin_, branch_patch_count);
+    internal::pass_manager passes{instructions_, registers, optimization_options_};
+
+    passes.run_to_fixed_point({&pipeline.fix_overwritten_flags});
+
+    std::vector<const internal::pass *> optimizations;
+    for (const auto &p : pipeline.optimizations)
+        optimizations.push_back(&p);
+    passes.run_to_fixed_point(optimizations);
+
+    passes.run(pipeline.use_branch_always);
+    passes.run(pipeline.use_16bit_accumulator);
+    passes.run_to_fixed_point({&pipeline.fix_long_branches});
+
+    if (passes.run(pipeline.align_to_pages))
+        passes.run_to_fixed_point({&pipeline.fix_long_branches});
+
+    for (const auto &i : instructions_)
     {
-        // do it however many times it takes
+        std::cout << i.to_string() << '\n';
     }
 
+    if (optimization_options_.time_passes)
+        passes.print_statistics(std::cerr);
+}
+
+auto mos6502_target::get_ir_passes() const -> std::vector<std::string>
+{
     int branch_patch_count = 0;
-    while (internal::fix_long_branches(instructions_, branch_patch_count))
+    const auto pipeline = internal::create_pipeline(instruction_set_, origin_, branch_patch_count);
+
+    std::vector<std::string> names;
+    for (const auto &p : pipeline.ir_passes)
     {
-        // do it however many times it takes
+        if (internal::is_enabled(p, optimization_options_))
+            names.push_back(p.name);
     }
+    return names;
+}
 
-    for (const auto &i : instructions_)
+auto mos6502_target::get_frame_area() const -> ca::memory_area
+{
+    // Zero page argument slots are shared by all calls, and only the low 16 bits of an argument are passed in them.
+    const auto copied_argument_bytes = calling_convention_ == calling_convention::zero_page ? 2 : 0;
+
+    // Direct page addressing is shorter and faster. The 65816 doesn't need the BASIC and KERNAL work areas, so the
+    // locals get what is left between the argument slots and the registers at $fb. Arguments read with stack
+    // relative addressing stay where they were pushed until they are pulled off after the call.
+
+    if (instruction_set_ == instruction_set::wdc65816)
+        return {0x67, 0xfb - 0x67, uses_stack_relative_arguments(), copied_argument_bytes};
+
+    // The PC Engine RAM after the zero page, the stack and the block transfer stub
+    if (instruction_set_ == instruction_set::huc6280)
     {
-        std::cout << i.to_string() << '\n';
+        const auto address = transfer_stub_address_ + transfer_stub_size_;
+        return {address, 0x4000 - address, false, copied_argument_bytes};
     }
+
+    // The cassette buffer, which is free as long as nothing is loaded from tape
+    return {0x033c, 192, false, copied_argument_bytes};
 }
 
 void mos6502_target::translate_unknown(const std::string &line)
@@ -197,13 +437,28 @@ void mos6502_target::translate_unknown(const std::string &line)
 
 void mos6502_target::translate_label(const std::string &line)
 {
+    // Arguments in the zero page are only stored once the call is seen
+    const auto has_pending_arguments = !pushed_arguments_.empty();
+
     emit(ca::asm_line::line_type::label, line);
+    pushed_arguments_.clear();
+    inlined_argument_bytes_ = 0;
+
+    // Flags may come from any jump to this label; keep emitting the plain branches for them.
+    set_flags_source(flags_source::sign_and_zero);
 
     // Update the current label only if it's one of the known functions.
     // We don't care about the intermediate labels. This way we can emit
     // rti and rts correctly.
     if (line == "nmi" || line == "irq" || line == "main")
         current_label_ = line;
+
+    // Interrupts keep the register widths of the code they interrupt, while the handler expects 8 bits
+    if (instruction_set_ == instruction_set::wdc65816 && (line == "nmi" || line == "irq"))
+        emit(mos6502_opcode::sep, ca::instruction_operand(ca::operand_type::literal, "#$30"));
+
+    if (calling_convention_ == calling_convention::zero_page && has_pending_arguments)
+        throw std::runtime_error("Cannot pass arguments across label " + line);
 }
 
 void mos6502_target::translate_directive(const std::string &line)
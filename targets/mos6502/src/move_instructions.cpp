@@ -2,16 +2,47 @@
 #include "opcodes.h"
 #include <ca/instruction_operand.h>
 
+namespace internal
+{
+
+// The HuC6280 stores immediates to the video display controller at $0000, $0002 and $0003 of the I/O page with
+// st0, st1 and st2, which work however the I/O page is mapped.
+static auto get_video_port_store(const ca::instruction_operand &o) -> mos6502_opcode
+{
+    if (!o.is_literal() || o.literal().kind != ca::literal_kind::address || !o.literal().symbol.empty())
+        return mos6502_opcode::unknown;
+
+    switch (o.literal().number)
+    {
+        case 0:
+            return mos6502_opcode::st0;
+        case 2:
+            return mos6502_opcode::st1;
+        case 3:
+            return mos6502_opcode::st2;
+        default:
+            return mos6502_opcode::unknown;
+    }
+}
+
+} // namespace internal
+
 void mos6502_target::translate_movb(const ca::instruction_operand &o1, const ca::instruction_operand &o2)
 {
-    if (o1.is_literal() && o2.is_literal())
+    const auto video_port_store = internal::get_video_port_store(o2);
+    if (instruction_set_ == instruction_set::huc6280 && is_immediate(o1) &&
+        video_port_store != mos6502_opcode::unknown)
+    {
+        emit(video_port_store, fixup_8bit_literal(o1));
+    }
+    else if (o1.is_literal() && o2.is_literal())
     {
-        emit(mos6502_opcode::lda, ca::instruction_operand(ca::operand_type::literal, fixup_8bit_literal(o1.value())));
+        emit(mos6502_opcode::lda, fixup_8bit_literal(o1));
         emit(mos6502_opcode::sta, o2);
     }
     else if (o1.is_literal() && o2.is_register())
     {
-        emit(mos6502_opcode::lda, ca::instruction_operand(ca::operand_type::literal, fixup_8bit_literal(o1.value())));
+        emit(mos6502_opcode::lda, fixup_8bit_literal(o1));
         emit(mos6502_opcode::sta, get_register(o2.reg()));
     }
     else if (o1.is_register() && o2.is_literal())
@@ -39,6 +70,21 @@ void mos6502_target::translate_movl(const ca::instruction_operand &o1, const ca:
         emit(mos6502_opcode::lda, get_register(o1.reg(), 1));
         emit(mos6502_opcode::sta, get_register(o2.reg(), 1));
     }
+    else if (o1.is_literal() && o2.is_register() && is_numeric_literal(o1))
+    {
+        const auto value = parse_literal(o1);
+        emit(mos6502_opcode::lda, create_8bit_literal(value));
+        emit(mos6502_opcode::sta, get_register(o2.reg()));
+        emit(mos6502_opcode::lda, create_8bit_literal(get_16bit_msb(value)));
+        emit(mos6502_opcode::sta, get_register(o2.reg(), 1));
+    }
+    else if (o1.is_literal() && !is_immediate(o1) && o2.is_register())
+    {
+        emit(mos6502_opcode::lda, get_operand_byte(o1, 0));
+        emit(mos6502_opcode::sta, get_register(o2.reg()));
+        emit(mos6502_opcode::lda, get_operand_byte(o1, 1));
+        emit(mos6502_opcode::sta, get_register(o2.reg(), 1));
+    }
     else if (o1.is_literal() && o2.is_register())
     {
         emit(mos6502_opcode::lda, ca::instruction_operand(ca::operand_type::literal, "#<" + o1.value()));
@@ -46,6 +92,15 @@ void mos6502_target::translate_movl(const ca::instruction_operand &o1, const ca:
         emit(mos6502_opcode::lda, ca::instruction_operand(ca::operand_type::literal, "#>" + o1.value()));
         emit(mos6502_opcode::sta, get_register(o2.reg(), 1));
     }
+    else if ((o1.is_register() || is_immediate(o1)) && o2.is_literal() && !is_immediate(o2))
+    {
+        // Stores all 4 bytes; the upper half of a register is zero
+        for (auto offset = 0; offset < get_operand_size(o2); ++offset)
+        {
+            emit(mos6502_opcode::lda, get_operand_byte(o1, offset));
+            emit(mos6502_opcode::sta, get_operand_byte(o2, offset));
+        }
+    }
     else
     {
         throw std::runtime_error("Cannot translate movl instruction");
@@ -54,10 +109,12 @@ void mos6502_target::translate_movl(const ca::instruction_operand &o1, const ca:
 
 void mos6502_target::translate_movzbl(const ca::instruction_operand &o1, const ca::instruction_operand &o2)
 {
-    if (o1.is_literal() && o2.is_register())
+    if ((o1.is_literal() || o1.is_register()) && o2.is_register())
     {
-        emit(mos6502_opcode::lda, o1);
+        emit(mos6502_opcode::lda, o1.is_register() ? get_register(o1.reg()) : fixup_8bit_literal(o1));
         emit(mos6502_opcode::sta, get_register(o2.reg()));
+        emit(mos6502_opcode::lda, create_8bit_literal(0));
+        emit(mos6502_opcode::sta, get_register(o2.reg(), 1));
     }
     else
     {
@@ -67,5 +124,17 @@ void mos6502_target::translate_movzbl(const ca::instruction_operand &o1, const c
 
 void mos6502_target::translate_movzwl(const ca::instruction_operand &o1, const ca::instruction_operand &o2)
 {
-    throw std::runtime_error("Cannot translate movzwl instruction");
+    // Registers only hold 16 bits, so there is nothing to extend
+    if ((o1.is_literal() || o1.is_register()) && o2.is_register())
+    {
+        for (auto offset = 0; offset < 2; ++offset)
+        {
+            emit(mos6502_opcode::lda, get_operand_byte(o1, offset));
+            emit(mos6502_opcode::sta, get_register(o2.reg(), offset));
+        }
+    }
+    else
+    {
+        throw std::runtime_error("Cannot translate movzwl instruction");
+    }
 }
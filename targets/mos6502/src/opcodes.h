@@ -4,27 +4,40 @@ enum class mos6502_opcode : int
 {
     unknown,
     lda,
+    ldx,
     ldy,
+    tax,
     tay,
+    txa,
     tya,
     cpy,
     eor,
     sta,
+    stx,
     sty,
     pha,
     pla,
     php,
     plp,
+    asl,
     lsr,
+    rol,
     ror,
     AND,
     inc,
     dec,
+    dex,
+    dey,
     ORA,
     cmp,
     bne,
     beq,
     bmi,
+    bcc,
+    bcs,
+    bpl,
+    bvc,
+    bvs,
     jmp,
     adc,
     sbc,
@@ -33,5 +46,40 @@ enum class mos6502_opcode : int
     clc,
     sec,
     bit,
-    jsr
+    jsr,
+    inx,
+    iny,
+    cpx,
+
+    // 65C02 only
+    stz,
+    bra,
+    phx,
+    phy,
+    plx,
+    ply,
+    trb,
+    tsb,
+
+    // 65816 only
+    rep,
+    sep,
+    mvn,
+    mvp,
+    pea,
+
+    // HuC6280 only
+    tii,
+    tdd,
+    st0,
+    st1,
+    st2,
+
+    // Stable undocumented NMOS opcodes
+    lax,
+    sax,
+    dcp,
+    isc,
+    anc,
+    alr
 };
@@ -0,0 +1,112 @@
+#include "passes.h"
+#include "opcodes.h"
+#include <algorithm>
+#include <cctype>
+
+namespace internal
+{
+
+auto erase_marked(std::vector<mos6502> &instructions, const std::vector<bool> &marked) -> bool
+{
+    size_t to = 0;
+    for (size_t from = 0; from < instructions.size(); ++from)
+    {
+        if (!marked[from])
+        {
+            if (to != from)
+                instructions[to] = std::move(instructions[from]);
+            ++to;
+        }
+    }
+
+    const auto removed = to != instructions.size();
+    instructions.erase(std::next(std::begin(instructions), static_cast<std::ptrdiff_t>(to)), std::end(instructions));
+    return removed;
+}
+
+auto parse_address(const std::string &s) -> int
+{
+    if (s.empty())
+        return -1;
+
+    const auto hex = s[0] == '$';
+    const auto first = hex ? std::next(std::begin(s)) : std::begin(s);
+
+    if (first == std::end(s) || std::distance(first, std::end(s)) > 5 ||
+        !std::all_of(first, std::end(s), [hex](const auto c) { return hex ? std::isxdigit(c) : std::isdigit(c); }))
+    {
+        return -1;
+    }
+
+    return std::stoi(std::string(first, std::end(s)), nullptr, hex ? 16 : 10);
+}
+
+// Returns the value of an 8-bit immediate like #$1f or #31, or -1 for anything else.
+auto parse_immediate(const std::string &s) -> int
+{
+    if (s.size() < 2 || s[0] != '#')
+        return -1;
+
+    const auto value = parse_address(s.substr(1));
+    return (value >= 0 && value <= 0xff) ? value : -1;
+}
+
+auto is_16bit_immediate(const std::string &s) -> bool
+{
+    if (s.size() < 2 || s[0] != '#')
+        return false;
+
+    if (s[1] == '$')
+        return s.size() == 6 && parse_address(s.substr(1)) >= 0;
+
+    return std::isalpha(s[1]) || s[1] == '_' || s[1] == '.';
+}
+
+auto is_stack_relative(const std::string &s) -> bool
+{
+    return s.size() > 2 && s.compare(s.size() - 2, 2, ",s") == 0;
+}
+
+// Anything that leaves the basic block is treated as a read, except for calls and returns;
+// the x86 calling convention doesn't preserve flags.
+auto are_flags_dead(const std::vector<mos6502> &instructions, size_t index, std::uint8_t flags) -> bool
+{
+    for (++index; index < instructions.size(); ++index)
+    {
+        const auto &i = instructions[index];
+
+        if (i.is_directive())
+            continue;
+
+        if (!i.is_instruction())
+            return false;
+
+        if ((i.flags_read() & flags) != 0)
+            return false;
+
+        flags &= static_cast<std::uint8_t>(~i.flags_written());
+
+        if (flags == 0)
+            return true;
+
+        switch (i.opcode())
+        {
+            case mos6502_opcode::jsr:
+            case mos6502_opcode::rts:
+            case mos6502_opcode::rti:
+                return true;
+            case mos6502_opcode::jmp:
+            case mos6502_opcode::bra:
+                return false;
+            default:
+                break;
+        }
+
+        if (i.is_branch())
+            return false;
+    }
+
+    return true;
+}
+
+} // namespace internal
@@ -0,0 +1,285 @@
+#include "pass_manager.h"
+#include <algorithm>
+#include <iomanip>
+#include <ostream>
+#include <stdexcept>
+
+namespace internal
+{
+
+namespace
+{
+
+auto contains(const std::vector<std::string> &names, const std::string &name) -> bool
+{
+    return std::find(std::begin(names), std::end(names), name) != std::end(names);
+}
+
+auto get_name(const analysis a) -> std::string
+{
+    switch (a)
+    {
+        case analysis::control_flow:
+            return "(control flow)";
+        case analysis::dominators:
+            return "(dominators)";
+        case analysis::loop_nest:
+            return "(loop nest)";
+        case analysis::liveness:
+            return "(liveness)";
+        case analysis::loops:
+            return "(loops)";
+    }
+
+    return "(unknown)";
+}
+
+} // namespace
+
+auto get_dependencies(const analysis a) -> std::vector<analysis>
+{
+    switch (a)
+    {
+        case analysis::dominators:
+        case analysis::liveness:
+            return {analysis::control_flow};
+        case analysis::loop_nest:
+            return {analysis::control_flow, analysis::dominators};
+        case analysis::control_flow:
+        case analysis::loops:
+            return {};
+    }
+
+    return {};
+}
+
+analysis_cache::analysis_cache(const std::vector<mos6502> &instructions, const zero_page_registers &registers)
+    : instructions_{instructions}
+    , registers_{registers}
+{
+}
+
+auto analysis_cache::is_valid(const analysis a) const -> bool
+{
+    switch (a)
+    {
+        case analysis::control_flow:
+            return control_flow_.has_value();
+        case analysis::dominators:
+            return dominators_.has_value();
+        case analysis::loop_nest:
+            return loop_nest_.has_value();
+        case analysis::liveness:
+            return liveness_.has_value();
+        case analysis::loops:
+            return loops_.has_value();
+    }
+
+    return false;
+}
+
+void analysis_cache::compute(const analysis a)
+{
+    switch (a)
+    {
+        case analysis::control_flow:
+            control_flow_ = build_control_flow_graph(instructions_);
+            break;
+        case analysis::dominators:
+            dominators_ = find_dominators(get_control_flow_graph());
+            break;
+        case analysis::loop_nest:
+            loop_nest_ = find_loop_nest(get_control_flow_graph(), get_dominators());
+            break;
+        case analysis::liveness:
+            liveness_ = analyze_liveness(instructions_, get_control_flow_graph(), registers_);
+            break;
+        case analysis::loops:
+            loops_ = find_loops(instructions_);
+            break;
+    }
+}
+
+void analysis_cache::invalidate()
+{
+    control_flow_.reset();
+    dominators_.reset();
+    loop_nest_.reset();
+    liveness_.reset();
+    loops_.reset();
+}
+
+auto analysis_cache::get_control_flow_graph() -> const control_flow_graph &
+{
+    if (!control_flow_)
+        compute(analysis::control_flow);
+
+    return *control_flow_;
+}
+
+auto analysis_cache::get_dominators() -> const dominator_tree &
+{
+    if (!dominators_)
+        compute(analysis::dominators);
+
+    return *dominators_;
+}
+
+auto analysis_cache::get_loop_nest() -> const loop_nest &
+{
+    if (!loop_nest_)
+        compute(analysis::loop_nest);
+
+    return *loop_nest_;
+}
+
+auto analysis_cache::get_liveness() -> const liveness &
+{
+    if (!liveness_)
+        compute(analysis::liveness);
+
+    return *liveness_;
+}
+
+auto analysis_cache::get_loops() -> const std::vector<loop> &
+{
+    if (!loops_)
+        compute(analysis::loops);
+
+    return *loops_;
+}
+
+void validate_options(const optimization_options &options, const std::vector<const pass *> &passes)
+{
+    const auto find = [&passes](const std::string &name) {
+        const auto p = std::find_if(std::begin(passes), std::end(passes), [&name](const auto *candidate) {
+            return candidate->name == name;
+        });
+        if (p == std::end(passes))
+            throw std::runtime_error("Unknown pass " + name);
+        return *p;
+    };
+
+    for (const auto &name : options.enabled_passes)
+        find(name);
+
+    for (const auto &name : options.disabled_passes)
+    {
+        if (find(name)->level == optimization_level::none)
+            throw std::runtime_error("Cannot disable pass " + name + ", the code is wrong without it");
+    }
+}
+
+auto is_enabled(const pass &p, const optimization_options &options) -> bool
+{
+    if (!p.available || contains(options.disabled_passes, p.name))
+        return false;
+
+    if (contains(options.enabled_passes, p.name))
+        return true;
+
+    switch (options.level)
+    {
+        case optimization_level::none:
+            return p.level == optimization_level::none;
+        case optimization_level::basic:
+            return p.level == optimization_level::none || p.level == optimization_level::basic;
+        case optimization_level::speed:
+            return true;
+        case optimization_level::size:
+            return !p.grows_code;
+    }
+
+    return true;
+}
+
+pass_manager::pass_manager(std::vector<mos6502> &instructions, const zero_page_registers &registers,
+                           const optimization_options &options)
+    : instructions_{instructions}
+    , options_{options}
+    , analyses_{instructions, registers}
+{
+}
+
+auto pass_manager::is_enabled(const pass &p) const -> bool
+{
+    return internal::is_enabled(p, options_);
+}
+
+auto pass_manager::run(const pass &p) -> bool
+{
+    if (!is_enabled(p))
+        return false;
+
+    for (const auto a : p.uses)
+        prepare(a);
+
+    const auto start = std::chrono::steady_clock::now();
+    const auto changed = p.run(instructions_, analyses_);
+    record(p.name, changed, std::chrono::steady_clock::now() - start);
+
+    if (changed)
+        analyses_.invalidate();
+
+    return changed;
+}
+
+auto pass_manager::run_to_fixed_point(const std::vector<const pass *> &passes) -> bool
+{
+    auto changed = false;
+
+    for (auto again = true; again;)
+    {
+        again = std::any_of(std::begin(passes), std::end(passes), [this](const auto *p) { return run(*p); });
+        changed = changed || again;
+    }
+
+    return changed;
+}
+
+void pass_manager::print_statistics(std::ostream &out) const
+{
+    std::chrono::steady_clock::duration total{};
+    out << std::left << std::setw(32) << "pass" << std::right << std::setw(8) << "runs" << std::setw(10) << "changes"
+        << std::setw(12) << "time (ms)" << '\n';
+
+    for (const auto &s : statistics_)
+    {
+        const auto ms = std::chrono::duration<double, std::milli>(s.time).count();
+        out << std::left << std::setw(32) << s.name << std::right << std::setw(8) << s.runs << std::setw(10)
+            << s.changes << std::setw(12) << std::fixed << std::setprecision(3) << ms << '\n';
+        total += s.time;
+    }
+
+    const auto ms = std::chrono::duration<double, std::milli>(total).count();
+    out << std::left << std::setw(50) << "total" << std::right << std::setw(12) << std::fixed << std::setprecision(3)
+        << ms << '\n';
+}
+
+void pass_manager::prepare(const analysis a)
+{
+    if (analyses_.is_valid(a))
+        return;
+
+    for (const auto dependency : get_dependencies(a))
+        prepare(dependency);
+
+    const auto start = std::chrono::steady_clock::now();
+    analyses_.compute(a);
+    record(get_name(a), false, std::chrono::steady_clock::now() - start);
+}
+
+void pass_manager::record(const std::string &name, const bool changed, const std::chrono::steady_clock::duration time)
+{
+    auto s = std::find_if(std::begin(statistics_), std::end(statistics_),
+                          [&name](const auto &entry) { return entry.name == name; });
+    if (s == std::end(statistics_))
+        s = statistics_.insert(std::end(statistics_), statistics{name});
+
+    ++s->runs;
+    if (changed)
+        ++s->changes;
+    s->time += time;
+}
+
+} // namespace internal
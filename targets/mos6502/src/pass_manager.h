@@ -0,0 +1,122 @@
+#pragma once
+
+#include "cfg.h"
+#include "liveness.h"
+#include "passes.h"
+#include <mos6502/mos6502_target.h>
+#include <chrono>
+#include <functional>
+#include <iosfwd>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace internal
+{
+
+// The analyses that passes declare they use
+enum class analysis
+{
+    control_flow,
+    dominators,
+    loop_nest,
+    liveness,
+    loops
+};
+
+// The analyses the given one is computed from
+auto get_dependencies(analysis a) -> std::vector<analysis>;
+
+// Analyses of the instructions as they currently are. Each one is computed the first time it's needed and kept
+// until a pass changes the code.
+class analysis_cache
+{
+public:
+    analysis_cache(const std::vector<mos6502> &instructions, const zero_page_registers &registers);
+
+    auto is_valid(analysis a) const -> bool;
+    void compute(analysis a);
+    void invalidate();
+
+    auto get_control_flow_graph() -> const control_flow_graph &;
+    auto get_dominators() -> const dominator_tree &;
+    auto get_loop_nest() -> const loop_nest &;
+    auto get_liveness() -> const liveness &;
+    auto get_loops() -> const std::vector<loop> &;
+
+private:
+    const std::vector<mos6502> &instructions_;
+    const zero_page_registers &registers_;
+    std::optional<control_flow_graph> control_flow_;
+    std::optional<dominator_tree> dominators_;
+    std::optional<loop_nest> loop_nest_;
+    std::optional<liveness> liveness_;
+    std::optional<std::vector<loop>> loops_;
+};
+
+struct pass
+{
+    std::string name;
+
+    // The lowest level the pass runs at. The passes the code is wrong without have level none and can't be disabled.
+    optimization_level level = optimization_level::basic;
+
+    // Set for passes that may make the code larger, which -Os leaves out
+    bool grows_code = false;
+
+    // False for passes that don't apply to this target, like those for instructions the processor doesn't have
+    bool available = true;
+
+    std::vector<analysis> uses;
+
+    // Returns true if the pass changed the code. Empty for the shared passes that ir::optimize runs before
+    // translation, which are only listed here so that the options apply to them as well.
+    std::function<bool(std::vector<mos6502> &, analysis_cache &)> run;
+};
+
+// Throws if the options name a pass that isn't one of the given ones, or disable one the code is wrong without.
+void validate_options(const optimization_options &options, const std::vector<const pass *> &passes);
+
+// Whether the options let the pass run
+auto is_enabled(const pass &p, const optimization_options &options) -> bool;
+
+// Runs the passes that the optimization options enable on the instructions, keeping the analyses they declare
+// between passes that leave the code unchanged, and records how often each ran and how long it took.
+class pass_manager
+{
+public:
+    pass_manager(std::vector<mos6502> &instructions, const zero_page_registers &registers,
+                 const optimization_options &options);
+
+    auto is_enabled(const pass &p) const -> bool;
+
+    // Runs the pass once if it's enabled. Returns true if it changed the code.
+    auto run(const pass &p) -> bool;
+
+    // Runs the enabled passes in order, starting over from the first one whenever one of them changes the code,
+    // until none of them do. Returns true if any of them changed the code.
+    auto run_to_fixed_point(const std::vector<const pass *> &passes) -> bool;
+
+    // A table of the runs, changes and time of every pass and analysis, in the order they first ran.
+    void print_statistics(std::ostream &out) const;
+
+private:
+    struct statistics
+    {
+        std::string name;
+        int runs = 0;
+        int changes = 0;
+        std::chrono::steady_clock::duration time{};
+    };
+
+    // Computes the analysis and the ones it depends on, where they aren't kept from earlier
+    void prepare(analysis a);
+    void record(const std::string &name, bool changed, std::chrono::steady_clock::duration time);
+
+    std::vector<mos6502> &instructions_;
+    const optimization_options &options_;
+    analysis_cache analyses_;
+    std::vector<statistics> statistics_;
+};
+
+} // namespace internal
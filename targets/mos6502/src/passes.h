@@ -0,0 +1,129 @@
+#pragma once
+
+#include <mos6502/mos6502_instruction.h>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace internal
+{
+
+// The zero page locations the target uses to hold the x86 registers
+struct zero_page_registers
+{
+    // All allocator owned locations
+    std::vector<int> locations;
+
+    // Locations that still hold a meaningful value after returning from a function; the return
+    // value and the callee saved registers.
+    std::vector<int> live_on_return;
+};
+
+// The passes that decide from liveness also take it already analyzed, so the pass manager can share one analysis
+// between all passes that leave the code unchanged.
+struct liveness;
+
+// The size in bytes of an instruction and the cycles it takes, not counting taken branches or crossed pages
+struct instruction_cost
+{
+    int bytes = 0;
+    int cycles = 0;
+};
+
+auto estimate_cost(const mos6502 &i) -> instruction_cost;
+
+// A range of lines that runs repeatedly; from a label up to a branch or jump back to it
+struct loop
+{
+    size_t head = 0;
+    size_t end = 0; // The branch or jump back to the head
+    int depth = 1;  // 1 for loops that aren't inside any other
+};
+
+auto find_loops(const std::vector<mos6502> &instructions) -> std::vector<loop>;
+
+// The address of each line when the code starts at the given origin, followed by the address just past the end.
+// Without an origin the addresses start at 0 and alignment takes the most padding it could need, so that distances
+// are never underestimated.
+auto get_addresses(const std::vector<mos6502> &instructions, std::optional<int> origin) -> std::vector<int>;
+
+// Keep loops and tables indexed by X or Y within a single page, where that saves enough cycles to be worth the
+// padding. Loops are found from branches and jumps back to a label and weighted by how deeply they are nested.
+auto align_to_pages(std::vector<mos6502> &instructions, int origin) -> bool;
+
+// Removes all instructions that were marked for removal. Returns true if anything was removed.
+auto erase_marked(std::vector<mos6502> &instructions, const std::vector<bool> &marked) -> bool;
+
+// Parses a plain numeric address operand like "$fb" or "53280". Returns -1 for anything else;
+// immediates, symbols and indexed or indirect addressing.
+auto parse_address(const std::string &s) -> int;
+
+// Parses an immediate operand like "#1" or "#$ff". Returns -1 for anything else; including symbolic
+// immediates like "#<label".
+auto parse_immediate(const std::string &s) -> int;
+
+// Returns true for the immediates of the 65816 while A or the index registers are 16 bits wide; four hex digits like
+// "#$0400", or a whole symbol like "#table" instead of one of its bytes.
+auto is_16bit_immediate(const std::string &s) -> bool;
+
+// Returns true for the stack relative operands of the 65816 like "3,s", which count from the current stack pointer.
+auto is_stack_relative(const std::string &s) -> bool;
+
+// Returns true if none of the given flags are read after the instruction at the given index
+// before they are overwritten.
+auto are_flags_dead(const std::vector<mos6502> &instructions, size_t index, std::uint8_t flags) -> bool;
+
+// Track what A, X and Y are known to contain throughout each basic block and remove loads and
+// transfers of values that are already present in the destination register.
+auto eliminate_redundant_loads(std::vector<mos6502> &instructions) -> bool;
+
+// Replace loads, updates and stores of the same memory location by read-modify-write instructions like
+// inc, dec, asl, lsr, rol and ror where the value left in A and the changed flags are not used.
+auto use_read_modify_write(std::vector<mos6502> &instructions, const zero_page_registers &registers) -> bool;
+auto use_read_modify_write(std::vector<mos6502> &instructions, const liveness &info) -> bool;
+
+// Turn calls followed by a return into tail jumps, replace jumps to a return by the return itself, thread jumps and
+// branches through jumps they land on and remove code that can't be reached.
+auto optimize_control_flow(std::vector<mos6502> &instructions) -> bool;
+
+// Copy small functions that consist of a single basic block into the places that call them, and remove functions
+// that have no callers left.
+auto inline_leaf_functions(std::vector<mos6502> &instructions) -> bool;
+
+// Use the instructions the 65C02 adds where they are shorter or faster: stz, inc and dec of A, phx, phy, plx, ply,
+// (zp) addressing without an index, trb and tsb.
+auto use_65c02_instructions(std::vector<mos6502> &instructions, const zero_page_registers &registers) -> bool;
+auto use_65c02_instructions(std::vector<mos6502> &instructions, const liveness &info) -> bool;
+
+// Replace jumps to labels in the stream by the 65C02 bra, which is a byte shorter. fix_long_branches turns the ones
+// that are out of range back into jumps.
+auto use_branch_always(std::vector<mos6502> &instructions) -> bool;
+
+// Combine the byte operations on the two halves of 16-bit values in the direct page, in program data or in
+// immediates into single operations with the 65816 accumulator switched to 16 bits by rep and back by sep, where
+// that is cheaper and the value left in A and N and Z aren't used.
+auto use_16bit_accumulator(std::vector<mos6502> &instructions, const zero_page_registers &registers) -> bool;
+auto use_16bit_accumulator(std::vector<mos6502> &instructions, const liveness &info) -> bool;
+
+// Replace pairs of instructions by the stable undocumented NMOS opcodes lax, sax, dcp, isc, anc and alr where
+// estimate_cost shows that this saves bytes or cycles.
+auto use_undocumented_opcodes(std::vector<mos6502> &instructions, const zero_page_registers &registers) -> bool;
+auto use_undocumented_opcodes(std::vector<mos6502> &instructions, const liveness &info) -> bool;
+
+// Keep the counters of loops that consist of a single basic block in X or Y instead of a zero page register, and
+// make loops that count up to a constant count down to zero instead where nothing else reads the counter.
+auto use_index_register_counters(std::vector<mos6502> &instructions, const zero_page_registers &registers) -> bool;
+auto use_index_register_counters(std::vector<mos6502> &instructions, const liveness &info,
+                                 const std::vector<loop> &loops) -> bool;
+
+// Replace sequences of instructions by the cheaper ones with the same effect from the table the superoptimizer
+// generated, where the registers and flags a replacement may leave different are dead.
+auto apply_peephole_rules(std::vector<mos6502> &instructions, const zero_page_registers &registers) -> bool;
+auto apply_peephole_rules(std::vector<mos6502> &instructions, const liveness &info) -> bool;
+
+// Remove stores to zero page registers and computations whose results are never read.
+auto eliminate_dead_code(std::vector<mos6502> &instructions, const zero_page_registers &registers) -> bool;
+auto eliminate_dead_code(std::vector<mos6502> &instructions, const liveness &info) -> bool;
+
+} // namespace internal
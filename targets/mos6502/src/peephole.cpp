@@ -0,0 +1,135 @@
+#include "peephole.h"
+#include "passes.h"
+#include "liveness.h"
+#include "opcodes.h"
+#include <map>
+
+namespace internal
+{
+
+namespace
+{
+
+// clang-format off
+const std::vector<peephole_rule> rules{
+#include "peephole_rules.inc"
+};
+// clang-format on
+
+auto is_memory_placeholder(const std::string &p) -> bool
+{
+    return p.size() == 2 && p[0] == 'm';
+}
+
+auto is_immediate_placeholder(const std::string &p) -> bool
+{
+    return p.size() == 3 && p[0] == '#' && p[1] == 'k';
+}
+
+// Matches the pattern of a rule against the instructions starting at op, and binds the placeholders to the operands
+// they stand for. Locations must be in the zero page, but not the processor port at $00 and $01, and different
+// placeholders must stand for different locations; that is what the superoptimizer assumed. Immediates are 8 bits wide.
+auto match(const std::vector<mos6502> &instructions, const size_t op, const peephole_rule &rule,
+           std::map<std::string, std::string> &bindings) -> bool
+{
+    if (op + rule.pattern.size() > instructions.size())
+        return false;
+
+    std::map<int, std::string> locations;
+    for (size_t n = 0; n < rule.pattern.size(); ++n)
+    {
+        const auto &i = instructions[op + n];
+        const auto &[opcode, placeholder] = rule.pattern[n];
+        if (!i.is_instruction() || i.opcode() != opcode)
+            return false;
+
+        const auto &operand = i.operand().value();
+        const std::string p = placeholder;
+        if (is_memory_placeholder(p))
+        {
+            const auto address = parse_address(operand);
+            if (address < 2 || address >= 256)
+                return false;
+
+            const auto location = locations.find(address);
+            if (location != std::end(locations) && location->second != p)
+                return false;
+            locations[address] = p;
+        }
+        else if (is_immediate_placeholder(p))
+        {
+            if (operand.empty() || operand[0] != '#' || is_16bit_immediate(operand))
+                return false;
+        }
+        else if (p.empty() ? !operand.empty() : parse_immediate(operand) != parse_immediate(p) ||
+                                                    parse_immediate(operand) < 0)
+        {
+            return false;
+        }
+        else
+        {
+            continue;
+        }
+
+        const auto binding = bindings.emplace(p, operand).first;
+        if (binding->second != operand)
+            return false;
+    }
+
+    return true;
+}
+
+} // namespace
+
+auto get_peephole_rules() -> const std::vector<peephole_rule> &
+{
+    return rules;
+}
+
+auto apply_peephole_rules(std::vector<mos6502> &instructions, const zero_page_registers &registers) -> bool
+{
+    return apply_peephole_rules(instructions, analyze_liveness(instructions, registers));
+}
+
+auto apply_peephole_rules(std::vector<mos6502> &instructions, const liveness &info) -> bool
+{
+    std::vector<bool> removed(instructions.size(), false);
+    auto changed = false;
+
+    for (size_t op = 0; op < instructions.size(); ++op)
+    {
+        for (const auto &rule : rules)
+        {
+            std::map<std::string, std::string> bindings;
+            const auto last = op + rule.pattern.size() - 1;
+            if (!match(instructions, op, rule, bindings) || (info.live_out[last] & rule.clobbers) != 0)
+                continue;
+
+            // Each replacement keeps the comment of the original instruction in the same place
+            for (size_t n = 0; n < rule.pattern.size(); ++n)
+            {
+                if (n >= rule.replacement.size())
+                {
+                    removed[op + n] = true;
+                    continue;
+                }
+
+                const auto &[opcode, placeholder] = rule.replacement[n];
+                const auto binding = bindings.find(placeholder);
+                const auto operand = binding == std::end(bindings) ? std::string(placeholder) : binding->second;
+                auto comment = instructions[op + n].comment();
+                instructions[op + n] = mos6502(opcode, ca::instruction_operand(ca::operand_type::literal, operand));
+                instructions[op + n].set_comment(std::move(comment));
+            }
+
+            changed = true;
+            op = last;
+            break;
+        }
+    }
+
+    erase_marked(instructions, removed);
+    return changed;
+}
+
+} // namespace internal
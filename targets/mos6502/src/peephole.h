@@ -0,0 +1,54 @@
+#pragma once
+
+#include <mos6502/mos6502_instruction.h>
+#include <array>
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace internal
+{
+
+// An instruction in a peephole rule. The operand is empty, a zero page location "m0" to "m3", an immediate "#k0" to
+// "#k3", or a constant immediate like "#0".
+using rule_instruction = std::pair<mos6502_opcode, const char *>;
+
+// A sequence of instructions and a cheaper one that has the same effect, generated by the superoptimizer.
+struct peephole_rule
+{
+    std::vector<rule_instruction> pattern;
+    std::vector<rule_instruction> replacement;
+
+    // The registers and flags, as a liveness mask, that may end up with a different value. The rule only applies
+    // where they are dead.
+    std::uint32_t clobbers = 0;
+};
+
+auto get_peephole_rules() -> const std::vector<peephole_rule> &;
+
+// The parts of the processor that straight line code can change, with as many memory locations and immediates as
+// a rule can refer to.
+struct machine_state
+{
+    std::uint8_t a = 0;
+    std::uint8_t x = 0;
+    std::uint8_t y = 0;
+    bool negative = false;
+    bool zero = false;
+    bool carry = false;
+    bool overflow = false;
+    std::array<std::uint8_t, 4> memory{};
+    std::array<std::uint8_t, 4> immediates{};
+
+    // The value of a constant operand like "#1" while the instruction that uses it runs
+    std::uint8_t constant = 0;
+
+    auto operator==(const machine_state &other) const -> bool;
+};
+
+// Runs a single instruction with an operand in the form of a rule. Returns false for instructions and operands the
+// simulator doesn't know; anything that jumps, uses the stack or needs an address.
+auto simulate(machine_state &state, mos6502_opcode o, const std::string &operand) -> bool;
+
+} // namespace internal
@@ -0,0 +1,119 @@
+#include "passes.h"
+#include "liveness.h"
+#include "opcodes.h"
+
+namespace internal
+{
+
+// Read-modify-write instructions support zero page and absolute addressing, optionally indexed by X.
+static auto supports_read_modify_write(const std::string &operand) -> bool
+{
+    if (operand.empty() || operand[0] == '#' || operand[0] == '(')
+        return false;
+
+    const auto comma = operand.find(',');
+    return comma == std::string::npos || operand.substr(comma) == ",x";
+}
+
+static auto is_accumulator_shift(const mos6502 &i) -> bool
+{
+    switch (i.opcode())
+    {
+        case mos6502_opcode::asl:
+        case mos6502_opcode::lsr:
+        case mos6502_opcode::rol:
+        case mos6502_opcode::ror:
+            return i.operand().is_empty();
+        default:
+            return false;
+    }
+}
+
+auto use_read_modify_write(std::vector<mos6502> &instructions, const zero_page_registers &registers) -> bool
+{
+    return use_read_modify_write(instructions, analyze_liveness(instructions, registers));
+}
+
+auto use_read_modify_write(std::vector<mos6502> &instructions, const liveness &info) -> bool
+{
+    std::vector<bool> removed(instructions.size(), false);
+
+    const auto is = [&instructions](const size_t op, const mos6502_opcode o) {
+        return op < instructions.size() && instructions[op].is_instruction() && instructions[op].opcode() == o;
+    };
+
+    const auto operand = [&instructions](const size_t op) -> const std::string & {
+        return instructions[op].operand().value();
+    };
+
+    const auto is_dead_after = [&info](const size_t op, const live_mask mask) {
+        return (info.live_out[op] & mask) == 0;
+    };
+
+    const auto replace = [&instructions, &removed](const size_t first, const size_t count, const mos6502_opcode o,
+                                                   const std::string &location) {
+        const auto comment = instructions[first].comment();
+        instructions[first] = mos6502(o, ca::instruction_operand(ca::operand_type::literal, location));
+        instructions[first].set_comment(comment);
+
+        for (auto op = first + 1; op < first + count; ++op)
+            removed[op] = true;
+    };
+
+    const auto carry_and_overflow = get_flags_mask(mos6502_flags::carry | mos6502_flags::overflow);
+
+    for (size_t op = 0; op < instructions.size(); ++op)
+    {
+        if (!is(op, mos6502_opcode::lda))
+            continue;
+
+        // lda m; asl; sta m -> asl m
+        // The flags are identical, only A differs.
+        if (op + 2 < instructions.size() && is_accumulator_shift(instructions[op + 1]) &&
+            is(op + 2, mos6502_opcode::sta) && operand(op) == operand(op + 2) &&
+            supports_read_modify_write(operand(op)) && is_dead_after(op + 2, register_a))
+        {
+            replace(op, 3, instructions[op + 1].opcode(), operand(op));
+            op += 2;
+            continue;
+        }
+
+        if (!is(op + 3, mos6502_opcode::sta))
+            continue;
+
+        const auto &location = operand(op + 3);
+
+        if (!supports_read_modify_write(location) || !is_dead_after(op + 3, register_a | carry_and_overflow))
+            continue;
+
+        // lda m; clc; adc #1; sta m -> inc m
+        // lda #1; clc; adc m; sta m -> inc m
+        // lda m; clc; adc #$ff; sta m -> dec m
+        // lda m; sec; sbc #1; sta m -> dec m
+        // N and Z are set from the result in both cases. C and V are not, so they must be dead.
+        if (is(op + 1, mos6502_opcode::clc) && is(op + 2, mos6502_opcode::adc))
+        {
+            if ((operand(op) == location && parse_immediate(operand(op + 2)) == 1) ||
+                (operand(op + 2) == location && parse_immediate(operand(op)) == 1))
+            {
+                replace(op, 4, mos6502_opcode::inc, location);
+                op += 3;
+            }
+            else if (operand(op) == location && parse_immediate(operand(op + 2)) == 0xff)
+            {
+                replace(op, 4, mos6502_opcode::dec, location);
+                op += 3;
+            }
+        }
+        else if (is(op + 1, mos6502_opcode::sec) && is(op + 2, mos6502_opcode::sbc) && operand(op) == location &&
+                 parse_immediate(operand(op + 2)) == 1)
+        {
+            replace(op, 4, mos6502_opcode::dec, location);
+            op += 3;
+        }
+    }
+
+    return erase_marked(instructions, removed);
+}
+
+} // namespace internal
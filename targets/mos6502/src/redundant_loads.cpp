@@ -0,0 +1,284 @@
+#include "passes.h"
+#include "opcodes.h"
+#include <array>
+#include <map>
+
+namespace internal
+{
+
+// Known contents of the A, X and Y registers and of zero page memory, expressed as value numbers.
+// Two locations holding the same value number are known to hold the same value.
+class known_contents
+{
+public:
+    enum reg
+    {
+        a,
+        x,
+        y
+    };
+
+    known_contents()
+    {
+        forget_all();
+    }
+
+    void forget_all()
+    {
+        for (auto &r : registers_)
+            r = fresh();
+
+        zero_page_.clear();
+    }
+
+    void forget(const reg r)
+    {
+        registers_[r] = fresh();
+    }
+
+    auto get(const reg r) const noexcept
+    {
+        return registers_[r];
+    }
+
+    void copy(const reg to, const reg from)
+    {
+        registers_[to] = registers_[from];
+    }
+
+    // Returns the value number of a load operand, creating a new one if it is not known yet.
+    auto value_of(const ca::instruction_operand &operand) -> int
+    {
+        const auto &text = operand.value();
+
+        if (!text.empty() && text[0] == '#')
+        {
+            const auto result = immediates_.emplace(text, 0);
+            if (result.second)
+                result.first->second = fresh();
+            return result.first->second;
+        }
+
+        const auto address = get_trackable_address(text);
+        if (address < 0)
+            return fresh();
+
+        const auto result = zero_page_.emplace(address, 0);
+        if (result.second)
+            result.first->second = fresh();
+        return result.first->second;
+    }
+
+    void load(const reg r, const ca::instruction_operand &operand)
+    {
+        registers_[r] = value_of(operand);
+    }
+
+    // Records a write to memory. Writes that may alias a remembered zero page location make us forget it.
+    void store(const ca::instruction_operand &operand, const int value)
+    {
+        const auto address = parse_address(operand.value());
+
+        if (address < 0)
+        {
+            zero_page_.clear();
+        }
+        else if (is_trackable_address(address))
+        {
+            zero_page_[address] = value;
+        }
+    }
+
+    void store(const ca::instruction_operand &operand, const reg r)
+    {
+        store(operand, registers_[r]);
+    }
+
+    void modify(const ca::instruction_operand &operand)
+    {
+        if (operand.is_empty())
+            forget(a);
+        else
+            store(operand, fresh());
+    }
+
+private:
+    // Only plain zero page locations are remembered. Anything else may be memory mapped I/O
+    // which can change under our feet. $00 and $01 are the processor port.
+    static auto is_trackable_address(const int address) noexcept -> bool
+    {
+        return address > 0x01 && address <= 0xff;
+    }
+
+    static auto get_trackable_address(const std::string &text) -> int
+    {
+        const auto address = parse_address(text);
+        return is_trackable_address(address) ? address : -1;
+    }
+
+    auto fresh() noexcept -> int
+    {
+        return ++next_value_;
+    }
+
+    int next_value_ = 0;
+    std::array<int, 3> registers_{};
+    std::map<int, int> zero_page_;
+    std::map<std::string, int> immediates_;
+};
+
+auto eliminate_redundant_loads(std::vector<mos6502> &instructions) -> bool
+{
+    known_contents contents;
+    std::vector<bool> redundant(instructions.size(), false);
+
+    const auto load = [&](const size_t index, const known_contents::reg r, const int value) {
+        if (contents.get(r) == value &&
+            are_flags_dead(instructions, index, mos6502_flags::negative | mos6502_flags::zero))
+        {
+            redundant[index] = true;
+        }
+    };
+
+    for (size_t op = 0; op < instructions.size(); ++op)
+    {
+        const auto &i = instructions[op];
+
+        if (i.is_directive())
+            continue;
+
+        if (!i.is_instruction())
+        {
+            // Labels can be reached from anywhere
+            contents.forget_all();
+            continue;
+        }
+
+        switch (i.opcode())
+        {
+            case mos6502_opcode::lda:
+                load(op, known_contents::a, contents.value_of(i.operand()));
+                contents.load(known_contents::a, i.operand());
+                break;
+            case mos6502_opcode::ldx:
+                load(op, known_contents::x, contents.value_of(i.operand()));
+                contents.load(known_contents::x, i.operand());
+                break;
+            case mos6502_opcode::ldy:
+                load(op, known_contents::y, contents.value_of(i.operand()));
+                contents.load(known_contents::y, i.operand());
+                break;
+            case mos6502_opcode::lax:
+                contents.load(known_contents::a, i.operand());
+                contents.copy(known_contents::x, known_contents::a);
+                break;
+            case mos6502_opcode::tax:
+                load(op, known_contents::x, contents.get(known_contents::a));
+                contents.copy(known_contents::x, known_contents::a);
+                break;
+            case mos6502_opcode::tay:
+                load(op, known_contents::y, contents.get(known_contents::a));
+                contents.copy(known_contents::y, known_contents::a);
+                break;
+            case mos6502_opcode::txa:
+                load(op, known_contents::a, contents.get(known_contents::x));
+                contents.copy(known_contents::a, known_contents::x);
+                break;
+            case mos6502_opcode::tya:
+                load(op, known_contents::a, contents.get(known_contents::y));
+                contents.copy(known_contents::a, known_contents::y);
+                break;
+            case mos6502_opcode::sta:
+                contents.store(i.operand(), known_contents::a);
+                break;
+            case mos6502_opcode::stx:
+                contents.store(i.operand(), known_contents::x);
+                break;
+            case mos6502_opcode::sty:
+                contents.store(i.operand(), known_contents::y);
+                break;
+            case mos6502_opcode::stz:
+                contents.store(i.operand(),
+                               contents.value_of(ca::instruction_operand(ca::operand_type::literal, "#0")));
+                break;
+            case mos6502_opcode::asl:
+            case mos6502_opcode::lsr:
+            case mos6502_opcode::rol:
+            case mos6502_opcode::ror:
+            case mos6502_opcode::inc:
+            case mos6502_opcode::dec:
+            case mos6502_opcode::trb:
+            case mos6502_opcode::tsb:
+            case mos6502_opcode::sax:
+            case mos6502_opcode::dcp:
+                contents.modify(i.operand());
+                break;
+            case mos6502_opcode::isc:
+                contents.modify(i.operand());
+                contents.forget(known_contents::a);
+                break;
+            case mos6502_opcode::dex:
+            case mos6502_opcode::inx:
+            case mos6502_opcode::plx:
+                contents.forget(known_contents::x);
+                break;
+            case mos6502_opcode::dey:
+            case mos6502_opcode::iny:
+            case mos6502_opcode::ply:
+                contents.forget(known_contents::y);
+                break;
+            case mos6502_opcode::eor:
+            case mos6502_opcode::pla:
+            case mos6502_opcode::AND:
+            case mos6502_opcode::ORA:
+            case mos6502_opcode::adc:
+            case mos6502_opcode::sbc:
+            case mos6502_opcode::anc:
+            case mos6502_opcode::alr:
+                contents.forget(known_contents::a);
+                break;
+            case mos6502_opcode::jmp:
+            case mos6502_opcode::bra:
+            case mos6502_opcode::rts:
+            case mos6502_opcode::rti:
+            case mos6502_opcode::jsr:
+            case mos6502_opcode::rep:
+            case mos6502_opcode::sep:
+            case mos6502_opcode::mvn:
+            case mos6502_opcode::mvp:
+            case mos6502_opcode::tii:
+            case mos6502_opcode::tdd:
+            case mos6502_opcode::unknown:
+                contents.forget_all();
+                break;
+            case mos6502_opcode::cpx:
+            case mos6502_opcode::cpy:
+            case mos6502_opcode::pha:
+            case mos6502_opcode::pea:
+            case mos6502_opcode::st0:
+            case mos6502_opcode::st1:
+            case mos6502_opcode::st2:
+            case mos6502_opcode::phx:
+            case mos6502_opcode::phy:
+            case mos6502_opcode::php:
+            case mos6502_opcode::plp:
+            case mos6502_opcode::cmp:
+            case mos6502_opcode::bne:
+            case mos6502_opcode::beq:
+            case mos6502_opcode::bmi:
+            case mos6502_opcode::bcc:
+            case mos6502_opcode::bcs:
+            case mos6502_opcode::bpl:
+            case mos6502_opcode::bvc:
+            case mos6502_opcode::bvs:
+            case mos6502_opcode::clc:
+            case mos6502_opcode::sec:
+            case mos6502_opcode::bit:
+                break;
+        }
+    }
+
+    return erase_marked(instructions, redundant);
+}
+
+} // namespace internal
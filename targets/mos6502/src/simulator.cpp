@@ -0,0 +1,289 @@
+#include "peephole.h"
+#include "passes.h"
+#include "opcodes.h"
+
+namespace internal
+{
+
+namespace
+{
+
+enum class operand_kind
+{
+    none,
+    memory,
+    immediate,
+    invalid
+};
+
+// Resolves an operand of a rule to the byte it refers to in the given state
+auto get_operand(machine_state &state, const std::string &operand, std::uint8_t *&value) -> operand_kind
+{
+    if (operand.empty())
+        return operand_kind::none;
+
+    if (operand.size() == 2 && operand[0] == 'm' && operand[1] >= '0' && operand[1] < '0' + 4)
+    {
+        value = &state.memory[static_cast<size_t>(operand[1] - '0')];
+        return operand_kind::memory;
+    }
+
+    if (operand.size() == 3 && operand[0] == '#' && operand[1] == 'k' && operand[2] >= '0' && operand[2] < '0' + 4)
+    {
+        value = &state.immediates[static_cast<size_t>(operand[2] - '0')];
+        return operand_kind::immediate;
+    }
+
+    const auto constant = parse_immediate(operand);
+    if (constant < 0 || constant > 0xff)
+        return operand_kind::invalid;
+
+    state.constant = static_cast<std::uint8_t>(constant);
+    value = &state.constant;
+    return operand_kind::immediate;
+}
+
+void set_sign_and_zero(machine_state &state, const std::uint8_t value)
+{
+    state.negative = (value & 0x80) != 0;
+    state.zero = value == 0;
+}
+
+void compare(machine_state &state, const std::uint8_t reg, const std::uint8_t value)
+{
+    state.carry = reg >= value;
+    set_sign_and_zero(state, static_cast<std::uint8_t>(reg - value));
+}
+
+// Binary mode only; the code the target generates never sets the decimal flag.
+void add(machine_state &state, const std::uint8_t value)
+{
+    const auto sum = state.a + value + (state.carry ? 1 : 0);
+    const auto result = static_cast<std::uint8_t>(sum);
+    state.overflow = ((state.a ^ result) & (value ^ result) & 0x80) != 0;
+    state.carry = sum > 0xff;
+    state.a = result;
+    set_sign_and_zero(state, result);
+}
+
+} // namespace
+
+auto machine_state::operator==(const machine_state &other) const -> bool
+{
+    return a == other.a && x == other.x && y == other.y && negative == other.negative && zero == other.zero &&
+           carry == other.carry && overflow == other.overflow && memory == other.memory;
+}
+
+auto simulate(machine_state &state, const mos6502_opcode o, const std::string &operand) -> bool
+{
+    std::uint8_t *value = nullptr;
+    const auto kind = get_operand(state, operand, value);
+    if (kind == operand_kind::invalid)
+        return false;
+
+    // Loads, stores, transfers and the rest that need an operand to read from or write to
+    const auto reads = kind != operand_kind::none;
+    const auto writes = kind == operand_kind::memory;
+
+    switch (o)
+    {
+        case mos6502_opcode::lda:
+            if (!reads)
+                return false;
+            state.a = *value;
+            set_sign_and_zero(state, state.a);
+            return true;
+        case mos6502_opcode::ldx:
+            if (!reads)
+                return false;
+            state.x = *value;
+            set_sign_and_zero(state, state.x);
+            return true;
+        case mos6502_opcode::ldy:
+            if (!reads)
+                return false;
+            state.y = *value;
+            set_sign_and_zero(state, state.y);
+            return true;
+        case mos6502_opcode::sta:
+            if (!writes)
+                return false;
+            *value = state.a;
+            return true;
+        case mos6502_opcode::stx:
+            if (!writes)
+                return false;
+            *value = state.x;
+            return true;
+        case mos6502_opcode::sty:
+            if (!writes)
+                return false;
+            *value = state.y;
+            return true;
+        case mos6502_opcode::tax:
+            state.x = state.a;
+            set_sign_and_zero(state, state.x);
+            return !reads;
+        case mos6502_opcode::tay:
+            state.y = state.a;
+            set_sign_and_zero(state, state.y);
+            return !reads;
+        case mos6502_opcode::txa:
+            state.a = state.x;
+            set_sign_and_zero(state, state.a);
+            return !reads;
+        case mos6502_opcode::tya:
+            state.a = state.y;
+            set_sign_and_zero(state, state.a);
+            return !reads;
+        case mos6502_opcode::inx:
+            set_sign_and_zero(state, ++state.x);
+            return !reads;
+        case mos6502_opcode::iny:
+            set_sign_and_zero(state, ++state.y);
+            return !reads;
+        case mos6502_opcode::dex:
+            set_sign_and_zero(state, --state.x);
+            return !reads;
+        case mos6502_opcode::dey:
+            set_sign_and_zero(state, --state.y);
+            return !reads;
+        case mos6502_opcode::inc:
+            // Only the form that changes memory; incrementing A needs a 65C02
+            if (!writes)
+                return false;
+            set_sign_and_zero(state, ++*value);
+            return true;
+        case mos6502_opcode::dec:
+            if (!writes)
+                return false;
+            set_sign_and_zero(state, --*value);
+            return true;
+        case mos6502_opcode::asl:
+        case mos6502_opcode::lsr:
+        case mos6502_opcode::rol:
+        case mos6502_opcode::ror:
+        {
+            if (reads && !writes)
+                return false;
+
+            auto &target = writes ? *value : state.a;
+            const auto carry_in = state.carry;
+            if (o == mos6502_opcode::asl || o == mos6502_opcode::rol)
+            {
+                state.carry = (target & 0x80) != 0;
+                target = static_cast<std::uint8_t>((target << 1) | (o == mos6502_opcode::rol && carry_in ? 1 : 0));
+            }
+            else
+            {
+                state.carry = (target & 0x01) != 0;
+                target = static_cast<std::uint8_t>((target >> 1) | (o == mos6502_opcode::ror && carry_in ? 0x80 : 0));
+            }
+            set_sign_and_zero(state, target);
+            return true;
+        }
+        case mos6502_opcode::AND:
+            if (!reads)
+                return false;
+            state.a &= *value;
+            set_sign_and_zero(state, state.a);
+            return true;
+        case mos6502_opcode::ORA:
+            if (!reads)
+                return false;
+            state.a |= *value;
+            set_sign_and_zero(state, state.a);
+            return true;
+        case mos6502_opcode::eor:
+            if (!reads)
+                return false;
+            state.a ^= *value;
+            set_sign_and_zero(state, state.a);
+            return true;
+        case mos6502_opcode::adc:
+            if (!reads)
+                return false;
+            add(state, *value);
+            return true;
+        case mos6502_opcode::sbc:
+            if (!reads)
+                return false;
+            add(state, static_cast<std::uint8_t>(~*value));
+            return true;
+        case mos6502_opcode::cmp:
+            if (!reads)
+                return false;
+            compare(state, state.a, *value);
+            return true;
+        case mos6502_opcode::cpx:
+            if (!reads)
+                return false;
+            compare(state, state.x, *value);
+            return true;
+        case mos6502_opcode::cpy:
+            if (!reads)
+                return false;
+            compare(state, state.y, *value);
+            return true;
+        case mos6502_opcode::bit:
+            // The immediate form only exists on the 65C02
+            if (!writes)
+                return false;
+            state.negative = (*value & 0x80) != 0;
+            state.overflow = (*value & 0x40) != 0;
+            state.zero = (state.a & *value) == 0;
+            return true;
+        case mos6502_opcode::clc:
+            state.carry = false;
+            return !reads;
+        case mos6502_opcode::sec:
+            state.carry = true;
+            return !reads;
+        case mos6502_opcode::unknown:
+        case mos6502_opcode::pha:
+        case mos6502_opcode::pla:
+        case mos6502_opcode::php:
+        case mos6502_opcode::plp:
+        case mos6502_opcode::bne:
+        case mos6502_opcode::beq:
+        case mos6502_opcode::bmi:
+        case mos6502_opcode::bcc:
+        case mos6502_opcode::bcs:
+        case mos6502_opcode::bpl:
+        case mos6502_opcode::bvc:
+        case mos6502_opcode::bvs:
+        case mos6502_opcode::jmp:
+        case mos6502_opcode::rts:
+        case mos6502_opcode::rti:
+        case mos6502_opcode::jsr:
+        case mos6502_opcode::stz:
+        case mos6502_opcode::bra:
+        case mos6502_opcode::phx:
+        case mos6502_opcode::phy:
+        case mos6502_opcode::plx:
+        case mos6502_opcode::ply:
+        case mos6502_opcode::trb:
+        case mos6502_opcode::tsb:
+        case mos6502_opcode::rep:
+        case mos6502_opcode::sep:
+        case mos6502_opcode::mvn:
+        case mos6502_opcode::mvp:
+        case mos6502_opcode::pea:
+        case mos6502_opcode::tii:
+        case mos6502_opcode::tdd:
+        case mos6502_opcode::st0:
+        case mos6502_opcode::st1:
+        case mos6502_opcode::st2:
+        case mos6502_opcode::lax:
+        case mos6502_opcode::sax:
+        case mos6502_opcode::dcp:
+        case mos6502_opcode::isc:
+        case mos6502_opcode::anc:
+        case mos6502_opcode::alr:
+            return false;
+    }
+
+    return false;
+}
+
+} // namespace internal
@@ -0,0 +1,189 @@
+#include "passes.h"
+#include "liveness.h"
+#include "opcodes.h"
+#include <utility>
+
+namespace internal
+{
+
+namespace
+{
+
+auto get_index(const std::string &operand) -> std::string
+{
+    const auto comma = operand.rfind(',');
+    return comma == std::string::npos ? "" : operand.substr(comma + 1);
+}
+
+// lax has no immediate form that behaves the same on every chip, and no form indexed by X.
+auto supports_load_both(const std::string &operand) -> bool
+{
+    return !operand.empty() && operand[0] != '#' && (operand[0] == '(' || get_index(operand) != "x");
+}
+
+// sax stores to zero page, zero page indexed by Y, absolute and (zp,x).
+auto supports_store_both(const std::string &operand) -> bool
+{
+    if (operand.empty() || operand[0] == '#' || (operand[0] == '(' && get_index(operand) != "x)"))
+        return false;
+
+    if (operand[0] == '(')
+        return true;
+
+    const auto index = get_index(operand);
+    if (index.empty())
+        return true;
+
+    const auto address = parse_address(operand.substr(0, operand.find(',')));
+    return index == "y" && address >= 0 && address < 256;
+}
+
+auto get_cost(std::vector<mos6502>::const_iterator begin, const std::vector<mos6502>::const_iterator end)
+    -> instruction_cost
+{
+    instruction_cost total;
+    for (; begin != end; ++begin)
+    {
+        const auto cost = estimate_cost(*begin);
+        total.bytes += cost.bytes;
+        total.cycles += cost.cycles;
+    }
+    return total;
+}
+
+// A replacement has to be at least as good in both bytes and cycles, and better in one of them.
+auto is_cheaper(const instruction_cost after, const instruction_cost before) -> bool
+{
+    return after.bytes <= before.bytes && after.cycles <= before.cycles &&
+           (after.bytes < before.bytes || after.cycles < before.cycles);
+}
+
+} // namespace
+
+auto use_undocumented_opcodes(std::vector<mos6502> &instructions, const zero_page_registers &registers) -> bool
+{
+    return use_undocumented_opcodes(instructions, analyze_liveness(instructions, registers));
+}
+
+auto use_undocumented_opcodes(std::vector<mos6502> &instructions, const liveness &info) -> bool
+{
+    std::vector<bool> removed(instructions.size(), false);
+    auto changed = false;
+
+    const auto is = [&instructions](const size_t op, const mos6502_opcode o) {
+        return op < instructions.size() && instructions[op].is_instruction() && instructions[op].opcode() == o;
+    };
+
+    const auto operand = [&instructions](const size_t op) -> const std::string & {
+        return instructions[op].operand().value();
+    };
+
+    // Replaces the instructions starting at op by one less instruction with the given opcodes and operands, if that
+    // is cheaper. The first and last replacements keep the comments of the first and last original instructions.
+    const auto replace = [&](const size_t op, const std::vector<std::pair<mos6502_opcode, std::string>> &replacement) {
+        std::vector<mos6502> created;
+        for (const auto &[opcode, location] : replacement)
+            created.emplace_back(opcode, ca::instruction_operand(ca::operand_type::literal, location));
+
+        const auto first = instructions.cbegin() + static_cast<std::ptrdiff_t>(op);
+        const auto last = first + static_cast<std::ptrdiff_t>(replacement.size() + 1);
+        if (!is_cheaper(get_cost(created.cbegin(), created.cend()), get_cost(first, last)))
+            return false;
+
+        created.front().set_comment(instructions[op].comment());
+        if (created.size() > 1)
+            created.back().set_comment(instructions[op + created.size()].comment());
+        for (size_t i = 0; i < created.size(); ++i)
+            instructions[op + i] = std::move(created[i]);
+        removed[op + created.size()] = true;
+        changed = true;
+        return true;
+    };
+
+    const auto sign_and_zero = get_flags_mask(mos6502_flags::negative | mos6502_flags::zero);
+
+    for (size_t op = 0; op + 1 < instructions.size(); ++op)
+    {
+        if (!instructions[op].is_instruction())
+            continue;
+
+        const auto opcode = instructions[op].opcode();
+
+        // lda m; tax -> lax m
+        // ldx m; txa -> lax m
+        // Both set N and Z from the same value that ends up in A and X.
+        if (((opcode == mos6502_opcode::lda && is(op + 1, mos6502_opcode::tax)) ||
+             (opcode == mos6502_opcode::ldx && is(op + 1, mos6502_opcode::txa))) &&
+            supports_load_both(operand(op)))
+        {
+            if (replace(op, {{mos6502_opcode::lax, operand(op)}}))
+                ++op;
+            continue;
+        }
+
+        // dec m; cmp m -> dcp m
+        // inc m; sbc m -> isc m
+        // The flags are all set by the second instruction.
+        if (((opcode == mos6502_opcode::dec && is(op + 1, mos6502_opcode::cmp)) ||
+             (opcode == mos6502_opcode::inc && is(op + 1, mos6502_opcode::sbc))) &&
+            !operand(op).empty() && operand(op) == operand(op + 1))
+        {
+            if (replace(op, {{opcode == mos6502_opcode::dec ? mos6502_opcode::dcp : mos6502_opcode::isc,
+                              operand(op)}}))
+            {
+                ++op;
+            }
+            continue;
+        }
+
+        // dec m; lda n; cmp m -> lda n; dcp m
+        // The load moves in front of the decrement, so it must not read m. N and Z of dec are overwritten anyway.
+        if (opcode == mos6502_opcode::dec && is(op + 1, mos6502_opcode::lda) && is(op + 2, mos6502_opcode::cmp) &&
+            !operand(op).empty() && operand(op) == operand(op + 2))
+        {
+            const auto address = parse_address(operand(op));
+            const auto loaded = parse_address(operand(op + 1));
+            const auto is_independent =
+                parse_immediate(operand(op + 1)) >= 0 || (address >= 0 && loaded >= 0 && address != loaded);
+
+            if (is_independent &&
+                replace(op, {{mos6502_opcode::lda, operand(op + 1)}, {mos6502_opcode::dcp, operand(op)}}))
+            {
+                op += 2;
+            }
+            continue;
+        }
+
+        // and #k; lsr -> alr #k
+        // and #k; clc -> anc #k
+        // anc copies bit 7 of the result into C, so it only clears C when the mask clears that bit.
+        if (opcode == mos6502_opcode::AND && parse_immediate(operand(op)) >= 0)
+        {
+            const auto mask = parse_immediate(operand(op));
+            if (is(op + 1, mos6502_opcode::lsr) && operand(op + 1).empty())
+            {
+                if (replace(op, {{mos6502_opcode::alr, operand(op)}}))
+                    ++op;
+            }
+            else if (is(op + 1, mos6502_opcode::clc) && mask < 0x80)
+            {
+                if (replace(op, {{mos6502_opcode::anc, operand(op)}}))
+                    ++op;
+            }
+            continue;
+        }
+
+        // txa; and m; sta n -> lda m; sax n
+        // A ends up holding m instead of the combination, and the load sets N and Z from it, so both must be dead.
+        if (opcode == mos6502_opcode::txa && is(op + 1, mos6502_opcode::AND) && is(op + 2, mos6502_opcode::sta) &&
+            supports_store_both(operand(op + 2)) && (info.live_out[op + 2] & (register_a | sign_and_zero)) == 0)
+        {
+            if (replace(op, {{mos6502_opcode::lda, operand(op + 1)}, {mos6502_opcode::sax, operand(op + 2)}}))
+                op += 2;
+        }
+    }
+
+    return erase_marked(instructions, removed) || changed;
+}
+
+} // namespace internal
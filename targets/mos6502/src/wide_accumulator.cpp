@@ -0,0 +1,409 @@
+#include "passes.h"
+#include "liveness.h"
+#include "opcodes.h"
+#include <cctype>
+#include <iomanip>
+#include <optional>
+#include <sstream>
+
+namespace internal
+{
+
+namespace
+{
+
+// Operations on the accumulator that combine a byte of each operand, and carry from one byte to the next
+auto is_combining(const mos6502_opcode o) -> bool
+{
+    switch (o)
+    {
+        case mos6502_opcode::adc:
+        case mos6502_opcode::sbc:
+        case mos6502_opcode::AND:
+        case mos6502_opcode::ORA:
+        case mos6502_opcode::eor:
+            return true;
+        default:
+            return false;
+    }
+}
+
+// Instructions that behave the same whatever the width of A, as long as A isn't read
+auto is_width_neutral(const mos6502_opcode o) -> bool
+{
+    switch (o)
+    {
+        case mos6502_opcode::clc:
+        case mos6502_opcode::sec:
+        case mos6502_opcode::ldx:
+        case mos6502_opcode::ldy:
+        case mos6502_opcode::stx:
+        case mos6502_opcode::sty:
+        case mos6502_opcode::inx:
+        case mos6502_opcode::iny:
+        case mos6502_opcode::dex:
+        case mos6502_opcode::dey:
+        case mos6502_opcode::cpx:
+        case mos6502_opcode::cpy:
+            return true;
+        default:
+            return false;
+    }
+}
+
+auto is_symbol(const std::string &s) -> bool
+{
+    return !s.empty() && (std::isalpha(s[0]) || s[0] == '_' || s[0] == '.');
+}
+
+// Splits a symbolic address like "table+3" into the symbol and the offset
+auto split_symbol(const std::string &s) -> std::optional<std::pair<std::string, int>>
+{
+    const auto plus = s.rfind('+');
+    if (plus == std::string::npos)
+        return is_symbol(s) ? std::optional{std::pair{s, 0}} : std::nullopt;
+
+    const auto offset = parse_address(s.substr(plus + 1));
+    if (!is_symbol(s) || offset < 0)
+        return std::nullopt;
+
+    return std::pair{s.substr(0, plus), offset};
+}
+
+// Returns the operand of the 16-bit instruction that does the work of two byte instructions with the given operands,
+// or an empty string if they aren't the two bytes of one value. Only immediates, the direct page, the stack and
+// program data are combined; absolute addresses may be hardware registers that have to be accessed a byte at a time.
+auto get_wide_operand(const std::string &low, const std::string &high) -> std::string
+{
+    if (is_stack_relative(low) && is_stack_relative(high))
+    {
+        const auto offset = parse_address(low.substr(0, low.size() - 2));
+        return (offset >= 0 && parse_address(high.substr(0, high.size() - 2)) == offset + 1) ? low : "";
+    }
+
+    if (low.empty() || high.empty() || low.find_first_of(",(") != std::string::npos ||
+        high.find_first_of(",(") != std::string::npos)
+    {
+        return "";
+    }
+
+    if (low[0] == '#' || high[0] == '#')
+    {
+        if (parse_immediate(low) >= 0 && parse_immediate(high) >= 0)
+        {
+            std::ostringstream wide;
+            wide << "#$" << std::hex << std::setw(4) << std::setfill('0')
+                 << (parse_immediate(high) << 8 | parse_immediate(low));
+            return wide.str();
+        }
+
+        const auto symbol = low.substr(std::min<size_t>(2, low.size()));
+        if (low.compare(0, 2, "#<") == 0 && high == "#>" + symbol && is_symbol(symbol))
+            return "#" + symbol;
+
+        return "";
+    }
+
+    const auto address = parse_address(low);
+    if (address >= 0)
+        return (address < 0xff && parse_address(high) == address + 1) ? low : "";
+
+    const auto low_symbol = split_symbol(low);
+    const auto high_symbol = split_symbol(high);
+    if (low_symbol && high_symbol && low_symbol->first == high_symbol->first &&
+        high_symbol->second == low_symbol->second + 1)
+    {
+        return low;
+    }
+
+    return "";
+}
+
+// Returns true if a store to the first location may change what is read from the second
+auto may_alias(const std::string &store, const std::string &read) -> bool
+{
+    if (read.empty() || read[0] == '#')
+        return false;
+
+    const auto address = parse_address(store);
+    if (address >= 0 || parse_address(read) >= 0)
+        return address == parse_address(read);
+
+    return store == read;
+}
+
+// A run of byte instructions and the 16-bit ones that replace it
+struct wide_operation
+{
+    size_t begin = 0;
+    size_t end = 0;
+    std::vector<std::pair<mos6502_opcode, std::string>> replacement;
+};
+
+// Reads the byte instructions of one half of a value: a load, the operations on it and at least one store.
+auto read_half(const std::vector<mos6502> &instructions, size_t op) -> std::vector<size_t>
+{
+    const auto is = [&instructions](const size_t i, const auto predicate) {
+        return i < instructions.size() && instructions[i].is_instruction() && predicate(instructions[i].opcode());
+    };
+
+    std::vector<size_t> half;
+    if (!is(op, [](const auto o) { return o == mos6502_opcode::lda; }))
+        return half;
+
+    half.push_back(op++);
+    while (is(op, is_combining))
+        half.push_back(op++);
+
+    const auto stores = op;
+    while (is(op, [](const auto o) { return o == mos6502_opcode::sta; }))
+        half.push_back(op++);
+
+    if (op == stores)
+        half.clear();
+
+    return half;
+}
+
+// lda a; adc b; sta c; lda a+1; adc b+1; sta c+1 -> lda a; adc b; sta c
+// lda #1; sta c; stz c+1 -> lda #$0001; sta c
+// stz c; stz c+1 -> stz c
+// asl c; rol c+1 -> asl c
+// lsr c+1; ror c -> lsr c
+auto match(const std::vector<mos6502> &instructions, const size_t op) -> std::optional<wide_operation>
+{
+    const auto operand = [&instructions](const size_t i) -> const std::string & {
+        return instructions[i].operand().value();
+    };
+    const auto is = [&instructions](const size_t i, const mos6502_opcode o) {
+        return i < instructions.size() && instructions[i].is_instruction() && instructions[i].opcode() == o;
+    };
+
+    wide_operation result{op, op, {}};
+    const auto pair = [&](const mos6502_opcode o, const size_t low, const size_t high) {
+        const auto wide = get_wide_operand(operand(low), operand(high));
+        if (wide.empty())
+            return false;
+
+        result.replacement.emplace_back(o, wide);
+        return true;
+    };
+
+    const auto low = read_half(instructions, op);
+    if (!low.empty())
+    {
+        const auto next = low.back() + 1;
+        const auto high = read_half(instructions, next);
+        if (high.size() == low.size())
+        {
+            for (size_t n = 0; n < low.size(); ++n)
+            {
+                if (instructions[low[n]].opcode() != instructions[high[n]].opcode() ||
+                    !pair(instructions[low[n]].opcode(), low[n], high[n]))
+                {
+                    return std::nullopt;
+                }
+            }
+
+            // The low bytes are stored before the high bytes are read or stored; the 16-bit stores write both at
+            // once
+            for (const auto store : low)
+            {
+                if (instructions[store].opcode() != mos6502_opcode::sta)
+                    continue;
+
+                for (const auto read : high)
+                {
+                    if (may_alias(operand(store), operand(read)))
+                        return std::nullopt;
+                }
+            }
+
+            result.end = high.back() + 1;
+            return result;
+        }
+
+        // A constant below 256, whose high byte is stored with stz
+        const auto stores = low.size() - 1;
+        if (parse_immediate(operand(op)) < 0 || !is(op + 1, mos6502_opcode::sta))
+            return std::nullopt;
+
+        for (size_t n = 0; n < stores; ++n)
+        {
+            if (!is(next + n, mos6502_opcode::stz) || get_wide_operand(operand(op + 1 + n), operand(next + n)).empty())
+                return std::nullopt;
+        }
+
+        result.replacement.emplace_back(mos6502_opcode::lda, get_wide_operand(operand(op), "#0"));
+        for (size_t n = 0; n < stores; ++n)
+            result.replacement.emplace_back(mos6502_opcode::sta, operand(op + 1 + n));
+        result.end = next + stores;
+        return result;
+    }
+
+    if (!instructions[op].is_instruction() || op + 1 >= instructions.size() || !instructions[op + 1].is_instruction())
+        return std::nullopt;
+
+    result.end = op + 2;
+    const auto first = instructions[op].opcode();
+    const auto second = instructions[op + 1].opcode();
+    if (first == mos6502_opcode::stz && second == mos6502_opcode::stz && pair(first, op, op + 1))
+        return result;
+
+    // Shifts to the left start at the low byte and shifts to the right at the high byte
+    const auto left = (first == mos6502_opcode::asl || first == mos6502_opcode::rol) && second == mos6502_opcode::rol;
+    const auto right = (first == mos6502_opcode::lsr || first == mos6502_opcode::ror) && second == mos6502_opcode::ror;
+    if ((left && pair(first, op, op + 1)) || (right && pair(first, op + 1, op)))
+        return result;
+
+    return std::nullopt;
+}
+
+// The 16-bit instructions take a cycle more for every byte of memory they read or write
+auto estimate_wide_cost(const mos6502_opcode o, const std::string &operand) -> instruction_cost
+{
+    auto cost = estimate_cost(mos6502(o, ca::instruction_operand(ca::operand_type::literal, operand)));
+    if (operand.empty() || operand[0] == '#')
+        return cost;
+
+    switch (o)
+    {
+        case mos6502_opcode::asl:
+        case mos6502_opcode::lsr:
+        case mos6502_opcode::rol:
+        case mos6502_opcode::ror:
+            cost.cycles += 2;
+            break;
+        default:
+            cost.cycles += 1;
+            break;
+    }
+
+    return cost;
+}
+
+// A replacement has to be at least as good in both bytes and cycles, and better in one of them.
+auto is_cheaper(const instruction_cost after, const instruction_cost before) -> bool
+{
+    return after.bytes <= before.bytes && after.cycles <= before.cycles &&
+           (after.bytes < before.bytes || after.cycles < before.cycles);
+}
+
+} // namespace
+
+auto use_16bit_accumulator(std::vector<mos6502> &instructions, const zero_page_registers &registers) -> bool
+{
+    return use_16bit_accumulator(instructions, analyze_liveness(instructions, registers));
+}
+
+auto use_16bit_accumulator(std::vector<mos6502> &instructions, const liveness &info) -> bool
+{
+    // The 16-bit result leaves the low byte in A instead of the high one, and sets Z from both bytes. N comes from
+    // the other byte after a shift to the right.
+    const auto clobbered = register_a | get_flags_mask(mos6502_flags::negative | mos6502_flags::zero);
+
+    // Runs of operations that only have instructions between them that don't care about the width of A share a
+    // single rep and sep.
+    std::vector<std::vector<wide_operation>> runs(1);
+    size_t run_end = 0;
+    auto wide = false;
+    for (size_t op = 0; op < instructions.size(); ++op)
+    {
+        const auto &i = instructions[op];
+        if (i.is_instruction() && (i.opcode() == mos6502_opcode::rep || i.opcode() == mos6502_opcode::sep))
+            wide = i.opcode() == mos6502_opcode::rep;
+
+        const auto operation = wide ? std::nullopt : match(instructions, op);
+        if (operation && (info.live_out[operation->end - 1] & clobbered) == 0)
+        {
+            if (!runs.back().empty() && run_end != op)
+                runs.emplace_back();
+
+            runs.back().push_back(*operation);
+            op = operation->end - 1;
+            run_end = operation->end;
+            continue;
+        }
+
+        if (run_end == op && i.is_instruction() && is_width_neutral(i.opcode()))
+            run_end = op + 1;
+    }
+
+    std::vector<std::vector<mos6502>> inserted(instructions.size());
+    std::vector<bool> removed(instructions.size(), false);
+    auto changed = false;
+
+    for (const auto &run : runs)
+    {
+        if (run.empty())
+            continue;
+
+        // The instructions between the operations stay as they are
+        instruction_cost before;
+        instruction_cost after{4, 6}; // rep and sep
+        for (const auto &operation : run)
+        {
+            for (auto op = operation.begin; op < operation.end; ++op)
+            {
+                const auto cost = estimate_cost(instructions[op]);
+                before.bytes += cost.bytes;
+                before.cycles += cost.cycles;
+            }
+
+            for (const auto &[opcode, operand] : operation.replacement)
+            {
+                const auto cost = estimate_wide_cost(opcode, operand);
+                after.bytes += cost.bytes;
+                after.cycles += cost.cycles;
+            }
+        }
+
+        if (!is_cheaper(after, before))
+            continue;
+
+        for (const auto &operation : run)
+        {
+            auto &lines = inserted[operation.begin];
+            if (&operation == &run.front())
+            {
+                lines.emplace_back(mos6502_opcode::rep, ca::instruction_operand(ca::operand_type::literal, "#$20"));
+                lines.back().set_comment(instructions[operation.begin].comment());
+            }
+
+            for (const auto &[opcode, operand] : operation.replacement)
+            {
+                lines.emplace_back(opcode, ca::instruction_operand(ca::operand_type::literal, operand));
+                lines.back().set_comment(instructions[operation.begin].comment());
+            }
+
+            if (&operation == &run.back())
+            {
+                lines.emplace_back(mos6502_opcode::sep, ca::instruction_operand(ca::operand_type::literal, "#$20"));
+                lines.back().set_comment(instructions[operation.end - 1].comment());
+            }
+
+            for (auto op = operation.begin; op < operation.end; ++op)
+                removed[op] = true;
+        }
+        changed = true;
+    }
+
+    if (!changed)
+        return false;
+
+    std::vector<mos6502> result;
+    result.reserve(instructions.size());
+    for (size_t op = 0; op < instructions.size(); ++op)
+    {
+        for (auto &line : inserted[op])
+            result.push_back(std::move(line));
+
+        if (!removed[op])
+            result.push_back(std::move(instructions[op]));
+    }
+
+    instructions = std::move(result);
+    return true;
+}
+
+} // namespace internal
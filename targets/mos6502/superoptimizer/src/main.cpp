@@ -0,0 +1,759 @@
+// Searches the output of x86-to-6502 for the most common short sequences of instructions and looks for cheaper
+// sequences with the same effect. Each replacement is checked against every possible input before it is written
+// to the peephole rule table the target includes when it's built.
+
+#include "peephole.h"
+#include "passes.h"
+#include "opcodes.h"
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <optional>
+#include <random>
+#include <set>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace
+{
+
+using internal::instruction_cost;
+using internal::machine_state;
+
+// The parts of the machine state an instruction reads or writes
+namespace component
+{
+constexpr unsigned a = 1u << 0;
+constexpr unsigned x = 1u << 1;
+constexpr unsigned y = 1u << 2;
+constexpr unsigned negative = 1u << 3;
+constexpr unsigned zero = 1u << 4;
+constexpr unsigned carry = 1u << 5;
+constexpr unsigned overflow = 1u << 6;
+constexpr unsigned first_memory = 1u << 7;
+constexpr unsigned first_immediate = 1u << 11;
+constexpr unsigned memory = 0xfu << 7;
+constexpr unsigned sign_and_zero = negative | zero;
+} // namespace component
+
+constexpr auto max_placeholders = 4;
+
+// Exhaustive checks with more input bits than this are skipped
+constexpr auto max_input_bits = 24;
+
+// Random states that candidates are tried on before they are checked exhaustively
+constexpr auto test_states = 32;
+
+constexpr auto max_window_length = 4;
+
+// Exhaustive checks per window, cheapest candidates first
+constexpr auto max_checks = 64;
+
+struct rule_operation
+{
+    mos6502_opcode opcode;
+    std::string operand;
+};
+
+using sequence = std::vector<rule_operation>;
+
+struct options
+{
+    size_t windows = 40;
+    size_t max_length = 3;
+    std::vector<std::string> files;
+};
+
+auto parse_opcode(const std::string &mnemonic) -> mos6502_opcode
+{
+    for (auto o = static_cast<int>(mos6502_opcode::lda); o <= static_cast<int>(mos6502_opcode::alr); ++o)
+    {
+        if (mos6502::to_string(static_cast<mos6502_opcode>(o)) == mnemonic)
+            return static_cast<mos6502_opcode>(o);
+    }
+
+    return mos6502_opcode::unknown;
+}
+
+// The name of the opcode in the enum, which differs from the mnemonic for the ones that are keywords in C++
+auto get_enum_name(const mos6502_opcode o) -> std::string
+{
+    switch (o)
+    {
+        case mos6502_opcode::AND:
+            return "AND";
+        case mos6502_opcode::ORA:
+            return "ORA";
+        default:
+            return mos6502::to_string(o);
+    }
+}
+
+auto get_operand_component(const std::string &operand) -> unsigned
+{
+    if (operand.size() == 2 && operand[0] == 'm')
+        return component::first_memory << (operand[1] - '0');
+
+    if (operand.size() == 3 && operand[1] == 'k')
+        return component::first_immediate << (operand[2] - '0');
+
+    return 0;
+}
+
+// What an instruction reads and writes, in components
+auto get_access(const rule_operation &i) -> std::pair<unsigned, unsigned>
+{
+    const auto operand = get_operand_component(i.operand);
+    const auto target = i.operand.empty() ? component::a : operand;
+
+    switch (i.opcode)
+    {
+        case mos6502_opcode::lda:
+            return {operand, component::a | component::sign_and_zero};
+        case mos6502_opcode::ldx:
+            return {operand, component::x | component::sign_and_zero};
+        case mos6502_opcode::ldy:
+            return {operand, component::y | component::sign_and_zero};
+        case mos6502_opcode::sta:
+            return {component::a, operand};
+        case mos6502_opcode::stx:
+            return {component::x, operand};
+        case mos6502_opcode::sty:
+            return {component::y, operand};
+        case mos6502_opcode::tax:
+            return {component::a, component::x | component::sign_and_zero};
+        case mos6502_opcode::tay:
+            return {component::a, component::y | component::sign_and_zero};
+        case mos6502_opcode::txa:
+            return {component::x, component::a | component::sign_and_zero};
+        case mos6502_opcode::tya:
+            return {component::y, component::a | component::sign_and_zero};
+        case mos6502_opcode::inx:
+        case mos6502_opcode::dex:
+            return {component::x, component::x | component::sign_and_zero};
+        case mos6502_opcode::iny:
+        case mos6502_opcode::dey:
+            return {component::y, component::y | component::sign_and_zero};
+        case mos6502_opcode::inc:
+        case mos6502_opcode::dec:
+            return {operand, operand | component::sign_and_zero};
+        case mos6502_opcode::asl:
+        case mos6502_opcode::lsr:
+            return {target, target | component::sign_and_zero | component::carry};
+        case mos6502_opcode::rol:
+        case mos6502_opcode::ror:
+            return {target | component::carry, target | component::sign_and_zero | component::carry};
+        case mos6502_opcode::AND:
+        case mos6502_opcode::ORA:
+        case mos6502_opcode::eor:
+            return {component::a | operand, component::a | component::sign_and_zero};
+        case mos6502_opcode::adc:
+        case mos6502_opcode::sbc:
+            return {component::a | operand | component::carry,
+                    component::a | component::sign_and_zero | component::carry | component::overflow};
+        case mos6502_opcode::cmp:
+            return {component::a | operand, component::sign_and_zero | component::carry};
+        case mos6502_opcode::cpx:
+            return {component::x | operand, component::sign_and_zero | component::carry};
+        case mos6502_opcode::cpy:
+            return {component::y | operand, component::sign_and_zero | component::carry};
+        case mos6502_opcode::bit:
+            return {component::a | operand, component::sign_and_zero | component::overflow};
+        case mos6502_opcode::clc:
+        case mos6502_opcode::sec:
+            return {0, component::carry};
+        default:
+            return {~0u, ~0u};
+    }
+}
+
+// The components a sequence reads before writing them
+auto get_inputs(const sequence &s) -> unsigned
+{
+    unsigned inputs = 0;
+    unsigned written = 0;
+    for (const auto &i : s)
+    {
+        const auto [reads, writes] = get_access(i);
+        inputs |= reads & ~written;
+        written |= writes;
+    }
+    return inputs;
+}
+
+void set_component(machine_state &state, const unsigned c, const std::uint8_t value)
+{
+    if (c == component::a)
+        state.a = value;
+    else if (c == component::x)
+        state.x = value;
+    else if (c == component::y)
+        state.y = value;
+    else if (c == component::negative)
+        state.negative = value != 0;
+    else if (c == component::zero)
+        state.zero = value != 0;
+    else if (c == component::carry)
+        state.carry = value != 0;
+    else if (c == component::overflow)
+        state.overflow = value != 0;
+
+    for (auto n = 0; n < max_placeholders; ++n)
+    {
+        if (c == component::first_memory << n)
+            state.memory[static_cast<size_t>(n)] = value;
+        else if (c == component::first_immediate << n)
+            state.immediates[static_cast<size_t>(n)] = value;
+    }
+}
+
+// The registers, flags and memory locations that differ between two states
+auto get_differences(const machine_state &lhs, const machine_state &rhs) -> unsigned
+{
+    unsigned differences = 0;
+    differences |= lhs.a != rhs.a ? component::a : 0;
+    differences |= lhs.x != rhs.x ? component::x : 0;
+    differences |= lhs.y != rhs.y ? component::y : 0;
+    differences |= lhs.negative != rhs.negative ? component::negative : 0;
+    differences |= lhs.zero != rhs.zero ? component::zero : 0;
+    differences |= lhs.carry != rhs.carry ? component::carry : 0;
+    differences |= lhs.overflow != rhs.overflow ? component::overflow : 0;
+    for (auto n = 0; n < max_placeholders; ++n)
+    {
+        if (lhs.memory[static_cast<size_t>(n)] != rhs.memory[static_cast<size_t>(n)])
+            differences |= component::first_memory << n;
+    }
+    return differences;
+}
+
+auto run(machine_state state, const sequence &s) -> machine_state
+{
+    for (const auto &i : s)
+        internal::simulate(state, i.opcode, i.operand);
+    return state;
+}
+
+auto can_simulate(const rule_operation &i) -> bool
+{
+    machine_state state;
+    return internal::simulate(state, i.opcode, i.operand);
+}
+
+// The cost of an instruction of a rule, with its placeholders standing for zero page locations and immediates
+auto estimate_cost(const rule_operation &i) -> instruction_cost
+{
+    auto operand = i.operand;
+    if (get_operand_component(operand) >= component::first_immediate)
+        operand = "#1";
+    else if (get_operand_component(operand) != 0)
+        operand = "$80";
+
+    return internal::estimate_cost(mos6502(i.opcode, ca::instruction_operand(ca::operand_type::literal, operand)));
+}
+
+auto estimate_cost(const sequence &s) -> instruction_cost
+{
+    instruction_cost total;
+    for (const auto &i : s)
+    {
+        const auto cost = estimate_cost(i);
+        total.bytes += cost.bytes;
+        total.cycles += cost.cycles;
+    }
+    return total;
+}
+
+// The same rule as the passes use; at least as good in both bytes and cycles, and better in one of them
+auto is_cheaper(const instruction_cost after, const instruction_cost before) -> bool
+{
+    return after.bytes <= before.bytes && after.cycles <= before.cycles &&
+           (after.bytes < before.bytes || after.cycles < before.cycles);
+}
+
+auto to_string(const sequence &s) -> std::string
+{
+    std::string text;
+    for (const auto &i : s)
+    {
+        if (!text.empty())
+            text += "; ";
+        text += mos6502::to_string(i.opcode) + (i.operand.empty() ? "" : " " + i.operand);
+    }
+    return text.empty() ? "nothing" : text;
+}
+
+// Reads the lines of the files that x86-to-6502 wrote and turns each run of instructions the simulator knows into
+// sequences in the form of a rule. Zero page locations become m0 to m3 and immediates become #k0 to #k3; or stay
+// as they are in the second form of each window, for replacements that only work with a certain constant.
+class window_counter
+{
+public:
+    void add_file(std::istream &input)
+    {
+        std::vector<std::pair<mos6502_opcode, std::string>> run;
+        std::string line;
+        while (std::getline(input, line))
+        {
+            const auto instruction = parse_instruction(line);
+            if (instruction.first == mos6502_opcode::unknown)
+            {
+                count(run);
+                run.clear();
+            }
+            else
+            {
+                run.push_back(instruction);
+            }
+        }
+        count(run);
+    }
+
+    // The windows seen most often, most common first
+    auto get_hottest(const size_t n) const -> std::vector<std::pair<std::string, size_t>>
+    {
+        std::vector<std::pair<std::string, size_t>> hottest(counts_.begin(), counts_.end());
+        std::stable_sort(hottest.begin(), hottest.end(), [](const auto &lhs, const auto &rhs) {
+            return lhs.second > rhs.second;
+        });
+        hottest.resize(std::min(n, hottest.size()));
+        return hottest;
+    }
+
+    auto get_window(const std::string &key) const -> const sequence &
+    {
+        return windows_.at(key);
+    }
+
+private:
+    static auto parse_instruction(const std::string &line) -> std::pair<mos6502_opcode, std::string>
+    {
+        std::istringstream stream(line.substr(0, line.find(';')));
+        std::string mnemonic;
+        std::string operand;
+        if (line.empty() || (line[0] != ' ' && line[0] != '\t') || !(stream >> mnemonic))
+            return {mos6502_opcode::unknown, ""};
+
+        stream >> operand;
+        return {parse_opcode(mnemonic), operand};
+    }
+
+    // Replaces an operand by a placeholder, or by the constant in a uniform form. Returns false for operands that
+    // aren't zero page locations or immediates.
+    static auto abstract_operand(const std::string &operand, const bool keep_constants,
+                                 std::map<std::string, std::string> &placeholders, std::string &abstract) -> bool
+    {
+        const auto constant = internal::parse_immediate(operand);
+        if (operand[0] == '#' && keep_constants && constant >= 0)
+        {
+            abstract = "#" + std::to_string(constant);
+            return true;
+        }
+
+        if (placeholders.count(operand) != 0)
+        {
+            abstract = placeholders[operand];
+            return true;
+        }
+
+        const auto is_immediate = operand[0] == '#';
+        const auto used = std::count_if(placeholders.begin(), placeholders.end(), [is_immediate](const auto &p) {
+            return (p.second[0] == '#') == is_immediate;
+        });
+
+        const auto address = internal::parse_address(operand);
+        if (used >= max_placeholders || (!is_immediate && (address < 2 || address >= 256)))
+            return false;
+
+        abstract = placeholders[operand] = (is_immediate ? "#k" : "m") + std::to_string(used);
+        return true;
+    }
+
+    void count(const std::vector<std::pair<mos6502_opcode, std::string>> &run)
+    {
+        for (size_t first = 0; first < run.size(); ++first)
+        {
+            // Windows without constants look the same both ways, but are only there once
+            std::set<std::string> seen;
+            for (auto keep_constants : {false, true})
+            {
+                std::map<std::string, std::string> placeholders;
+                sequence window;
+                for (auto op = first; op < run.size() && window.size() < max_window_length; ++op)
+                {
+                    const auto &[opcode, operand] = run[op];
+                    auto abstract = operand;
+                    if (!operand.empty() && !abstract_operand(operand, keep_constants, placeholders, abstract))
+                        break;
+
+                    window.push_back({opcode, abstract});
+                    if (!can_simulate(window.back()))
+                        break;
+
+                    if (window.size() >= 2)
+                    {
+                        const auto key = to_string(window);
+                        if (seen.insert(key).second)
+                            ++counts_[key];
+                        windows_.emplace(key, window);
+                    }
+                }
+            }
+        }
+    }
+
+    std::map<std::string, size_t> counts_;
+    std::map<std::string, sequence> windows_;
+};
+
+struct candidate
+{
+    sequence instructions;
+    instruction_cost cost;
+    unsigned differences = 0; // On the random states only
+};
+
+// Looks for the cheapest sequences that leave memory the same as the window does
+class searcher
+{
+public:
+    searcher(const sequence &window, const size_t max_length)
+        : window_{window}
+        , max_length_{std::min(max_length, window.size())}
+        , window_cost_{estimate_cost(window)}
+    {
+        for (const auto &i : window)
+            window_writes_ |= get_access(i).second;
+
+        create_alphabet();
+        create_states();
+        find_shorter();
+    }
+
+    // The cheapest replacement that has exactly the same effect, and a cheaper one that may leave other values in
+    // some registers or flags, if there is one
+    auto search() -> std::vector<std::pair<sequence, unsigned>>
+    {
+        std::vector<candidate> candidates;
+        sequence s;
+        find_candidates(s, states_, {}, candidates);
+
+        std::stable_sort(candidates.begin(), candidates.end(), [](const candidate &lhs, const candidate &rhs) {
+            return lhs.cost.bytes + lhs.cost.cycles < rhs.cost.bytes + rhs.cost.cycles;
+        });
+
+        // The exact replacement first, then one that is cheaper still but may leave other values behind
+        std::optional<candidate> exact;
+        auto checks = 0;
+        for (const auto &c : candidates)
+        {
+            if (c.differences == 0 && ++checks <= max_checks && verify(c.instructions, true))
+            {
+                exact = c;
+                break;
+            }
+        }
+
+        std::vector<std::pair<sequence, unsigned>> found;
+        checks = 0;
+        for (const auto &c : candidates)
+        {
+            if (exact && c.cost.bytes + c.cost.cycles >= exact->cost.bytes + exact->cost.cycles)
+                break;
+
+            if (c.differences == 0 || is_dead_code(c.cost, c.differences) || ++checks > max_checks)
+                continue;
+
+            const auto clobbers = verify(c.instructions, false);
+            if (clobbers && !is_dead_code(c.cost, *clobbers))
+            {
+                found.emplace_back(c.instructions, *clobbers);
+                break;
+            }
+        }
+
+        if (exact)
+            found.emplace_back(exact->instructions, 0);
+
+        return found;
+    }
+
+private:
+    // Replacements that only work where more of the window's results aren't read than leaving out some of its
+    // instructions needs are of no use; that is what dead code elimination does already.
+    auto is_dead_code(const instruction_cost cost, const unsigned clobbers) const -> bool
+    {
+        return clobbers != 0 && std::any_of(shorter_.begin(), shorter_.end(), [&](const candidate &c) {
+                   return c.cost.bytes <= cost.bytes && c.cost.cycles <= cost.cycles &&
+                          (c.differences & ~clobbers) == 0;
+               });
+    }
+
+    // Every sequence that leaves out some of the window's instructions, and still writes the same memory
+    void find_shorter()
+    {
+        for (unsigned kept = 0; kept + 1 < 1u << window_.size(); ++kept)
+        {
+            sequence s;
+            for (size_t n = 0; n < window_.size(); ++n)
+            {
+                if ((kept & (1u << n)) != 0)
+                    s.push_back(window_[n]);
+            }
+
+            unsigned differences = 0;
+            for (size_t n = 0; n < states_.size(); ++n)
+                differences |= get_differences(run(states_[n], s), expected_[n]);
+
+            if ((differences & component::memory) == 0)
+                shorter_.push_back({s, estimate_cost(s), differences});
+        }
+    }
+
+    void create_alphabet()
+    {
+        std::vector<std::string> operands{"", "#0", "#1"};
+        for (const auto &i : window_)
+        {
+            if (!i.operand.empty() && std::find(operands.begin(), operands.end(), i.operand) == operands.end())
+                operands.push_back(i.operand);
+        }
+
+        for (const auto o : {mos6502_opcode::lda, mos6502_opcode::ldx, mos6502_opcode::ldy, mos6502_opcode::sta,
+                             mos6502_opcode::stx, mos6502_opcode::sty, mos6502_opcode::tax, mos6502_opcode::tay,
+                             mos6502_opcode::txa, mos6502_opcode::tya, mos6502_opcode::inx, mos6502_opcode::iny,
+                             mos6502_opcode::dex, mos6502_opcode::dey, mos6502_opcode::inc, mos6502_opcode::dec,
+                             mos6502_opcode::asl, mos6502_opcode::lsr, mos6502_opcode::rol, mos6502_opcode::ror,
+                             mos6502_opcode::AND, mos6502_opcode::ORA, mos6502_opcode::eor, mos6502_opcode::adc,
+                             mos6502_opcode::sbc, mos6502_opcode::cmp, mos6502_opcode::cpx, mos6502_opcode::cpy,
+                             mos6502_opcode::bit, mos6502_opcode::clc, mos6502_opcode::sec})
+        {
+            for (const auto &operand : operands)
+            {
+                rule_operation i{o, operand};
+                if (can_simulate(i))
+                    alphabet_.push_back(i);
+            }
+        }
+    }
+
+    void create_states()
+    {
+        std::mt19937 random(0x6502);
+        std::uniform_int_distribution<int> byte(0, 0xff);
+        for (auto n = 0; n < test_states; ++n)
+        {
+            machine_state state;
+            for (unsigned c = component::a; c < component::first_immediate << max_placeholders; c <<= 1)
+                set_component(state, c, static_cast<std::uint8_t>(byte(random)));
+            states_.push_back(state);
+        }
+
+        for (const auto &state : states_)
+            expected_.push_back(run(state, window_));
+    }
+
+    void find_candidates(sequence &s, const std::vector<machine_state> &states, const instruction_cost cost,
+                         std::vector<candidate> &candidates) const
+    {
+        if (is_cheaper(cost, window_cost_))
+        {
+            unsigned differences = 0;
+            for (size_t n = 0; n < states.size(); ++n)
+                differences |= get_differences(states[n], expected_[n]);
+
+            // Replacements may only leave other values behind where the window writes something
+            if ((differences & ~window_writes_) == 0)
+                candidates.push_back({s, cost, differences});
+        }
+
+        if (s.size() == max_length_)
+            return;
+
+        for (const auto &i : alphabet_)
+        {
+            const auto added = estimate_cost(i);
+            const instruction_cost next{cost.bytes + added.bytes, cost.cycles + added.cycles};
+            if (next.bytes > window_cost_.bytes || next.cycles > window_cost_.cycles)
+                continue;
+
+            auto next_states = states;
+            for (auto &state : next_states)
+                internal::simulate(state, i.opcode, i.operand);
+
+            s.push_back(i);
+            find_candidates(s, next_states, next, candidates);
+            s.pop_back();
+        }
+    }
+
+    // Runs both sequences on every value of everything either of them reads, with everything else set to all zero
+    // bits and then to all one bits. Returns the registers and flags that may differ, or nothing if memory may or if
+    // the replacement is of no use; because it has to be exact, or leaves nothing of the window's results.
+    auto verify(const sequence &replacement, const bool exact) const -> std::optional<unsigned>
+    {
+        const auto inputs = get_inputs(window_) | get_inputs(replacement);
+        std::vector<unsigned> input_components;
+        auto bits = 0;
+        for (unsigned c = component::a; c < component::first_immediate << max_placeholders; c <<= 1)
+        {
+            if ((inputs & c) == 0)
+                continue;
+            input_components.push_back(c);
+            bits += c == component::carry ? 1 : 8;
+        }
+
+        if (bits > max_input_bits)
+            return std::nullopt;
+
+        const auto cost = estimate_cost(replacement);
+        unsigned differences = 0;
+        for (const auto filler : {0x00, 0xff})
+        {
+            machine_state base;
+            for (unsigned c = component::a; c < component::first_immediate << max_placeholders; c <<= 1)
+                set_component(base, c, static_cast<std::uint8_t>(filler));
+
+            for (std::uint32_t value = 0; value < (1u << bits); ++value)
+            {
+                auto state = base;
+                auto shift = 0;
+                for (const auto c : input_components)
+                {
+                    const auto width = c == component::carry ? 1 : 8;
+                    set_component(state, c, static_cast<std::uint8_t>((value >> shift) & ((1u << width) - 1)));
+                    shift += width;
+                }
+
+                differences |= get_differences(run(state, window_), run(state, replacement));
+                if ((differences & component::memory) != 0 || (exact && differences != 0) ||
+                    is_dead_code(cost, differences))
+                {
+                    return std::nullopt;
+                }
+            }
+        }
+
+        return differences;
+    }
+
+    const sequence &window_;
+    size_t max_length_;
+    instruction_cost window_cost_;
+    unsigned window_writes_ = 0;
+    std::vector<rule_operation> alphabet_;
+    std::vector<machine_state> states_;
+    std::vector<machine_state> expected_;
+    std::vector<candidate> shorter_;
+};
+
+auto to_initializer(const sequence &s) -> std::string
+{
+    std::string text = "{";
+    for (const auto &i : s)
+    {
+        if (text.size() > 1)
+            text += ", ";
+        text += "{mos6502_opcode::" + get_enum_name(i.opcode) + ", \"" + i.operand + "\"}";
+    }
+    return text + "}";
+}
+
+auto to_clobbers(const unsigned differences) -> std::string
+{
+    std::vector<std::string> parts;
+    if ((differences & component::a) != 0)
+        parts.emplace_back("register_a");
+    if ((differences & component::x) != 0)
+        parts.emplace_back("register_x");
+    if ((differences & component::y) != 0)
+        parts.emplace_back("register_y");
+
+    std::vector<std::string> flags;
+    if ((differences & component::carry) != 0)
+        flags.emplace_back("mos6502_flags::carry");
+    if ((differences & component::zero) != 0)
+        flags.emplace_back("mos6502_flags::zero");
+    if ((differences & component::overflow) != 0)
+        flags.emplace_back("mos6502_flags::overflow");
+    if ((differences & component::negative) != 0)
+        flags.emplace_back("mos6502_flags::negative");
+
+    if (!flags.empty())
+    {
+        auto mask = flags[0];
+        for (size_t n = 1; n < flags.size(); ++n)
+            mask += " | " + flags[n];
+        parts.push_back("get_flags_mask(" + mask + ")");
+    }
+
+    if (parts.empty())
+        return "0";
+
+    auto text = parts[0];
+    for (size_t n = 1; n < parts.size(); ++n)
+        text += " | " + parts[n];
+    return text;
+}
+
+auto parse_options(const int argc, char **argv) -> options
+{
+    options result;
+    for (auto n = 1; n < argc; ++n)
+    {
+        const std::string argument = argv[n];
+        if (argument == "--windows" && n + 1 < argc)
+            result.windows = std::stoul(argv[++n]);
+        else if (argument == "--length" && n + 1 < argc)
+            result.max_length = std::stoul(argv[++n]);
+        else
+            result.files.push_back(argument);
+    }
+    return result;
+}
+
+} // namespace
+
+int main(const int argc, char **argv)
+{
+    const auto o = parse_options(argc, argv);
+
+    window_counter counter;
+    if (o.files.empty())
+        counter.add_file(std::cin);
+
+    for (const auto &file : o.files)
+    {
+        std::ifstream input(file);
+        if (!input)
+        {
+            std::cerr << "Cannot open " << file << '\n';
+            return EXIT_FAILURE;
+        }
+        counter.add_file(input);
+    }
+
+    std::cout << "// Generated by mos6502-superoptimizer from the most common sequences in its input; do not edit.\n"
+              << "// Every replacement was checked against all values of the registers, flags, locations and\n"
+              << "// immediates it reads.\n";
+
+    for (const auto &[key, frequency] : counter.get_hottest(o.windows))
+    {
+        const auto &window = counter.get_window(key);
+        const auto window_cost = estimate_cost(window);
+        for (const auto &[replacement, clobbers] : searcher(window, o.max_length).search())
+        {
+            const auto cost = estimate_cost(replacement);
+            std::cout << "\n// " << key << " (" << window_cost.bytes << " bytes, " << window_cost.cycles
+                      << " cycles, seen " << frequency << " times)\n"
+                      << "// -> " << to_string(replacement) << " (" << cost.bytes << " bytes, " << cost.cycles
+                      << " cycles)\n"
+                      << "{" << to_initializer(window) << ",\n " << to_initializer(replacement) << ",\n "
+                      << to_clobbers(clobbers) << "},\n";
+        }
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <ca/cross_assembler.h>
+#include <mos6502/mos6502_target.h>
+#include "opcodes.h"
+#include <gtest/gtest.h>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// Renders the given lines the way assemble returns them.
+inline auto to_strings(const std::vector<mos6502> &instructions) -> std::vector<std::string>
+{
+    std::vector<std::string> lines;
+    for (const auto &i : instructions)
+    {
+        auto line = i.to_string();
+        line = line.substr(0, line.find(';'));
+        line.erase(0, line.find_first_not_of(' '));
+        line.erase(line.find_last_not_of(' ') + 1);
+        lines.emplace_back(std::move(line));
+    }
+    return lines;
+}
+
+// Creates an instruction with a literal operand, for tests that run a single pass.
+inline auto create(const mos6502_opcode o, const std::string &operand = "") -> mos6502
+{
+    return operand.empty() ? mos6502(o) : mos6502(o, ca::instruction_operand(ca::operand_type::literal, operand));
+}
+
+// Runs the given x86 source through the cross assembler and returns the generated 6502 lines,
+// stripped of their source comments and indentation.
+inline auto assemble(const std::string &source, const calling_convention convention = calling_convention::stack,
+                     const instruction_set instructions = instruction_set::nmos6502,
+                     const optimization_options &options = {}) -> std::vector<std::string>
+{
+    std::istringstream input{source};
+    const auto old_input = std::cin.rdbuf(input.rdbuf());
+    std::cin.clear();
+
+    testing::internal::CaptureStdout();
+    mos6502_target target{convention, instructions, std::nullopt, options};
+    ca::cross_assembler assembler{target};
+    assembler.assemble();
+    const auto output = testing::internal::GetCapturedStdout();
+
+    std::cin.rdbuf(old_input);
+    std::cin.clear();
+
+    std::vector<std::string> lines;
+    std::istringstream stream{output};
+    std::string line;
+    while (std::getline(stream, line))
+    {
+        line = line.substr(0, line.find(';'));
+        line.erase(0, line.find_first_not_of(' '));
+        line.erase(line.find_last_not_of(' ') + 1);
+        lines.emplace_back(std::move(line));
+    }
+
+    return lines;
+}
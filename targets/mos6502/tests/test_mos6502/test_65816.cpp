@@ -0,0 +1,114 @@
+#include "assemble.h"
+#include "passes.h"
+#include <gtest/gtest.h>
+
+static auto assemble_65816(const std::string &source) -> std::vector<std::string>
+{
+    return assemble(source, calling_convention::stack, instruction_set::wdc65816);
+}
+
+TEST(test_65816, test_locals_are_placed_in_the_direct_page)
+{
+    const auto result = assemble_65816("_main:\n"
+                                       "\tsubl\t$4, %esp\n"
+                                       "\tmovb\t53280, %al\n"
+                                       "\tmovb\t%al, 3(%esp)\n"
+                                       "\taddl\t$4, %esp\n"
+                                       "\tretl\n");
+
+    const std::vector<std::string> expected{"main", "lda 53280", "sta $03", "sta 106", "rts"};
+    EXPECT_EQ(expected, result);
+}
+
+TEST(test_65816, test_arguments_are_read_with_stack_relative_addressing)
+{
+    const auto result = assemble_65816("_main:\n"
+                                       "\tpushl\t$3\n"
+                                       "\tcalll\t_f\n"
+                                       "\taddl\t$4, %esp\n"
+                                       "\tretl\n"
+                                       "_f:\n"
+                                       "\tmovb\t4(%esp), %al\n"
+                                       "\tmovb\t%al, 53280\n"
+                                       "\tretl\n");
+
+    // Every argument takes two bytes on the stack, above the return address, and is pulled off after the call
+    const std::vector<std::string> expected{"main",    "pea $0003", "jsr f",     "pla", "pla", "rts",
+                                            "f",       "lda 3,s",   "sta $03",   "sta 53280", "rts"};
+    EXPECT_EQ(expected, result);
+}
+
+TEST(test_65816, test_memcpy_uses_mvn)
+{
+    const auto result = assemble_65816("_main:\n"
+                                       "\tpushl\t$100\n"
+                                       "\tpushl\t$4096\n"
+                                       "\tpushl\t$8192\n"
+                                       "\tcalll\tmemcpy\n"
+                                       "\taddl\t$12, %esp\n"
+                                       "\tretl\n");
+
+    const std::vector<std::string> expected{"main",      "rep #$30", "lda #$0063", "ldx #$1000", "ldy #$2000",
+                                            "mvn 0,0",   "sep #$30", "stz $03",    "lda #32",    "sta $04",
+                                            "rts"};
+    EXPECT_EQ(expected, result);
+}
+
+TEST(test_65816, test_memmove_onto_the_end_of_the_source_uses_mvp)
+{
+    const auto result = assemble_65816("_main:\n"
+                                       "\tpushl\t$100\n"
+                                       "\tpushl\t$4096\n"
+                                       "\tpushl\t$4097\n"
+                                       "\tcalll\tmemmove\n"
+                                       "\taddl\t$12, %esp\n"
+                                       "\tretl\n");
+
+    // mvp copies from the last byte down
+    const std::vector<std::string> expected{"main",    "rep #$30", "lda #$0063", "ldx #$1063", "ldy #$1064",
+                                            "mvp 0,0", "sep #$30", "lda #1",     "sta $03",    "lda #16",
+                                            "sta $04", "rts"};
+    EXPECT_EQ(expected, result);
+}
+
+TEST(test_65816, test_16bit_add_uses_the_wide_accumulator)
+{
+    std::vector<mos6502> instructions;
+    instructions.emplace_back(create(mos6502_opcode::clc));
+    instructions.emplace_back(create(mos6502_opcode::lda, "$fb"));
+    instructions.emplace_back(create(mos6502_opcode::adc, "#$e8"));
+    instructions.emplace_back(create(mos6502_opcode::sta, "$fb"));
+    instructions.emplace_back(create(mos6502_opcode::lda, "$fc"));
+    instructions.emplace_back(create(mos6502_opcode::adc, "#$03"));
+    instructions.emplace_back(create(mos6502_opcode::sta, "$fc"));
+    instructions.emplace_back(create(mos6502_opcode::asl, "$fd"));
+    instructions.emplace_back(create(mos6502_opcode::rol, "$fe"));
+    instructions.emplace_back(create(mos6502_opcode::lda, "#0"));
+    instructions.emplace_back(create(mos6502_opcode::rts));
+
+    EXPECT_TRUE(internal::use_16bit_accumulator(instructions, internal::zero_page_registers{}));
+
+    const std::vector<std::string> expected{"clc",     "rep #$20", "lda $fb", "adc #$03e8", "sta $fb",
+                                            "asl $fd", "sep #$20", "lda #0",  "rts"};
+    EXPECT_EQ(expected, to_strings(instructions));
+}
+
+TEST(test_65816, test_wide_accumulator_keeps_hardware_registers_and_used_results)
+{
+    // Absolute addresses may be I/O that is accessed a byte at a time
+    std::vector<mos6502> instructions;
+    instructions.emplace_back(create(mos6502_opcode::lda, "$fb"));
+    instructions.emplace_back(create(mos6502_opcode::sta, "53280"));
+    instructions.emplace_back(create(mos6502_opcode::lda, "$fc"));
+    instructions.emplace_back(create(mos6502_opcode::sta, "53281"));
+
+    // The high byte is still used in A
+    instructions.emplace_back(create(mos6502_opcode::lda, "$fb"));
+    instructions.emplace_back(create(mos6502_opcode::sta, "$fd"));
+    instructions.emplace_back(create(mos6502_opcode::lda, "$fc"));
+    instructions.emplace_back(create(mos6502_opcode::sta, "$fe"));
+    instructions.emplace_back(create(mos6502_opcode::pha));
+    instructions.emplace_back(create(mos6502_opcode::rts));
+
+    EXPECT_FALSE(internal::use_16bit_accumulator(instructions, internal::zero_page_registers{}));
+}
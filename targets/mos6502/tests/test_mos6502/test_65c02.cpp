@@ -0,0 +1,64 @@
+#include "assemble.h"
+#include <gtest/gtest.h>
+
+static auto assemble_65c02(const std::string &source) -> std::vector<std::string>
+{
+    return assemble(source, calling_convention::stack, instruction_set::wdc65c02);
+}
+
+TEST(test_65c02, test_zero_is_stored_with_stz)
+{
+    const auto result = assemble_65c02("_main:\n"
+                                       "\tmovb\t$0, 53280\n"
+                                       "\tmovb\t$0, 53281\n"
+                                       "\tretl\n");
+
+    const std::vector<std::string> expected{"main", "stz 53280", "stz 53281", "rts"};
+    EXPECT_EQ(expected, result);
+}
+
+TEST(test_65c02, test_bits_are_changed_with_tsb_and_trb)
+{
+    const auto result = assemble_65c02("_main:\n"
+                                       "\torb\t$4, 53280\n"
+                                       "\tandb\t$-5, 53281\n"
+                                       "\tretl\n");
+
+    const std::vector<std::string> expected{"main", "lda #4", "tsb 53280", "trb 53281", "rts"};
+    EXPECT_EQ(expected, result);
+}
+
+TEST(test_65c02, test_short_jumps_use_bra)
+{
+    const auto result = assemble_65c02("_main:\n"
+                                       ".LBB0_1:\n"
+                                       "\tmovb\t53280, %al\n"
+                                       "\tcmpb\t$5, %al\n"
+                                       "\tjne\t.LBB0_2\n"
+                                       "\tjmp\t.LBB0_1\n"
+                                       ".LBB0_2:\n"
+                                       "\tretl\n");
+
+    const std::vector<std::string> expected{"main",      "lbb01",     "lda 53280", "sta $03", "cmp #5",
+                                            "bne lbb02", "bra lbb01", "lbb02",     "rts"};
+    EXPECT_EQ(expected, result);
+}
+
+TEST(test_65c02, test_block_copy_uses_zero_page_indirect)
+{
+    const auto result = assemble_65c02("_main:\n"
+                                       "\tmovl\t$1, %ecx\n"
+                                       "\tmovl\t$4096, %esi\n"
+                                       "\tmovl\t$8192, %edi\n"
+                                       "\trep\tmovsb\n"
+                                       "\tretl\n");
+
+    // The pointers are moved past the block afterwards, as esi and edi are preserved across calls
+    const std::vector<std::string> expected{"main",      "lda #1",      "sta $fb", "stz $fc", "stz $22",
+                                            "lda #16",   "sta $23",     "stz $39", "lda #32", "sta $3a",
+                                            "lda ($22)", "sta ($39)",   "clc",     "lda $39", "adc #1",
+                                            "sta $39",   "bcc local_1", "inc $3a", "local_1", "clc",
+                                            "lda $22",   "adc #1",      "sta $22", "bcc local_2",
+                                            "inc $23",   "local_2",     "rts"};
+    EXPECT_EQ(expected, result);
+}
@@ -0,0 +1,111 @@
+#include "assemble.h"
+#include <gtest/gtest.h>
+
+TEST(test_arithmetic, test_add_carries_into_all_bytes_of_memory)
+{
+    const auto result = assemble("_main:\n"
+                                 "\taddl\t$300, counter\n"
+                                 "\tret\n");
+
+    const std::vector<std::string> expected{"main",          "clc",           "lda counter",   "adc #44",
+                                            "sta counter",   "lda counter+1", "adc #1",        "sta counter+1",
+                                            "bcc local_1",   "inc counter+2", "bne local_1",   "inc counter+3",
+                                            "local_1",       "rts"};
+    EXPECT_EQ(expected, result);
+}
+
+TEST(test_arithmetic, test_add_skips_zero_low_bytes)
+{
+    const auto result = assemble("_main:\n"
+                                 "\taddl\t$512, %ebx\n"
+                                 "\tret\n");
+
+    const std::vector<std::string> expected{"main", "clc", "lda $06", "adc #2", "sta $06", "rts"};
+    EXPECT_EQ(expected, result);
+}
+
+TEST(test_arithmetic, test_increment_ripples_with_branches)
+{
+    const auto result = assemble("_main:\n"
+                                 "\tincl\t%ebx\n"
+                                 "\tret\n");
+
+    const std::vector<std::string> expected{"main", "inc $05", "bne local_1", "inc $06", "local_1", "rts"};
+    EXPECT_EQ(expected, result);
+}
+
+TEST(test_arithmetic, test_decrement_tests_all_bytes_for_zero)
+{
+    const auto result = assemble("_main:\n"
+                                 "_loop:\n"
+                                 "\tdecl\t%ebx\n"
+                                 "\tjne\t_loop\n"
+                                 "\tret\n");
+
+    const std::vector<std::string> expected{"main",    "loop",    "lda $05", "bne local_1", "dec $06", "local_1",
+                                            "dec $05", "lda $05", "ora $06", "bne loop",    "rts"};
+    EXPECT_EQ(expected, result);
+}
+
+TEST(test_arithmetic, test_subtract_register_borrows_into_high_byte)
+{
+    const auto result = assemble("_main:\n"
+                                 "\tsubl\t%ebx, %eax\n"
+                                 "\tret\n");
+
+    const std::vector<std::string> expected{"main",    "sec",     "lda $03", "sbc $05", "sta $03",
+                                            "lda $04", "sbc $06", "sta $04", "rts"};
+    EXPECT_EQ(expected, result);
+}
+
+TEST(test_arithmetic, test_and_with_byte_mask_clears_high_byte)
+{
+    const auto result = assemble("_main:\n"
+                                 "\tandl\t$255, %eax\n"
+                                 "\tret\n");
+
+    const std::vector<std::string> expected{"main", "lda #0", "sta $04", "rts"};
+    EXPECT_EQ(expected, result);
+}
+
+TEST(test_arithmetic, test_byte_of_symbol_address_is_its_low_byte)
+{
+    const auto result = assemble("_main:\n"
+                                 "\tmovb\t$_table+2, %al\n"
+                                 "\taddb\t$_table, %al\n"
+                                 "\tmovb\t%al, 53280\n"
+                                 "\tret\n");
+
+    const std::vector<std::string> expected{"main",    "lda #<_table+2", "clc", "adc #<_table",
+                                            "sta $03", "sta 53280",      "rts"};
+    EXPECT_EQ(expected, result);
+}
+
+TEST(test_arithmetic, test_shift_by_register_count_loops_over_the_destination)
+{
+    const auto result = assemble("_main:\n"
+                                 "\tsall\t%cl, %ebx\n"
+                                 "\tret\n");
+
+    const std::vector<std::string> expected{"main",    "lda $fb", "and #31",     "beq local_2", "tax",     "local_1",
+                                            "asl $05", "rol $06", "dex",         "bne local_1", "local_2", "rts"};
+    EXPECT_EQ(expected, result);
+}
+
+TEST(test_arithmetic, test_zero_extension_clears_the_high_byte_of_the_register)
+{
+    const auto result = assemble("_main:\n"
+                                 "\tmovl\t1028, %ebx\n"
+                                 "\tmovzbl\t1024, %ebx\n"
+                                 "\tmovl\t%ebx, 1100\n"
+                                 "\tmovzwl\t1030, %ebx\n"
+                                 "\tmovl\t%ebx, 1104\n"
+                                 "\tret\n");
+
+    const std::vector<std::string> expected{
+        "main",     "lda 1028", "lda 1029", "lda 1024", "sta $05",  "lda #0",   "sta $06",  "lda $05",
+        "sta 1100", "lda $06",  "sta 1101", "sta 1102", "sta 1103", "lda 1030", "sta $05",  "lda 1031",
+        "sta $06",  "lda $05",  "sta 1104", "lda $06",  "sta 1105", "lda #0",   "sta 1106", "sta 1107",
+        "rts"};
+    EXPECT_EQ(expected, result);
+}
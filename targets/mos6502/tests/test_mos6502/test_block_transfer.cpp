@@ -0,0 +1,85 @@
+#include "assemble.h"
+#include <gtest/gtest.h>
+
+TEST(test_block_transfer, test_small_memcpy_is_unrolled)
+{
+    const auto result = assemble("_main:\n"
+                                 "\tpushl\t$3\n"
+                                 "\tpushl\t$sprite\n"
+                                 "\tpushl\t$buffer\n"
+                                 "\tcalll\tmemcpy\n"
+                                 "\taddl\t$12, %esp\n"
+                                 "\tmovl\t$0, %eax\n"
+                                 "\tret\n");
+
+    const std::vector<std::string> expected{"main",       "lda sprite",   "sta buffer", "lda sprite+1",
+                                            "sta buffer+1", "lda sprite+2", "sta buffer+2", "lda #0",
+                                            "sta $03",    "sta $04",      "rts"};
+    EXPECT_EQ(expected, result);
+}
+
+TEST(test_block_transfer, test_memset_loops_over_pages_and_rest)
+{
+    const auto result = assemble("_main:\n"
+                                 "\tpushl\t$300\n"
+                                 "\tpushl\t$0\n"
+                                 "\tpushl\t$screen\n"
+                                 "\tcalll\tmemset\n"
+                                 "\taddl\t$12, %esp\n"
+                                 "\tmovl\t$0, %eax\n"
+                                 "\tret\n");
+
+    const std::vector<std::string> expected{"main",    "lda #0",  "ldy #0",          "local_1", "sta screen,y",
+                                            "dey",     "bne local_1", "ldy #44",     "local_2", "sta screen+255,y",
+                                            "dey",     "bne local_2", "lda #0",      "sta $03", "sta $04",
+                                            "rts"};
+    EXPECT_EQ(expected, result);
+}
+
+TEST(test_block_transfer, test_memcpy_from_register_calls_library)
+{
+    const auto result = assemble("_main:\n"
+                                 "\tpushl\t$4\n"
+                                 "\tpushl\t%ebx\n"
+                                 "\tpushl\t$screen\n"
+                                 "\tcalll\tmemcpy\n"
+                                 "\taddl\t$12, %esp\n"
+                                 "\tret\n");
+
+    const std::vector<std::string> expected{"main",       "lda #4",  "pha", "lda $05",    "pha", "lda $06",
+                                            "pha",        "lda #>screen", "pha", "lda #<screen", "pha",
+                                            "jmp memcpy"};
+    EXPECT_EQ(expected, result);
+}
+
+TEST(test_block_transfer, test_rep_stosb_with_known_count_is_unrolled)
+{
+    const auto result = assemble("_main:\n"
+                                 "\tmovl\t$3, %ecx\n"
+                                 "\tmovb\t$0, %al\n"
+                                 "\trep\tstosb\n"
+                                 "\tmovl\t$0, %edi\n"
+                                 "\tret\n");
+
+    const std::vector<std::string> expected{"main",        "lda #0", "sta $03",     "ldy #2",  "sta ($39),y",
+                                            "dey",         "sta ($39),y", "dey",     "sta ($39),y", "local_1",
+                                            "lda #0",      "sta $39", "sta $3a",     "rts"};
+    EXPECT_EQ(expected, result);
+}
+
+TEST(test_block_transfer, test_rep_movsb_counts_pages_with_x)
+{
+    const auto result = assemble("_main:\n"
+                                 "\trep\tmovsb\n"
+                                 "\tmovl\t$0, %esi\n"
+                                 "\tmovl\t$0, %edi\n"
+                                 "\tret\n");
+
+    const std::vector<std::string> expected{
+        "main",        "ldx $fc",     "beq local_1", "ldy #0",  "local_2",     "lda ($22),y", "sta ($39),y",
+        "dey",         "bne local_2", "inc $23",     "inc $3a", "dex",         "bne local_2", "local_1",
+        "ldy $fb",     "beq local_4", "local_3",     "dey",     "lda ($22),y", "sta ($39),y", "cpy #0",
+        "bne local_3", "local_4",     "local_5",     "local_6", "lda #0",      "sta $22",     "sta $23",
+        "sta $39",     "sta $3a",     "rts"};
+    EXPECT_EQ(expected, result);
+}
@@ -0,0 +1,103 @@
+#include "assemble.h"
+#include <gtest/gtest.h>
+
+TEST(test_branches, test_unsigned_jumps_after_comparison_use_inverted_carry)
+{
+    const auto result = assemble("_main:\n"
+                                 "\tcmpb\t$5, %al\n"
+                                 "\tjb\t_less\n"
+                                 "\tja\t_more\n"
+                                 "\tret\n"
+                                 "_less:\n"
+                                 "\tret\n"
+                                 "_more:\n"
+                                 "\tret\n");
+
+    const std::vector<std::string> expected{"main",    "lda $03", "cmp #5",  "bcc less", "beq local_1", "bcs more",
+                                            "local_1", "rts",     "less",    "rts",      "more",        "rts"};
+    EXPECT_EQ(expected, result);
+}
+
+TEST(test_branches, test_signed_jump_turns_comparison_into_subtraction)
+{
+    const auto result = assemble("_main:\n"
+                                 "\tcmpb\t$5, %al\n"
+                                 "\tjl\t_less\n"
+                                 "\tret\n"
+                                 "_less:\n"
+                                 "\tret\n");
+
+    const std::vector<std::string> expected{"main",     "lda $03",     "sec",     "sbc #5",   "bvc local_1",
+                                            "bpl less", "bvs local_2", "local_1", "bmi less", "local_2",
+                                            "rts",      "less",        "rts"};
+    EXPECT_EQ(expected, result);
+}
+
+TEST(test_branches, test_signed_jump_preserves_subtraction_flags)
+{
+    const auto result = assemble("_main:\n"
+                                 "\tcmpb\t$5, %al\n"
+                                 "\tmovb\t$1, %bl\n"
+                                 "\tjle\t_less\n"
+                                 "\tret\n"
+                                 "_less:\n"
+                                 "\tret\n");
+
+    const std::vector<std::string> expected{"main",     "lda $03",     "sec",     "sbc #5",   "php",
+                                            "lda #1",   "sta $05",     "plp",     "beq less", "bvc local_1",
+                                            "bpl less", "bvs local_2", "local_1", "bmi less", "local_2",
+                                            "rts",      "less",        "rts"};
+    EXPECT_EQ(expected, result);
+}
+
+TEST(test_branches, test_jumps_after_logic_know_carry_and_overflow_are_clear)
+{
+    const auto result = assemble("_main:\n"
+                                 "\ttestb\t%al, %al\n"
+                                 "\tjg\t_positive\n"
+                                 "\tjae\t_done\n"
+                                 "_positive:\n"
+                                 "\tret\n"
+                                 "_done:\n"
+                                 "\tret\n");
+
+    const std::vector<std::string> expected{"main", "lda $03",  "beq done", "bpl positive", "local_1",
+                                            "rts",  "positive", "rts",      "done",         "rts"};
+    EXPECT_EQ(expected, result);
+}
+
+TEST(test_branches, test_signed_jump_after_comparing_two_registers)
+{
+    const auto result = assemble("_main:\n"
+                                 "\tcmpb\t%cl, %al\n"
+                                 "\tjl\t_less\n"
+                                 "\tret\n"
+                                 "_less:\n"
+                                 "\tret\n");
+
+    const std::vector<std::string> expected{"main",     "lda $03",     "sec",     "sbc $fb",  "bvc local_1",
+                                            "bpl less", "bvs local_2", "local_1", "bmi less", "local_2",
+                                            "rts",      "less",        "rts"};
+    EXPECT_EQ(expected, result);
+}
+
+TEST(test_branches, test_signed_jump_uses_the_subtraction_after_an_earlier_test)
+{
+    // Without the optimizations, the bit of testb is left in front of the comparison
+    optimization_options options;
+    options.level = optimization_level::none;
+
+    const auto result = assemble("_main:\n"
+                                 "\ttestb\t%bl, %dl\n"
+                                 "\tcmpb\t$3, %dl\n"
+                                 "\tjge\t_done\n"
+                                 "\tincb\t%al\n"
+                                 "_done:\n"
+                                 "\tretl\n",
+                                 calling_convention::stack, instruction_set::nmos6502, options);
+
+    const std::vector<std::string> expected{"main",     "lda $05",     "bit $fd",  "lda $fd",     "sec",
+                                            "sbc #3",   "bvc local_1", "bmi done", "bvs local_2", "local_1",
+                                            "bpl done", "local_2",     "inc $03",  "done",        "rts"};
+    EXPECT_EQ(expected, result);
+}
@@ -0,0 +1,83 @@
+#include "assemble.h"
+#include <gtest/gtest.h>
+
+TEST(test_calling_convention, test_stack_arguments_are_pushed)
+{
+    const auto result = assemble("_main:\n"
+                                 "\tpushl\t%ebx\n"
+                                 "\tcalll\tputchar\n"
+                                 "\taddl\t$4, %esp\n"
+                                 "\tmovb\t%al, 53280\n"
+                                 "\tretl\n");
+
+    const std::vector<std::string> expected{"main",        "lda $05", "pha",       "lda $06", "pha",
+                                            "jsr putchar", "lda $03", "sta 53280", "rts"};
+    EXPECT_EQ(expected, result);
+}
+
+TEST(test_calling_convention, test_zero_page_arguments_are_stored_in_slots)
+{
+    const auto result = assemble("_main:\n"
+                                 "\tpushl\t$300\n"
+                                 "\tpushl\t%ebx\n"
+                                 "\tcalll\tplot\n"
+                                 "\taddl\t$8, %esp\n"
+                                 "\tmovb\t%al, 53280\n"
+                                 "\tretl\n",
+                                 calling_convention::zero_page);
+
+    const std::vector<std::string> expected{"main",    "lda #44",   "sta $5b", "lda #1",  "sta $5c",
+                                            "lda $05", "sta $57",   "lda $06", "sta $58", "jsr plot",
+                                            "lda $03", "sta 53280", "rts"};
+    EXPECT_EQ(expected, result);
+}
+
+TEST(test_calling_convention, test_zero_page_arguments_are_read_by_callee)
+{
+    const auto result = assemble("_main:\n"
+                                 "\tmovb\t8(%esp), %al\n"
+                                 "\tmovb\t%al, 53280\n"
+                                 "\tmovl\t4(%esp), %eax\n"
+                                 "\tretl\n",
+                                 calling_convention::zero_page);
+
+    const std::vector<std::string> expected{"main",    "lda $5b", "sta 53280", "lda $57",
+                                            "sta $03", "lda $58", "sta $04",   "rts"};
+    EXPECT_EQ(expected, result);
+}
+
+TEST(test_calling_convention, test_locals_are_placed_in_static_frames)
+{
+    const auto result = assemble("_main:\n"
+                                 "\tsubl\t$4, %esp\n"
+                                 "\tmovl\t$513, (%esp)\n"
+                                 "\tmovb\t1(%esp), %al\n"
+                                 "\tmovb\t%al, 53280\n"
+                                 "\taddl\t$4, %esp\n"
+                                 "\tretl\n",
+                                 calling_convention::zero_page);
+
+    const std::vector<std::string> expected{"main",    "lda #1",  "sta 828", "lda #2",  "sta 829",   "lda #0",
+                                            "sta 830", "sta 831", "lda 829", "sta $03", "sta 53280", "rts"};
+    EXPECT_EQ(expected, result);
+}
+
+TEST(test_calling_convention, test_zero_page_arguments_read_after_a_call_are_copied_on_entry)
+{
+    // The call to g overwrites the slot that holds the argument of main
+    const auto result = assemble("_main:\n"
+                                 "\tmovb\t4(%esp), %al\n"
+                                 "\tmovb\t%al, 53280\n"
+                                 "\tpushl\t%ebx\n"
+                                 "\tcalll\tg\n"
+                                 "\taddl\t$4, %esp\n"
+                                 "\tmovb\t4(%esp), %al\n"
+                                 "\tmovb\t%al, 53281\n"
+                                 "\tretl\n",
+                                 calling_convention::zero_page);
+
+    const std::vector<std::string> expected{"main",    "lda $57",   "sta 828",   "lda $58", "sta 829", "lda 828",
+                                            "sta $03", "sta 53280", "lda $05",   "sta $57", "lda $06", "sta $58",
+                                            "jsr g",   "lda 828",   "sta $03",   "sta 53281", "rts"};
+    EXPECT_EQ(expected, result);
+}
@@ -0,0 +1,111 @@
+#include "assemble.h"
+#include "cfg.h"
+#include <gtest/gtest.h>
+
+static auto label(const std::string &name) -> mos6502
+{
+    return mos6502(ca::asm_line::line_type::label, name);
+}
+
+// Two nested loops, followed by a call to a function with a branch around a store
+static auto create_nested_loops() -> std::vector<mos6502>
+{
+    std::vector<mos6502> instructions;
+    instructions.emplace_back(label("main"));
+    instructions.emplace_back(create(mos6502_opcode::ldx, "#3"));
+    instructions.emplace_back(label("outer"));
+    instructions.emplace_back(create(mos6502_opcode::ldy, "#4"));
+    instructions.emplace_back(label("inner"));
+    instructions.emplace_back(create(mos6502_opcode::dey));
+    instructions.emplace_back(create(mos6502_opcode::bne, "inner"));
+    instructions.emplace_back(create(mos6502_opcode::dex));
+    instructions.emplace_back(create(mos6502_opcode::bne, "outer"));
+    instructions.emplace_back(create(mos6502_opcode::jsr, "sub"));
+    instructions.emplace_back(create(mos6502_opcode::rts));
+    instructions.emplace_back(label("sub"));
+    instructions.emplace_back(create(mos6502_opcode::lda, "#1"));
+    instructions.emplace_back(create(mos6502_opcode::beq, "skip"));
+    instructions.emplace_back(create(mos6502_opcode::sta, "53280"));
+    instructions.emplace_back(label("skip"));
+    instructions.emplace_back(create(mos6502_opcode::rts));
+    return instructions;
+}
+
+TEST(test_cfg, test_blocks_end_at_branches_and_start_at_labels)
+{
+    const auto cfg = internal::build_control_flow_graph(create_nested_loops());
+
+    ASSERT_EQ(8u, cfg.blocks.size());
+    EXPECT_EQ(4u, cfg.blocks[2].begin);
+    EXPECT_EQ(7u, cfg.blocks[2].end);
+    EXPECT_EQ(2u, cfg.block_of[6]);
+    EXPECT_EQ(2u, cfg.labels.at("inner"));
+
+    const std::vector<size_t> inner{2, 3};
+    EXPECT_EQ(inner, cfg.blocks[2].successors);
+    const std::vector<size_t> outer{1, 4};
+    EXPECT_EQ(outer, cfg.blocks[3].successors);
+    const std::vector<size_t> skip{5, 6};
+    EXPECT_EQ(skip, cfg.blocks[7].predecessors);
+
+    // The call continues in the same block, and the function it calls is entered from outside
+    const std::vector<size_t> callees{5};
+    EXPECT_EQ(callees, cfg.blocks[4].callees);
+    EXPECT_TRUE(cfg.blocks[4].returns);
+    EXPECT_TRUE(cfg.blocks[4].successors.empty());
+    const std::vector<size_t> entries{0, 5};
+    EXPECT_EQ(entries, cfg.entries);
+}
+
+TEST(test_cfg, test_unknown_targets_and_the_end_leave_the_code)
+{
+    std::vector<mos6502> instructions;
+    instructions.emplace_back(create(mos6502_opcode::lda, "#1"));
+    instructions.emplace_back(create(mos6502_opcode::bne, "elsewhere"));
+    instructions.emplace_back(create(mos6502_opcode::sta, "53280"));
+
+    const auto cfg = internal::build_control_flow_graph(instructions);
+
+    ASSERT_EQ(2u, cfg.blocks.size());
+    EXPECT_TRUE(cfg.blocks[0].leaves);
+    EXPECT_TRUE(cfg.blocks[1].leaves);
+    const std::vector<size_t> fall_through{1};
+    EXPECT_EQ(fall_through, cfg.blocks[0].successors);
+}
+
+TEST(test_cfg, test_dominators)
+{
+    const auto cfg = internal::build_control_flow_graph(create_nested_loops());
+    const auto dominators = internal::find_dominators(cfg);
+
+    const std::vector<size_t> expected{0, 0, 1, 2, 3, 5, 5, 5};
+    EXPECT_EQ(expected, dominators.immediate_dominators);
+
+    EXPECT_TRUE(dominators.dominates(1, 3));
+    EXPECT_TRUE(dominators.dominates(3, 3));
+    EXPECT_FALSE(dominators.dominates(6, 7));
+    EXPECT_FALSE(dominators.dominates(0, 5));
+}
+
+TEST(test_cfg, test_loop_nest)
+{
+    const auto cfg = internal::build_control_flow_graph(create_nested_loops());
+    const auto nest = internal::find_loop_nest(cfg, internal::find_dominators(cfg));
+
+    ASSERT_EQ(2u, nest.loops.size());
+
+    EXPECT_EQ(1u, nest.loops[0].header);
+    const std::vector<size_t> outer{1, 2, 3};
+    EXPECT_EQ(outer, nest.loops[0].blocks);
+    EXPECT_EQ(internal::no_block, nest.loops[0].parent);
+    EXPECT_EQ(1, nest.loops[0].depth);
+
+    EXPECT_EQ(2u, nest.loops[1].header);
+    const std::vector<size_t> inner{2};
+    EXPECT_EQ(inner, nest.loops[1].blocks);
+    EXPECT_EQ(0u, nest.loops[1].parent);
+    EXPECT_EQ(2, nest.loops[1].depth);
+
+    const std::vector<int> depths{0, 1, 2, 1, 0, 0, 0, 0};
+    EXPECT_EQ(depths, nest.depth_of);
+}
@@ -0,0 +1,78 @@
+#include "assemble.h"
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <iterator>
+
+static auto assemble_huc6280(const std::string &source) -> std::vector<std::string>
+{
+    return assemble(source, calling_convention::stack, instruction_set::huc6280);
+}
+
+TEST(test_huc6280, test_constants_are_stored_to_the_video_display_controller_with_st0_st1_and_st2)
+{
+    const auto result = assemble_huc6280("_main:\n"
+                                         "\tmovb\t$5, 0\n"
+                                         "\tmovb\t$0, 2\n"
+                                         "\tmovb\t$1, 3\n"
+                                         "\tretl\n");
+
+    const std::vector<std::string> expected{"main", "st0 #5", "st1 #0", "st2 #1", "rts"};
+    EXPECT_EQ(expected, result);
+}
+
+TEST(test_huc6280, test_memcpy_and_memset_use_tii)
+{
+    const auto result = assemble_huc6280("_main:\n"
+                                         "\tpushl\t$100\n"
+                                         "\tpushl\t$4096\n"
+                                         "\tpushl\t$8192\n"
+                                         "\tcalll\tmemcpy\n"
+                                         "\taddl\t$12, %esp\n"
+                                         "\tpushl\t$100\n"
+                                         "\tpushl\t$32\n"
+                                         "\tpushl\t$8192\n"
+                                         "\tcalll\tmemset\n"
+                                         "\taddl\t$12, %esp\n"
+                                         "\tretl\n");
+
+    // A fill stores the first byte, and then moves every byte one up
+    const std::vector<std::string> expected{"main",    "tii 4096,8192,100", "lda #32",  "sta 8192",
+                                            "tii 8192,8193,99",   "stz $03",  "lda #32", "sta $04", "rts"};
+    EXPECT_EQ(expected, result);
+}
+
+TEST(test_huc6280, test_memmove_onto_the_end_of_the_source_uses_tdd)
+{
+    const auto result = assemble_huc6280("_main:\n"
+                                         "\tpushl\t$100\n"
+                                         "\tpushl\t$4096\n"
+                                         "\tpushl\t$4097\n"
+                                         "\tcalll\tmemmove\n"
+                                         "\taddl\t$12, %esp\n"
+                                         "\tretl\n");
+
+    const std::vector<std::string> expected{"main",   "tdd 4195,4196,100", "lda #1", "sta $03", "lda #16",
+                                            "sta $04", "rts"};
+    EXPECT_EQ(expected, result);
+}
+
+TEST(test_huc6280, test_copy_between_pointers_calls_a_transfer_written_to_ram)
+{
+    const auto result = assemble_huc6280("_main:\n"
+                                         "\tmovl\t53280, %esi\n"
+                                         "\tmovl\t53282, %edi\n"
+                                         "\tmovl\t53284, %ecx\n"
+                                         "\trep\tmovsb\n"
+                                         "\tretl\n");
+
+    // tii, its source, length and destination, and an rts
+    const std::vector<std::string> transfer{"lda #115", "sta 8704", "lda $22", "sta 8705", "lda $fb", "sta 8709",
+                                            "lda $23",  "sta 8706", "lda $fc", "sta 8710", "lda $39", "sta 8707",
+                                            "lda $3a",  "sta 8708", "lda #96", "sta 8711", "jsr 8704"};
+    const auto start = std::find(std::begin(result), std::end(result), "lda #115");
+    ASSERT_LE(transfer.size(), static_cast<size_t>(std::distance(start, std::end(result))));
+    EXPECT_TRUE(std::equal(std::begin(transfer), std::end(transfer), start));
+
+    // Nothing is transferred when ecx is zero, as a length of zero would move 64K
+    EXPECT_EQ("beq local_1", *std::prev(start));
+}
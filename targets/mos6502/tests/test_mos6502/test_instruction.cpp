@@ -0,0 +1,31 @@
+#include "assemble.h"
+#include <gtest/gtest.h>
+
+TEST(test_instruction, test_instructions_without_operand_have_an_empty_one)
+{
+    EXPECT_EQ("$fb", create(mos6502_opcode::lda, "$fb").operand().value());
+    EXPECT_TRUE(mos6502(mos6502_opcode::rts).operand().is_empty());
+}
+
+TEST(test_instruction, test_operands_keep_what_the_front_end_knew)
+{
+    const auto text = create(mos6502_opcode::lda, "#5");
+    const auto immediate =
+        mos6502(mos6502_opcode::lda, ca::instruction_operand({ca::literal_kind::immediate, 5, 1}, "#5"));
+
+    EXPECT_EQ(ca::literal_kind::text, text.operand().literal().kind);
+    EXPECT_EQ(ca::literal_kind::immediate, immediate.operand().literal().kind);
+}
+
+TEST(test_instruction, test_source_lines_are_shared)
+{
+    const source_line line{"\tmovb\t%al, 53280"};
+    auto first = create(mos6502_opcode::lda, "$03");
+    auto second = create(mos6502_opcode::sta, "53280");
+    first.set_comment(line);
+    second.set_comment(line);
+
+    EXPECT_EQ(&first.comment().text(), &second.comment().text());
+    EXPECT_TRUE(first.comment() == source_line{"\tmovb\t%al, 53280"});
+    EXPECT_EQ("    sta 53280  ; \tmovb\t%al, 53280", second.to_string());
+}
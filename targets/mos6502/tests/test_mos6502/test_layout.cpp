@@ -0,0 +1,136 @@
+#include "assemble.h"
+#include "passes.h"
+#include <gtest/gtest.h>
+
+static auto label(const std::string &name) -> mos6502
+{
+    return mos6502(ca::asm_line::line_type::label, name);
+}
+
+static auto directive(const std::string &text) -> mos6502
+{
+    return mos6502(ca::asm_line::line_type::directive, text);
+}
+
+// A loop of 4 bytes and 3 for each increment, which it ends with a return
+static void create_loop(std::vector<mos6502> &instructions, const int increments = 2)
+{
+    instructions.emplace_back(label("loop"));
+    for (auto i = 0; i < increments; ++i)
+        instructions.emplace_back(create(mos6502_opcode::inc, std::to_string(53280 + i)));
+    instructions.emplace_back(create(mos6502_opcode::dec, "$fb"));
+    instructions.emplace_back(create(mos6502_opcode::bne, "loop"));
+    instructions.emplace_back(create(mos6502_opcode::rts));
+}
+
+TEST(test_layout, test_addresses_include_data_and_alignment)
+{
+    std::vector<mos6502> instructions;
+    instructions.emplace_back(create(mos6502_opcode::lda, "#1"));
+    instructions.emplace_back(create(mos6502_opcode::sta, "53280"));
+    instructions.emplace_back(directive(".byte\t1, 2, 3"));
+    instructions.emplace_back(directive(".align 256"));
+    instructions.emplace_back(directive(".short\t1"));
+    instructions.emplace_back(create(mos6502_opcode::rts));
+
+    const std::vector<int> expected{0x0801, 0x0803, 0x0806, 0x0809, 0x0900, 0x0902, 0x0903};
+    EXPECT_EQ(expected, internal::get_addresses(instructions, 0x0801));
+
+    // Without an origin the alignment may need up to 255 bytes of padding
+    const std::vector<int> worst_case{0, 2, 5, 8, 263, 265, 266};
+    EXPECT_EQ(worst_case, internal::get_addresses(instructions, std::nullopt));
+}
+
+TEST(test_layout, test_loop_is_moved_to_the_next_page_after_return)
+{
+    std::vector<mos6502> instructions;
+    instructions.emplace_back(create(mos6502_opcode::lda, "#0"));
+    instructions.emplace_back(create(mos6502_opcode::rts));
+    create_loop(instructions);
+
+    EXPECT_TRUE(internal::align_to_pages(instructions, 0x08f8));
+
+    const std::vector<std::string> expected{"lda #0",  "rts",     "loop", "inc 53280", "inc 53281",
+                                            "dec $fb", "bne loop", "rts"};
+    auto result = to_strings(instructions);
+    ASSERT_EQ(9U, result.size());
+    EXPECT_EQ(".align 256", result[2]);
+    result.erase(result.begin() + 2);
+    EXPECT_EQ(expected, result);
+    EXPECT_EQ(0x0900, internal::get_addresses(instructions, 0x08f8)[3]);
+}
+
+TEST(test_layout, test_loop_reached_by_falling_through_is_jumped_to)
+{
+    std::vector<mos6502> instructions;
+    instructions.emplace_back(create(mos6502_opcode::lda, "#0"));
+    create_loop(instructions);
+
+    EXPECT_TRUE(internal::align_to_pages(instructions, 0x08f8));
+
+    const auto result = to_strings(instructions);
+    ASSERT_EQ(9U, result.size());
+    EXPECT_EQ("jmp loop", result[1]);
+    EXPECT_EQ(".align 256", result[2]);
+    EXPECT_EQ("loop", result[3]);
+}
+
+TEST(test_layout, test_padding_is_only_added_when_it_pays_off)
+{
+    // The loop starts 48 bytes before the end of the page, which is more padding than a single loop saves, but not
+    // more than a loop inside another one does
+    std::vector<mos6502> instructions;
+    instructions.emplace_back(create(mos6502_opcode::rts));
+    instructions.emplace_back(directive(".zero\t207"));
+    create_loop(instructions, 16);
+
+    EXPECT_FALSE(internal::align_to_pages(instructions, 0x0800));
+
+    instructions.insert(instructions.begin() + 2, label("outer"));
+    instructions.insert(instructions.end() - 1, create(mos6502_opcode::jmp, "outer"));
+
+    EXPECT_TRUE(internal::align_to_pages(instructions, 0x0800));
+
+    const auto result = to_strings(instructions);
+    ASSERT_GT(result.size(), 5U);
+    EXPECT_EQ("jmp loop", result[3]);
+    EXPECT_EQ("loop", result[5]);
+    EXPECT_EQ(0x0900, internal::get_addresses(instructions, 0x0800)[5]);
+}
+
+TEST(test_layout, test_indexed_table_is_kept_within_a_page)
+{
+    std::vector<mos6502> instructions;
+    instructions.emplace_back(label("loop"));
+    instructions.emplace_back(create(mos6502_opcode::lda, "table,x"));
+    instructions.emplace_back(create(mos6502_opcode::sta, "53280"));
+    instructions.emplace_back(create(mos6502_opcode::dex));
+    instructions.emplace_back(create(mos6502_opcode::bne, "loop"));
+    instructions.emplace_back(create(mos6502_opcode::rts));
+    instructions.emplace_back(label("table"));
+    instructions.emplace_back(directive(".byte\t1, 2, 3, 4, 5, 6, 7, 8"));
+
+    EXPECT_TRUE(internal::align_to_pages(instructions, 0x08f0));
+
+    const auto result = to_strings(instructions);
+    ASSERT_EQ(9U, result.size());
+    EXPECT_EQ(".align 256", result[6]);
+    EXPECT_EQ(0x0900, internal::get_addresses(instructions, 0x08f0)[7]);
+}
+
+TEST(test_layout, test_branch_further_than_127_bytes_is_turned_into_jump)
+{
+    // Each store takes 3 bytes, so the branch has to cover 43 of them
+    std::string source = "_main:\n"
+                         "\tcmpb\t$5, %al\n"
+                         "\tjne\t.LBB0_2\n";
+    for (auto i = 0; i < 43; ++i)
+        source += "\tmovb\t%al, " + std::to_string(1024 + i) + "\n";
+    source += ".LBB0_2:\n"
+              "\tretl\n";
+
+    const auto result = assemble(source);
+    ASSERT_GT(result.size(), 5U);
+    EXPECT_EQ("beq patch_1", result[3]);
+    EXPECT_EQ("jmp lbb02", result[4]);
+}
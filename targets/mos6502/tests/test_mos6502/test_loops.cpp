@@ -0,0 +1,81 @@
+#include "assemble.h"
+#include "passes.h"
+#include <gtest/gtest.h>
+
+TEST(test_loops, test_decrementing_counter_uses_dex)
+{
+    const auto result = assemble("_main:\n"
+                                 "\tmovb\t$10, %cl\n"
+                                 ".LBB0_1:\n"
+                                 "\tmovb\t%cl, 53280\n"
+                                 "\tdecb\t%cl\n"
+                                 "\tjne\t.LBB0_1\n"
+                                 "\tretl\n");
+
+    const std::vector<std::string> expected{"main", "ldx #10", "lbb01", "txa", "sta 53280", "dex", "bne lbb01", "rts"};
+    EXPECT_EQ(expected, result);
+}
+
+TEST(test_loops, test_incrementing_counter_that_is_read_uses_inx_and_cpx)
+{
+    const auto result = assemble("_main:\n"
+                                 "\tmovb\t$0, %dl\n"
+                                 ".LBB0_1:\n"
+                                 "\tmovb\t%dl, 53281\n"
+                                 "\tincb\t%dl\n"
+                                 "\tcmpb\t$20, %dl\n"
+                                 "\tjne\t.LBB0_1\n"
+                                 "\tretl\n");
+
+    const std::vector<std::string> expected{"main", "ldx #0",  "lbb01",     "txa", "sta 53281",
+                                            "inx",  "cpx #20", "bne lbb01", "rts"};
+    EXPECT_EQ(expected, result);
+}
+
+TEST(test_loops, test_incrementing_counter_that_is_not_read_counts_down)
+{
+    const auto result = assemble("_main:\n"
+                                 "\tmovb\t$3, %dl\n"
+                                 ".LBB0_1:\n"
+                                 "\tincb\t53280\n"
+                                 "\tincb\t%dl\n"
+                                 "\tcmpb\t$20, %dl\n"
+                                 "\tjne\t.LBB0_1\n"
+                                 "\tretl\n");
+
+    const std::vector<std::string> expected{"main", "ldx #17", "lbb01", "inc 53280", "dex", "bne lbb01", "rts"};
+    EXPECT_EQ(expected, result);
+}
+
+TEST(test_loops, test_counter_read_after_loop_is_stored)
+{
+    const auto result = assemble("_main:\n"
+                                 "\tmovb\t$5, %cl\n"
+                                 ".LBB0_1:\n"
+                                 "\tdecb\t%cl\n"
+                                 "\tjne\t.LBB0_1\n"
+                                 "\tmovb\t%cl, 53282\n"
+                                 "\tretl\n");
+
+    const std::vector<std::string> expected{"main",    "ldx #5",  "lbb01",     "dex", "bne lbb01",
+                                            "stx $fb", "lda $fb", "sta 53282", "rts"};
+    EXPECT_EQ(expected, result);
+}
+
+TEST(test_loops, test_loop_that_uses_x_counts_in_y)
+{
+    std::vector<mos6502> instructions;
+    instructions.emplace_back(create(mos6502_opcode::lda, "#8"));
+    instructions.emplace_back(create(mos6502_opcode::sta, "$fb"));
+    instructions.emplace_back(mos6502(ca::asm_line::line_type::label, "loop"));
+    instructions.emplace_back(create(mos6502_opcode::stx, "53281"));
+    instructions.emplace_back(create(mos6502_opcode::dec, "$fb"));
+    instructions.emplace_back(create(mos6502_opcode::bne, "loop"));
+    instructions.emplace_back(create(mos6502_opcode::rts));
+
+    EXPECT_TRUE(internal::use_index_register_counters(instructions, {{0xfb}, {}}));
+
+    const std::vector<std::string> expected{"lda #8",    "sta $fb", "ldy #8",   "loop",
+                                            "stx 53281", "dey",     "bne loop", "rts"};
+    EXPECT_EQ(expected, to_strings(instructions));
+}
@@ -0,0 +1,41 @@
+#include "assemble.h"
+#include <gtest/gtest.h>
+
+TEST(test_memory_operands, test_array_elements_are_indexed_by_x)
+{
+    const auto result = assemble("_main:\n"
+                                 "\tmovb\t_table(,%ecx), %al\n"
+                                 "\tmovb\t%al, 2040(%ecx)\n"
+                                 "\tmovl\t_table+2(%ecx), %edx\n"
+                                 "\tretl\n");
+
+    // X is loaded again after the indexed store, which might have changed %ecx as far as the optimizer knows
+    const std::vector<std::string> expected{"main",    "ldx $fb",        "lda _table,x", "sta $03",        "sta 2040,x",
+                                            "ldx $fb", "lda _table+2,x", "sta $fd",      "lda _table+3,x", "rts"};
+    EXPECT_EQ(expected, result);
+}
+
+TEST(test_memory_operands, test_pointers_are_indirect_indexed_by_y)
+{
+    const auto result = assemble("_main:\n"
+                                 "\tmovb\t3(%eax), %cl\n"
+                                 "\tmovb\t%cl, (%ebx)\n"
+                                 "\tmovb\t(%eax,%edx), %cl\n"
+                                 "\tmovb\t%cl, 53280\n"
+                                 "\tretl\n");
+
+    const std::vector<std::string> expected{"main",        "ldy #3",  "lda ($03),y", "sta $fb",   "ldy #0",
+                                            "sta ($05),y", "ldy $fd", "lda ($03),y", "sta 53280", "rts"};
+    EXPECT_EQ(expected, result);
+}
+
+TEST(test_memory_operands, test_each_byte_of_a_pointer_target_has_its_own_offset)
+{
+    const auto result = assemble("_main:\n"
+                                 "\tmovl\t2(%ebx), %eax\n"
+                                 "\tretl\n");
+
+    const std::vector<std::string> expected{"main",   "ldy #2",      "lda ($05),y", "sta $03",
+                                            "ldy #3", "lda ($05),y", "sta $04",     "rts"};
+    EXPECT_EQ(expected, result);
+}
@@ -0,0 +1,222 @@
+#include "assemble.h"
+#include <gtest/gtest.h>
+
+TEST(test_optimizer, test_redundant_register_copy_load_is_removed)
+{
+    const auto result = assemble("_main:\n"
+                                 "\tmovb\t%al, %bl\n"
+                                 "\tmovb\t%bl, %bh\n"
+                                 "\tret\n");
+
+    const std::vector<std::string> expected{"main", "lda $03", "sta $05", "sta $06", "rts"};
+    EXPECT_EQ(expected, result);
+}
+
+TEST(test_optimizer, test_redundant_immediate_load_is_removed)
+{
+    const auto result = assemble("_main:\n"
+                                 "\tmovb\t$1, 53280\n"
+                                 "\tmovb\t%cl, 53281\n"
+                                 "\tmovb\t$1, 53280\n"
+                                 "\tret\n");
+
+    const std::vector<std::string> expected{"main",      "lda #1", "sta 53280", "lda $fb",
+                                            "sta 53281", "lda #1", "sta 53280", "rts"};
+    EXPECT_EQ(expected, result);
+}
+
+TEST(test_optimizer, test_load_is_kept_after_label)
+{
+    const auto result = assemble("_main:\n"
+                                 "\tmovb\t%cl, 53280\n"
+                                 "_loop:\n"
+                                 "\tmovb\t%cl, 53280\n"
+                                 "\tjmp\t_loop\n");
+
+    const std::vector<std::string> expected{"main", "lda $fb", "sta 53280", "loop", "lda $fb", "sta 53280", "jmp loop"};
+    EXPECT_EQ(expected, result);
+}
+
+TEST(test_optimizer, test_load_is_kept_when_flags_are_used)
+{
+    const auto result = assemble("_main:\n"
+                                 "\tmovb\t%cl, %bl\n"
+                                 "\tincb\t%bh\n"
+                                 "\ttestb\t%cl, %cl\n"
+                                 "\tje\t_main\n"
+                                 "\tret\n");
+
+    const std::vector<std::string> expected{"main", "lda $fb", "sta $05", "inc $06", "lda $fb", "beq main", "rts"};
+    EXPECT_EQ(expected, result);
+}
+
+TEST(test_optimizer, test_store_to_zero_page_invalidates_register_copy)
+{
+    const auto result = assemble("_main:\n"
+                                 "\tmovb\t%bl, %bh\n"
+                                 "\tmovb\t$4, %bl\n"
+                                 "\tmovb\t%bh, 53280\n"
+                                 "\tret\n");
+
+    const std::vector<std::string> expected{"main", "lda $05", "sta $06", "lda #4", "sta $05",
+                                            "lda $06", "sta 53280", "rts"};
+    EXPECT_EQ(expected, result);
+}
+
+TEST(test_optimizer, test_scratch_register_store_before_return_is_removed)
+{
+    const auto result = assemble("_main:\n"
+                                 "\tmovb\t53280, %cl\n"
+                                 "\taddb\t$1, %cl\n"
+                                 "\tret\n");
+
+    // The load from memory mapped I/O must stay
+    const std::vector<std::string> expected{"main", "lda 53280", "rts"};
+    EXPECT_EQ(expected, result);
+}
+
+TEST(test_optimizer, test_overwritten_register_store_is_removed)
+{
+    const auto result = assemble("_main:\n"
+                                 "\tmovb\t53280, %bl\n"
+                                 "\tmovb\t53281, %bl\n"
+                                 "\tret\n");
+
+    const std::vector<std::string> expected{"main", "lda 53280", "lda 53281", "sta $05", "rts"};
+    EXPECT_EQ(expected, result);
+}
+
+TEST(test_optimizer, test_register_store_read_after_branch_is_kept)
+{
+    const auto result = assemble("_main:\n"
+                                 "\tmovb\t53280, %cl\n"
+                                 "_loop:\n"
+                                 "\tmovb\t%cl, 53281\n"
+                                 "\tjmp\t_loop\n");
+
+    const std::vector<std::string> expected{"main", "lda 53280", "sta $fb", "loop", "lda $fb", "sta 53281", "jmp loop"};
+    EXPECT_EQ(expected, result);
+}
+
+TEST(test_optimizer, test_add_one_to_register_becomes_increment)
+{
+    const auto result = assemble("_main:\n"
+                                 "\taddb\t$1, %bl\n"
+                                 "\taddb\t$-1, %bh\n"
+                                 "\tret\n");
+
+    const std::vector<std::string> expected{"main", "inc $05", "dec $06", "rts"};
+    EXPECT_EQ(expected, result);
+}
+
+TEST(test_optimizer, test_add_one_is_kept_when_carry_is_used)
+{
+    const auto result = assemble("_main:\n"
+                                 "\taddb\t$1, %bl\n"
+                                 "\tsbbb\t%al, %al\n"
+                                 "\tret\n");
+
+    const std::vector<std::string> expected{"main",   "lda $05", "clc",     "adc #1", "sta $05",
+                                            "lda #$00", "sbc #$00", "eor #$ff", "sta $03", "rts"};
+    EXPECT_EQ(expected, result);
+}
+
+TEST(test_optimizer, test_shift_left_stays_in_memory)
+{
+    const auto result = assemble("_main:\n"
+                                 "\tsall\t$1, %ebx\n"
+                                 "\tret\n");
+
+    const std::vector<std::string> expected{"main", "asl $05", "rol $06", "rts"};
+    EXPECT_EQ(expected, result);
+}
+
+TEST(test_optimizer, test_call_before_return_becomes_jump)
+{
+    const auto result = assemble("_main:\n"
+                                 "\tpushl\t$1\n"
+                                 "\tcalll\tputchar\n"
+                                 "\taddl\t$4, %esp\n"
+                                 "\tretl\n");
+
+    const std::vector<std::string> expected{"main", "lda #1", "pha", "jmp putchar"};
+    EXPECT_EQ(expected, result);
+}
+
+TEST(test_optimizer, test_jump_to_return_becomes_return)
+{
+    const auto result = assemble("_main:\n"
+                                 "\ttestb\t%al, %al\n"
+                                 "\tje\t_zero\n"
+                                 "\tincb\t%bl\n"
+                                 "\tjmp\t_done\n"
+                                 "_zero:\n"
+                                 "\tdecb\t%bl\n"
+                                 "_done:\n"
+                                 "\tret\n");
+
+    const std::vector<std::string> expected{"main", "lda $03", "beq zero", "inc $05", "rts",
+                                            "zero", "dec $05", "done",     "rts"};
+    EXPECT_EQ(expected, result);
+}
+
+TEST(test_optimizer, test_branch_to_jump_is_threaded)
+{
+    const auto result = assemble("_main:\n"
+                                 "\ttestb\t%al, %al\n"
+                                 "\tjne\t_skip\n"
+                                 "\tincb\t%bl\n"
+                                 "_skip:\n"
+                                 "\tjmp\t_main\n");
+
+    const std::vector<std::string> expected{"main", "lda $03", "bne main", "inc $05", "skip", "jmp main"};
+    EXPECT_EQ(expected, result);
+}
+
+TEST(test_optimizer, test_code_after_return_is_kept_at_an_unprefixed_main)
+{
+    // ELF compilers don't put an underscore in front of main
+    const auto result = assemble("foo:\n"
+                                 "\tmovb\t$1, 53280\n"
+                                 "\tret\n"
+                                 "main:\n"
+                                 "\tmovb\t$2, 53281\n"
+                                 "\tcalll\tfoo\n"
+                                 "\tret\n");
+
+    const std::vector<std::string> expected{"main", "lda #2", "sta 53281", "lda #1", "sta 53280", "rts"};
+    EXPECT_EQ(expected, result);
+}
+
+TEST(test_optimizer, test_small_leaf_function_is_inlined_and_removed)
+{
+    const auto result = assemble("_main:\n"
+                                 "\tcalll\t_next\n"
+                                 "\tcalll\t_next\n"
+                                 "\tmovb\t%al, 53280\n"
+                                 "\tretl\n"
+                                 "_next:\n"
+                                 "\tincb\t%al\n"
+                                 "\tretl\n");
+
+    const std::vector<std::string> expected{"main", "inc $03", "inc $03", "lda $03", "sta 53280", "rts"};
+    EXPECT_EQ(expected, result);
+}
+
+TEST(test_optimizer, test_large_function_with_several_callers_is_kept)
+{
+    const auto result = assemble("_main:\n"
+                                 "\tcalll\t_clear\n"
+                                 "\tcalll\t_clear\n"
+                                 "\tretl\n"
+                                 "_clear:\n"
+                                 "\tmovb\t$0, 53280\n"
+                                 "\tmovb\t$0, 53281\n"
+                                 "\tmovb\t$0, 53282\n"
+                                 "\tmovb\t$0, 53283\n"
+                                 "\tretl\n");
+
+    const std::vector<std::string> expected{"main",      "jsr clear", "clear",     "lda #0",    "sta 53280",
+                                            "sta 53281", "sta 53282", "sta 53283", "rts"};
+    EXPECT_EQ(expected, result);
+}
@@ -0,0 +1,147 @@
+#include "assemble.h"
+#include "pass_manager.h"
+#include <gtest/gtest.h>
+#include <sstream>
+
+static const std::string leaf_function_source = "_main:\n"
+                                                "\tcalll\t_next\n"
+                                                "\tcalll\t_next\n"
+                                                "\tmovb\t%al, 53280\n"
+                                                "\tretl\n"
+                                                "_next:\n"
+                                                "\tincb\t%al\n"
+                                                "\tretl\n";
+
+static auto assemble_with(const std::string &source, const optimization_options &options) -> std::vector<std::string>
+{
+    return assemble(source, calling_convention::stack, instruction_set::nmos6502, options);
+}
+
+// Returns the number of runs the statistics of a pass manager report for the given pass or analysis.
+static auto get_runs(const internal::pass_manager &passes, const std::string &name) -> int
+{
+    std::ostringstream out;
+    passes.print_statistics(out);
+
+    std::istringstream table{out.str()};
+    std::string line;
+    while (std::getline(table, line))
+    {
+        std::istringstream fields{line};
+        std::string first;
+        int runs = 0;
+        if (fields >> first >> runs && first == name)
+            return runs;
+    }
+
+    return 0;
+}
+
+TEST(test_pass_manager, test_level_none_only_runs_required_passes)
+{
+    optimization_options options;
+    options.level = optimization_level::none;
+
+    const auto result = assemble_with("_main:\n"
+                                      "\tmovb\t53280, %bl\n"
+                                      "\tmovb\t%bl, %bh\n"
+                                      "\tret\n",
+                                      options);
+
+    const std::vector<std::string> expected{"main", "lda 53280", "sta $05", "lda $05", "sta $06", "rts"};
+    EXPECT_EQ(expected, result);
+}
+
+TEST(test_pass_manager, test_shared_passes_follow_the_level_and_options)
+{
+    const std::string source = "_main:\n"
+                               "\tmovb\t$1, %bl\n"
+                               "\tmovb\t%bl, %cl\n"
+                               "\tmovb\t%cl, 53280\n"
+                               "\tretl\n";
+
+    optimization_options none;
+    none.level = optimization_level::none;
+    const std::vector<std::string> copied{"main", "lda #1", "sta $05", "lda $05", "sta $fb", "lda $fb", "sta 53280",
+                                          "rts"};
+    EXPECT_EQ(copied, assemble_with(source, none));
+
+    optimization_options propagated = none;
+    propagated.enabled_passes.emplace_back("ir-propagate-copies-and-constants");
+    const std::vector<std::string> expected{"main", "lda #1", "sta $05", "lda #1", "sta $fb", "lda #1", "sta 53280",
+                                            "rts"};
+    EXPECT_EQ(expected, assemble_with(source, propagated));
+}
+
+TEST(test_pass_manager, test_size_level_does_not_inline)
+{
+    optimization_options options;
+    options.level = optimization_level::size;
+
+    const std::vector<std::string> expected{"main", "jsr next", "jsr next", "lda $03", "sta 53280",
+                                            "rts",  "next",     "inc $03",  "rts"};
+    EXPECT_EQ(expected, assemble_with(leaf_function_source, options));
+
+    // The same as leaving out the pass at the level that would run it
+    optimization_options disabled;
+    disabled.disabled_passes.emplace_back("inline-leaf-functions");
+    EXPECT_EQ(expected, assemble_with(leaf_function_source, disabled));
+}
+
+TEST(test_pass_manager, test_enabled_pass_runs_below_its_level)
+{
+    optimization_options options;
+    options.level = optimization_level::size;
+    options.enabled_passes.emplace_back("inline-leaf-functions");
+
+    const std::vector<std::string> expected{"main", "inc $03", "inc $03", "lda $03", "sta 53280", "rts"};
+    EXPECT_EQ(expected, assemble_with(leaf_function_source, options));
+}
+
+TEST(test_pass_manager, test_unknown_and_required_passes_are_rejected)
+{
+    optimization_options unknown;
+    unknown.enabled_passes.emplace_back("vectorize");
+    EXPECT_THROW(mos6502_target(calling_convention::stack, instruction_set::nmos6502, std::nullopt, unknown),
+                 std::runtime_error);
+
+    optimization_options required;
+    required.disabled_passes.emplace_back("fix-long-branches");
+    EXPECT_THROW(mos6502_target(calling_convention::stack, instruction_set::nmos6502, std::nullopt, required),
+                 std::runtime_error);
+
+    const auto names = mos6502_target::get_pass_names();
+    EXPECT_EQ("ir-propagate-copies-and-constants", names.front());
+    EXPECT_NE(std::end(names), std::find(std::begin(names), std::end(names), "use-undocumented-opcodes"));
+}
+
+TEST(test_pass_manager, test_analyses_are_kept_until_the_code_changes)
+{
+    std::vector<mos6502> instructions;
+    instructions.emplace_back(create(mos6502_opcode::lda, "#1"));
+    instructions.emplace_back(create(mos6502_opcode::lda, "#2"));
+    instructions.emplace_back(create(mos6502_opcode::sta, "53280"));
+    instructions.emplace_back(create(mos6502_opcode::rts));
+
+    const internal::zero_page_registers registers;
+    const optimization_options options;
+    internal::pass_manager passes{instructions, registers, options};
+
+    auto observed = 0;
+    const internal::pass observe{"observe", optimization_level::basic, false, true, {internal::analysis::liveness},
+                                 [&observed](auto &, auto &) {
+                                     ++observed;
+                                     return false;
+                                 }};
+    const internal::pass remove{"remove", optimization_level::basic, false, true, {internal::analysis::liveness},
+                                [](auto &i, auto &a) { return internal::eliminate_dead_code(i, a.get_liveness()); }};
+
+    // The first round removes the dead load and starts over, the second one finds nothing left to do
+    EXPECT_TRUE(passes.run_to_fixed_point({&observe, &remove, &observe}));
+    EXPECT_EQ(3, observed);
+    EXPECT_EQ(2, get_runs(passes, "remove"));
+    EXPECT_EQ(2, get_runs(passes, "(liveness)"));
+
+    const std::vector<std::string> expected{"lda #2", "sta 53280", "rts"};
+    EXPECT_EQ(expected, to_strings(instructions));
+}
@@ -0,0 +1,154 @@
+#include "assemble.h"
+#include "liveness.h"
+#include "passes.h"
+#include "peephole.h"
+#include <gtest/gtest.h>
+#include <random>
+
+using internal::machine_state;
+
+static auto run(machine_state state, const std::vector<internal::rule_instruction> &instructions) -> machine_state
+{
+    for (const auto &[opcode, operand] : instructions)
+        EXPECT_TRUE(internal::simulate(state, opcode, operand));
+    return state;
+}
+
+// The cost of a rule's instructions, with zero page locations for its placeholders
+static auto get_cost(const std::vector<internal::rule_instruction> &instructions) -> internal::instruction_cost
+{
+    internal::instruction_cost total;
+    for (const auto &[opcode, placeholder] : instructions)
+    {
+        const std::string p = placeholder;
+        const auto operand = p.size() == 2 && p[0] == 'm' ? "$80" : p.size() == 3 && p[1] == 'k' ? "#1" : p;
+        const auto cost = internal::estimate_cost(create(opcode, operand));
+        total.bytes += cost.bytes;
+        total.cycles += cost.cycles;
+    }
+    return total;
+}
+
+TEST(test_peephole, test_simulator_sets_overflow_and_carry)
+{
+    machine_state state;
+    state.a = 0x7f;
+    EXPECT_TRUE(internal::simulate(state, mos6502_opcode::adc, "#1"));
+    EXPECT_EQ(0x80, state.a);
+    EXPECT_TRUE(state.overflow);
+    EXPECT_TRUE(state.negative);
+    EXPECT_FALSE(state.carry);
+
+    state.memory[0] = 0x81;
+    EXPECT_TRUE(internal::simulate(state, mos6502_opcode::sec, ""));
+    EXPECT_TRUE(internal::simulate(state, mos6502_opcode::sbc, "m0"));
+    EXPECT_EQ(0xff, state.a);
+    EXPECT_FALSE(state.carry);
+
+    EXPECT_FALSE(internal::simulate(state, mos6502_opcode::sta, "#k0"));
+    EXPECT_FALSE(internal::simulate(state, mos6502_opcode::jsr, "m0"));
+}
+
+TEST(test_peephole, test_rules_keep_everything_they_do_not_clobber)
+{
+    std::mt19937 random(6502);
+    std::uniform_int_distribution<int> byte(0, 0xff);
+
+    ASSERT_FALSE(internal::get_peephole_rules().empty());
+    for (const auto &rule : internal::get_peephole_rules())
+    {
+        for (auto n = 0; n < 4096; ++n)
+        {
+            machine_state state;
+            state.a = static_cast<std::uint8_t>(byte(random));
+            state.x = static_cast<std::uint8_t>(byte(random));
+            state.y = static_cast<std::uint8_t>(byte(random));
+            state.negative = byte(random) < 0x80;
+            state.zero = byte(random) < 0x80;
+            state.carry = byte(random) < 0x80;
+            state.overflow = byte(random) < 0x80;
+            for (auto &m : state.memory)
+                m = static_cast<std::uint8_t>(byte(random));
+            for (auto &k : state.immediates)
+                k = static_cast<std::uint8_t>(byte(random));
+
+            auto expected = run(state, rule.pattern);
+            auto result = run(state, rule.replacement);
+
+            // Whatever the rule may clobber is left out of the comparison
+            const auto clobbered = [&rule](const std::uint32_t mask) { return (rule.clobbers & mask) != 0; };
+            if (clobbered(internal::register_a))
+                result.a = expected.a;
+            if (clobbered(internal::register_x))
+                result.x = expected.x;
+            if (clobbered(internal::register_y))
+                result.y = expected.y;
+            if (clobbered(internal::get_flags_mask(mos6502_flags::negative)))
+                result.negative = expected.negative;
+            if (clobbered(internal::get_flags_mask(mos6502_flags::zero)))
+                result.zero = expected.zero;
+            if (clobbered(internal::get_flags_mask(mos6502_flags::carry)))
+                result.carry = expected.carry;
+            if (clobbered(internal::get_flags_mask(mos6502_flags::overflow)))
+                result.overflow = expected.overflow;
+
+            ASSERT_TRUE(expected == result);
+        }
+    }
+}
+
+TEST(test_peephole, test_rules_are_cheaper)
+{
+    for (const auto &rule : internal::get_peephole_rules())
+    {
+        const auto before = get_cost(rule.pattern);
+        const auto after = get_cost(rule.replacement);
+        EXPECT_LE(after.bytes, before.bytes);
+        EXPECT_LE(after.cycles, before.cycles);
+        EXPECT_LT(after.bytes + after.cycles, before.bytes + before.cycles);
+    }
+}
+
+TEST(test_peephole, test_rule_is_applied_to_zero_page_locations)
+{
+    std::vector<mos6502> instructions;
+    instructions.emplace_back(create(mos6502_opcode::sta, "$fb"));
+    instructions.emplace_back(create(mos6502_opcode::lda, "$fc"));
+    instructions.emplace_back(create(mos6502_opcode::ORA, "$fb"));
+    instructions.emplace_back(create(mos6502_opcode::sta, "53280"));
+    instructions.emplace_back(create(mos6502_opcode::sta, "53281"));
+    instructions.emplace_back(create(mos6502_opcode::lda, "53282"));
+    instructions.emplace_back(create(mos6502_opcode::ORA, "53281"));
+    instructions.emplace_back(create(mos6502_opcode::rts));
+
+    EXPECT_TRUE(internal::apply_peephole_rules(instructions, internal::zero_page_registers{}));
+
+    const std::vector<std::string> expected{"sta $fb",   "ora $fc",   "sta 53280", "sta 53281",
+                                            "lda 53282", "ora 53281", "rts"};
+    EXPECT_EQ(expected, to_strings(instructions));
+}
+
+TEST(test_peephole, test_rule_is_only_applied_where_clobbers_are_dead)
+{
+    // Only the carry of the addition is read afterwards
+    std::vector<mos6502> instructions;
+    instructions.emplace_back(create(mos6502_opcode::clc));
+    instructions.emplace_back(create(mos6502_opcode::lda, "$fb"));
+    instructions.emplace_back(create(mos6502_opcode::adc, "#128"));
+    instructions.emplace_back(create(mos6502_opcode::rol, "$fc"));
+    instructions.emplace_back(create(mos6502_opcode::rts));
+
+    EXPECT_TRUE(internal::apply_peephole_rules(instructions, internal::zero_page_registers{}));
+
+    const std::vector<std::string> expected{"lda $fb", "asl", "rol $fc", "rts"};
+    EXPECT_EQ(expected, to_strings(instructions));
+
+    std::vector<mos6502> live;
+    live.emplace_back(create(mos6502_opcode::clc));
+    live.emplace_back(create(mos6502_opcode::lda, "$fb"));
+    live.emplace_back(create(mos6502_opcode::adc, "#128"));
+    live.emplace_back(create(mos6502_opcode::sta, "53280"));
+    live.emplace_back(create(mos6502_opcode::rts));
+
+    EXPECT_FALSE(internal::apply_peephole_rules(live, internal::zero_page_registers{}));
+}
@@ -0,0 +1,94 @@
+#include "assemble.h"
+#include "passes.h"
+#include <gtest/gtest.h>
+
+static auto assemble_undocumented(const std::string &source) -> std::vector<std::string>
+{
+    return assemble(source, calling_convention::stack, instruction_set::nmos6502_undocumented);
+}
+
+static auto get_cost(const std::vector<mos6502> &instructions) -> internal::instruction_cost
+{
+    internal::instruction_cost total;
+    for (const auto &i : instructions)
+    {
+        total.bytes += internal::estimate_cost(i).bytes;
+        total.cycles += internal::estimate_cost(i).cycles;
+    }
+    return total;
+}
+
+TEST(test_undocumented_opcodes, test_mask_before_add_uses_anc)
+{
+    const auto result = assemble_undocumented("_main:\n"
+                                              "\tandb\t$6, %cl\n"
+                                              "\taddb\t$3, %cl\n"
+                                              "\tmovb\t%cl, 53281\n"
+                                              "\tretl\n");
+
+    const std::vector<std::string> expected{"main", "lda $fb", "anc #6", "adc #3", "sta 53281", "rts"};
+    EXPECT_EQ(expected, result);
+}
+
+TEST(test_undocumented_opcodes, test_decrement_and_compare_uses_dcp)
+{
+    const auto result = assemble_undocumented("_main:\n"
+                                              "\tdecb\t53282\n"
+                                              "\tcmpb\t53282, %al\n"
+                                              "\tjne\t_main\n"
+                                              "\tretl\n");
+
+    const std::vector<std::string> expected{"main", "lda $03", "dcp 53282", "bne main", "rts"};
+    EXPECT_EQ(expected, result);
+}
+
+TEST(test_undocumented_opcodes, test_default_instruction_set_keeps_documented_opcodes)
+{
+    const auto result = assemble("_main:\n"
+                                 "\tandb\t$6, %cl\n"
+                                 "\taddb\t$3, %cl\n"
+                                 "\tmovb\t%cl, 53281\n"
+                                 "\tretl\n");
+
+    const std::vector<std::string> expected{"main", "lda $fb", "and #6", "clc", "adc #3", "sta 53281", "rts"};
+    EXPECT_EQ(expected, result);
+}
+
+TEST(test_undocumented_opcodes, test_replacements_are_cheaper)
+{
+    std::vector<mos6502> instructions;
+    instructions.emplace_back(create(mos6502_opcode::lda, "53280,y"));
+    instructions.emplace_back(create(mos6502_opcode::tax));
+    instructions.emplace_back(create(mos6502_opcode::inc, "$fb"));
+    instructions.emplace_back(create(mos6502_opcode::sbc, "$fb"));
+    instructions.emplace_back(create(mos6502_opcode::AND, "#$f0"));
+    instructions.emplace_back(create(mos6502_opcode::lsr));
+    instructions.emplace_back(create(mos6502_opcode::sta, "53280"));
+    instructions.emplace_back(create(mos6502_opcode::txa));
+    instructions.emplace_back(create(mos6502_opcode::AND, "#15"));
+    instructions.emplace_back(create(mos6502_opcode::sta, "53281"));
+    instructions.emplace_back(create(mos6502_opcode::lda, "#0"));
+    instructions.emplace_back(create(mos6502_opcode::rts));
+
+    const auto before = get_cost(instructions);
+    EXPECT_TRUE(internal::use_undocumented_opcodes(instructions, internal::zero_page_registers{}));
+    const auto after = get_cost(instructions);
+
+    const std::vector<std::string> expected{"lax 53280,y", "isc $fb",   "alr #$f0", "sta 53280",
+                                            "lda #15",     "sax 53281", "lda #0",   "rts"};
+    EXPECT_EQ(expected, to_strings(instructions));
+    EXPECT_LT(after.bytes, before.bytes);
+    EXPECT_LT(after.cycles, before.cycles);
+}
+
+TEST(test_undocumented_opcodes, test_load_indexed_by_x_is_kept)
+{
+    std::vector<mos6502> instructions;
+    instructions.emplace_back(create(mos6502_opcode::lda, "53280,x"));
+    instructions.emplace_back(create(mos6502_opcode::tax));
+    instructions.emplace_back(create(mos6502_opcode::AND, "#$80"));
+    instructions.emplace_back(create(mos6502_opcode::clc));
+    instructions.emplace_back(create(mos6502_opcode::rts));
+
+    EXPECT_FALSE(internal::use_undocumented_opcodes(instructions, internal::zero_page_registers{}));
+}
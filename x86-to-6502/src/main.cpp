@@ -1,11 +1,93 @@
 #include <ca/cross_assembler.h>
+#include <ca/linker.h>
 #include <mos6502/mos6502_target.h>
+#include <fstream>
+#include <iostream>
+#include <optional>
+#include <stdexcept>
+#include <sstream>
+#include <string>
+#include <vector>
 
 int main(int argc, char *argv[])
 {
-    mos6502_target target;
-    ca::cross_assembler assembler{target};
-    assembler.assemble();
+    auto convention = calling_convention::stack;
+    auto instructions = instruction_set::nmos6502;
+    std::optional<int> origin;
+    optimization_options optimizations;
+    std::vector<std::string> files;
+
+    for (auto i = 1; i < argc; ++i)
+    {
+        if (std::string(argv[i]) == "--zero-page-arguments")
+            convention = calling_convention::zero_page;
+        else if (std::string(argv[i]) == "--65c02")
+            instructions = instruction_set::wdc65c02;
+        else if (std::string(argv[i]) == "--65816")
+            instructions = instruction_set::wdc65816;
+        else if (std::string(argv[i]) == "--huc6280")
+            instructions = instruction_set::huc6280;
+        else if (std::string(argv[i]) == "--undocumented-opcodes")
+            instructions = instruction_set::nmos6502_undocumented;
+        else if (std::string(argv[i]) == "--origin" && i + 1 < argc)
+            origin = std::stoi(argv[++i], nullptr, 0);
+        else if (std::string(argv[i]) == "-O0")
+            optimizations.level = optimization_level::none;
+        else if (std::string(argv[i]) == "-O1")
+            optimizations.level = optimization_level::basic;
+        else if (std::string(argv[i]) == "-O2")
+            optimizations.level = optimization_level::speed;
+        else if (std::string(argv[i]) == "-Os")
+            optimizations.level = optimization_level::size;
+        else if (std::string(argv[i]) == "--enable-pass" && i + 1 < argc)
+            optimizations.enabled_passes.emplace_back(argv[++i]);
+        else if (std::string(argv[i]) == "--disable-pass" && i + 1 < argc)
+            optimizations.disabled_passes.emplace_back(argv[++i]);
+        else if (std::string(argv[i]) == "--time-passes")
+            optimizations.time_passes = true;
+        else if (std::string(argv[i]) == "--list-passes")
+        {
+            for (const auto &name : mos6502_target::get_pass_names())
+                std::cout << name << '\n';
+            return 0;
+        }
+        else if (argv[i][0] != '-')
+            files.emplace_back(argv[i]);
+    }
+
+    try
+    {
+        mos6502_target target{convention, instructions, origin, optimizations};
+        ca::cross_assembler assembler{target};
+
+        if (files.empty())
+        {
+            assembler.assemble();
+        }
+        else
+        {
+            // Several files are linked into one program, so that calls between them are resolved and the zero
+            // page and static frames are shared by all of them
+            std::vector<std::string> units;
+            for (const auto &file : files)
+            {
+                std::ifstream input{file};
+                if (!input)
+                    throw std::runtime_error("Cannot open " + file);
+
+                std::stringstream text;
+                text << input.rdbuf();
+                units.emplace_back(text.str());
+            }
+
+            assembler.assemble(ca::link(units));
+        }
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << e.what() << '\n';
+        return 1;
+    }
 
     return 0;
 }